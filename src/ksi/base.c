@@ -205,6 +205,10 @@ static void initOptions(KSI_CTX *ctx) {
 	KSI_CTX_setOption(ctx, KSI_OPT_PUBFILE_CACHE_TTL_SECONDS, (void*)KSI_CTX_PUBFILE_CACHE_DEFAULT_TTL);
 
 	KSI_CTX_setOption(ctx, KSI_OPT_HA_SAFEGUARD, (void*)KSI_CTX_HA_MAX_SUBSERVICES);
+
+	KSI_CTX_setOption(ctx, KSI_OPT_OBJECT_POOL_SIZE, (void*)0);
+
+	KSI_CTX_setOption(ctx, KSI_OPT_IO_MAP_WINDOW_SIZE, (void*)0);
 }
 
 /**
@@ -288,6 +292,12 @@ int KSI_CTX_new(KSI_CTX **context) {
 	ctx->dataHashRecycle = NULL;
 	ctx->asyncHandleRecycle = NULL;
 	ctx->haRequestRecycle = NULL;
+	memset(ctx->hmacCache, 0, sizeof(ctx->hmacCache));
+	ctx->hmacCacheNext = 0;
+	memset(ctx->hasherPrototype, 0, sizeof(ctx->hasherPrototype));
+	memset(ctx->templateIndex, 0, sizeof(ctx->templateIndex));
+	memset(ctx->objectPool, 0, sizeof(ctx->objectPool));
+	memset(ctx->objectPoolLen, 0, sizeof(ctx->objectPoolLen));
 	ctx->cleanupFnList = NULL;
 	ctx->globalObjList = NULL;
 	ctx->registerGlobalObject = registerGlobalObject;
@@ -417,6 +427,8 @@ static void globalCleanup(KSI_CTX *ctx) {
  *
  */
 void KSI_CTX_free(KSI_CTX *ctx) {
+	size_t i;
+
 	if (ctx != NULL) {
 		/* Call cleanup methods. */
 		globalCleanup(ctx);
@@ -438,6 +450,23 @@ void KSI_CTX_free(KSI_CTX *ctx) {
 		KSI_DataHashList_free(ctx->dataHashRecycle);
 		KSI_AsyncHandleList_free(ctx->asyncHandleRecycle);
 		KSI_HighAvailabilityRequestList_free(ctx->haRequestRecycle);
+		for (i = 0; i < KSI_HMAC_CACHE_SIZE; i++) {
+			KSI_HmacHasher_free(ctx->hmacCache[i]);
+		}
+		for (i = 0; i < KSI_NUMBER_OF_KNOWN_HASHALGS; i++) {
+			KSI_DataHasher_free(ctx->hasherPrototype[i]);
+		}
+		for (i = 0; i < KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE; i++) {
+			KSI_TlvTemplateIndex_free(ctx->templateIndex[i]);
+		}
+		for (i = 0; i < KSI_OBJECT_POOL_CLASSES; i++) {
+			while (ctx->objectPool[i] != NULL) {
+				void *next = *(void **)ctx->objectPool[i];
+				KSI_free(ctx->objectPool[i]);
+				ctx->objectPool[i] = next;
+			}
+			ctx->objectPoolLen[i] = 0;
+		}
 
 		KSI_free(ctx);
 	}
@@ -1114,6 +1143,52 @@ cleanup:
 	return res;
 }
 
+/* Size class of the pooled object, objects of the same class share the allocation size. */
+#define OBJECT_POOL_CLASS(size) (((size) + 15) / 16 - 1)
+#define OBJECT_POOL_MAX_SIZE (KSI_OBJECT_POOL_CLASSES * 16)
+
+void *KSI_CTX_poolAlloc(KSI_CTX *ctx, size_t size) {
+	size_t cls;
+	void *ptr = NULL;
+
+	if (size == 0 || size > OBJECT_POOL_MAX_SIZE) return KSI_malloc(size);
+
+	cls = OBJECT_POOL_CLASS(size);
+
+	if (ctx != NULL && ctx->objectPool[cls] != NULL) {
+		ptr = ctx->objectPool[cls];
+		ctx->objectPool[cls] = *(void **)ptr;
+		ctx->objectPoolLen[cls]--;
+	} else {
+		/* Allocate the full class size, so the block can be reused for any object of the class. */
+		ptr = KSI_malloc((cls + 1) * 16);
+	}
+
+	return ptr;
+}
+
+void KSI_CTX_poolFree(KSI_CTX *ctx, void *ptr, size_t size) {
+	size_t cls;
+
+	if (ptr == NULL) return;
+
+	if (ctx == NULL || size == 0 || size > OBJECT_POOL_MAX_SIZE) {
+		KSI_free(ptr);
+		return;
+	}
+
+	cls = OBJECT_POOL_CLASS(size);
+
+	if (ctx->objectPoolLen[cls] >= ctx->options[KSI_OPT_OBJECT_POOL_SIZE]) {
+		KSI_free(ptr);
+		return;
+	}
+
+	*(void **)ptr = ctx->objectPool[cls];
+	ctx->objectPool[cls] = ptr;
+	ctx->objectPoolLen[cls]++;
+}
+
 int KSI_CTX_setOption(KSI_CTX *ctx, KSI_Option opt, void *param) {
 	if (ctx == NULL || opt >= __KSI_NUMBER_OF_OPTIONS) return KSI_INVALID_ARGUMENT;
 	ctx->options[opt] = (size_t)param;
@@ -17,12 +17,22 @@
  * reserves and retains all trademark rights.
  */
 
+#include <string.h>
 
 #include "internal.h"
 #include "blocksigner.h"
 #include "tree_builder.h"
 #include "hashchain.h"
+#include "net_async.h"
 #include "signature_builder.h"
+#include "fast_tlv.h"
+#include "tlv_template.h"
+#include "impl/signature_impl.h"
+
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationHashChain);
+
+/* Maximum length of a serialized signature, including the TLV16 header. */
+#define BLOCK_SIGNATURE_MAX_LEN (0xffff + 4)
 
 
 KSI_IMPLEMENT_LIST(KSI_BlockSignerHandle, KSI_BlockSignerHandle_free)
@@ -38,11 +48,39 @@ struct KSI_BlockSigner_st {
 	KSI_OctetString *iv;
 	KSI_MetaData *metaData;
 
+	/** Leafs in the order of adding, used for the bulk signature output. */
+	KSI_LIST(KSI_TreeLeafHandle) *leafList;
+
 	/** Common hasher object. */
 	KSI_DataHasher *hsr;
 
 	KSI_TreeBuilderLeafProcessor metaDataProcessor;
 	KSI_TreeBuilderLeafProcessor maskingProcessor;
+
+	/** Async service of the pipelined mode, \c NULL in the synchronous mode. */
+	KSI_AsyncService *service;
+	/** Completion callback and its user pointer for the pipelined mode. */
+	KSI_BlockSignerCallback_Completion completion;
+	void *completionUserp;
+	/** Seal thresholds of the pipelined mode. */
+	size_t options[__KSI_BLOCK_SIGNER_OPT_COUNT];
+	/** The block collecting the leafs in the pipelined mode. */
+	KSI_BlockSigner *block;
+	/** Sealed blocks waiting for the signature. */
+	KSI_BlockSigner *pendingBlocks;
+	size_t pendingCount;
+	/** Sealed blocks waiting for a free slot in the request cache of the service, in the order of sealing. */
+	KSI_BlockSigner *queuedBlocks;
+	size_t queuedCount;
+
+	/** Pipelined block signer of a block that is waiting for the signature. */
+	KSI_BlockSigner *pipeline;
+	/** Next block in the list of the pending or the queued blocks. */
+	KSI_BlockSigner *nextPending;
+	/** Time of adding the first leaf to the block. */
+	uint64_t openTime;
+	/** Input data size reported for the block. */
+	size_t inputSize;
 };
 
 struct KSI_BlockSignerHandle_st {
@@ -53,6 +91,7 @@ struct KSI_BlockSignerHandle_st {
 };
 
 static KSI_IMPLEMENT_REF(KSI_BlockSignerHandle)
+KSI_IMPLEMENT_REF(KSI_BlockSigner)
 
 void KSI_BlockSignerHandle_free(KSI_BlockSignerHandle *handle) {
 	if (handle != NULL && --handle->ref == 0) {
@@ -271,6 +310,20 @@ int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algoId, KSI_DataHash *pr
 	tmp->iv = NULL;
 	tmp->metaData = NULL;
 	tmp->hsr = NULL;
+	tmp->leafList = NULL;
+	tmp->service = NULL;
+	tmp->completion = NULL;
+	tmp->completionUserp = NULL;
+	memset(tmp->options, 0, sizeof(tmp->options));
+	tmp->block = NULL;
+	tmp->pendingBlocks = NULL;
+	tmp->pendingCount = 0;
+	tmp->queuedBlocks = NULL;
+	tmp->queuedCount = 0;
+	tmp->pipeline = NULL;
+	tmp->nextPending = NULL;
+	tmp->openTime = 0;
+	tmp->inputSize = 0;
 
 	tmp->metaDataProcessor.c = tmp;
 	tmp->metaDataProcessor.fn = metaDataProcessor;
@@ -286,6 +339,9 @@ int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algoId, KSI_DataHash *pr
 	res = KSI_TreeBuilder_new(ctx, algoId, &tmp->builder);
 	if (res != KSI_OK) goto cleanup;
 
+	res = KSI_TreeLeafHandleList_new(&tmp->leafList);
+	if (res != KSI_OK) goto cleanup;
+
 	tmp->prevLeaf = KSI_DataHash_ref(prevLeaf);
 	tmp->origPrevLeaf = KSI_DataHash_ref(prevLeaf);
 	tmp->iv = KSI_OctetString_ref(initVal);
@@ -325,14 +381,49 @@ cleanup:
 	return res;
 }
 
+static void removePendingBlock(KSI_BlockSigner *signer, KSI_BlockSigner *block) {
+	KSI_BlockSigner **pp = &signer->pendingBlocks;
+
+	while (*pp != NULL) {
+		if (*pp == block) {
+			*pp = block->nextPending;
+			signer->pendingCount--;
+			break;
+		}
+		pp = &(*pp)->nextPending;
+	}
+
+	block->nextPending = NULL;
+	block->pipeline = NULL;
+}
+
 void KSI_BlockSigner_free(KSI_BlockSigner *signer) {
 	if (signer != NULL && --signer->ref == 0) {
+		/* A block still waiting for its signature. */
+		if (signer->pipeline != NULL) removePendingBlock(signer->pipeline, signer);
+
+		/* The async service still holds the pending blocks, their completion is dropped. */
+		while (signer->pendingBlocks != NULL) {
+			removePendingBlock(signer, signer->pendingBlocks);
+		}
+
+		/* The blocks that have not been submitted yet are dropped as well. */
+		while (signer->queuedBlocks != NULL) {
+			KSI_BlockSigner *block = signer->queuedBlocks;
+
+			signer->queuedBlocks = block->nextPending;
+			block->nextPending = NULL;
+			KSI_BlockSigner_free(block);
+		}
+
+		KSI_BlockSigner_free(signer->block);
 		KSI_TreeBuilder_free(signer->builder);
 		KSI_Signature_free(signer->signature);
 		KSI_OctetString_free(signer->iv);
 		KSI_DataHash_free(signer->prevLeaf);
 		KSI_DataHash_free(signer->origPrevLeaf);
 		KSI_DataHasher_free(signer->hsr);
+		KSI_TreeLeafHandleList_free(signer->leafList);
 		KSI_free(signer);
 	}
 }
@@ -347,6 +438,11 @@ int KSI_BlockSigner_closeAndSign(KSI_BlockSigner *signer) {
 
 	KSI_ERR_clearErrors(signer->ctx);
 
+	if (signer->service != NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The blocks of a pipelined block signer are sealed with KSI_BlockSigner_seal.");
+		goto cleanup;
+	}
+
 	KSI_LOG_debug(signer->ctx, "Closing block signer instance.");
 
 	/* Finalize the tree. */
@@ -380,6 +476,7 @@ int KSI_BlockSigner_close(KSI_BlockSigner *signer, void KSI_UNUSED(*dummy)) {
 int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_TreeBuilder *builder = NULL;
+	KSI_LIST(KSI_TreeLeafHandle) *leafList = NULL;
 
 	if (signer == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -394,9 +491,23 @@ int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
 		goto cleanup;
 	}
 
+	res = KSI_TreeLeafHandleList_new(&leafList);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
 	KSI_Signature_free(signer->signature);
 	signer->signature = NULL;
 
+	/* Drop the unsealed block of the pipelined mode. */
+	KSI_BlockSigner_free(signer->block);
+	signer->block = NULL;
+
+	KSI_TreeLeafHandleList_free(signer->leafList);
+	signer->leafList = leafList;
+	leafList = NULL;
+
 	KSI_TreeBuilder_free(signer->builder);
 	signer->builder = builder;
 	builder = NULL;
@@ -422,6 +533,358 @@ int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
 cleanup:
 
 	KSI_TreeBuilder_free(builder);
+	KSI_TreeLeafHandleList_free(leafList);
+
+	return res;
+}
+
+static int openBlock(KSI_BlockSigner *signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *tmp = NULL;
+
+	res = KSI_BlockSigner_new(signer->ctx, signer->builder->algo, NULL, NULL, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Continue the masking chain of the previous block. */
+	tmp->prevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+	tmp->origPrevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+	tmp->iv = KSI_OctetString_ref(signer->iv);
+	tmp->openTime = KSI_getMonotonicTimeMs();
+
+	signer->block = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_BlockSigner_free(tmp);
+
+	return res;
+}
+
+static int isSealDue(const KSI_BlockSigner *signer) {
+	const KSI_BlockSigner *block = signer->block;
+	size_t count;
+
+	if (block == NULL || (count = KSI_TreeLeafHandleList_length(block->leafList)) == 0) return 0;
+
+	if (signer->options[KSI_BLOCK_SIGNER_OPT_MAX_LEAVES] > 0 && count >= signer->options[KSI_BLOCK_SIGNER_OPT_MAX_LEAVES]) return 1;
+	if (signer->options[KSI_BLOCK_SIGNER_OPT_MAX_BYTES] > 0 && block->inputSize >= signer->options[KSI_BLOCK_SIGNER_OPT_MAX_BYTES]) return 1;
+	if (signer->options[KSI_BLOCK_SIGNER_OPT_MAX_AGE] > 0 &&
+			KSI_getMonotonicTimeMs() - block->openTime >= signer->options[KSI_BLOCK_SIGNER_OPT_MAX_AGE]) return 1;
+
+	return 0;
+}
+
+static void blockRequestCtxFree(void *block) {
+	KSI_BlockSigner_free((KSI_BlockSigner *)block);
+}
+
+static int submitQueuedBlocks(KSI_BlockSigner *signer);
+
+static int blockSignedCallback(KSI_CTX KSI_UNUSED(*ctx), KSI_AsyncHandle *handle, int state, void KSI_UNUSED(*userp)) {
+	int res = KSI_UNKNOWN_ERROR;
+	int submitRes = KSI_UNKNOWN_ERROR;
+	const void *reqCtx = NULL;
+	KSI_BlockSigner *block = NULL;
+	KSI_BlockSigner *signer = NULL;
+
+	res = KSI_AsyncHandle_getRequestCtx(handle, &reqCtx);
+	if (res != KSI_OK || reqCtx == NULL) goto cleanup;
+
+	block = (KSI_BlockSigner *)reqCtx;
+	signer = block->pipeline;
+
+	/* The pipelined block signer has been freed meanwhile. */
+	if (signer == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	removePendingBlock(signer, block);
+
+	if (state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+		res = KSI_AsyncHandle_getSignature(handle, &block->signature);
+	} else if (KSI_AsyncHandle_getError(handle, &res) != KSI_OK || res == KSI_OK) {
+		res = KSI_UNKNOWN_ERROR;
+	}
+
+	res = signer->completion(block, res, signer->completionUserp);
+
+	/* The request cache slot of the block has been freed, submit the blocks waiting for it. */
+	submitRes = submitQueuedBlocks(signer);
+	if (res == KSI_OK) res = submitRes;
+
+cleanup:
+
+	return res;
+}
+
+static int submitBlock(KSI_BlockSigner *signer, KSI_BlockSigner *block) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_DataHash *rootHash = NULL;
+	KSI_TreeNode *root = block->builder->rootNode;
+
+	res = KSI_AsyncSigningHandle_new(signer->ctx, rootHash = KSI_DataHash_ref(root->hash), root->level, &handle);
+	if (res != KSI_OK) goto cleanup;
+	rootHash = NULL;
+
+	res = KSI_AsyncHandle_setCompletionCallback(handle, blockSignedCallback);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AsyncHandle_setRequestCtx(handle, KSI_BlockSigner_ref(block), blockRequestCtxFree);
+	if (res != KSI_OK) {
+		KSI_BlockSigner_free(block);
+		goto cleanup;
+	}
+
+	block->pipeline = signer;
+	block->nextPending = signer->pendingBlocks;
+	signer->pendingBlocks = block;
+	signer->pendingCount++;
+
+	res = KSI_AsyncService_addRequest(signer->service, handle);
+	if (res != KSI_OK) goto cleanup;
+	handle = NULL;
+
+	KSI_LOG_debug(signer->ctx, "Block of %llu leafs submitted for signing.", (unsigned long long)KSI_TreeLeafHandleList_length(block->leafList));
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK && block->pipeline != NULL) removePendingBlock(signer, block);
+
+	KSI_DataHash_free(rootHash);
+	KSI_AsyncHandle_free(handle);
+
+	return res;
+}
+
+static int submitQueuedBlocks(KSI_BlockSigner *signer) {
+	int res = KSI_OK;
+
+	while (signer->queuedBlocks != NULL) {
+		KSI_BlockSigner *block = signer->queuedBlocks;
+
+		signer->queuedBlocks = block->nextPending;
+		signer->queuedCount--;
+		block->nextPending = NULL;
+
+		res = submitBlock(signer, block);
+		if (res == KSI_ASYNC_REQUEST_CACHE_FULL) {
+			/* Keep the block until a slot of the request cache is freed by a finished request. */
+			block->nextPending = signer->queuedBlocks;
+			signer->queuedBlocks = block;
+			signer->queuedCount++;
+			res = KSI_OK;
+			break;
+		}
+
+		/* The leafs have been accepted already, thus report the failure via the completion callback. */
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Unable to submit the sealed block for signing.");
+			signer->completion(block, res, signer->completionUserp);
+		}
+
+		KSI_BlockSigner_free(block);
+		if (res != KSI_OK) break;
+	}
+
+	return res;
+}
+
+static int sealBlock(KSI_BlockSigner *signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *block = NULL;
+	KSI_BlockSigner **pp = NULL;
+
+	block = signer->block;
+	signer->block = NULL;
+
+	/* The next block continues the masking chain. */
+	KSI_DataHash_free(signer->prevLeaf);
+	signer->prevLeaf = KSI_DataHash_ref(block->prevLeaf);
+
+	res = KSI_TreeBuilder_close(block->builder);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		/* The leafs have been accepted already, thus report the failure via the completion callback. */
+		signer->completion(block, res, signer->completionUserp);
+		KSI_BlockSigner_free(block);
+		goto cleanup;
+	}
+
+	KSI_LOG_debug(signer->ctx, "Block of %llu leafs sealed for signing.", (unsigned long long)KSI_TreeLeafHandleList_length(block->leafList));
+
+	/* Append to the queue, so that the blocks are submitted in the order of sealing. */
+	pp = &signer->queuedBlocks;
+	while (*pp != NULL) pp = &(*pp)->nextPending;
+	*pp = block;
+	signer->queuedCount++;
+
+	res = submitQueuedBlocks(signer);
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_setOption(KSI_BlockSigner *signer, int option, void *value) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL || option < 0 || option >= __KSI_BLOCK_SIGNER_OPT_COUNT) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	signer->options[option] = (size_t)value;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_setAsyncService(KSI_BlockSigner *signer, KSI_AsyncService *service, KSI_BlockSignerCallback_Completion callback, void *userp) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL || service == NULL || callback == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (KSI_TreeLeafHandleList_length(signer->leafList) > 0 || signer->signature != NULL || signer->block != NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "Leafs have already been added to the block signer.");
+		goto cleanup;
+	}
+
+	signer->service = service;
+	signer->completion = callback;
+	signer->completionUserp = userp;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_addInputSize(KSI_BlockSigner *signer, size_t size) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (signer->service == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The block signer is not in the pipelined mode.");
+		goto cleanup;
+	}
+
+	if (signer->block == NULL) {
+		res = openBlock(signer);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	signer->block->inputSize += size;
+
+	/* A failure has been reported via the completion callback. */
+	if (isSealDue(signer)) {
+		sealBlock(signer);
+	} else {
+		submitQueuedBlocks(signer);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_seal(KSI_BlockSigner *signer, int force) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (signer->service == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The block signer is not in the pipelined mode.");
+		goto cleanup;
+	}
+
+	if (signer->block != NULL && KSI_TreeLeafHandleList_length(signer->block->leafList) > 0 && (force || isSealDue(signer))) {
+		res = sealBlock(signer);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = submitQueuedBlocks(signer);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_getPendingCount(const KSI_BlockSigner *signer, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*count = signer->pendingCount + signer->queuedCount;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int addPipelinedLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer->block == NULL) {
+		res = openBlock(signer);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_BlockSigner_addLeaf(signer->block, hsh, level, metaData, handle);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The leaf has been accepted, a failure of the sealed block is reported via the completion callback. */
+	if (isSealDue(signer)) {
+		sealBlock(signer);
+	} else {
+		submitQueuedBlocks(signer);
+	}
+
+	res = KSI_OK;
+
+cleanup:
 
 	return res;
 }
@@ -439,6 +902,11 @@ int KSI_BlockSigner_addLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int leve
 
 	KSI_ERR_clearErrors(signer->ctx);
 
+	if (signer->service != NULL) {
+		res = addPipelinedLeaf(signer, hsh, level, metaData, handle);
+		goto cleanup;
+	}
+
 	/* Make sure the input hash algorithm is still trusted. */
 	res = KSI_DataHash_extract(hsh, &algoId, NULL, NULL);
 	if (res != KSI_OK) {
@@ -460,6 +928,19 @@ int KSI_BlockSigner_addLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int leve
 		goto cleanup;
 	}
 
+	{
+		KSI_TreeLeafHandle *ref = NULL;
+
+		res = KSI_TreeLeafHandleList_append(signer->leafList, ref = KSI_TreeLeafHandle_ref(leafHandle));
+		if (res != KSI_OK) {
+			/* Cleanup the reference. */
+			KSI_TreeLeafHandle_free(ref);
+
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
 	res = KSI_BlockSignerHandle_new(signer->ctx, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(signer->ctx, res, NULL);
@@ -500,7 +981,8 @@ int KSI_BlockSigner_getPrevLeaf(const KSI_BlockSigner *signer, KSI_DataHash **pr
 
 	KSI_ERR_clearErrors(signer->ctx);
 
-	*prevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+	/* In the pipelined mode the masking chain continues in the current block. */
+	*prevLeaf = KSI_DataHash_ref(signer->block != NULL ? signer->block->prevLeaf : signer->prevLeaf);
 
 	res = KSI_OK;
 
@@ -583,3 +1065,1234 @@ cleanup:
 
 	return res;
 }
+
+/* Adds (or subtracts) the level to the level correction of the first link of the aggregation hash chain. */
+static int updateFirstLinkLevel(KSI_CTX *ctx, KSI_AggregationHashChain *aggr, KSI_uint64_t level, int subtract) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_LIST(KSI_HashChainLink) *chain = NULL;
+	KSI_HashChainLink *link = NULL;
+	KSI_Integer *oldLvl = NULL;
+	KSI_Integer *newLvl = NULL;
+	KSI_uint64_t lvlVal;
+
+	res = KSI_AggregationHashChain_getChain(aggr, &chain);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HashChainLinkList_elementAt(chain, 0, &link);
+	if (res != KSI_OK || link == NULL) {
+		KSI_pushError(ctx, res = (res != KSI_OK ? res : KSI_INVALID_STATE), NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HashChainLink_getLevelCorrection(link, &oldLvl);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	lvlVal = KSI_Integer_getUInt64(oldLvl);
+	if (subtract) {
+		if (lvlVal < level) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Calculated level correction is not valid.");
+			goto cleanup;
+		}
+		lvlVal -= level;
+	} else {
+		lvlVal += level;
+	}
+
+	if (!KSI_IS_VALID_TREE_LEVEL(lvlVal)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Calculated level correction is not valid.");
+		goto cleanup;
+	}
+
+	res = KSI_Integer_new(ctx, lvlVal, &newLvl);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HashChainLink_setLevelCorrection(link, newLvl);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	newLvl = NULL;
+
+	KSI_Integer_free(oldLvl);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(newLvl);
+
+	return res;
+}
+
+/**
+ * Writes the payload of the block signature, shared by all the leaf signatures, into the buffer. The level of
+ * the block root is removed from the level correction of the first aggregation hash chain, as it is accounted
+ * for by the aggregation hash chain of the leaf.
+ */
+static int writeSharedElements(KSI_CTX *ctx, const KSI_Signature *signature, unsigned rootLevel, const unsigned char *raw, size_t raw_len, unsigned char *buf, size_t buf_size, size_t *buf_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	const unsigned char *payload = NULL;
+	size_t payload_len;
+	size_t offset = 0;
+	size_t len = 0;
+	KSI_AggregationHashChain *rootChain = NULL;
+	KSI_AggregationHashChain *aggr = NULL;
+	int adjusted = 0;
+
+	res = KSI_FTLV_memRead(raw, raw_len, &ftlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	payload = raw + ftlv.hdr_len;
+	payload_len = ftlv.dat_len;
+
+	/* The first aggregation hash chain is the one with the longest chain index. */
+	res = KSI_AggregationHashChainList_elementAt(signature->aggregationChainList, 0, &rootChain);
+	if (res != KSI_OK || rootChain == NULL) {
+		KSI_pushError(ctx, res = (res != KSI_OK ? res : KSI_INVALID_STATE), "Signature does not contain any aggregation hash chains.");
+		goto cleanup;
+	}
+
+	while (offset < payload_len) {
+		size_t elem_len;
+		size_t tmp_len = 0;
+
+		res = KSI_FTLV_memRead(payload + offset, payload_len - offset, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		elem_len = ftlv.hdr_len + ftlv.dat_len;
+
+		if (rootLevel != 0 && !adjusted && ftlv.tag == 0x0801) {
+			res = KSI_AggregationHashChain_new(ctx, &aggr);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = KSI_TlvTemplate_parse(ctx, payload + offset, elem_len, KSI_TLV_TEMPLATE(KSI_AggregationHashChain), aggr);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			if (KSI_AggregationHashChain_compare((const KSI_AggregationHashChain **)&aggr, (const KSI_AggregationHashChain **)&rootChain) == 0) {
+				res = updateFirstLinkLevel(ctx, aggr, rootLevel, 1);
+				if (res != KSI_OK) goto cleanup;
+
+				res = KSI_AggregationHashChain_writeBytes(aggr, buf + len, buf_size - len, &tmp_len, 0);
+				if (res != KSI_OK) {
+					KSI_pushError(ctx, res, NULL);
+					goto cleanup;
+				}
+				adjusted = 1;
+			}
+
+			KSI_AggregationHashChain_free(aggr);
+			aggr = NULL;
+		}
+
+		if (tmp_len == 0) {
+			if (buf_size - len < elem_len) {
+				KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, NULL);
+				goto cleanup;
+			}
+			memcpy(buf + len, payload + offset, elem_len);
+			tmp_len = elem_len;
+		}
+
+		len += tmp_len;
+		offset += elem_len;
+	}
+
+	if (rootLevel != 0 && !adjusted) {
+		KSI_pushError(ctx, res = KSI_INVALID_STATE, "Unable to find the aggregation hash chain of the block signature.");
+		goto cleanup;
+	}
+
+	*buf_len = len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationHashChain_free(aggr);
+
+	return res;
+}
+
+/* Writes the aggregation hash chain of the leaf, extended with the chain index and aggregation time of the block signature. */
+static int writeLeafChain(KSI_BlockSigner *signer, const KSI_TreeLeafHandle *leaf, unsigned char *buf, size_t buf_size, size_t *buf_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationHashChain *aggr = NULL;
+	KSI_AggregationHashChain *rootChain = NULL;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_LIST(KSI_Integer) *rootIndex = NULL;
+	KSI_LIST(KSI_Integer) *chainIndex = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *shape = NULL;
+	KSI_TreeNode *node = NULL;
+	KSI_uint64_t shapeVal;
+	size_t i;
+
+	res = KSI_TreeLeafHandle_getAggregationChain(leaf, &aggr);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_getChain(aggr, &links);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* A leaf without any links is the root of the block - the block signature is used as is. */
+	if (KSI_HashChainLinkList_length(links) == 0) {
+		*buf_len = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_TreeLeafHandle_getTreeNode(leaf, &node);
+	if (res != KSI_OK || node == NULL) {
+		KSI_pushError(signer->ctx, res = (res != KSI_OK ? res : KSI_INVALID_FORMAT), "Leaf node is missing.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_getSigningTime(signer->signature, &aggrTime);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_setAggregationTime(aggr, KSI_Integer_ref(aggrTime));
+	if (res != KSI_OK) {
+		KSI_Integer_free(aggrTime);
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The chain index of the leaf is the chain index of the block signature followed by the shape of the leaf chain. */
+	res = KSI_AggregationHashChainList_elementAt(signer->signature->aggregationChainList, 0, &rootChain);
+	if (res != KSI_OK || rootChain == NULL) {
+		KSI_pushError(signer->ctx, res = (res != KSI_OK ? res : KSI_INVALID_STATE), NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_getChainIndex(rootChain, &rootIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_IntegerList_new(&chainIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < KSI_IntegerList_length(rootIndex); i++) {
+		KSI_Integer *tmp = NULL;
+		KSI_Integer *ref = NULL;
+
+		res = KSI_IntegerList_elementAt(rootIndex, i, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_IntegerList_append(chainIndex, ref = KSI_Integer_ref(tmp));
+		if (res != KSI_OK) {
+			/* Cleanup the reference. */
+			KSI_Integer_free(ref);
+
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_AggregationHashChain_calculateShape(aggr, &shapeVal);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Integer_new(signer->ctx, shapeVal, &shape);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_IntegerList_append(chainIndex, shape);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	shape = NULL;
+
+	res = KSI_AggregationHashChain_setChainIndex(aggr, chainIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	chainIndex = NULL;
+
+	/* Add the level of the leaf, as done by #KSI_SignatureBuilder_close. */
+	if (node->level != 0) {
+		res = updateFirstLinkLevel(signer->ctx, aggr, node->level, 0);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_writeBytes(aggr, buf, buf_size, buf_len, 0);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(shape);
+	KSI_IntegerList_free(chainIndex);
+	KSI_AggregationHashChain_free(aggr);
+
+	return res;
+}
+
+int KSI_BlockSigner_writeSignatures(KSI_BlockSigner *signer, int (*sink)(void *, size_t, const unsigned char *, size_t), void *sinkCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char *buf = NULL;
+	size_t shared_len = 0;
+	size_t i;
+
+	if (signer == NULL || sink == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (signer->signature == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The blocksigner is not closed.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_serialize(signer->signature, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* A single buffer is used for all the signatures: the TLV header, the shared elements and the leaf chain. */
+	buf = KSI_malloc(BLOCK_SIGNATURE_MAX_LEN);
+	if (buf == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = writeSharedElements(signer->ctx, signer->signature, signer->builder->rootNode->level, raw, raw_len, buf + 4, BLOCK_SIGNATURE_MAX_LEN - 4, &shared_len);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < KSI_TreeLeafHandleList_length(signer->leafList); i++) {
+		KSI_TreeLeafHandle *leaf = NULL;
+		size_t chain_len = 0;
+		size_t payload_len;
+
+		res = KSI_TreeLeafHandleList_elementAt(signer->leafList, i, &leaf);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = writeLeafChain(signer, leaf, buf + 4 + shared_len, BLOCK_SIGNATURE_MAX_LEN - 4 - shared_len, &chain_len);
+		if (res != KSI_OK) goto cleanup;
+
+		if (chain_len == 0) {
+			res = sink(sinkCtx, i, raw, raw_len);
+		} else {
+			payload_len = shared_len + chain_len;
+
+			/* Encode the signature header as TLV16. */
+			buf[0] = (unsigned char)(KSI_TLV_MASK_TLV16 | (0x0800 >> 8));
+			buf[1] = 0x0800 & 0xff;
+			buf[2] = (unsigned char)((payload_len >> 8) & 0xff);
+			buf[3] = (unsigned char)(payload_len & 0xff);
+
+			res = sink(sinkCtx, i, buf, payload_len + 4);
+		}
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Signature sink returned an error.");
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(buf);
+	KSI_free(raw);
+
+	return res;
+}
+
+/* Magic bytes at the beginning of a block proof. */
+#define BLOCK_PROOF_MAGIC "KSIBLKPF"
+#define BLOCK_PROOF_MAGIC_LEN (sizeof(BLOCK_PROOF_MAGIC) - 1)
+
+/* Version of the block proof format. */
+#define BLOCK_PROOF_VERSION 1
+
+/* Tags of the block proof elements, see #KSI_BlockSigner_writeProof. */
+#define BLOCK_PROOF_TAG_HEADER 0x0b01
+#define BLOCK_PROOF_TAG_LEAF 0x0b02
+
+/* Tags of the block proof header fields. */
+#define BLOCK_PROOF_HDR_LEAF_COUNT 0x01
+#define BLOCK_PROOF_HDR_ROOT_LEVEL 0x02
+#define BLOCK_PROOF_HDR_CHAIN_TEMPLATE 0x03
+#define BLOCK_PROOF_HDR_VERSION 0x04
+
+struct KSI_BlockProof_st {
+	KSI_CTX *ctx;
+
+	/** Copy of the serialized block proof. */
+	unsigned char *raw;
+	size_t raw_len;
+
+	size_t leafCount;
+	unsigned rootLevel;
+
+	/** Elements of the leaf aggregation hash chains shared by all the leafs, points into \c raw. */
+	const unsigned char *tmpl;
+	size_t tmpl_len;
+
+	/** The block signature and its serialized form, pointing into \c raw. */
+	KSI_Signature *signature;
+	const unsigned char *sigRaw;
+	size_t sigRaw_len;
+
+	/** Offsets of the leaf records in \c raw. */
+	size_t *leafOffset;
+
+	/** Work buffer for composing the leaf signatures, holds the shared elements after the signature header. */
+	unsigned char *buf;
+	size_t shared_len;
+};
+
+/* Writes the TLV header into the buffer (of at least 4 bytes) and returns its length. */
+static size_t writeTlvHeader(unsigned tag, size_t len, unsigned char *buf) {
+	if (tag <= KSI_TLV_MASK_TLV8_TYPE && len <= 0xff) {
+		buf[0] = (unsigned char)tag;
+		buf[1] = (unsigned char)len;
+		return 2;
+	}
+
+	buf[0] = (unsigned char)(KSI_TLV_MASK_TLV16 | ((tag >> 8) & KSI_TLV_MASK_TLV8_TYPE));
+	buf[1] = (unsigned char)(tag & 0xff);
+	buf[2] = (unsigned char)((len >> 8) & 0xff);
+	buf[3] = (unsigned char)(len & 0xff);
+	return 4;
+}
+
+/* Writes an unsigned integer TLV8 into the buffer (of at least 10 bytes) and returns its length. */
+static size_t writeUintTlv(unsigned tag, KSI_uint64_t val, unsigned char *buf) {
+	size_t len = 0;
+	size_t i;
+
+	while (len < 8 && (val >> (8 * len)) != 0) len++;
+
+	buf[0] = (unsigned char)tag;
+	buf[1] = (unsigned char)len;
+	for (i = 0; i < len; i++) {
+		buf[2 + i] = (unsigned char)((val >> (8 * (len - i - 1))) & 0xff);
+	}
+
+	return len + 2;
+}
+
+static int readUint(const unsigned char *raw, size_t len, KSI_uint64_t *val) {
+	KSI_uint64_t tmp = 0;
+	size_t i;
+
+	if (len > 8) return KSI_INVALID_FORMAT;
+
+	for (i = 0; i < len; i++) {
+		tmp = (tmp << 8) | raw[i];
+	}
+	*val = tmp;
+
+	return KSI_OK;
+}
+
+/**
+ * Splits the serialized aggregation hash chain of a leaf into the elements shared by all the leafs of the
+ * block (the aggregation time, the chain index of the block signature and the hash algorithm) and the record of the
+ * leaf (the shape of the leaf chain, the input hash and the links). Either of the output buffers may be \c NULL.
+ */
+static int splitLeafChain(KSI_CTX *ctx, const unsigned char *chain, size_t chain_len, unsigned char *tmpl, size_t *tmpl_len, unsigned char *rec, size_t *rec_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	const unsigned char *payload = NULL;
+	size_t payload_len;
+	size_t offset;
+	size_t shapeOffset = 0;
+	size_t t_len = 0;
+	size_t r_len = 0;
+
+	res = KSI_FTLV_memRead(chain, chain_len, &ftlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	payload = chain + ftlv.hdr_len;
+	payload_len = ftlv.dat_len;
+
+	/* The last chain index element is the shape of the leaf chain. */
+	for (offset = 0; offset < payload_len; offset += ftlv.hdr_len + ftlv.dat_len) {
+		res = KSI_FTLV_memRead(payload + offset, payload_len - offset, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		if (ftlv.tag == 0x03) shapeOffset = offset;
+	}
+
+	for (offset = 0; offset < payload_len; offset += ftlv.hdr_len + ftlv.dat_len) {
+		int isShared;
+
+		res = KSI_FTLV_memRead(payload + offset, payload_len - offset, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		isShared = ftlv.tag == 0x02 || ftlv.tag == 0x06 || (ftlv.tag == 0x03 && offset != shapeOffset);
+
+		if (isShared && tmpl != NULL) {
+			memcpy(tmpl + t_len, payload + offset, ftlv.hdr_len + ftlv.dat_len);
+			t_len += ftlv.hdr_len + ftlv.dat_len;
+		} else if (!isShared && rec != NULL) {
+			memcpy(rec + r_len, payload + offset, ftlv.hdr_len + ftlv.dat_len);
+			r_len += ftlv.hdr_len + ftlv.dat_len;
+		}
+	}
+
+	if (tmpl_len != NULL) *tmpl_len = t_len;
+	if (rec_len != NULL) *rec_len = r_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_writeProof(KSI_BlockSigner *signer, int (*sink)(void *, const unsigned char *, size_t), void *sinkCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char *chain = NULL;
+	unsigned char *buf = NULL;
+	size_t leafCount;
+	size_t len = 0;
+	size_t hdr_len;
+	size_t i;
+
+	if (signer == NULL || sink == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (signer->signature == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The blocksigner is not closed.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_serialize(signer->signature, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	chain = KSI_malloc(BLOCK_SIGNATURE_MAX_LEN);
+	buf = KSI_malloc(BLOCK_SIGNATURE_MAX_LEN);
+	if (chain == NULL || buf == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	leafCount = KSI_TreeLeafHandleList_length(signer->leafList);
+
+	res = sink(sinkCtx, (const unsigned char *)BLOCK_PROOF_MAGIC, BLOCK_PROOF_MAGIC_LEN);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, "Block proof sink returned an error.");
+		goto cleanup;
+	}
+
+	/* The header: the format version, the leaf count, the level of the block root, the shared leaf chain elements and the block signature. */
+	len = 4;
+	len += writeUintTlv(BLOCK_PROOF_HDR_VERSION, BLOCK_PROOF_VERSION, buf + len);
+	len += writeUintTlv(BLOCK_PROOF_HDR_LEAF_COUNT, leafCount, buf + len);
+	len += writeUintTlv(BLOCK_PROOF_HDR_ROOT_LEVEL, signer->builder->rootNode->level, buf + len);
+
+	if (leafCount > 0) {
+		KSI_TreeLeafHandle *leaf = NULL;
+		size_t chain_len = 0;
+		size_t tmpl_len = 0;
+
+		res = KSI_TreeLeafHandleList_elementAt(signer->leafList, 0, &leaf);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = writeLeafChain(signer, leaf, chain, BLOCK_SIGNATURE_MAX_LEN, &chain_len);
+		if (res != KSI_OK) goto cleanup;
+
+		/* A block with a single leaf does not have any leaf chains. */
+		if (chain_len > 0) {
+			res = splitLeafChain(signer->ctx, chain, chain_len, buf + len + 2, &tmpl_len, NULL, NULL);
+			if (res != KSI_OK) goto cleanup;
+
+			if (tmpl_len > 0xff) {
+				KSI_pushError(signer->ctx, res = KSI_INVALID_FORMAT, "Shared leaf chain elements are too long.");
+				goto cleanup;
+			}
+
+			len += writeTlvHeader(BLOCK_PROOF_HDR_CHAIN_TEMPLATE, tmpl_len, buf + len) + tmpl_len;
+		}
+	}
+
+	if (len - 4 + raw_len > 0xffff) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_FORMAT, "Block signature is too long for the block proof.");
+		goto cleanup;
+	}
+
+	memcpy(buf + len, raw, raw_len);
+	len += raw_len;
+
+	writeTlvHeader(BLOCK_PROOF_TAG_HEADER, len - 4, buf);
+
+	res = sink(sinkCtx, buf, len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, "Block proof sink returned an error.");
+		goto cleanup;
+	}
+
+	/* A record per leaf, in the order the leafs were added. */
+	for (i = 0; i < leafCount; i++) {
+		KSI_TreeLeafHandle *leaf = NULL;
+		size_t chain_len = 0;
+		size_t rec_len = 0;
+
+		res = KSI_TreeLeafHandleList_elementAt(signer->leafList, i, &leaf);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = writeLeafChain(signer, leaf, chain, BLOCK_SIGNATURE_MAX_LEN, &chain_len);
+		if (res != KSI_OK) goto cleanup;
+
+		if (chain_len > 0) {
+			res = splitLeafChain(signer->ctx, chain, chain_len, NULL, NULL, buf + 4, &rec_len);
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		hdr_len = writeTlvHeader(BLOCK_PROOF_TAG_LEAF, rec_len, buf);
+
+		res = sink(sinkCtx, buf, hdr_len + rec_len);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Block proof sink returned an error.");
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(buf);
+	KSI_free(chain);
+	KSI_free(raw);
+
+	return res;
+}
+
+void KSI_BlockProof_free(KSI_BlockProof *proof) {
+	if (proof != NULL) {
+		KSI_Signature_free(proof->signature);
+		KSI_free(proof->leafOffset);
+		KSI_free(proof->buf);
+		KSI_free(proof->raw);
+		KSI_free(proof);
+	}
+}
+
+static int parseProofHeader(KSI_BlockProof *proof, const unsigned char *payload, size_t payload_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	size_t offset;
+	KSI_uint64_t val;
+	int hasLeafCount = 0;
+	int hasVersion = 0;
+
+	for (offset = 0; offset < payload_len; offset += ftlv.hdr_len + ftlv.dat_len) {
+		const unsigned char *dat = NULL;
+
+		res = KSI_FTLV_memRead(payload + offset, payload_len - offset, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(proof->ctx, res, NULL);
+			goto cleanup;
+		}
+		dat = payload + offset + ftlv.hdr_len;
+
+		switch (ftlv.tag) {
+			case BLOCK_PROOF_HDR_VERSION:
+				res = readUint(dat, ftlv.dat_len, &val);
+				if (res != KSI_OK || val != BLOCK_PROOF_VERSION) {
+					KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Unsupported block proof version.");
+					goto cleanup;
+				}
+				hasVersion = 1;
+				break;
+			case BLOCK_PROOF_HDR_LEAF_COUNT:
+				res = readUint(dat, ftlv.dat_len, &val);
+				if (res != KSI_OK || val == 0 || val > proof->raw_len) {
+					KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Invalid leaf count of the block proof.");
+					goto cleanup;
+				}
+				proof->leafCount = (size_t)val;
+				hasLeafCount = 1;
+				break;
+			case BLOCK_PROOF_HDR_ROOT_LEVEL:
+				res = readUint(dat, ftlv.dat_len, &val);
+				if (res != KSI_OK || !KSI_IS_VALID_TREE_LEVEL(val)) {
+					KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Invalid root level of the block proof.");
+					goto cleanup;
+				}
+				proof->rootLevel = (unsigned)val;
+				break;
+			case BLOCK_PROOF_HDR_CHAIN_TEMPLATE:
+				proof->tmpl = dat;
+				proof->tmpl_len = ftlv.dat_len;
+				break;
+			case 0x0800:
+				proof->sigRaw = payload + offset;
+				proof->sigRaw_len = ftlv.hdr_len + ftlv.dat_len;
+				break;
+			default:
+				if (!ftlv.is_nc) {
+					KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Unknown critical element in the block proof header.");
+					goto cleanup;
+				}
+		}
+	}
+
+	if (!hasVersion || !hasLeafCount || proof->sigRaw == NULL) {
+		KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Block proof header is incomplete.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockProof_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_BlockProof **proof) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockProof *tmp = NULL;
+	KSI_FTLV ftlv;
+	size_t offset;
+	size_t count = 0;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || raw == NULL || raw_len == 0 || proof == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_BlockProof);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->raw = NULL;
+	tmp->raw_len = raw_len;
+	tmp->leafCount = 0;
+	tmp->rootLevel = 0;
+	tmp->tmpl = NULL;
+	tmp->tmpl_len = 0;
+	tmp->signature = NULL;
+	tmp->sigRaw = NULL;
+	tmp->sigRaw_len = 0;
+	tmp->leafOffset = NULL;
+	tmp->buf = NULL;
+	tmp->shared_len = 0;
+
+	tmp->raw = KSI_malloc(raw_len);
+	tmp->buf = KSI_malloc(BLOCK_SIGNATURE_MAX_LEN);
+	if (tmp->raw == NULL || tmp->buf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	memcpy(tmp->raw, raw, raw_len);
+
+	if (raw_len < BLOCK_PROOF_MAGIC_LEN || memcmp(raw, BLOCK_PROOF_MAGIC, BLOCK_PROOF_MAGIC_LEN)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Unrecognized block proof header.");
+		goto cleanup;
+	}
+
+	res = KSI_FTLV_memRead(tmp->raw + BLOCK_PROOF_MAGIC_LEN, raw_len - BLOCK_PROOF_MAGIC_LEN, &ftlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (ftlv.tag != BLOCK_PROOF_TAG_HEADER) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Block proof does not start with the header.");
+		goto cleanup;
+	}
+
+	res = parseProofHeader(tmp, tmp->raw + BLOCK_PROOF_MAGIC_LEN + ftlv.hdr_len, ftlv.dat_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Signature_parse(ctx, tmp->sigRaw, tmp->sigRaw_len, &tmp->signature);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The shared elements are written once, the leaf chains are composed after them. */
+	res = writeSharedElements(ctx, tmp->signature, tmp->rootLevel, tmp->sigRaw, tmp->sigRaw_len, tmp->buf + 4, BLOCK_SIGNATURE_MAX_LEN - 4, &tmp->shared_len);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->leafOffset = KSI_calloc(tmp->leafCount, sizeof(size_t));
+	if (tmp->leafOffset == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (offset = BLOCK_PROOF_MAGIC_LEN + ftlv.hdr_len + ftlv.dat_len; offset < raw_len; offset += ftlv.hdr_len + ftlv.dat_len) {
+		res = KSI_FTLV_memRead(tmp->raw + offset, raw_len - offset, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (ftlv.tag != BLOCK_PROOF_TAG_LEAF || count == tmp->leafCount) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Unexpected element in the block proof.");
+			goto cleanup;
+		}
+
+		tmp->leafOffset[count++] = offset;
+	}
+
+	if (count != tmp->leafCount) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Block proof leaf count mismatch.");
+		goto cleanup;
+	}
+
+	*proof = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_BlockProof_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockProof_getLeafCount(const KSI_BlockProof *proof, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (proof == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*count = proof->leafCount;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Composes the aggregation hash chain of the leaf at the given index into the buffer by merging the shared elements
+ * and the leaf record in the order of the tags. The output length is 0 if the leaf is the root of the block.
+ */
+static int composeLeafChain(KSI_BlockProof *proof, size_t index, unsigned char *buf, size_t buf_size, size_t *buf_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	KSI_FTLV tmplTlv;
+	KSI_FTLV recTlv;
+	const unsigned char *rec = NULL;
+	size_t rec_len;
+	size_t tmplOff = 0;
+	size_t recOff = 0;
+	size_t len = 4;
+
+	res = KSI_FTLV_memRead(proof->raw + proof->leafOffset[index], proof->raw_len - proof->leafOffset[index], &ftlv);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	rec = proof->raw + proof->leafOffset[index] + ftlv.hdr_len;
+	rec_len = ftlv.dat_len;
+
+	if (rec_len == 0) {
+		*buf_len = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (proof->tmpl == NULL || buf_size < 4 + proof->tmpl_len + rec_len || proof->tmpl_len + rec_len > 0xffff) {
+		KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Unable to compose the leaf aggregation hash chain.");
+		goto cleanup;
+	}
+
+	while (tmplOff < proof->tmpl_len || recOff < rec_len) {
+		const unsigned char *src = NULL;
+		size_t elem_len;
+
+		if (tmplOff < proof->tmpl_len) {
+			res = KSI_FTLV_memRead(proof->tmpl + tmplOff, proof->tmpl_len - tmplOff, &tmplTlv);
+			if (res != KSI_OK) {
+				KSI_pushError(proof->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		if (recOff < rec_len) {
+			res = KSI_FTLV_memRead(rec + recOff, rec_len - recOff, &recTlv);
+			if (res != KSI_OK) {
+				KSI_pushError(proof->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		/* On equal tags the shared elements go first, as the shape follows the chain index of the block signature. */
+		if (recOff >= rec_len || (tmplOff < proof->tmpl_len && tmplTlv.tag <= recTlv.tag)) {
+			src = proof->tmpl + tmplOff;
+			elem_len = tmplTlv.hdr_len + tmplTlv.dat_len;
+			tmplOff += elem_len;
+		} else {
+			src = rec + recOff;
+			elem_len = recTlv.hdr_len + recTlv.dat_len;
+			recOff += elem_len;
+		}
+
+		memcpy(buf + len, src, elem_len);
+		len += elem_len;
+	}
+
+	writeTlvHeader(0x0801, len - 4, buf);
+
+	*buf_len = len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockProof_getSignature(KSI_BlockProof *proof, size_t index, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Signature *tmp = NULL;
+	size_t chain_len = 0;
+	size_t payload_len;
+
+	if (proof == NULL || sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(proof->ctx);
+
+	if (index >= proof->leafCount) {
+		KSI_pushError(proof->ctx, res = KSI_INVALID_ARGUMENT, "Leaf index out of range.");
+		goto cleanup;
+	}
+
+	res = composeLeafChain(proof, index, proof->buf + 4 + proof->shared_len, BLOCK_SIGNATURE_MAX_LEN - 4 - proof->shared_len, &chain_len);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The root of the block is signed by the block signature itself. */
+	if (chain_len == 0) {
+		res = KSI_Signature_clone(proof->signature, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(proof->ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		payload_len = proof->shared_len + chain_len;
+		if (payload_len > 0xffff) {
+			KSI_pushError(proof->ctx, res = KSI_INVALID_FORMAT, "Leaf signature is too long.");
+			goto cleanup;
+		}
+
+		/* Encode the signature header as TLV16. */
+		proof->buf[0] = (unsigned char)(KSI_TLV_MASK_TLV16 | (0x0800 >> 8));
+		proof->buf[1] = 0x0800 & 0xff;
+		proof->buf[2] = (unsigned char)((payload_len >> 8) & 0xff);
+		proof->buf[3] = (unsigned char)(payload_len & 0xff);
+
+		res = KSI_Signature_parse(proof->ctx, proof->buf, payload_len + 4, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(proof->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Signature_free(tmp);
+
+	return res;
+}
+
+/* Checks that the aggregation hash chain of the leaf aggregates to the root of the block. */
+static int verifyLeafChain(KSI_BlockProof *proof, size_t index, const KSI_AggregationHashChain *rootChain, const KSI_DataHash *rootHash, KSI_VerificationErrorCode *error) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationHashChain *aggr = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_LIST(KSI_Integer) *chainIndex = NULL;
+	KSI_LIST(KSI_Integer) *rootIndex = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *rootTime = NULL;
+	KSI_Integer *shape = NULL;
+	KSI_uint64_t shapeVal;
+	size_t chain_len = 0;
+	size_t prefix_len = 0;
+	size_t i;
+	int endLevel = 0;
+
+	*error = KSI_VER_ERR_NONE;
+
+	res = composeLeafChain(proof, index, proof->buf + 4 + proof->shared_len, BLOCK_SIGNATURE_MAX_LEN - 4 - proof->shared_len, &chain_len);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The root of the block is verified with the block signature. */
+	if (chain_len == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_new(proof->ctx, &aggr);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_parse(proof->ctx, proof->buf + 4 + proof->shared_len, chain_len, KSI_TLV_TEMPLATE(KSI_AggregationHashChain), aggr);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_aggregate(aggr, 0, &endLevel, &hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_calculateShape(aggr, &shapeVal);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_getChainIndex(aggr, &chainIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_IntegerList_elementAt(chainIndex, KSI_IntegerList_length(chainIndex) - 1, &shape);
+	if (res != KSI_OK || shape == NULL) {
+		KSI_pushError(proof->ctx, res = (res != KSI_OK ? res : KSI_INVALID_FORMAT), NULL);
+		goto cleanup;
+	}
+
+	/* The shared header elements have to continue the first aggregation hash chain of the block signature. */
+	res = KSI_AggregationHashChain_getAggregationTime(aggr, &aggrTime);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_getAggregationTime(rootChain, &rootTime);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_getChainIndex(rootChain, &rootIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (!KSI_Integer_equals(aggrTime, rootTime)) {
+		KSI_LOG_info(proof->ctx, "Aggregation time of leaf %llu does not match the block signature.", (unsigned long long)index);
+		*error = KSI_VER_ERR_INT_2;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	prefix_len = KSI_IntegerList_length(rootIndex);
+	for (i = 0; i < prefix_len && KSI_IntegerList_length(chainIndex) == prefix_len + 1; i++) {
+		KSI_Integer *a = NULL;
+		KSI_Integer *b = NULL;
+
+		if (KSI_IntegerList_elementAt(chainIndex, i, &a) != KSI_OK || KSI_IntegerList_elementAt(rootIndex, i, &b) != KSI_OK ||
+				!KSI_Integer_equals(a, b)) break;
+	}
+	if (KSI_IntegerList_length(chainIndex) != prefix_len + 1 || i != prefix_len) {
+		KSI_LOG_info(proof->ctx, "Chain index of leaf %llu does not continue the block signature.", (unsigned long long)index);
+		*error = KSI_VER_ERR_INT_12;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (!KSI_Integer_equalsUInt(shape, shapeVal)) {
+		KSI_LOG_info(proof->ctx, "Chain index of leaf %llu does not match the shape of its hash chain.", (unsigned long long)index);
+		*error = KSI_VER_ERR_INT_10;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (!KSI_DataHash_equals(hsh, rootHash) || endLevel != (int)proof->rootLevel) {
+		KSI_LOG_info(proof->ctx, "Aggregation hash chain of leaf %llu does not match the block root.", (unsigned long long)index);
+		*error = KSI_VER_ERR_INT_1;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(hsh);
+	KSI_AggregationHashChain_free(aggr);
+
+	return res;
+}
+
+int KSI_BlockProof_verify(KSI_BlockProof *proof, const KSI_Policy *policy, KSI_VerificationContext *context, KSI_PolicyVerificationResult **result) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PolicyVerificationResult *tmp = NULL;
+	KSI_Signature *origSig = NULL;
+	const KSI_DataHash *origDocHash = NULL;
+	KSI_uint64_t origLevel = 0;
+	KSI_DataHash *rootHash = NULL;
+	KSI_AggregationHashChain *rootChain = NULL;
+	KSI_VerificationErrorCode error = KSI_VER_ERR_NONE;
+	size_t i;
+
+	if (proof == NULL || policy == NULL || context == NULL || result == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(proof->ctx);
+
+	/* A single verification of the block signature covers the calendar part of all the leafs. */
+	origSig = context->signature;
+	origDocHash = context->documentHash;
+	origLevel = context->docAggrLevel;
+
+	context->signature = proof->signature;
+	context->documentHash = NULL;
+	context->docAggrLevel = proof->rootLevel;
+
+	res = KSI_SignatureVerifier_verify(policy, context, &tmp);
+
+	context->signature = origSig;
+	context->documentHash = origDocHash;
+	context->docAggrLevel = origLevel;
+
+	if (res != KSI_OK) {
+		KSI_pushError(proof->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (tmp->finalResult.resultCode == KSI_VER_RES_OK) {
+		res = KSI_Signature_getDocumentHash(proof->signature, &rootHash);
+		if (res != KSI_OK) {
+			KSI_pushError(proof->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_AggregationHashChainList_elementAt(proof->signature->aggregationChainList, 0, &rootChain);
+		if (res != KSI_OK || rootChain == NULL) {
+			KSI_pushError(proof->ctx, res = (res != KSI_OK ? res : KSI_INVALID_FORMAT), "Block signature does not contain any aggregation hash chains.");
+			goto cleanup;
+		}
+
+		for (i = 0; i < proof->leafCount && error == KSI_VER_ERR_NONE; i++) {
+			res = verifyLeafChain(proof, i, rootChain, rootHash, &error);
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		/* A leaf that does not belong to the block fails the whole proof. */
+		if (error != KSI_VER_ERR_NONE) {
+			tmp->finalResult.resultCode = KSI_VER_RES_FAIL;
+			tmp->finalResult.errorCode = error;
+			tmp->finalResult.ruleName = __FUNCTION__;
+			tmp->finalResult.stepsPerformed |= KSI_VERIFY_AGGRCHAIN_INTERNALLY;
+			tmp->finalResult.stepsSuccessful &= ~KSI_VERIFY_AGGRCHAIN_INTERNALLY;
+			tmp->finalResult.stepsFailed |= KSI_VERIFY_AGGRCHAIN_INTERNALLY;
+			tmp->resultCode = KSI_VER_RES_FAIL;
+		}
+	}
+
+	*result = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PolicyVerificationResult_free(tmp);
+
+	return res;
+}
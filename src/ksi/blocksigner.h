@@ -28,6 +28,7 @@ extern "C" {
 
 typedef struct KSI_BlockSigner_st KSI_BlockSigner;
 typedef struct KSI_BlockSignerHandle_st KSI_BlockSignerHandle;
+typedef struct KSI_BlockProof_st KSI_BlockProof;
 
 KSI_DEFINE_LIST(KSI_BlockSignerHandle);
 #define KSI_BlockSignerHandleList_append(lst, o) KSI_APPLY_TO_NOT_NULL((lst), append, ((lst), (o)))
@@ -116,6 +117,204 @@ int KSI_BlockSigner_getPrevLeaf(const KSI_BlockSigner *signer, KSI_DataHash **pr
  */
 int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig);
 
+/**
+ * Serializes the signatures of all the leafs of a closed block signer and passes them to the \c sink
+ * one by one, in the order the leafs were added. The shared part of the block signature is
+ * serialized once and each leaf signature is composed of it and the aggregation hash chain of the
+ * leaf, thus avoiding building and verifying a #KSI_Signature object per leaf as
+ * #KSI_BlockSignerHandle_getSignature does.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	sink		Function receiving the sink context, the index of the leaf and the serialized signature. The
+ * 							buffer is only valid during the call. The function is expected to return #KSI_OK to continue.
+ * \param[in]	sinkCtx		Context for the \c sink, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Unlike #KSI_BlockSignerHandle_getSignature, the resulting signatures are not verified internally.
+ * \see #KSI_BlockSigner_closeAndSign, #KSI_Signature_parse.
+ */
+int KSI_BlockSigner_writeSignatures(KSI_BlockSigner *signer, int (*sink)(void *, size_t, const unsigned char *, size_t), void *sinkCtx);
+
+/**
+ * Completion callback of the pipelined block signer. The callback is invoked for every sealed block
+ * when signing of its root hash has finished.
+ * \param[in]	block		The sealed block - a closed #KSI_BlockSigner holding the leafs of the block.
+ * \param[in]	error		#KSI_OK if the block has been signed, otherwise an error code.
+ * \param[in]	userp		The user pointer set with #KSI_BlockSigner_setAsyncService.
+ * \return Implementation must return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note On success the signatures of the block are available via #KSI_BlockSigner_writeSignatures and
+ * #KSI_BlockSignerHandle_getSignature of the handles returned while adding the leafs.
+ * \note The block (and the handles of its leafs) is released after the callback returns. Use #KSI_BlockSigner_ref
+ * in order to keep a reference.
+ * \note The callback is invoked from #KSI_AsyncService_run or #KSI_AsyncService_socketReady. If the block could not
+ * be submitted, it is invoked from the function that sealed the block. Of those only #KSI_BlockSigner_seal also returns
+ * the error, the leaf passed to #KSI_BlockSigner_addLeaf has been accepted regardless.
+ */
+typedef int (*KSI_BlockSignerCallback_Completion)(KSI_BlockSigner *block, int error, void *userp);
+
+/**
+ * Seal thresholds of the pipelined block signer. A threshold set to 0 is ignored.
+ * \see #KSI_BlockSigner_setOption
+ */
+typedef enum KSI_BlockSignerOption_en {
+	/**
+	 * Maximum number of leafs in a block.
+	 * \param		count			Paramer of type size_t. Default 0.
+	 */
+	KSI_BLOCK_SIGNER_OPT_MAX_LEAVES = 0,
+
+	/**
+	 * Maximum amount of input data of a block in bytes, as reported via #KSI_BlockSigner_addInputSize.
+	 * \param		size			Paramer of type size_t. Default 0.
+	 */
+	KSI_BLOCK_SIGNER_OPT_MAX_BYTES,
+
+	/**
+	 * Maximum age of a block in milliseconds, counted from adding the first leaf. The age is checked when a
+	 * leaf is added and by #KSI_BlockSigner_seal.
+	 * \param		ms				Paramer of type size_t. Default 0.
+	 */
+	KSI_BLOCK_SIGNER_OPT_MAX_AGE,
+
+	__KSI_BLOCK_SIGNER_OPT_COUNT
+} KSI_BlockSignerOption;
+
+/**
+ * Setter for the block signer options.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	option		Option to be set (see #KSI_BlockSignerOption).
+ * \param[in]	value		Value to be set, casted to void*.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_setOption(KSI_BlockSigner *signer, int option, void *value);
+
+/**
+ * Switches the block signer to the pipelined mode. In this mode the leafs are collected into blocks. A block
+ * is sealed as soon as one of its thresholds (see #KSI_BlockSignerOption) is reached, and its root hash is
+ * signed via the \c service while the new leafs already go into the next block. The masking chain is carried
+ * over from block to block. The signed blocks are delivered via the \c callback.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner, no leafs may have been added to it.
+ * \param[in]	service		Signing async service, the caller has to drive it with #KSI_AsyncService_run (or
+ * 							the event loop integration functions).
+ * \param[in]	callback	Completion callback for the blocks.
+ * \param[in]	userp		User pointer passed to the \c callback, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The \c service has to outlive the \c signer. The pending blocks of a freed \c signer are silently dropped.
+ * \note Every pending block takes a slot of the request cache of the \c service, see #KSI_ASYNC_OPT_REQUEST_CACHE_SIZE.
+ * If the cache is full, the sealed blocks are kept in the order of sealing and submitted by the following calls of
+ * #KSI_BlockSigner_addLeaf, #KSI_BlockSigner_addInputSize and #KSI_BlockSigner_seal.
+ * \note In the pipelined mode #KSI_BlockSigner_closeAndSign may not be used, see #KSI_BlockSigner_seal.
+ * \see #KSI_SigningAsyncService_new, #KSI_BlockSigner_getPendingCount.
+ */
+int KSI_BlockSigner_setAsyncService(KSI_BlockSigner *signer, KSI_AsyncService *service, KSI_BlockSignerCallback_Completion callback, void *userp);
+
+/**
+ * Reports the amount of input data behind the leafs of the current block, for the #KSI_BLOCK_SIGNER_OPT_MAX_BYTES
+ * threshold of the pipelined block signer.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	size		Number of bytes.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_addInputSize(KSI_BlockSigner *signer, size_t size);
+
+/**
+ * Seals the current block of the pipelined block signer and submits its root hash for signing. Should
+ * be called periodically for the #KSI_BLOCK_SIGNER_OPT_MAX_AGE threshold to take effect when no leafs are added,
+ * and with \c force set for flushing the last block.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	force		If not 0, the block is sealed regardless of the thresholds.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note An empty block is never sealed.
+ */
+int KSI_BlockSigner_seal(KSI_BlockSigner *signer, int force);
+
+/**
+ * Getter for the number of sealed blocks of the pipelined block signer that are waiting for the signature,
+ * including the blocks not yet submitted because of a full request cache.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[out]	count		Pointer to the receiving variable.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_getPendingCount(const KSI_BlockSigner *signer, size_t *count);
+
+KSI_DEFINE_REF(KSI_BlockSigner);
+
+/**
+ * Serializes the compact proof of a closed block signer and passes it to the \c sink in parts. The proof
+ * consists of a header, holding the block signature and the aggregation hash chain elements shared by all the
+ * leafs, followed by a record per leaf, in the order the leafs were added. A leaf record only holds the shape,
+ * the input hash and the links of the aggregation hash chain of the leaf. The concatenation of the parts is
+ * the serialized proof, see #KSI_BlockProof_parse. The proof has the following components:
+ * - 8-byte magic 4B 53 49 42 4C 4B 50 46 (in hexadecimal), which in ASCII means the string 'KSIBLKPF'.
+ * - Header (Single) with TLV tag 0x0b01. It contains the format version (tag 0x04, currently 1), the
+ * leaf count (tag 0x01), the level of the block root (tag 0x02), the shared aggregation hash chain
+ * elements (tag 0x03, omitted for a single leaf) and the block signature (tag 0x0800).
+ * - Leaf records (Multiple) with TLV tag 0x0b02, one per leaf.
+ *
+ * \note The tags 0x0b01 and 0x0b02 are only meaningful after the magic and are not used by the KSI
+ * signatures, publications files or PDUs.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	sink		Function receiving the sink context and the next part of the proof. The buffer is only valid
+ * 							during the call. The function is expected to return #KSI_OK to continue.
+ * \param[in]	sinkCtx		Context for the \c sink, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_BlockSigner_writeSignatures.
+ */
+int KSI_BlockSigner_writeProof(KSI_BlockSigner *signer, int (*sink)(void *, const unsigned char *, size_t), void *sinkCtx);
+
+/**
+ * Parses a block proof written by #KSI_BlockSigner_writeProof. The block signature is verified
+ * internally while parsing.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	raw			Serialized block proof.
+ * \param[in]	raw_len		Length of the serialized block proof.
+ * \param[out]	proof		Pointer to the receiving pointer.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_BlockProof_free.
+ */
+int KSI_BlockProof_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_BlockProof **proof);
+
+/**
+ * Cleanup method for the #KSI_BlockProof.
+ * \param[in]	proof		Instance of the #KSI_BlockProof.
+ */
+void KSI_BlockProof_free(KSI_BlockProof *proof);
+
+/**
+ * Getter for the number of leafs in the block proof.
+ * \param[in]	proof		Instance of the #KSI_BlockProof.
+ * \param[out]	count		Pointer to the receiving variable.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockProof_getLeafCount(const KSI_BlockProof *proof, size_t *count);
+
+/**
+ * Reconstructs the full signature of a leaf from the block proof. The signature is the same as
+ * written for the leaf by #KSI_BlockSigner_writeSignatures.
+ * \param[in]	proof		Instance of the #KSI_BlockProof.
+ * \param[in]	index		Index of the leaf, in the order the leafs were added.
+ * \param[out]	sig			Pointer to the receiving pointer.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Ownership of \c sig is passed to the caller who is responsible for freeing the object.
+ */
+int KSI_BlockProof_getSignature(KSI_BlockProof *proof, size_t index, KSI_Signature **sig);
+
+/**
+ * Verifies all the leafs of the block proof. The block signature is verified once with the \c policy,
+ * and if the verification succeeds, the aggregation hash chain of every leaf is checked to aggregate to the
+ * root of the block, and to continue the first aggregation hash chain of the block signature (aggregation time
+ * and chain index).
+ * \param[in]	proof		Instance of the #KSI_BlockProof.
+ * \param[in]	policy		Policy for the verification of the block signature.
+ * \param[in]	context		Verification context. The \c signature, \c documentHash and \c docAggrLevel fields are
+ * 							ignored and left unchanged.
+ * \param[out]	result		Pointer to the receiving pointer of the verification result.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note A leaf that does not match the block fails the \c result with #KSI_VER_RES_FAIL and an internal
+ * verification error code (eg. #KSI_VER_ERR_INT_1).
+ * \note The leaf chains are not checked if the block signature did not verify, see the \c result.
+ * \see #KSI_SignatureVerifier_verify, #KSI_PolicyVerificationResult_free.
+ */
+int KSI_BlockProof_verify(KSI_BlockProof *proof, const KSI_Policy *policy, KSI_VerificationContext *context, KSI_PolicyVerificationResult **result);
+
 /**
  * Cleanup method for the handle.
  * \param[in]	handle		Instance of the #KSI_BlockSignerHandle
@@ -24,6 +24,10 @@
 #include "ksi.h"
 #include "compatibility.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #ifdef _WIN32
 size_t KSI_vsnprintf(char *buf, size_t n, const char *format, va_list va){
 	size_t ret = 0;
@@ -203,3 +207,16 @@ int KSI_strcasecmp(const char *s1, const char *s2) {
 		return strcasecmp(s1, s2);
 	#endif
 }
+
+#ifdef _WIN32
+uint64_t KSI_getMonotonicTimeMs(void) {
+	return (uint64_t)GetTickCount64();
+}
+#else
+uint64_t KSI_getMonotonicTimeMs(void) {
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return (uint64_t)time(NULL) * 1000;
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+#endif
@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <stdarg.h>
 #include <time.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -89,6 +90,13 @@ time_t KSI_CalendarTimeToUnixTime(struct tm *time);
  */
 int KSI_strcasecmp(const char *s1, const char *s2);
 
+/**
+ * Platform independent monotonic clock. The returned value is not related to the calendar time and is only
+ * suitable for measuring time intervals.
+ * \return Time elapsed since an unspecified starting point in milliseconds.
+ */
+uint64_t KSI_getMonotonicTimeMs(void);
+
 /**
  * @}
  */
@@ -406,6 +406,90 @@ cleanup:
 	return res;
 }
 
+int KSI_DataHash_createBatch(KSI_CTX *ctx, const void * const *data, const size_t *data_length, size_t count, KSI_HashAlgorithm algo_id, unsigned char *imprints, size_t imprints_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash hsh;
+	size_t imprint_len;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if ((count > 0 && (data == NULL || data_length == NULL)) || (imprints == NULL && imprints_len > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	imprint_len = KSI_getHashLength(algo_id) + 1;
+	if (imprint_len == 1) {
+		KSI_pushError(ctx, res = KSI_UNAVAILABLE_HASH_ALGORITHM, NULL);
+		goto cleanup;
+	}
+
+	if (count > imprints_len / imprint_len) {
+		KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, "Imprint buffer too short.");
+		goto cleanup;
+	}
+
+	/* Validate all the inputs before any of the imprints is written. */
+	for (i = 0; i < count; i++) {
+		if (data[i] == NULL && data_length[i] > 0) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Input data missing.");
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* A single hasher is reused for all the inputs. */
+	res = KSI_DataHasher_open(ctx, algo_id, &hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	hsh.ctx = ctx;
+	hsh.ref = 1;
+
+	for (i = 0; i < count; i++) {
+		if (i > 0) {
+			res = KSI_DataHasher_reset(hsr);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		if (data_length[i] > 0) {
+			res = hsr->add(hsr, data[i], data_length[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		/* Close directly into a stack object to avoid allocating a #KSI_DataHash per input. */
+		res = hsr->closeExisting(hsr, &hsh);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		hsr->isOpen = false;
+
+		memcpy(imprints + i * imprint_len, hsh.imprint, imprint_len);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHasher_free(hsr);
+
+	return res;
+}
+
 int KSI_DataHash_clone(KSI_DataHash *from, KSI_DataHash **to) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -593,8 +677,65 @@ cleanup:
 
 }
 
+int KSI_DataHasher_closeInto(KSI_DataHasher *hsr, KSI_Imprint *imprint) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash hsh;
+
+	if (hsr == NULL || imprint == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(hsr->ctx);
+
+	if (!hsr->isOpen) {
+		KSI_pushError(hsr->ctx, res = KSI_INVALID_STATE, "Hasher is already closed.");
+		goto cleanup;
+	}
+
+	if (hsr->closeExisting == NULL) {
+		KSI_pushError(hsr->ctx, res = KSI_INVALID_STATE, "Hasher not properly initialized.");
+		goto cleanup;
+	}
+
+	/* The stack object is never shared, so it is safe to close into it. */
+	hsh.ctx = hsr->ctx;
+	hsh.ref = 1;
+
+	res = hsr->closeExisting(hsr, &hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(hsr->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	memcpy(imprint->value, hsh.imprint, hsh.imprint_length);
+	imprint->length = hsh.imprint_length;
+
+	hsr->isOpen = false;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static const KSI_DataHasher *getHasherPrototype(KSI_CTX *ctx, KSI_HashAlgorithm algo_id) {
+	KSI_DataHasher *tmp = NULL;
+
+	if (ctx == NULL || !ksi_isHashAlgorithmIdValid(algo_id)) return NULL;
+
+	if (ctx->hasherPrototype[algo_id] == NULL) {
+		/* The prototype has no context, thus its own initialization does not end up here. */
+		if (KSI_DataHasher_open(NULL, algo_id, &tmp) != KSI_OK) return NULL;
+		ctx->hasherPrototype[algo_id] = tmp;
+	}
+
+	return ctx->hasherPrototype[algo_id];
+}
+
 int KSI_DataHasher_reset(KSI_DataHasher *hsr) {
 	int res = KSI_UNKNOWN_ERROR;
+	const KSI_DataHasher *prototype = NULL;
 
 	if (hsr == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -607,7 +748,17 @@ int KSI_DataHasher_reset(KSI_DataHasher *hsr) {
 		goto cleanup;
 	}
 
-	res = hsr->reset(hsr);
+	/* Cloning the initial state of the per context prototype is cheaper than initializing the
+	 * digest context from scratch. */
+	if (hsr->copyState != NULL) {
+		prototype = getHasherPrototype(hsr->ctx, hsr->algorithm);
+	}
+
+	if (prototype != NULL && prototype->copyState == hsr->copyState) {
+		res = hsr->copyState(hsr, prototype);
+	} else {
+		res = hsr->reset(hsr);
+	}
 	if (res != KSI_OK) {
 		KSI_pushError(hsr->ctx, res, NULL);
 		goto cleanup;
@@ -656,6 +807,45 @@ cleanup:
 	return res;
 }
 
+int KSI_DataHasher_copyState(KSI_DataHasher *dst, const KSI_DataHasher *src) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (dst == NULL || src == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(dst->ctx);
+
+	if (!src->isOpen) {
+		KSI_pushError(dst->ctx, res = KSI_INVALID_STATE, "Source hasher is closed.");
+		goto cleanup;
+	}
+
+	if (dst->algorithm != src->algorithm) {
+		KSI_pushError(dst->ctx, res = KSI_INVALID_ARGUMENT, "Hash algorithm mismatch.");
+		goto cleanup;
+	}
+
+	if (dst->copyState == NULL || dst->copyState != src->copyState) {
+		KSI_pushError(dst->ctx, res = KSI_INVALID_STATE, "Hasher state copying not supported.");
+		goto cleanup;
+	}
+
+	res = dst->copyState(dst, src);
+	if (res != KSI_OK) {
+		KSI_pushError(dst->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	dst->isOpen = true;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 void KSI_DataHasher_free(KSI_DataHasher *hsr) {
 	if (hsr != NULL) {
 		if (hsr->cleanup != NULL) {
@@ -665,6 +855,120 @@ void KSI_DataHasher_free(KSI_DataHasher *hsr) {
 	}
 }
 
+int KSI_DataHasher_addImprintValue(KSI_DataHasher *hasher, const KSI_Imprint *imprint) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (hasher == NULL || imprint == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(hasher->ctx);
+
+	if (imprint->length == 0 || imprint->length > KSI_MAX_IMPRINT_LEN) {
+		KSI_pushError(hasher->ctx, res = KSI_INVALID_ARGUMENT, "Imprint value not set.");
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_add(hasher, imprint->value, imprint->length);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_Imprint_aggregate(KSI_DataHasher *hasher, const KSI_Imprint *left, const KSI_Imprint *right, unsigned char level, KSI_Imprint *root) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (hasher == NULL || left == NULL || right == NULL || root == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(hasher->ctx);
+
+	res = KSI_DataHasher_reset(hasher);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_addImprintValue(hasher, left);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_addImprintValue(hasher, right);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_add(hasher, &level, 1);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* As the inputs have been consumed, root may alias either of them. */
+	res = KSI_DataHasher_closeInto(hasher, root);
+	if (res != KSI_OK) {
+		KSI_pushError(hasher->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_Imprint_fromDataHash(const KSI_DataHash *hash, KSI_Imprint *imprint) {
+	if (hash == NULL || imprint == NULL || hash->imprint_length > KSI_MAX_IMPRINT_LEN) {
+		return KSI_INVALID_ARGUMENT;
+	}
+
+	memcpy(imprint->value, hash->imprint, hash->imprint_length);
+	imprint->length = hash->imprint_length;
+
+	return KSI_OK;
+}
+
+int KSI_Imprint_toDataHash(KSI_CTX *ctx, const KSI_Imprint *imprint, KSI_DataHash **hash) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (imprint == NULL || hash == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_fromImprint(ctx, imprint->value, imprint->length, hash);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_Imprint_equals(const KSI_Imprint *left, const KSI_Imprint *right) {
+	return left != NULL && right != NULL && left->length > 0 &&
+			(left == right || (left->length == right->length && !memcmp(left->value, right->value, left->length)));
+}
+
 int KSI_DataHasher_addImprint(KSI_DataHasher *hasher, const KSI_DataHash *hsh) {
 	int res = KSI_UNKNOWN_ERROR;
 	const unsigned char *imprint;
@@ -94,6 +94,19 @@ extern "C" {
 	 */
 	#define KSI_MAX_IMPRINT_LEN 65 /* Algorithm ID (1 byte) + longest digest. */
 
+	/**
+	 * Fixed size value type holding an imprint. Unlike #KSI_DataHash, it can be allocated on
+	 * the stack or embedded into other structures, so calculating it does not require any heap
+	 * allocations.
+	 * \see #KSI_DataHasher_closeInto, #KSI_Imprint_aggregate, #KSI_Imprint_fromDataHash
+	 */
+	typedef struct KSI_Imprint_st {
+		/** Length of the imprint, 0 if the value is not set. */
+		size_t length;
+		/** Hash algorithm id followed by the digest. */
+		unsigned char value[KSI_MAX_IMPRINT_LEN];
+	} KSI_Imprint;
+
 	/**
 	 * Starts a hash computation.
 	 * \param[in]		ctx			KSI context.
@@ -156,6 +169,69 @@ extern "C" {
 	 */
 	int KSI_DataHasher_close(KSI_DataHasher *hasher, KSI_DataHash **hash);
 
+	/**
+	 * Finalizes a hash computation into caller provided storage.
+	 * \param[in]	hasher			Hasher object.
+	 * \param[out]	imprint			Imprint receiving the result.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_DataHasher_close
+	 */
+	int KSI_DataHasher_closeInto(KSI_DataHasher *hasher, KSI_Imprint *imprint);
+
+	/**
+	 * Adds the imprint value to the hash computation.
+	 * \param[in]	hasher				Hasher object.
+	 * \param[in]	imprint				Imprint value.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_DataHasher_addImprint
+	 */
+	int KSI_DataHasher_addImprintValue(KSI_DataHasher *hasher, const KSI_Imprint *imprint);
+
+	/**
+	 * Calculates the aggregation tree node value \c H(left || right || level) using the given hasher,
+	 * which is reset before use. The result is written into \c root, which may be the same object as
+	 * one of the inputs.
+	 * \param[in]	hasher			Hasher object.
+	 * \param[in]	left			Imprint of the left child.
+	 * \param[in]	right			Imprint of the right child.
+	 * \param[in]	level			Level of the node.
+	 * \param[out]	root			Imprint receiving the node value.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Imprint_aggregate(KSI_DataHasher *hasher, const KSI_Imprint *left, const KSI_Imprint *right, unsigned char level, KSI_Imprint *root);
+
+	/**
+	 * Copies the imprint of the data hash object into \c imprint.
+	 * \param[in]	hash			Data hash object.
+	 * \param[out]	imprint			Imprint receiving the value.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Imprint_fromDataHash(const KSI_DataHash *hash, KSI_Imprint *imprint);
+
+	/**
+	 * Creates a data hash object from the imprint value.
+	 * \param[in]	ctx				KSI context.
+	 * \param[in]	imprint			Imprint value.
+	 * \param[out]	hash			Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_DataHash_free
+	 */
+	int KSI_Imprint_toDataHash(KSI_CTX *ctx, const KSI_Imprint *imprint, KSI_DataHash **hash);
+
+	/**
+	 * Returns non-zero, if the two imprints are both not \c NULL, set and equal to each other.
+	 * \param[in]	left			One imprint.
+	 * \param[in]	right			An other imprint.
+	 *
+	 * \return Returns 0 if the imprints are \c NULL, not set or are not equal, otherwise non-zero value
+	 * is returned.
+	 */
+	int KSI_Imprint_equals(const KSI_Imprint *left, const KSI_Imprint *right);
+
 	/**
 	 * Frees the data hasher object.
 	 * \param[in]		hasher			Hasher object.
@@ -189,6 +265,27 @@ extern "C" {
 	 */
 	int KSI_DataHash_create(KSI_CTX *ctx, const void *data, size_t data_length, KSI_HashAlgorithm algo_id, KSI_DataHash **hash);
 
+	/**
+	 * Calculates the imprints of a batch of independent inputs. The \c i-th imprint is written to
+	 * \c imprints at offset \c i * (#KSI_getHashLength(\c algo_id) + 1). This is considerably faster
+	 * than calling #KSI_DataHash_create for every input, as the hasher is set up only once and no
+	 * objects are allocated per input.
+	 *
+	 * \param[in]	ctx				KSI context.
+	 * \param[in]	data			Array of pointers to the input data.
+	 * \param[in]	data_length		Array of the input data lengths.
+	 * \param[in]	count			Number of inputs.
+	 * \param[in]	algo_id			Hash algorithm id.
+	 * \param[out]	imprints		Buffer receiving the imprints.
+	 * \param[in]	imprints_len	Size of the \c imprints buffer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \return #KSI_BUFFER_OVERFLOW if \c imprints can not hold \c count imprints.
+	 * \return #KSI_INVALID_ARGUMENT if an input is \c NULL while its length is not zero.
+	 * \see #KSI_DataHash_create, #KSI_DataHash_fromImprint
+	 */
+	int KSI_DataHash_createBatch(KSI_CTX *ctx, const void * const *data, const size_t *data_length, size_t count, KSI_HashAlgorithm algo_id, unsigned char *imprints, size_t imprints_len);
+
 	/**
 	 * Creates a clone of the data hash.
 	 *
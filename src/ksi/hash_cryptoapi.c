@@ -246,6 +246,69 @@ cleanup:
 	return res;
 }
 
+static int ksi_DataHasher_copyState(KSI_DataHasher *hasher, const KSI_DataHasher *src) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	/* Crypto helper structs. */
+	CRYPTO_HASH_CTX *pCryptoCTX = NULL;
+	const CRYPTO_HASH_CTX *pSrcCTX = NULL;
+
+	/* Hash object. */
+	HCRYPTHASH pTmp_hash = 0;
+
+	if (hasher == NULL || src == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(hasher->ctx);
+
+	pCryptoCTX = (CRYPTO_HASH_CTX*)hasher->hashContext;
+	pSrcCTX = (const CRYPTO_HASH_CTX*)src->hashContext;
+	if (pCryptoCTX == NULL || pSrcCTX == NULL || pSrcCTX->pt_hHash == 0) {
+		KSI_pushError(hasher->ctx, res = KSI_INVALID_STATE, NULL);
+		goto cleanup;
+	}
+
+	if (!CryptDuplicateHash(pSrcCTX->pt_hHash, NULL, 0, &pTmp_hash)) {
+		DWORD error = GetLastError();
+		KSI_LOG_debug(hasher->ctx, "Cryptoapi: Duplicate hash error %i.", error);
+		KSI_pushError(hasher->ctx, res = KSI_CRYPTO_FAILURE, NULL);
+		goto cleanup;
+	}
+
+	/* The duplicate belongs to the CSP of the source, so keep a reference to it. */
+	if (pCryptoCTX->pt_CSP != pSrcCTX->pt_CSP) {
+		if (!CryptContextAddRef(pSrcCTX->pt_CSP, NULL, 0)) {
+			DWORD error = GetLastError();
+			KSI_LOG_debug(hasher->ctx, "Cryptoapi: Context add reference error %i.", error);
+			KSI_pushError(hasher->ctx, res = KSI_CRYPTO_FAILURE, NULL);
+			goto cleanup;
+		}
+	}
+
+	/* Replace the existing hash object. */
+	if (pCryptoCTX->pt_hHash != 0) {
+		CryptDestroyHash(pCryptoCTX->pt_hHash);
+	}
+
+	if (pCryptoCTX->pt_CSP != pSrcCTX->pt_CSP) {
+		if (pCryptoCTX->pt_CSP) CryptReleaseContext(pCryptoCTX->pt_CSP, 0);
+		pCryptoCTX->pt_CSP = pSrcCTX->pt_CSP;
+	}
+
+	pCryptoCTX->pt_hHash = pTmp_hash;
+	pTmp_hash = 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (pTmp_hash) CryptDestroyHash(pTmp_hash);
+
+	return res;
+}
+
 int KSI_DataHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher **hasher) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_DataHasher *tmp_hasher = NULL;
@@ -279,6 +342,7 @@ int KSI_DataHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher
 	tmp_hasher->reset = ksi_DataHasher_reset;
 	tmp_hasher->add = ksi_DataHasher_add;
 	tmp_hasher->cleanup = ksi_DataHasher_cleanup;
+	tmp_hasher->copyState = ksi_DataHasher_copyState;
 
 	/* Create new helper context for crypto api. */
 	res = CRYPTO_HASH_CTX_new(&tmp_cryptoCTX);
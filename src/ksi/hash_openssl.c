@@ -171,6 +171,41 @@ cleanup:
 	return res;
 }
 
+static int ksi_DataHasher_copyState(KSI_DataHasher *hasher, const KSI_DataHasher *src) {
+	int res = KSI_UNKNOWN_ERROR;
+	EVP_MD_CTX *context = NULL;
+
+	if (hasher == NULL || src == NULL || src->hashContext == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(hasher->ctx);
+
+	context = hasher->hashContext;
+	if (context == NULL) {
+		context = KSI_EVP_MD_CTX_create();
+		if (context == NULL) {
+			KSI_pushError(hasher->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		EVP_MD_CTX_init(context);
+
+		hasher->hashContext = context;
+	}
+
+	if (!EVP_MD_CTX_copy_ex(context, src->hashContext)) {
+		KSI_pushError(hasher->ctx, res = KSI_CRYPTO_FAILURE, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_DataHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher **hasher) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_DataHasher *tmp_hasher = NULL;
@@ -200,6 +235,7 @@ int KSI_DataHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher
 	tmp_hasher->reset = ksi_DataHasher_reset;
 	tmp_hasher->add = ksi_DataHasher_add;
 	tmp_hasher->cleanup = ksi_DataHasher_cleanup;
+	tmp_hasher->copyState = ksi_DataHasher_copyState;
 
 	res = KSI_DataHasher_reset(tmp_hasher);
 	if (res != KSI_OK) {
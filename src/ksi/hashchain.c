@@ -24,6 +24,7 @@
 #include "hashchain.h"
 #include "tlv.h"
 #include "tlv_template.h"
+#include "impl/ctx_impl.h"
 #include "impl/hashchain_impl.h"
 #include "impl/meta_data_element_impl.h"
 #include "compatibility.h"
@@ -47,20 +48,21 @@ static long long int highBit(long long int n) {
 }
 
 
-static int dataHasher_addNvlImprint(KSI_DataHasher *hsr, const KSI_DataHash *first, const KSI_DataHash *second) {
+static int dataHasher_addNvlImprint(KSI_DataHasher *hsr, const KSI_Imprint *first, const KSI_DataHash *second) {
 	int res = KSI_UNKNOWN_ERROR;
-	const KSI_DataHash *hsh = first;
 
-	if (hsh == NULL) {
+	if (first->length > 0) {
+		res = KSI_DataHasher_addImprintValue(hsr, first);
+		if (res != KSI_OK) goto cleanup;
+	} else {
 		if (second == NULL) {
 			res = KSI_INVALID_ARGUMENT;
 			goto cleanup;
 		}
-		hsh = second;
-	}
 
-	res = KSI_DataHasher_addImprint(hsr, hsh);
-	if (res != KSI_OK) goto cleanup;
+		res = KSI_DataHasher_addImprint(hsr, second);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 	res = KSI_OK;
 
@@ -158,17 +160,20 @@ cleanup:
 	return res;
 }
 
-static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm aggr_algo_id, int isCalendar, int *endLevel, KSI_DataHash **outputHash) {
+static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm aggr_algo_id, int isCalendar, int *endLevel, KSI_Imprint *outputHash) {
 	int res = KSI_UNKNOWN_ERROR;
 	int level = startLevel;
 	KSI_DataHasher *hsr = NULL;
-	KSI_DataHash *hsh = NULL;
+	/* The intermediate value is kept on the stack, so the links are aggregated without allocations. */
+	KSI_Imprint hsh;
 	KSI_HashChainLink *link = NULL;
 	KSI_HashAlgorithm algo_id = aggr_algo_id;
 	char chr_level;
 	char logMsg[0xff];
 	size_t i;
 
+	hsh.length = 0;
+
 	KSI_ERR_clearErrors(ctx);
 	if (ctx == NULL || chain == NULL || inputHash == NULL || outputHash == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
@@ -236,7 +241,7 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 		}
 
 		if (link->isLeft) {
-			res = dataHasher_addNvlImprint(hsr, hsh, inputHash);
+			res = dataHasher_addNvlImprint(hsr, &hsh, inputHash);
 			if (res != KSI_OK) {
 				KSI_pushError(ctx, res, NULL);
 				goto cleanup;
@@ -254,7 +259,7 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 				goto cleanup;
 			}
 
-			res = dataHasher_addNvlImprint(hsr, hsh, inputHash);
+			res = dataHasher_addNvlImprint(hsr, &hsh, inputHash);
 			if (res != KSI_OK) {
 				KSI_pushError(ctx, res, NULL);
 				goto cleanup;
@@ -270,12 +275,7 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 		chr_level = (char) level;
 		KSI_DataHasher_add(hsr, &chr_level, 1);
 
-		if (hsh != NULL) {
-			KSI_DataHash_free(hsh);
-			hsh = NULL;
-		}
-
-		res = KSI_DataHasher_close(hsr, &hsh);
+		res = KSI_DataHasher_closeInto(hsr, &hsh);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
@@ -283,19 +283,54 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 	}
 
 	KSI_snprintf(logMsg, sizeof(logMsg), "Finished %s hash chain aggregation with output hash.", isCalendar ? "calendar": "aggregation");
-	KSI_LOG_logDataHash(ctx, KSI_LOG_DEBUG, logMsg, hsh);
+	KSI_LOG_logBlob(ctx, KSI_LOG_DEBUG, logMsg, hsh.value, hsh.length);
 
 	if (endLevel != NULL) *endLevel = level;
-	if (outputHash != NULL) *outputHash = hsh;
-	hsh = NULL;
-
+	*outputHash = hsh;
 
 	res = KSI_OK;
 
 cleanup:
 
 	KSI_DataHasher_free(hsr);
-	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+static int aggregateChainToDataHash(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm aggr_algo_id, int isCalendar, int *endLevel, KSI_DataHash **outputHash) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Imprint hsh;
+	KSI_DataHash *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || outputHash == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = aggregateChain(ctx, chain, inputHash, startLevel, aggr_algo_id, isCalendar, endLevel, &hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* An empty chain has no output value. */
+	if (hsh.length > 0) {
+		res = KSI_Imprint_toDataHash(ctx, &hsh, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*outputHash = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(tmp);
 
 	return res;
 }
@@ -363,6 +398,13 @@ cleanup:
  *
  */
 int KSI_HashChain_aggregate(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm algo_id, int *endLevel, KSI_DataHash **outputHash) {
+	return aggregateChainToDataHash(ctx, chain, inputHash, startLevel, algo_id, 0, endLevel, outputHash);
+}
+
+/**
+ *
+ */
+int KSI_HashChain_aggregateInto(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm algo_id, int *endLevel, KSI_Imprint *outputHash) {
 	return aggregateChain(ctx, chain, inputHash, startLevel, algo_id, 0, endLevel, outputHash);
 }
 
@@ -370,7 +412,7 @@ int KSI_HashChain_aggregate(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, co
  *
  */
 int KSI_HashChain_aggregateCalendar(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, KSI_DataHash **outputHash) {
-	return aggregateChain(ctx, chain, inputHash, 0xff, -1, 1, NULL, outputHash);
+	return aggregateChainToDataHash(ctx, chain, inputHash, 0xff, -1, 1, NULL, outputHash);
 }
 
 /**
@@ -488,7 +530,7 @@ void KSI_HashChainLink_free(KSI_HashChainLink *t) {
 		KSI_MetaDataElement_free(t->metaData);
 		KSI_DataHash_free(t->imprint);
 		KSI_Integer_free(t->levelCorrection);
-		KSI_free(t);
+		KSI_CTX_poolFree(t->ctx, t, sizeof(KSI_HashChainLink));
 	}
 }
 
@@ -501,7 +543,7 @@ int KSI_HashChainLink_new(KSI_CTX *ctx, KSI_HashChainLink **t) {
 		goto cleanup;
 	}
 
-	tmp = KSI_new(KSI_HashChainLink);
+	tmp = KSI_CTX_poolAlloc(ctx, sizeof(KSI_HashChainLink));
 	if (tmp == NULL) {
 		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
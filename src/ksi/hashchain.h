@@ -68,6 +68,19 @@ extern "C" {
 	 */
 	int KSI_HashChain_aggregate(KSI_CTX *, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm algo_id, int *endLevel, KSI_DataHash **outputHash);
 
+	/**
+	 * Same as #KSI_HashChain_aggregate, but the result is written into caller provided storage, so
+	 * no #KSI_DataHash objects are allocated during the aggregation.
+	 * \param[in]	chain			Hash chain (list of hash chain links)
+	 * \param[in]	inputHash		Input hash value.
+	 * \param[in]	startLevel		The initial level of this hash chain.
+	 * \param[in]	algo_id			Hash algorithm to be used to calculate the next value.
+	 * \param[out]	endLevel		Pointer to the receiving end level variable.
+	 * \param[out]	outputHash		Imprint receiving the result, its length is 0 if the chain is empty.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_HashChain_aggregateInto(KSI_CTX *, KSI_LIST(KSI_HashChainLink) *chain, const KSI_DataHash *inputHash, int startLevel, KSI_HashAlgorithm algo_id, int *endLevel, KSI_Imprint *outputHash);
+
 	/**
 	 * This function aggregates the calendar hash chain and returns the result hash via \c outputHash parameter.
 	 * \param[in]	chain			Hash chain.
@@ -22,6 +22,49 @@
 #include "internal.h"
 #include "hmac.h"
 #include "impl/hmac_impl.h"
+#include "impl/hash_impl.h"
+#include "impl/ctx_impl.h"
+
+static int hmacCache_get(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, KSI_HmacHasher **hasher) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HmacHasher *tmp = NULL;
+	size_t i;
+
+	for (i = 0; i < KSI_HMAC_CACHE_SIZE; i++) {
+		tmp = ctx->hmacCache[i];
+		if (tmp != NULL && tmp->dataHasher->algorithm == algo_id && !strcmp(tmp->key, key)) {
+			res = KSI_HmacHasher_reset(tmp);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			*hasher = tmp;
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	/* Cache miss - derive the key state and replace the oldest entry. */
+	res = KSI_HmacHasher_open(ctx, algo_id, key, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	i = ctx->hmacCacheNext;
+	ctx->hmacCacheNext = (i + 1) % KSI_HMAC_CACHE_SIZE;
+
+	KSI_HmacHasher_free(ctx->hmacCache[i]);
+	ctx->hmacCache[i] = tmp;
+
+	*hasher = tmp;
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
 
 int KSI_HMAC_create(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, const unsigned char *data, size_t data_len, KSI_DataHash **hmac) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -29,12 +72,13 @@ int KSI_HMAC_create(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, co
 	KSI_DataHash *tmp_hmac = NULL;
 
 	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || hmac == NULL) {
+	if (ctx == NULL || key == NULL || hmac == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_HmacHasher_open(ctx, algo_id, key, &hasher);
+	/* The hasher is owned by the context cache. */
+	res = hmacCache_get(ctx, algo_id, key, &hasher);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -59,7 +103,33 @@ int KSI_HMAC_create(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, co
 cleanup:
 
 	KSI_DataHash_free(tmp_hmac);
-	KSI_HmacHasher_free(hasher);
+
+	return res;
+}
+
+static int openPadState(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const unsigned char *pad, size_t pad_len, KSI_DataHasher **state) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHasher *tmp = NULL;
+
+	res = KSI_DataHasher_open(ctx, algo_id, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_add(tmp, pad, pad_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*state = tmp;
+	tmp = NULL;
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHasher_free(tmp);
 
 	return res;
 }
@@ -110,6 +180,15 @@ int KSI_HmacHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key
 	tmp_hasher->blockSize = 0;
 	tmp_hasher->ctx = ctx;
 	tmp_hasher->dataHasher = NULL;
+	tmp_hasher->innerState = NULL;
+	tmp_hasher->outerState = NULL;
+	tmp_hasher->key = NULL;
+
+	res = KSI_strdup(key, &tmp_hasher->key);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
 
 	/* Open the data hasher. */
 	res = KSI_DataHasher_open(ctx, algo_id, &tmp_hasher->dataHasher);
@@ -164,6 +243,21 @@ int KSI_HmacHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key
 		tmp_hasher->opadXORkey[i] = 0x5c;
 	}
 
+	/* Absorb the padded keys once, if the implementation allows to copy the intermediate states. */
+	if (tmp_hasher->dataHasher->copyState != NULL) {
+		res = openPadState(ctx, algo_id, tmp_hasher->ipadXORkey, blockSize, &tmp_hasher->innerState);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = openPadState(ctx, algo_id, tmp_hasher->opadXORkey, blockSize, &tmp_hasher->outerState);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
 	res = KSI_HmacHasher_reset(tmp_hasher);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
@@ -191,6 +285,18 @@ int KSI_HmacHasher_reset(KSI_HmacHasher *hasher) {
 	}
 	KSI_ERR_clearErrors(hasher->ctx);
 
+	if (hasher->innerState != NULL) {
+		/* Continue from the precomputed inner state. */
+		res = KSI_DataHasher_copyState(hasher->dataHasher, hasher->innerState);
+		if (res != KSI_OK) {
+			KSI_pushError(hasher->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_OK;
+		goto cleanup;
+	}
+
 	res = KSI_DataHasher_reset(hasher->dataHasher);
 	if (res != KSI_OK) {
 		KSI_pushError(hasher->ctx, res, NULL);
@@ -257,17 +363,25 @@ int KSI_HmacHasher_close(KSI_HmacHasher *hasher, KSI_DataHash **hmac) {
 	}
 
 	/* Hash outer data. */
-	res = KSI_DataHasher_reset(hasher->dataHasher);
-	if (res != KSI_OK) {
-		KSI_pushError(hasher->ctx, res, NULL);
-		goto cleanup;
-	}
+	if (hasher->outerState != NULL) {
+		res = KSI_DataHasher_copyState(hasher->dataHasher, hasher->outerState);
+		if (res != KSI_OK) {
+			KSI_pushError(hasher->ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		res = KSI_DataHasher_reset(hasher->dataHasher);
+		if (res != KSI_OK) {
+			KSI_pushError(hasher->ctx, res, NULL);
+			goto cleanup;
+		}
 
-	KSI_LOG_logBlob(hasher->ctx, KSI_LOG_DEBUG, "Adding opad", hasher->opadXORkey, hasher->blockSize);
-	res = KSI_DataHasher_add(hasher->dataHasher, hasher->opadXORkey, hasher->blockSize);
-	if (res != KSI_OK) {
-		KSI_pushError(hasher->ctx, res, NULL);
-		goto cleanup;
+		KSI_LOG_logBlob(hasher->ctx, KSI_LOG_DEBUG, "Adding opad", hasher->opadXORkey, hasher->blockSize);
+		res = KSI_DataHasher_add(hasher->dataHasher, hasher->opadXORkey, hasher->blockSize);
+		if (res != KSI_OK) {
+			KSI_pushError(hasher->ctx, res, NULL);
+			goto cleanup;
+		}
 	}
 
 	res = KSI_DataHash_extract(innerHash, NULL, &digest, &digest_len);
@@ -306,6 +420,15 @@ cleanup:
 void KSI_HmacHasher_free(KSI_HmacHasher *hasher) {
 	if (hasher != NULL) {
 		KSI_DataHasher_free(hasher->dataHasher);
+		KSI_DataHasher_free(hasher->innerState);
+		KSI_DataHasher_free(hasher->outerState);
+		if (hasher->key != NULL) {
+			memset(hasher->key, 0, strlen(hasher->key));
+			KSI_free(hasher->key);
+		}
+		/* Do not leave the key material in the released memory. */
+		memset(hasher->ipadXORkey, 0, sizeof(hasher->ipadXORkey));
+		memset(hasher->opadXORkey, 0, sizeof(hasher->opadXORkey));
 		KSI_free(hasher);
 	}
 }
@@ -45,6 +45,8 @@ extern "C" {
 	 * \param[in]	data_len	Length of the data.
 	 * \param[out]	hmac		Pointer to the receiving pointer.
 	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The keyed hasher is cached in \c ctx, so repeated calls with the same key and
+	 * algorithm do not derive the padded key again.
 	 * \see #KSI_DataHash_free
 	 */
 	int KSI_HMAC_create(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, const unsigned char *data, size_t data_len, KSI_DataHash **hmac);
@@ -64,7 +66,8 @@ extern "C" {
 	int KSI_HmacHasher_open(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const char *key, KSI_HmacHasher **hasher);
 
 	/**
-	 * Resets the state of the HMAC computation.
+	 * Resets the state of the HMAC computation. The hasher keeps the key, so it can be
+	 * reused for HMAC-ing several messages with the same key.
 	 * \param[in]	hasher			The hasher.
 	 *
 	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
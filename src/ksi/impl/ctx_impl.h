@@ -22,7 +22,9 @@
 
 #include "../types.h"
 #include "../hash.h"
+#include "../hmac.h"
 #include "../ksi.h"
+#include "tlv_template_impl.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +32,12 @@ extern "C" {
 
 #define KSI_ERR_STACK_LEN 16
 
+/** Number of size classes (16 byte steps) in the per-context object pool. */
+#define KSI_OBJECT_POOL_CLASSES 8
+
+/** Number of keyed HMAC hashers cached by #KSI_HMAC_create. */
+#define KSI_HMAC_CACHE_SIZE 4
+
 	typedef void (*GlobalCleanupFn)(void);
 	typedef int (*GlobalInitFn)(void);
 
@@ -111,8 +119,42 @@ extern "C" {
 		/* This list is used to recycle #KSI_AsyncHandle objects to reduce the number of allocs. */
 		KSI_LIST(KSI_AsyncHandle) *asyncHandleRecycle;
 		KSI_LIST(KSI_HighAvailabilityRequest) *haRequestRecycle;
+
+		/* Keyed HMAC hashers with precomputed pad states, reused by #KSI_HMAC_create. */
+		KSI_HmacHasher *hmacCache[KSI_HMAC_CACHE_SIZE];
+		/* Index of the next #hmacCache slot to be replaced. */
+		size_t hmacCacheNext;
+
+		/* Freshly initialized hashers per algorithm, cloned by #KSI_DataHasher_reset. */
+		KSI_DataHasher *hasherPrototype[KSI_NUMBER_OF_KNOWN_HASHALGS];
+
+		/* Compiled template lookup tables, hashed by the template address. */
+		KSI_TlvTemplateIndex *templateIndex[KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE];
+
+		/* Free lists of released small objects per size class, see #KSI_CTX_poolAlloc. */
+		void *objectPool[KSI_OBJECT_POOL_CLASSES];
+		size_t objectPoolLen[KSI_OBJECT_POOL_CLASSES];
 	};
 
+	/**
+	 * Allocates memory for a small object. Blocks released with #KSI_CTX_poolFree are reused
+	 * before falling back to #KSI_malloc.
+	 * \param[in]	ctx		KSI context (may be \c NULL).
+	 * \param[in]	size	Size of the object.
+	 * \return Pointer to the memory or \c NULL if out of memory.
+	 * \note The memory must be released with #KSI_CTX_poolFree with the same \c size before the context is freed.
+	 */
+	void *KSI_CTX_poolAlloc(KSI_CTX *ctx, size_t size);
+
+	/**
+	 * Returns the memory allocated with #KSI_CTX_poolAlloc to the context pool, or frees it
+	 * if the pool is full (see #KSI_OPT_OBJECT_POOL_SIZE).
+	 * \param[in]	ctx		KSI context (may be \c NULL).
+	 * \param[in]	ptr		Pointer to the memory.
+	 * \param[in]	size	Size of the object.
+	 */
+	void KSI_CTX_poolFree(KSI_CTX *ctx, void *ptr, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
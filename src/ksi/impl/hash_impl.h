@@ -75,8 +75,22 @@ extern "C" {
 
 		/** Closes the hasher and returns a #KSI_DataHash object. Must not check or modify the DataHasher::isOpen value. */
 		int (*close)(KSI_DataHasher *, KSI_DataHash **);
+
+		/** Copies the intermediate state of the source hasher (of the same algorithm) into this hasher. Must not
+		 * check or modify the DataHasher::isOpen value. May be \c NULL, if the implementation can not copy its state. */
+		int (*copyState)(KSI_DataHasher *, const KSI_DataHasher *);
 	};
 
+	/**
+	 * Copies the intermediate state of an open hasher \c src into \c dst, which must use the same
+	 * algorithm. After the call \c dst is open and continues from where \c src currently is.
+	 * \param[in]	dst			Destination hasher.
+	 * \param[in]	src			Opened source hasher.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Returns #KSI_INVALID_STATE if the hash implementation does not support state copying.
+	 */
+	int KSI_DataHasher_copyState(KSI_DataHasher *dst, const KSI_DataHasher *src);
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,6 +46,15 @@ extern "C" {
 
 		/** Block size of algorithm. */
 		unsigned blockSize;
+
+		/** Hasher holding the state after absorbing #ipadXORkey, or \c NULL if the state can not be copied. */
+		KSI_DataHasher *innerState;
+
+		/** Hasher holding the state after absorbing #opadXORkey, or \c NULL if the state can not be copied. */
+		KSI_DataHasher *outerState;
+
+		/** Copy of the key, used to look up cached hashers. */
+		char *key;
 	};
 
 #ifdef __cplusplus
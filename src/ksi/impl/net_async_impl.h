@@ -22,11 +22,22 @@
 
 #include "../net_async.h"
 #include "../internal.h"
+#include "../tree_builder.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+	/**
+	 * Returns the lesser of two event loop timeouts, where a negative value stands for an infinite timeout.
+	 */
+	#define KSI_ASYNC_TIMEOUT_MIN(a, b) ((a) < 0 ? (b) : ((b) < 0 ? (a) : ((a) < (b) ? (a) : (b))))
+
+	/**
+	 * First usable position in the async client request cache. The position 0 is reserved.
+	 */
+	#define KSI_ASYNC_CACHE_START_POS 1
+
 	/**
 	 * Async request wrapper object.
 	 */
@@ -69,6 +80,20 @@ extern "C" {
 
 		/** Async client id who has handled the request. */
 		size_t parentId;
+		/** Transport layer connection id the request has been sent over. */
+		size_t connId;
+
+		/** Flag indicating that the handle has been put into the async client completion queue. */
+		bool cmplQueued;
+		/** Request specific completion callback. */
+		KSI_AsyncServiceCallback_Completion cmplCallback;
+
+		/** Local aggregation hash chain from the request hash to the local aggregation root hash. */
+		KSI_AggregationHashChain *aggrChain;
+		/** Signature for the local aggregation root hash, shared by the locally aggregated requests. */
+		KSI_Signature *rootSig;
+		/** Locally aggregated request handles in case this is a local aggregation root request. */
+		KSI_LIST(KSI_AsyncHandle) *batch;
 
 		/** Time when the query has been added to the request queue. */
 		time_t reqTime;
@@ -76,6 +101,10 @@ extern "C" {
 		time_t sndTime;
 		/** Time when the response has been received. */
 		time_t rcvTime;
+		/** Monotonic time in milliseconds when the query has been added to the service. */
+		uint64_t reqTimeMs;
+		/** Monotonic time in milliseconds when the query has been handed to the network. */
+		uint64_t sndTimeMs;
 	};
 
 	/**
@@ -105,9 +134,30 @@ extern "C" {
 		 */
 		KSI_ASYNC_PRIVOPT_ENDPOINT_ID,
 
+		/**
+		 * Maximum number of bytes written with a single send call (0 for no limit). Used for testing
+		 * partially sent requests.
+		 * \param		count			Paramer of type size_t.
+		 */
+		KSI_ASYNC_PRIVOPT_SEND_LIMIT,
+
 		__NOF_KSI_ASYNC_OPT
 	};
 
+	/**
+	 * Local aggregation batch. Signing requests are collected into a hash tree and only the root hash is sent out.
+	 */
+	typedef struct KSI_AsyncLocalAggr_st {
+		/** Hash tree of the request hashes. */
+		KSI_TreeBuilder *builder;
+		/** Tree leaf handles in the same order as the request handles. */
+		KSI_LIST(KSI_TreeLeafHandle) *leafs;
+		/** Request handles. */
+		KSI_LIST(KSI_AsyncHandle) *handles;
+		/** Time in milliseconds when the first request was added to the batch. */
+		uint64_t openTime;
+	} KSI_AsyncLocalAggr;
+
 	/**
 	 * Async service presentation layer context object.
 	 */
@@ -122,8 +172,14 @@ extern "C" {
 		/** Private helper methods. */
 		int (*addRequest)(void *, KSI_AsyncHandle *);
 		int (*getResponse)(void *, KSI_OctetString **, size_t *);
+		/** Optional zero-copy alternative to getResponse. The returned PDU is valid until the next call or dispatch. */
+		int (*getResponseRaw)(void *, const unsigned char **, size_t *, size_t *);
 		int (*getCredentials)(void *, const char **, const char **);
 		int (*dispatch)(void *);
+		/** Optional event loop integration methods. */
+		int (*getSockets)(void *, KSI_AsyncSocket *, size_t, size_t *);
+		int (*getTimeout)(void *, long *);
+		int (*socketReady)(void *, int, int);
 
 		/** PDU header field values: */
 		/** Client instanse id. Is set to current unix time when the #KSI_AsyncClient is constructed. */
@@ -138,8 +194,6 @@ extern "C" {
 
 		/** Request cache. */
 		KSI_AsyncHandle **reqCache;
-		/** Request cache position of the last handle that was returned to the used. */
-		size_t tail;
 		/** Nof pending requests (including in error state). */
 		size_t pending;
 		/** Nof received valid responses. */
@@ -148,10 +202,48 @@ extern "C" {
 		/** Push config is not part of the request cache, as it can not be assigned to a particular request handle. */
 		KSI_AsyncHandle *serverConf;
 
+		/** Completion queue. Circular buffer of finalized request cache handles waiting to be returned to the user. */
+		KSI_AsyncHandle **cmplQueue;
+		/** Completion queue position of the next handle to be returned to the user. */
+		size_t cmplHead;
+		/** Nof handles in the completion queue. */
+		size_t cmplCount;
+		/** Time when the request cache has to be checked for timeouts next. The transport layer resets it to 0
+		 * when it finalizes a cached request (eg. send timeout or connection failure). */
+		time_t nextSweep;
+
+		/** Local aggregation batch that is collecting requests. */
+		KSI_AsyncLocalAggr *localAggr;
+		/** Locally aggregated handles that have been finalized and are waiting to be returned to the user. */
+		KSI_LIST(KSI_AsyncHandle) *localAggrDone;
+		/** Position of the next handle to be returned from the local aggregation done list. */
+		size_t localAggrDonePos;
+		/** Nof local aggregation root requests in the request cache. */
+		size_t localAggrRoots;
+		/** Nof locally aggregated requests that are pending (including in error state). */
+		size_t localAggrPending;
+		/** Nof locally aggregated requests with a valid response. */
+		size_t localAggrReceived;
+
+		/** Finalized handles that are waiting for the completion callback to be invoked. */
+		KSI_LIST(KSI_AsyncHandle) *cbQueue;
+		/** Flag indicating that the completion callbacks are being invoked. */
+		bool cbActive;
+
+		/** Request statistics. */
+		KSI_AsyncStatistics stats;
+
 		/** Array of configuration options. */
 		size_t options[__NOF_KSI_ASYNC_OPT];
 	};
 
+	/**
+	 * Add a duration sample to a #KSI_AsyncStatistics histogram.
+	 * \param[in,out]	histogram		Histogram of #KSI_ASYNC_STAT_HISTOGRAM_SIZE buckets.
+	 * \param[in]		ms				Duration in milliseconds.
+	 */
+	void KSI_AsyncStatistics_addSample(size_t *histogram, uint64_t ms);
+
 	/**
 	 * Async service application layer context object.
 	 */
@@ -168,8 +260,12 @@ extern "C" {
 		int (*responseHandler)(void *);
 
 		int (*run)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *);
+		int (*getSockets)(void *, KSI_AsyncSocket *, size_t, size_t *);
+		int (*getTimeout)(void *, long *);
+		int (*socketReady)(void *, int (*)(void *), int, int);
 		int (*getPendingCount)(void *, size_t *);
 		int (*getReceivedCount)(void *, size_t *);
+		int (*getStatistics)(void *, KSI_AsyncStatistics *);
 
 		int (*setOption)(void *, const int, void *);
 		int (*getOption)(void *, const int, void *);
@@ -197,8 +293,30 @@ extern "C" {
 		/** Request components. */
 		bool hasReq;
 		bool hasCnf;
+
+		/** Bitmask of the subservices the request has been routed to. Only used in the routed modes. */
+		KSI_uint64_t routedMask;
+		/** Monotonic time in milliseconds after which a hedged copy of the request is sent out. */
+		uint64_t hedgeAt;
 	};
 
+	/** Number of most recent response times used for calculating the hedging delay. */
+	#define KSI_HA_LATENCY_WINDOW 32
+
+	/**
+	 * Response time statistics of a high availability subservice.
+	 */
+	typedef struct KSI_HighAvailabilityLatency_st {
+		/** Number of measured responses. */
+		size_t count;
+		/** Exponentially weighted moving average of the response time in milliseconds. */
+		double avg;
+		/** Ring buffer of the most recent response times in milliseconds. */
+		uint64_t samples[KSI_HA_LATENCY_WINDOW];
+		/** Response time percentile in milliseconds, see #KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE. */
+		uint64_t hedgeDelay;
+	} KSI_HighAvailabilityLatency;
+
 	/**
 	 * High availability application layer constext object. #KSI_HighAvailabilityService functions incorporates
 	 * logic for handling communication to and from multiple sub-services.
@@ -216,13 +334,64 @@ extern "C" {
 		KSI_Config_Callback confCallback;
 		/** Intercepted #KSI_ASYNC_OPT_CONF_CONSOLIDATE_CALLBACK option for overring default handling. */
 		KSI_AsyncServiceCallback_configConsolidate confConsolidateCallback;
+		/** Intercepted #KSI_ASYNC_OPT_COMPLETION_CALLBACK, as the subservices are operating on cloned handles. */
+		KSI_AsyncServiceCallback_Completion cmplCallback;
+		/** Flag indicating that the completion callbacks are being invoked. */
+		bool cbActive;
 		/** Consolidated configuration based on the responses from individual subservices. */
 		KSI_Config *consolidatedConfig;
 
+		/** Request routing mode, see #KSI_AsyncHaRouting. */
+		size_t routingMode;
+		/** Hedging response time percentile. */
+		size_t hedgePercentile;
+		/** Response time statistics in the same order as the subservices. */
+		KSI_HighAvailabilityLatency *latency;
+		/** Requests waiting for the hedging delay to expire. */
+		KSI_LIST(KSI_HighAvailabilityRequest) *hedgeQueue;
+
 		/** Private helper method for subservice construction. */
 		int (*subservice_new)(KSI_CTX *, KSI_AsyncService **);
 	};
 
+	/**
+	 * Submission queue entry.
+	 */
+	typedef struct KSI_AsyncSubmitEntry_st KSI_AsyncSubmitEntry;
+	struct KSI_AsyncSubmitEntry_st {
+		/** Next entry in the queue. Updated atomically. */
+		KSI_AsyncSubmitEntry *volatile next;
+
+		/** Request data. */
+		bool isExtend;
+		unsigned char imprint[KSI_MAX_IMPRINT_LEN];
+		size_t imprint_len;
+		KSI_uint64_t level;
+		KSI_uint64_t aggrTime;
+		KSI_uint64_t pubTime;
+
+		/** Request context. */
+		void *reqCtx;
+		void (*reqCtx_free)(void*);
+	};
+
+	/**
+	 * Multi-producer single-consumer intrusive queue in front of the async service.
+	 */
+	struct KSI_AsyncSubmitQueue_st {
+		/** Async service the requests are added to. */
+		KSI_AsyncService *service;
+
+		/** Most recently submitted entry. Exchanged atomically by the producers. */
+		KSI_AsyncSubmitEntry *volatile head;
+		/** Oldest entry. Only accessed by the consumer. */
+		KSI_AsyncSubmitEntry *tail;
+		/** Placeholder entry that keeps the queue non-empty. */
+		KSI_AsyncSubmitEntry stub;
+		/** Entry that has been dequeued, but not accepted by the service yet. */
+		KSI_AsyncSubmitEntry *held;
+	};
+
 #ifdef __cplusplus
 }
 #endif
@@ -48,6 +48,7 @@
 #    include <netdb.h>
 #  endif
 #  include <sys/time.h>
+#  include <sys/uio.h>
 #endif
 
 #ifdef _WIN32
@@ -63,6 +64,9 @@
 #  define KSI_SCK_EWOULDBLOCK WSAEWOULDBLOCK
 #  define KSI_SCK_EINPROGRESS WSAEINPROGRESS
 #  define KSI_SCK_EINTR       WSAEINTR
+   typedef WSABUF KSI_SCK_IOVEC;
+#  define KSI_SCK_IOVEC_SET(v, b, l) ((v).buf = (char *)(b), (v).len = (ULONG)(l))
+#  define KSI_SCK_SEND_FLAGS  0
 #else
 #  define KSI_INVALID_SOCKET  (-1)
 #  define KSI_SCK_SOCKET_ERROR (-1)
@@ -73,6 +77,14 @@
 #  define KSI_SCK_EWOULDBLOCK EWOULDBLOCK
 #  define KSI_SCK_EINPROGRESS EINPROGRESS
 #  define KSI_SCK_EINTR       EINTR
+   typedef struct iovec KSI_SCK_IOVEC;
+#  define KSI_SCK_IOVEC_SET(v, b, l) ((v).iov_base = (void *)(b), (v).iov_len = (l))
+   /* Report a closed peer as EPIPE instead of raising SIGPIPE. */
+#  ifdef MSG_NOSIGNAL
+#    define KSI_SCK_SEND_FLAGS  MSG_NOSIGNAL
+#  else
+#    define KSI_SCK_SEND_FLAGS  0
+#  endif
 #endif
 
 #ifndef TEMP_FAILURE_RETRY
@@ -21,6 +21,7 @@
 #define SIGNATURE_IMPL_H_
 
 #include "../verification.h"
+#include "../fast_tlv.h"
 
 #include "verification_impl.h"
 
@@ -101,6 +102,31 @@ extern "C" {
 		int (*removeCalAuthAndPublication)(KSI_Signature *sig);
 	};
 
+	/**
+	 * Lazily parsed KSI signature.
+	 */
+	struct KSI_LazySignature_st {
+		/** KSI context. */
+		KSI_CTX *ctx;
+		/** The raw signature, owned by the caller. */
+		const unsigned char *raw;
+		/** Length of the raw signature. */
+		size_t raw_len;
+		/** Payload of the top-level signature element. */
+		const unsigned char *payload;
+		/** Index of the signature components, offsets relative to #payload. */
+		KSI_FTLV *index;
+		/** Number of the elements in #index. */
+		size_t index_len;
+		/** Signing time, materialized on first access. */
+		KSI_Integer *signingTime;
+		/** Document hash, materialized on first access. */
+		KSI_DataHash *documentHash;
+		/** Calendar hash chain, materialized on first access. */
+		KSI_CalendarHashChain *calendarChain;
+		/** Fully parsed signature, materialized on first access. */
+		KSI_Signature *signature;
+	};
 
 #ifdef __cplusplus
 }
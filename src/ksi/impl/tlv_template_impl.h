@@ -0,0 +1,87 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef TLV_TEMPLATE_IMPL_H_
+#define TLV_TEMPLATE_IMPL_H_
+
+#include "../internal.h"
+#include "../tlv_template.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/** Number of compiled template indices cached per context (must be a power of two). */
+	#define KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE 128
+
+	/** Maximum number of template entries covered by a compiled index. */
+	#define KSI_TLV_TEMPLATE_INDEX_MAX_LEN 64
+
+	/** Number of buckets in the tag lookup table of a compiled index (must be a power of two). */
+	#define KSI_TLV_TEMPLATE_INDEX_BUCKETS 128
+
+	/** Marks an empty bucket or the end of a slot chain. */
+	#define KSI_TLV_TEMPLATE_INDEX_NONE 0xff
+
+	typedef struct KSI_TlvTemplateIndex_st KSI_TlvTemplateIndex;
+
+	/**
+	 * Tag lookup table and field masks compiled from a #KSI_TlvTemplate on first use.
+	 */
+	struct KSI_TlvTemplateIndex_st {
+		/** The template this index was compiled from. */
+		const KSI_TlvTemplate *tmpl;
+
+		/** Number of entries in the template. */
+		size_t template_len;
+
+		/** Open addressing table from tag to the first template slot with this tag. */
+		unsigned short bucketTag[KSI_TLV_TEMPLATE_INDEX_BUCKETS];
+		unsigned char bucketSlot[KSI_TLV_TEMPLATE_INDEX_BUCKETS];
+
+		/** Next template slot with the same tag, in template order. */
+		unsigned char nextSlot[KSI_TLV_TEMPLATE_INDEX_MAX_LEN];
+
+		/** Bitmask of slots with #KSI_TLV_TMPL_FLG_MANDATORY. */
+		KSI_uint64_t mandatory;
+
+		/** Are there slots with #KSI_TLV_TMPL_FLG_LEAST_ONE_G0 or #KSI_TLV_TMPL_FLG_LEAST_ONE_G1. */
+		bool hasGroup[2];
+	};
+
+	void KSI_TlvTemplateIndex_free(KSI_TlvTemplateIndex *idx);
+
+	/**
+	 * Selects the template of the aggregation and extending PDU payloads according to the PDU version
+	 * set in the context. When \c tmpl is set to \c NULL, the payload is serialized as an empty element.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	data		Payload object.
+	 * \param[out]	tmpl		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_AggregationReq_getTemplate(KSI_CTX *ctx, const KSI_AggregationReq *data, const KSI_TlvTemplate **tmpl);
+	int KSI_AggregationResp_getTemplate(KSI_CTX *ctx, const KSI_AggregationResp *data, const KSI_TlvTemplate **tmpl);
+	int KSI_ExtendReq_getTemplate(KSI_CTX *ctx, const KSI_ExtendReq *data, const KSI_TlvTemplate **tmpl);
+	int KSI_ExtendResp_getTemplate(KSI_CTX *ctx, const KSI_ExtendResp *data, const KSI_TlvTemplate **tmpl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TLV_TEMPLATE_IMPL_H_ */
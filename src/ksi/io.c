@@ -22,10 +22,23 @@
 #include <errno.h>
 #include <limits.h>
 
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 #include "internal.h"
 #include "io.h"
+#include "hash.h"
+#include "impl/ctx_impl.h"
 #include "impl/net_sock_impl.h"
 
+/* Size of the block used for streaming files. */
+#define KSI_IO_FILE_BLOCK_SIZE (1024 * 1024)
+
 int KSI_IO_readSocket(int fd, void *buf, size_t size, size_t *readCount) {
 	int res = KSI_UNKNOWN_ERROR;
 	int c;
@@ -104,3 +117,197 @@ cleanup:
 	return res;
 
 }
+
+static int hashStream(KSI_CTX *ctx, FILE *f, KSI_DataHasher *hsr) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *buf = NULL;
+	size_t rd;
+
+	buf = KSI_malloc(KSI_IO_FILE_BLOCK_SIZE);
+	if (buf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+	/* The advice fails harmlessly for pipes and other streams that can not be read ahead. */
+	posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	do {
+		res = KSI_IO_readFile(f, buf, KSI_IO_FILE_BLOCK_SIZE, &rd);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (ferror(f)) {
+			KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file.");
+			goto cleanup;
+		}
+
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+		/* Start reading the next block while the current one is hashed. */
+		if (rd == KSI_IO_FILE_BLOCK_SIZE) {
+			off_t next = ftello(f);
+			if (next > 0) posix_fadvise(fileno(f), next, KSI_IO_FILE_BLOCK_SIZE, POSIX_FADV_WILLNEED);
+		}
+#endif
+
+		res = KSI_DataHasher_add(hsr, buf, rd);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} while (rd == KSI_IO_FILE_BLOCK_SIZE);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(buf);
+
+	return res;
+}
+
+#ifndef _WIN32
+/* Hashes the regular file in memory-mapped windows of \c window bytes and sets \c hashed to the
+ * number of bytes hashed. The caller is responsible for reading the rest of the file. Accessing
+ * the mapped pages past the end of a file truncated meanwhile raises SIGBUS, thus the file size is
+ * checked before each window is mapped and the mapping is abandoned as soon as the file shrinks. */
+static int hashMapped(KSI_CTX *ctx, int fd, off_t size, size_t window, KSI_DataHasher *hsr, off_t *hashed) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *map = MAP_FAILED;
+	size_t mapLen = 0;
+	off_t offset = 0;
+	long pageSize;
+
+	*hashed = 0;
+
+	/* The window must be a multiple of the page size. */
+	pageSize = sysconf(_SC_PAGESIZE);
+	if (pageSize > 0) {
+		window -= window % (size_t)pageSize;
+		if (window == 0) window = (size_t)pageSize;
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	while (offset < size) {
+		struct stat st;
+
+		if (fstat(fd, &st) != 0 || st.st_size < size) {
+			KSI_LOG_debug(ctx, "File size changed while hashing, reading the rest of the file.");
+			break;
+		}
+
+		mapLen = (size - offset) > (off_t)window ? window : (size_t)(size - offset);
+
+		map = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, offset);
+		if (map == MAP_FAILED) break;
+
+#ifdef MADV_SEQUENTIAL
+		madvise(map, mapLen, MADV_SEQUENTIAL);
+#endif
+#ifdef POSIX_FADV_WILLNEED
+		/* Start reading the next window while the current one is hashed. */
+		if (offset + (off_t)mapLen < size) {
+			posix_fadvise(fd, offset + mapLen, window, POSIX_FADV_WILLNEED);
+		}
+#endif
+
+		res = KSI_DataHasher_add(hsr, map, mapLen);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		munmap(map, mapLen);
+		map = MAP_FAILED;
+
+		offset += mapLen;
+		*hashed = offset;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (map != MAP_FAILED) munmap(map, mapLen);
+
+	return res;
+}
+#endif
+
+int KSI_IO_hashFile(KSI_CTX *ctx, const char *fileName, KSI_HashAlgorithm algo_id, KSI_DataHash **hash) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *tmp = NULL;
+	FILE *f = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || fileName == NULL || hash == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_open(ctx, algo_id, &hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	f = fopen(fileName, "rb");
+	if (f == NULL) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open file.");
+		goto cleanup;
+	}
+
+#ifndef _WIN32
+	if (ctx->options[KSI_OPT_IO_MAP_WINDOW_SIZE] > 0) {
+		struct stat st;
+		off_t hashed = 0;
+
+		if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			res = hashMapped(ctx, fileno(f), st.st_size, ctx->options[KSI_OPT_IO_MAP_WINDOW_SIZE], hsr, &hashed);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			/* Continue with streaming from where the mapping ended. */
+			if (hashed > 0 && fseeko(f, hashed, SEEK_SET) != 0) {
+				KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to seek in file.");
+				goto cleanup;
+			}
+		}
+	}
+#endif
+
+	res = hashStream(ctx, f, hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_close(hsr, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*hash = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (f != NULL) fclose(f);
+	KSI_DataHash_free(tmp);
+	KSI_DataHasher_free(hsr);
+
+	return res;
+}
@@ -48,6 +48,23 @@ extern "C" {
 	 */
 	int KSI_IO_readFile(FILE *f, void *buf, size_t size, size_t *count);
 
+	/**
+	 * Calculates the hash of the file contents. The file is streamed in large blocks. On POSIX systems
+	 * regular files can be memory-mapped window by window instead by setting #KSI_OPT_IO_MAP_WINDOW_SIZE,
+	 * in which case the kernel is advised to read the next window ahead, so the disk I/O overlaps with
+	 * the hashing of the current window.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	fileName	Path to the file.
+	 * \param[in]	algo_id		Hash algorithm id.
+	 * \param[out]	hash		Pointer to the receiving pointer to the data hash object.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note When memory-mapping is enabled, the file must not be truncated while it is being hashed.
+	 * See #KSI_OPT_IO_MAP_WINDOW_SIZE.
+	 * \see #KSI_DataHash_free, #KSI_Signature_sign
+	 */
+	int KSI_IO_hashFile(KSI_CTX *ctx, const char *fileName, KSI_HashAlgorithm algo_id, KSI_DataHash **hash);
+
 #ifdef __cplusplus
 }
 #endif
@@ -421,6 +421,27 @@ typedef enum KSI_Option_en {
 	 */
 	KSI_OPT_HA_SAFEGUARD,
 
+	/**
+	 * The maximum number of released small objects (hash chain links, TLV nodes, octet strings)
+	 * kept per size class for reuse by the same context. Setting the value to 0 disables the pool.
+	 * The pool is disabled by default.
+	 * \param		count		Pool size. Paramer of type size_t.
+	 * \note Objects allocated while the pool is enabled must be released before the context.
+	 */
+	KSI_OPT_OBJECT_POOL_SIZE,
+
+	/**
+	 * The size of the window used by #KSI_IO_hashFile for memory-mapping regular files. The value is
+	 * rounded down to a multiple of the page size. Setting the value to 0 (default) disables the
+	 * memory-mapping and the files are read in blocks.
+	 * \param		size		Window size in bytes. Paramer of type size_t.
+	 * \note		The file must not be truncated by another process while it is being hashed, as
+	 *				accessing a mapped page past the end of the file raises SIGBUS. The file size is
+	 *				checked before each window is mapped, but this can not rule out a truncation while
+	 *				the window is being hashed.
+	 */
+	KSI_OPT_IO_MAP_WINDOW_SIZE,
+
 	__KSI_NUMBER_OF_OPTIONS,
 } KSI_Option;
 
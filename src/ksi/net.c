@@ -1338,8 +1338,12 @@ int KSI_AbstractAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
 	tmp->addRequest = NULL;
 	tmp->responseHandler = NULL;
 	tmp->run = NULL;
+	tmp->getSockets = NULL;
+	tmp->getTimeout = NULL;
+	tmp->socketReady = NULL;
 	tmp->getPendingCount = NULL;
 	tmp->getReceivedCount = NULL;
+	tmp->getStatistics = NULL;
 	tmp->setOption = NULL;
 
 	tmp->setEndpoint = NULL;
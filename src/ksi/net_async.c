@@ -39,10 +39,9 @@
 #define KSI_ASYNC_DEFAULT_ROUND_MAX_COUNT 1
 #define KSI_ASYNC_DEFAULT_REQUEST_CACHE_SIZE 1
 #define KSI_ASYNC_DEFAULT_TIMEOUT_SEC 10
+#define KSI_ASYNC_DEFAULT_CONNECTION_COUNT 1
 #define KSI_ASYNC_ROUND_DURATION_SEC 1
 
-#define KSI_ASYNC_CACHE_START_POS 1
-
 static void KSI_AsyncHandle_cleanup(KSI_AsyncHandle *o) {
 	if (o != NULL) {
 		KSI_AggregationReq_free(o->aggrReq);
@@ -51,6 +50,9 @@ static void KSI_AsyncHandle_cleanup(KSI_AsyncHandle *o) {
 		if (o->userCtx_free) o->userCtx_free(o->userCtx);
 		KSI_free(o->raw);
 		KSI_Utf8String_free(o->errMsg);
+		KSI_AggregationHashChain_free(o->aggrChain);
+		KSI_Signature_free(o->rootSig);
+		KSI_AsyncHandleList_free(o->batch);
 
 		KSI_nofree(o->signature);
 		KSI_nofree(o->pubRec);
@@ -115,6 +117,8 @@ int KSI_AbstractAsyncHandle_new(KSI_CTX *ctx, KSI_AsyncHandle **o) {
 	tmp->reqTime = 0;
 	tmp->sndTime = 0;
 	tmp->rcvTime = 0;
+	tmp->reqTimeMs = 0;
+	tmp->sndTimeMs = 0;
 
 	tmp->userCtx = NULL;
 	tmp->userCtx_free = NULL;
@@ -126,6 +130,13 @@ int KSI_AbstractAsyncHandle_new(KSI_CTX *ctx, KSI_AsyncHandle **o) {
 	tmp->errMsg = NULL;
 
 	tmp->parentId = 0;
+	tmp->connId = 0;
+	tmp->cmplQueued = false;
+	tmp->cmplCallback = NULL;
+
+	tmp->aggrChain = NULL;
+	tmp->rootSig = NULL;
+	tmp->batch = NULL;
 
 	*o = tmp;
 	tmp = NULL;
@@ -361,13 +372,104 @@ cleanup:
 	return res;
 }
 
+static int appendLocalAggrChain(const KSI_AsyncHandle *h, KSI_Signature *rootSig, KSI_uint64_t level, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureBuilder *builder = NULL;
+
+	if (h == NULL || h->aggrChain == NULL || rootSig == NULL || sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_SignatureBuilder_openFromSignature(rootSig, &builder);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_SignatureBuilder_setAggregationChainStartLevel(builder, level);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_SignatureBuilder_appendAggregationChain(builder, h->aggrChain);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The signature is verified against the request hash by the caller. */
+	builder->noVerify = 1;
+	res = KSI_SignatureBuilder_close(builder, level, sig);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_SignatureBuilder_free(builder);
+	return res;
+}
+
+static int createRootSignature(KSI_CTX *ctx, const KSI_AggregationResp *resp, KSI_uint64_t level, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureBuilder *builder = NULL;
+	KSI_Signature *respSig = NULL;
+
+	if (resp == NULL || sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_SignatureBuilder_openFromAggregationResp(resp, &builder);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The response is shared by all the locally aggregated requests. As applying the root level
+	 * updates the hash chains in place, do it on a copy of the signature. */
+	builder->noVerify = 1;
+	res = KSI_SignatureBuilder_close(builder, 0, &respSig);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	KSI_SignatureBuilder_free(builder);
+	builder = NULL;
+
+	res = KSI_SignatureBuilder_openFromSignature(respSig, &builder);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	builder->noVerify = 1;
+	res = KSI_SignatureBuilder_close(builder, level, sig);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_SignatureBuilder_free(builder);
+	KSI_Signature_free(respSig);
+	return res;
+}
+
 static int createSignature(const KSI_AsyncHandle *h, KSI_Signature **sig) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Signature *tmp = NULL;
+	KSI_Signature *rootSig = NULL;
 	KSI_DataHash *rootHash = NULL;
 	KSI_Integer *rootLevel = NULL;
 	KSI_AggregationResp *resp = NULL;
 	KSI_SignatureBuilder *builder = NULL;
+	KSI_uint64_t level = 0;
 
 	if (h == NULL || sig == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -381,21 +483,46 @@ static int createSignature(const KSI_AsyncHandle *h, KSI_Signature **sig) {
 	}
 	resp = (KSI_AggregationResp *)h->respCtx;
 
-	res = KSI_SignatureBuilder_openFromAggregationResp(resp, &builder);
-	if (res != KSI_OK) {
-		KSI_pushError(h->ctx, res, NULL);
-		goto cleanup;
-	}
-
 	res = KSI_AggregationReq_getRequestLevel(h->aggrReq, &rootLevel);
 	if (res != KSI_OK) {
 		KSI_pushError(h->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Turn off the verification. */
-	builder->noVerify = 1;
-	res = KSI_SignatureBuilder_close(builder, KSI_Integer_getUInt64(rootLevel), &tmp);
+	level = KSI_Integer_getUInt64(rootLevel);
+
+	if (h->aggrChain != NULL) {
+		/* The request has been aggregated locally, the response is for the local aggregation root. */
+		if (h->rootSig != NULL) {
+			rootSig = KSI_Signature_ref(h->rootSig);
+		} else {
+			int aggrLevel = 0;
+
+			res = KSI_AggregationHashChain_aggregate(h->aggrChain, (int)level, &aggrLevel, NULL);
+			if (res != KSI_OK) {
+				KSI_pushError(h->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = createRootSignature(h->ctx, resp, (KSI_uint64_t)aggrLevel, &rootSig);
+			if (res != KSI_OK) {
+				KSI_pushError(h->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		res = appendLocalAggrChain(h, rootSig, level, &tmp);
+	} else {
+		res = KSI_SignatureBuilder_openFromAggregationResp(resp, &builder);
+		if (res != KSI_OK) {
+			KSI_pushError(h->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Turn off the verification. */
+		builder->noVerify = 1;
+		res = KSI_SignatureBuilder_close(builder, level, &tmp);
+	}
 	if (res != KSI_OK) {
 		KSI_pushError(h->ctx, res, NULL);
 		goto cleanup;
@@ -419,6 +546,7 @@ static int createSignature(const KSI_AsyncHandle *h, KSI_Signature **sig) {
 	res = KSI_OK;
 cleanup:
 	KSI_SignatureBuilder_free(builder);
+	KSI_Signature_free(rootSig);
 	KSI_Signature_free(tmp);
 	return res;
 }
@@ -575,6 +703,20 @@ cleanup:
 	return res;
 }
 
+int KSI_AsyncHandle_setCompletionCallback(KSI_AsyncHandle *o, KSI_AsyncServiceCallback_Completion callback) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (o == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	o->cmplCallback = callback;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
 
 static int asyncClient_calculateRequestId(KSI_AsyncClient *c, KSI_uint64_t *id, KSI_uint64_t *offset) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -711,9 +853,15 @@ static int addRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle, void *req,
 	handle->respCtx_free = NULL;
 	handle->respCtx = NULL;
 	handle->id = 0;
+	handle->cmplQueued = false;
+	KSI_AggregationHashChain_free(handle->aggrChain);
+	handle->aggrChain = NULL;
+	KSI_Signature_free(handle->rootSig);
+	handle->rootSig = NULL;
 
 	/* Update the request handler. */
 	handle->parentId = c->options[KSI_ASYNC_PRIVOPT_ENDPOINT_ID];
+	handle->reqTimeMs = KSI_getMonotonicTimeMs();
 
 	/* Update request id only in case of ksi service request. */
 	if (hasRequest) {
@@ -825,7 +973,7 @@ cleanup:
 	return res;
 }
 
-static int asyncClient_addAggregatorRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+static int asyncClient_sendAggregatorRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_DataHash *reqHash = NULL;
 	KSI_Config *reqConfig = NULL;
@@ -895,130 +1043,587 @@ cleanup:
 	return res;
 }
 
-static void asyncClient_setResponseError(KSI_AsyncClient *c, int state, int err, long extErr, KSI_Utf8String *errMsg) {
-	size_t i;
+static void KSI_AsyncLocalAggr_free(KSI_AsyncLocalAggr *o) {
+	if (o != NULL) {
+		KSI_TreeLeafHandleList_free(o->leafs);
+		KSI_TreeBuilder_free(o->builder);
+		KSI_AsyncHandleList_free(o->handles);
+		KSI_free(o);
+	}
+}
 
-	if (c == NULL) return;
+static int KSI_AsyncLocalAggr_new(KSI_CTX *ctx, KSI_AsyncLocalAggr **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncLocalAggr *tmp = NULL;
 
-	for (i = KSI_ASYNC_CACHE_START_POS; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
-		if (c->reqCache[i] != NULL && c->reqCache[i]->state == state) {
-			c->reqCache[i]->state = KSI_ASYNC_STATE_ERROR;
-			c->reqCache[i]->err = err;
-			c->reqCache[i]->errExt = extErr;
-			c->reqCache[i]->errMsg = KSI_Utf8String_ref(errMsg);
+	if (ctx == NULL || o == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_AsyncLocalAggr);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->builder = NULL;
+	tmp->leafs = NULL;
+	tmp->handles = NULL;
+	tmp->openTime = KSI_getMonotonicTimeMs();
+
+	res = KSI_TreeBuilder_new(ctx, KSI_getHashAlgorithmByName("default"), &tmp->builder);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TreeLeafHandleList_new(&tmp->leafs);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AsyncHandleList_new(&tmp->handles);
+	if (res != KSI_OK) goto cleanup;
+
+	*o = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncLocalAggr_free(tmp);
+	return res;
+}
+
+static KSI_AsyncServiceCallback_Completion asyncClient_getCompletionCallback(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	if (handle->cmplCallback != NULL) return handle->cmplCallback;
+	return (KSI_AsyncServiceCallback_Completion)c->options[KSI_ASYNC_OPT_COMPLETION_CALLBACK];
+}
+
+static void asyncClient_localAggrSetDone(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	KSI_AsyncHandle *ref = NULL;
+	bool callback;
+
+	if (c == NULL || handle == NULL) return;
+
+	callback = (asyncClient_getCompletionCallback(c, handle) != NULL);
+	if (KSI_AsyncHandleList_append((callback ? c->cbQueue : c->localAggrDone), (ref = KSI_AsyncHandle_ref(handle))) != KSI_OK) {
+		/* The handle is lost, keep the counters consistent. */
+		KSI_AsyncHandle_free(ref);
+		callback = true;
+	}
+
+	/* The handle is finalized at once, if it is not returned via the done list. */
+	if (callback) {
+		if (handle->state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+			c->localAggrReceived--;
+		} else {
+			c->localAggrPending--;
 		}
 	}
+}
 
-	if (c->serverConf != NULL && c->serverConf->state == state) {
-		c->serverConf->state = KSI_ASYNC_STATE_ERROR;
-		c->serverConf->err = err;
-		c->serverConf->errExt = extErr;
-		c->serverConf->errMsg = KSI_Utf8String_ref(errMsg);
+static void asyncClient_localAggrSetError(KSI_AsyncClient *c, KSI_LIST(KSI_AsyncHandle) *handles, int err, long errExt, KSI_Utf8String *errMsg) {
+	size_t i;
+
+	if (c == NULL) return;
+
+	for (i = 0; i < KSI_AsyncHandleList_length(handles); i++) {
+		KSI_AsyncHandle *handle = NULL;
+
+		if (KSI_AsyncHandleList_elementAt(handles, i, &handle) != KSI_OK || handle == NULL) continue;
+
+		handle->state = KSI_ASYNC_STATE_ERROR;
+		handle->err = err;
+		handle->errExt = errExt;
+		KSI_Utf8String_free(handle->errMsg);
+		handle->errMsg = KSI_Utf8String_ref(errMsg);
+		asyncClient_localAggrSetDone(c, handle);
 	}
 }
 
-static int handleResponse(KSI_AsyncClient *c, void *resp,
-			int (*asyncHandle_getRequest)(const KSI_AsyncHandle *h, void **req),
-			int (*convertStatusCode)(const KSI_Integer *statusCode),
-			int (*resp_getRequestId)(const void *resp, KSI_Integer **requestId),
-			int (*resp_verifyWithRequest)(const void *resp, const void *req),
-			int (*resp_getStatus)(const void *resp, KSI_Integer **status),
-			int (*resp_getErrorMsg)(const void *resp, KSI_Utf8String **errorMsg),
-			void* (*resp_ref)(void *resp),
-			void (*resp_free)(void *resp)) {
+static int asyncClient_localAggrSubmit(KSI_AsyncClient *c) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_Integer *reqId = NULL;
+	KSI_AsyncLocalAggr *batch = NULL;
 	KSI_AsyncHandle *handle = NULL;
-	KSI_uint64_t id = 0;
+	KSI_AsyncHandle *root = NULL;
+	KSI_TreeNode *rootNode = NULL;
+	size_t i;
 
-	if (c == NULL || resp == NULL) {
+	if (c == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 	KSI_ERR_clearErrors(c->ctx);
 
-	res = resp_getRequestId(resp, &reqId);
-	if (res != KSI_OK) {
-		KSI_pushError(c->ctx, res , NULL);
+	if (c->localAggr == NULL || KSI_AsyncHandleList_length(c->localAggr->handles) == 0) {
+		res = KSI_OK;
 		goto cleanup;
 	}
 
-	/* Get handle from the cache. */
-	id = KSI_Integer_getUInt64(reqId) & KSI_ASYNC_REQUEST_ID_MASK;
-	if (c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] <= id ||
-			(handle = c->reqCache[id]) == NULL || handle->id != KSI_Integer_getUInt64(reqId)) {
-		KSI_LOG_warn(c->ctx, "Unexpected async response received.");
+	/* Keep collecting until there is spare place in the request cache. */
+	if (c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] <= (c->pending + c->received + 1)) {
 		res = KSI_OK;
 		goto cleanup;
 	}
 
-	if (handle->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
-		KSI_Integer *status = NULL;
-		void *req = NULL;
+	batch = c->localAggr;
+	c->localAggr = NULL;
 
-		res = asyncHandle_getRequest(handle, &req);
-		if (res != KSI_OK) {
-			KSI_pushError(c->ctx, res, NULL);
-			goto cleanup;
-		}
+	if (KSI_AsyncHandleList_length(batch->handles) == 1) {
+		/* There is nothing to aggregate, send the request as is. */
+		res = KSI_AsyncHandleList_elementAt(batch->handles, 0, &handle);
+		if (res != KSI_OK) goto cleanup;
 
-		res = resp_verifyWithRequest(resp, req);
-		if (res != KSI_OK) {
-			KSI_pushError(c->ctx, res, NULL);
-			goto cleanup;
-		}
+		res = asyncClient_sendAggregatorRequest(c, handle);
+		if (res != KSI_OK) goto cleanup;
 
-		/* Verify response status. */
-		res = resp_getStatus(resp, &status);
-		if (res != KSI_OK) {
-			KSI_pushError(c->ctx, res, NULL);
-			goto cleanup;
-		}
+		/* The request cache has taken over the reference. */
+		KSI_AsyncHandle_ref(handle);
+		c->localAggrPending--;
+		res = KSI_OK;
+		goto cleanup;
+	}
 
-		res = convertStatusCode(status);
-		if (res != KSI_OK) {
-			KSI_Utf8String *errorMsg = NULL;
+	res = KSI_TreeBuilder_close(batch->builder);
+	if (res != KSI_OK) goto cleanup;
+	rootNode = batch->builder->rootNode;
 
-			resp_getErrorMsg(resp, &errorMsg);
-			KSI_LOG_error(c->ctx, "Async request failed: [%llx] %s", (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
+	res = KSI_AsyncSigningHandle_new(c->ctx, KSI_DataHash_ref(rootNode->hash), rootNode->level, &root);
+	if (res != KSI_OK) goto cleanup;
 
-			handle->state = KSI_ASYNC_STATE_ERROR;
-			handle->err = res;
-			handle->errExt = (long)KSI_Integer_getUInt64(status);
-			handle->errMsg = KSI_Utf8String_ref(errorMsg);
-		} else {
-			handle->respCtx = resp_ref(resp);
-			handle->respCtx_free = resp_free;
+	/* Extract the hash chains from the request hashes to the local root. */
+	for (i = 0; i < KSI_AsyncHandleList_length(batch->handles); i++) {
+		KSI_TreeLeafHandle *leaf = NULL;
 
-			handle->state = KSI_ASYNC_STATE_RESPONSE_RECEIVED;
-			c->pending--;
-			c->received++;
-		}
+		res = KSI_AsyncHandleList_elementAt(batch->handles, i, &handle);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_TreeLeafHandleList_elementAt(batch->leafs, i, &leaf);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_TreeLeafHandle_getAggregationChain(leaf, &handle->aggrChain);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	root->batch = batch->handles;
+	batch->handles = NULL;
+
+	res = asyncClient_sendAggregatorRequest(c, root);
+	if (res != KSI_OK) {
+		batch->handles = root->batch;
+		root->batch = NULL;
+		goto cleanup;
 	}
+	/* The request cache has taken over the root handle. */
+	root = NULL;
+	c->localAggrRoots++;
 
 	res = KSI_OK;
 cleanup:
+	if (batch != NULL) {
+		/* The requests have been accepted already, thus report the failure via the request handles. */
+		if (res != KSI_OK) asyncClient_localAggrSetError(c, batch->handles, res, 0L, NULL);
+		KSI_AsyncLocalAggr_free(batch);
+	}
+	KSI_AsyncHandle_free(root);
+
 	return res;
 }
 
-static int asyncClient_handleAggregationResp(KSI_AsyncClient *c, KSI_AggregationPdu *pdu) {
+static int asyncClient_localAggrAdd(KSI_AsyncClient *c, KSI_AsyncHandle *handle, KSI_DataHash *reqHash) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_AggregationResp *resp = NULL;
+	KSI_Integer *reqLevel = NULL;
+	KSI_TreeLeafHandle *leaf = NULL;
 
-	if (c == NULL || pdu == NULL) {
+	if (c == NULL || handle == NULL || reqHash == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 	KSI_ERR_clearErrors(c->ctx);
 
-	/*Get response object*/
-	res = KSI_AggregationPdu_getResponse(pdu, &resp);
-	if (res != KSI_OK) {
-		KSI_pushError(c->ctx, res, NULL);
+	/* The batch is full, but it has not been possible to send it out yet. */
+	if (c->localAggr != NULL &&
+			KSI_AsyncHandleList_length(c->localAggr->handles) >= c->options[KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT]) {
+		res = KSI_ASYNC_REQUEST_CACHE_FULL;
 		goto cleanup;
 	}
 
-	if (resp != NULL) {
+	if (c->localAggr == NULL) {
+		res = KSI_AsyncLocalAggr_new(c->ctx, &c->localAggr);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_AggregationReq_getRequestLevel(handle->aggrReq, &reqLevel);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TreeBuilder_addDataHash(c->localAggr->builder, reqHash, (int)KSI_Integer_getUInt64(reqLevel), &leaf);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TreeLeafHandleList_append(c->localAggr->leafs, leaf);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+	leaf = NULL;
+
+	/* Cleanup the handle in case it has been added repeteadly. */
+	KSI_free(handle->raw);
+	handle->raw = NULL;
+	KSI_Utf8String_free(handle->errMsg);
+	handle->errMsg = NULL;
+	if (handle->respCtx_free) handle->respCtx_free(handle->respCtx);
+	handle->respCtx_free = NULL;
+	handle->respCtx = NULL;
+	handle->id = 0;
+	handle->cmplQueued = false;
+	KSI_AggregationHashChain_free(handle->aggrChain);
+	handle->aggrChain = NULL;
+	KSI_Signature_free(handle->rootSig);
+	handle->rootSig = NULL;
+
+	handle->parentId = c->options[KSI_ASYNC_PRIVOPT_ENDPOINT_ID];
+	handle->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
+	time(&handle->reqTime);
+	handle->reqTimeMs = KSI_getMonotonicTimeMs();
+
+	/* The batch holds the reference until the handle is returned to the user. */
+	res = KSI_AsyncHandleList_append(c->localAggr->handles, handle);
+	if (res != KSI_OK) {
+		size_t last = KSI_TreeLeafHandleList_length(c->localAggr->leafs) - 1;
+		KSI_TreeLeafHandleList_remove(c->localAggr->leafs, last, NULL);
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+	c->localAggrPending++;
+
+	if (KSI_AsyncHandleList_length(c->localAggr->handles) >= c->options[KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT]) {
+		res = asyncClient_localAggrSubmit(c);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, "Async client failed to send out local aggregation request.");
+			KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_TreeLeafHandle_free(leaf);
+	return res;
+}
+
+static int asyncClient_addAggregatorRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *reqHash = NULL;
+	KSI_Config *reqConfig = NULL;
+
+	if (c == NULL || handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_AggregationReq_getRequestHash(handle->aggrReq, &reqHash);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_getConfig(handle->aggrReq, &reqConfig);
+	if (res != KSI_OK) goto cleanup;
+
+	if (reqHash != NULL && reqConfig == NULL && c->options[KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT] > 1) {
+		res = asyncClient_localAggrAdd(c, handle, reqHash);
+	} else {
+		res = asyncClient_sendAggregatorRequest(c, handle);
+	}
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+void KSI_AsyncStatistics_addSample(size_t *histogram, uint64_t ms) {
+	size_t i = 0;
+
+	if (histogram == NULL) return;
+
+	while (ms > 0 && i < KSI_ASYNC_STAT_HISTOGRAM_SIZE - 1) {
+		ms >>= 1;
+		i++;
+	}
+	histogram[i]++;
+}
+
+static void asyncClient_statFailed(KSI_AsyncClient *c, const KSI_AsyncHandle *handle) {
+	switch (handle->err) {
+		case KSI_NETWORK_CONNECTION_TIMEOUT:
+		case KSI_NETWORK_SEND_TIMEOUT:
+		case KSI_NETWORK_RECIEVE_TIMEOUT:
+			c->stats.timedOut++;
+			break;
+		default:
+			c->stats.failed++;
+			break;
+	}
+}
+
+static void asyncClient_localAggrComplete(KSI_AsyncClient *c, KSI_AsyncHandle *root) {
+	KSI_Signature *rootSig = NULL;
+	size_t i;
+	size_t id;
+
+	if (c == NULL || root == NULL || root->batch == NULL) return;
+
+	id = (size_t)(root->id & KSI_ASYNC_REQUEST_ID_MASK);
+	if (id >= c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] || c->reqCache[id] != root) return;
+	c->reqCache[id] = NULL;
+	c->localAggrRoots--;
+
+	if (root->state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+		c->received--;
+	} else {
+		c->pending--;
+	}
+
+	if (root->state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+		KSI_Integer *rootLevel = NULL;
+
+		/* Build the root signature once for the whole batch. On failure the signature is built, and the
+		 * error is reported, per request when the signature is requested. */
+		if (KSI_AggregationReq_getRequestLevel(root->aggrReq, &rootLevel) == KSI_OK) {
+			createRootSignature(c->ctx, (KSI_AggregationResp*)root->respCtx, KSI_Integer_getUInt64(rootLevel), &rootSig);
+		}
+	}
+
+	/* Fan out the root response to the locally aggregated requests. */
+	for (i = 0; i < KSI_AsyncHandleList_length(root->batch); i++) {
+		KSI_AsyncHandle *handle = NULL;
+
+		if (KSI_AsyncHandleList_elementAt(root->batch, i, &handle) != KSI_OK || handle == NULL) continue;
+
+		handle->id = root->id;
+		handle->sndTime = root->sndTime;
+		handle->rcvTime = root->rcvTime;
+
+		if (root->state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+			handle->respCtx = (void*)KSI_AggregationResp_ref((KSI_AggregationResp*)root->respCtx);
+			handle->respCtx_free = root->respCtx_free;
+			handle->rootSig = KSI_Signature_ref(rootSig);
+			handle->state = KSI_ASYNC_STATE_RESPONSE_RECEIVED;
+			c->localAggrPending--;
+			c->localAggrReceived++;
+			asyncClient_localAggrSetDone(c, handle);
+		}
+	}
+	if (root->state != KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+		asyncClient_statFailed(c, root);
+		asyncClient_localAggrSetError(c, root->batch, root->err, root->errExt, root->errMsg);
+	}
+
+	/* The root handle might be still referenced by the transport layer. */
+	KSI_AsyncHandleList_free(root->batch);
+	root->batch = NULL;
+	KSI_AsyncHandle_free(root);
+	KSI_Signature_free(rootSig);
+}
+
+static bool asyncClient_finalizeRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	if (c == NULL || handle == NULL) return false;
+
+	switch (handle->state) {
+		case KSI_ASYNC_STATE_WAITING_FOR_RESPONSE:
+			/* Verify that the handle has not been waiting a response for too long. */
+			if (c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] == 0 ||
+				difftime(time(NULL), handle->sndTime) > c->options[KSI_ASYNC_OPT_RCV_TIMEOUT]) {
+				/* Set handle into error state and return it. */
+				handle->state = KSI_ASYNC_STATE_ERROR;
+				handle->err = KSI_NETWORK_RECIEVE_TIMEOUT;
+				c->pending--;
+				asyncClient_statFailed(c, handle);
+				return true;
+			}
+			return false;
+
+		case KSI_ASYNC_STATE_ERROR:
+			c->pending--;
+			asyncClient_statFailed(c, handle);
+			return true;
+
+		case KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED:
+		case KSI_ASYNC_STATE_RESPONSE_RECEIVED:
+			c->received--;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static void asyncClient_pushCompleted(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	size_t size;
+
+	if (c == NULL || c->cmplQueue == NULL || handle == NULL || handle->cmplQueued) return;
+
+	if (handle->batch != NULL) {
+		asyncClient_localAggrComplete(c, handle);
+		return;
+	}
+
+	/* Handles with a completion callback are finalized at once and delivered after the responses are handled. */
+	if (asyncClient_getCompletionCallback(c, handle) != NULL) {
+		size_t id = (size_t)(handle->id & KSI_ASYNC_REQUEST_ID_MASK);
+
+		if (id >= c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] || c->reqCache[id] != handle) return;
+		if (asyncClient_finalizeRequest(c, handle) == true) {
+			c->reqCache[id] = NULL;
+			handle->cmplQueued = true;
+			/* The handle ownership is moved from the request cache to the callback queue. */
+			if (KSI_AsyncHandleList_append(c->cbQueue, handle) != KSI_OK) KSI_AsyncHandle_free(handle);
+		}
+		return;
+	}
+
+	/* The queue can not overflow, as each cached handle is queued only once. */
+	size = c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE];
+	if (c->cmplCount >= size) return;
+
+	c->cmplQueue[(c->cmplHead + c->cmplCount) % size] = handle;
+	c->cmplCount++;
+	handle->cmplQueued = true;
+}
+
+static void asyncClient_setResponseError(KSI_AsyncClient *c, int state, int err, long extErr, KSI_Utf8String *errMsg) {
+	size_t i;
+
+	if (c == NULL) return;
+
+	for (i = KSI_ASYNC_CACHE_START_POS; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
+		if (c->reqCache[i] != NULL && c->reqCache[i]->state == state) {
+			c->reqCache[i]->state = KSI_ASYNC_STATE_ERROR;
+			c->reqCache[i]->err = err;
+			c->reqCache[i]->errExt = extErr;
+			c->reqCache[i]->errMsg = KSI_Utf8String_ref(errMsg);
+			asyncClient_pushCompleted(c, c->reqCache[i]);
+		}
+	}
+
+	if (c->serverConf != NULL && c->serverConf->state == state) {
+		c->serverConf->state = KSI_ASYNC_STATE_ERROR;
+		c->serverConf->err = err;
+		c->serverConf->errExt = extErr;
+		c->serverConf->errMsg = KSI_Utf8String_ref(errMsg);
+	}
+}
+
+static int handleResponse(KSI_AsyncClient *c, void *resp,
+			int (*asyncHandle_getRequest)(const KSI_AsyncHandle *h, void **req),
+			int (*convertStatusCode)(const KSI_Integer *statusCode),
+			int (*resp_getRequestId)(const void *resp, KSI_Integer **requestId),
+			int (*resp_verifyWithRequest)(const void *resp, const void *req),
+			int (*resp_getStatus)(const void *resp, KSI_Integer **status),
+			int (*resp_getErrorMsg)(const void *resp, KSI_Utf8String **errorMsg),
+			void* (*resp_ref)(void *resp),
+			void (*resp_free)(void *resp)) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *reqId = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_uint64_t id = 0;
+
+	if (c == NULL || resp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(c->ctx);
+
+	res = resp_getRequestId(resp, &reqId);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res , NULL);
+		goto cleanup;
+	}
+
+	/* Get handle from the cache. */
+	id = KSI_Integer_getUInt64(reqId) & KSI_ASYNC_REQUEST_ID_MASK;
+	if (c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] <= id ||
+			(handle = c->reqCache[id]) == NULL || handle->id != KSI_Integer_getUInt64(reqId)) {
+		KSI_LOG_warn(c->ctx, "Unexpected async response received.");
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (handle->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
+		KSI_Integer *status = NULL;
+		void *req = NULL;
+
+		c->stats.received++;
+		if (handle->sndTimeMs != 0) {
+			KSI_AsyncStatistics_addSample(c->stats.roundTripTime, KSI_getMonotonicTimeMs() - handle->sndTimeMs);
+		}
+
+		res = asyncHandle_getRequest(handle, &req);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = resp_verifyWithRequest(resp, req);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Verify response status. */
+		res = resp_getStatus(resp, &status);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = convertStatusCode(status);
+		if (res != KSI_OK) {
+			KSI_Utf8String *errorMsg = NULL;
+
+			resp_getErrorMsg(resp, &errorMsg);
+			KSI_LOG_error(c->ctx, "Async request failed: [%llx] %s", (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
+
+			handle->state = KSI_ASYNC_STATE_ERROR;
+			handle->err = res;
+			handle->errExt = (long)KSI_Integer_getUInt64(status);
+			handle->errMsg = KSI_Utf8String_ref(errorMsg);
+		} else {
+			handle->respCtx = resp_ref(resp);
+			handle->respCtx_free = resp_free;
+
+			handle->state = KSI_ASYNC_STATE_RESPONSE_RECEIVED;
+			c->pending--;
+			c->received++;
+		}
+		asyncClient_pushCompleted(c, handle);
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_handleAggregationResp(KSI_AsyncClient *c, KSI_AggregationPdu *pdu) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationResp *resp = NULL;
+
+	if (c == NULL || pdu == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(c->ctx);
+
+	/*Get response object*/
+	res = KSI_AggregationPdu_getResponse(pdu, &resp);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (resp != NULL) {
 		res =  handleResponse(c, resp,
 				(int (*)(const KSI_AsyncHandle *h, void **req))KSI_AsyncHandle_getAggregationReq,
 				KSI_convertAggregatorStatusCode,
@@ -1164,37 +1769,51 @@ static int processResponseQueue(KSI_AsyncClient *c,
 
 	KSI_ERR_clearErrors(c->ctx);
 
-	if (c->clientImpl == NULL || c->getResponse == NULL || c->getCredentials == NULL) {
+	if (c->clientImpl == NULL || (c->getResponse == NULL && c->getResponseRaw == NULL) || c->getCredentials == NULL) {
 		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not properly initialized.");
 		goto cleanup;
 	}
 	impl = c->clientImpl;
 
 	do {
+		const unsigned char *raw = NULL;
+		size_t len = 0;
+
 		/* Cleanup leftovers from previous cycle. */
 		KSI_OctetString_free(resp);
 		resp = NULL;
 		pdu_free(pdu);
 		pdu = NULL;
 
-		res = c->getResponse(impl, &resp, &left);
-		if (res != KSI_OK) {
-			KSI_pushError(c->ctx, res, NULL);
-			goto cleanup;
+		if (c->getResponseRaw != NULL) {
+			/* The PDU is parsed directly from the transport input buffer. */
+			res = c->getResponseRaw(impl, &raw, &len, &left);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+		} else {
+			res = c->getResponse(impl, &resp, &left);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			if (resp != NULL) {
+				res = KSI_OctetString_extract(resp, &raw, &len);
+				if (res != KSI_OK) {
+					KSI_pushError(c->ctx, res, NULL);
+					goto cleanup;
+				}
+			}
 		}
 
-		if (resp != NULL) {
+		if (raw != NULL) {
 			KSI_ErrorPdu *error = NULL;
 			KSI_Config *tmpConf = NULL;
 			const char *pass = NULL;
-			const unsigned char *raw = NULL;
-			size_t len = 0;
 
-			res = KSI_OctetString_extract(resp, &raw, &len);
-			if (res != KSI_OK) {
-				KSI_pushError(c->ctx, res, NULL);
-				goto cleanup;
-			}
+			c->stats.bytesIn += len;
 
 			KSI_LOG_logBlob(c->ctx, KSI_LOG_DEBUG, "Parsing response", raw, len);
 
@@ -1315,39 +1934,47 @@ static int asyncClient_processExtenderResponseQueue(KSI_AsyncClient *c) {
 					c->ctx->options[KSI_OPT_EXT_CONF_RECEIVED_CALLBACK]));
 }
 
-static bool asyncClient_finalizeRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
-	if (c == NULL || handle == NULL) return false;
+static void asyncClient_checkRequestCache(KSI_AsyncClient *c) {
+	size_t i;
+	time_t now;
+	time_t next;
+	size_t timeout;
 
-	switch (handle->state) {
-		case KSI_ASYNC_STATE_WAITING_FOR_RESPONSE:
-			/* Verify that the handle has not been waiting a response for too long. */
-			if (c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] == 0 ||
-				difftime(time(NULL), handle->sndTime) > c->options[KSI_ASYNC_OPT_RCV_TIMEOUT]) {
-				/* Set handle into error state and return it. */
+	if (c == NULL || c->reqCache == NULL || c->pending == 0) return;
+
+	/* Receive timeouts are measured in seconds from the time the request has been sent out. Unless the transport
+	 * layer has finalized a request, there is nothing to collect before the earliest receive timeout elapses. */
+	time(&now);
+	if (c->nextSweep != 0 && now < c->nextSweep) return;
+
+	timeout = c->options[KSI_ASYNC_OPT_RCV_TIMEOUT];
+	/* A request sent out from now on can not time out earlier. */
+	next = now + (time_t)timeout + 1;
+
+	for (i = KSI_ASYNC_CACHE_START_POS; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
+		KSI_AsyncHandle *handle = c->reqCache[i];
+
+		if (handle == NULL || handle->cmplQueued) continue;
+
+		if (handle->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
+			if (timeout == 0 || difftime(now, handle->sndTime) > timeout) {
 				handle->state = KSI_ASYNC_STATE_ERROR;
 				handle->err = KSI_NETWORK_RECIEVE_TIMEOUT;
-				c->pending--;
-				return true;
+			} else if (handle->sndTime + (time_t)timeout + 1 < next) {
+				next = handle->sndTime + (time_t)timeout + 1;
 			}
-			return false;
-
-		case KSI_ASYNC_STATE_ERROR:
-			c->pending--;
-			return true;
-
-		case KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED:
-		case KSI_ASYNC_STATE_RESPONSE_RECEIVED:
-			c->received--;
-			return true;
+		}
 
-		default:
-			return false;
+		if (handle->state == KSI_ASYNC_STATE_ERROR) asyncClient_pushCompleted(c, handle);
 	}
+
+	/* Without a receive timeout the requests time out as soon as they have been sent out. */
+	c->nextSweep = (timeout == 0) ? 0 : next;
 }
 
 static int asyncClient_findNextResponse(KSI_AsyncClient *c, KSI_AsyncHandle **handle) {
 	int res;
-	size_t last;
+	KSI_AsyncHandle *tmp = NULL;
 
 	if (c == NULL || handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -1355,13 +1982,13 @@ static int asyncClient_findNextResponse(KSI_AsyncClient *c, KSI_AsyncHandle **ha
 	}
 	KSI_ERR_clearErrors(c->ctx);
 
-	if (c->reqCache == NULL) {
+	if (c->reqCache == NULL || c->cmplQueue == NULL) {
 		res = KSI_INVALID_STATE;
 		goto cleanup;
 	}
 
 	/* Verify if there are any handles on hold in cache. */
-	if (c->pending == 0 && c->received == 0) {
+	if (c->pending == 0 && c->received == 0 && c->localAggrPending == 0 && c->localAggrReceived == 0) {
 		*handle = NULL;
 		res = KSI_OK;
 		goto cleanup;
@@ -1375,20 +2002,50 @@ static int asyncClient_findNextResponse(KSI_AsyncClient *c, KSI_AsyncHandle **ha
 		goto cleanup;
 	}
 
-	/* Search cache for finalized requests. */
-	last = c->tail;
-	for (;;) {
-		if (asyncClient_finalizeRequest(c, c->reqCache[c->tail]) == true) {
-			*handle = c->reqCache[c->tail];
-			c->reqCache[c->tail] = NULL;
-			res = KSI_OK;
-			goto cleanup;
+	/* Collect handles that have been finalized outside of the response handling. */
+	asyncClient_checkRequestCache(c);
+
+	/* Return the next finalized locally aggregated request. */
+	if (c->localAggrDonePos < KSI_AsyncHandleList_length(c->localAggrDone)) {
+		res = KSI_AsyncHandleList_elementAt(c->localAggrDone, c->localAggrDonePos++, &tmp);
+		if (res != KSI_OK) goto cleanup;
+
+		if (tmp->state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+			c->localAggrReceived--;
+		} else {
+			c->localAggrPending--;
 		}
+		*handle = KSI_AsyncHandle_ref(tmp);
 
-		if (++c->tail == c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]) c->tail = KSI_ASYNC_CACHE_START_POS;
-		if (c->tail == last) {
-			/* We are back at where we began the search. There are no finalized requests to return yet. */
-			break;
+		/* Release the list references once all handles have been returned. */
+		if (c->localAggrDonePos == KSI_AsyncHandleList_length(c->localAggrDone)) {
+			while (KSI_AsyncHandleList_length(c->localAggrDone) > 0) {
+				KSI_AsyncHandleList_remove(c->localAggrDone, KSI_AsyncHandleList_length(c->localAggrDone) - 1, NULL);
+			}
+			c->localAggrDonePos = 0;
+		}
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* Return the next finalized request from the completion queue. */
+	while (c->cmplCount > 0) {
+		size_t id;
+
+		tmp = c->cmplQueue[c->cmplHead];
+		c->cmplQueue[c->cmplHead] = NULL;
+		c->cmplHead = (c->cmplHead + 1) % c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE];
+		c->cmplCount--;
+
+		tmp->cmplQueued = false;
+		id = (size_t)(tmp->id & KSI_ASYNC_REQUEST_ID_MASK);
+		if (id >= c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] || c->reqCache[id] != tmp) continue;
+
+		if (asyncClient_finalizeRequest(c, tmp) == true) {
+			c->reqCache[id] = NULL;
+			*handle = tmp;
+			res = KSI_OK;
+			goto cleanup;
 		}
 	}
 	/* Nothing to return. */
@@ -1398,32 +2055,64 @@ cleanup:
 	return res;
 }
 
-static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient *), KSI_AsyncHandle **handle, size_t *waiting) {
-	int res = KSI_UNKNOWN_ERROR;
-	bool connClosed = false;
+static void asyncClient_invokeCallbacks(KSI_AsyncClient *c) {
+	size_t i;
+	void *userp = NULL;
 
-	if (c == NULL || handleResp == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
+	if (c == NULL || c->cbActive) return;
+
+	/* Collect handles that have been finalized outside of the response handling. */
+	asyncClient_checkRequestCache(c);
+
+	/* Server configuration is delivered via the service callback. */
+	if (c->serverConf != NULL && c->options[KSI_ASYNC_OPT_COMPLETION_CALLBACK] != 0 &&
+			asyncClient_finalizeRequest(c, c->serverConf) == true) {
+		if (KSI_AsyncHandleList_append(c->cbQueue, c->serverConf) != KSI_OK) KSI_AsyncHandle_free(c->serverConf);
+		c->serverConf = NULL;
 	}
 
-	KSI_ERR_clearErrors(c->ctx);
-	if (c->clientImpl == NULL || c->dispatch == NULL) {
-		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not properly initialized.");
-		goto cleanup;
+	if (KSI_AsyncHandleList_length(c->cbQueue) == 0) return;
+
+	c->cbActive = true;
+	userp = (void *)c->options[KSI_ASYNC_OPT_CALLBACK_USERDATA];
+	for (i = 0; i < KSI_AsyncHandleList_length(c->cbQueue); i++) {
+		int res;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_AsyncServiceCallback_Completion callback = NULL;
+
+		if (KSI_AsyncHandleList_elementAt(c->cbQueue, i, &handle) != KSI_OK || handle == NULL) continue;
+
+		callback = asyncClient_getCompletionCallback(c, handle);
+		if (callback == NULL) continue;
+
+		KSI_ERR_clearErrors(c->ctx);
+		res = callback(c->ctx, handle, handle->state, userp);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, "Async request completion callback returned error.");
+			KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
+		}
 	}
 
-	KSI_ERR_clearErrors(c->ctx);
-	res = c->dispatch(c->clientImpl);
-	if (res == KSI_ASYNC_CONNECTION_CLOSED) {
+	/* Release the handles. */
+	while (KSI_AsyncHandleList_length(c->cbQueue) > 0) {
+		KSI_AsyncHandleList_remove(c->cbQueue, KSI_AsyncHandleList_length(c->cbQueue) - 1, NULL);
+	}
+	c->cbActive = false;
+}
+
+static void asyncClient_processTransport(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient *), int transportRes) {
+	int res = KSI_UNKNOWN_ERROR;
+	bool connClosed = false;
+
+	if (transportRes == KSI_ASYNC_CONNECTION_CLOSED) {
 		/* Request in KSI_ASYNC_STATE_WAITING_FOR_RESPONSE state will not get responded. However, run through the
 		 * response queue first, there might be some valid responses still waiting.
 		 */
 		connClosed = true;
-	} else if (res != KSI_OK) {
-		KSI_pushError(c->ctx, res, "Async client impl returned error.");
+	} else if (transportRes != KSI_OK) {
+		KSI_pushError(c->ctx, transportRes, "Async client impl returned error.");
 		KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
-		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE, res, 0L, NULL);
+		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE, transportRes, 0L, NULL);
 	}
 
 	/* Handle responses. */
@@ -1442,6 +2131,39 @@ static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient
 				KSI_ASYNC_CONNECTION_CLOSED, 0L, NULL);
 	}
 
+	/* Deliver the finalized requests with a completion callback. */
+	asyncClient_invokeCallbacks(c);
+}
+
+static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient *), KSI_AsyncHandle **handle, size_t *waiting) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (c == NULL || handleResp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(c->ctx);
+	if (c->clientImpl == NULL || c->dispatch == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not properly initialized.");
+		goto cleanup;
+	}
+
+	/* Send out the local aggregation batch if its time window has elapsed. */
+	if (c->localAggr != NULL && (c->options[KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT] <= 1 ||
+			KSI_getMonotonicTimeMs() - c->localAggr->openTime >= c->options[KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD])) {
+		KSI_ERR_clearErrors(c->ctx);
+		res = asyncClient_localAggrSubmit(c);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, "Async client failed to send out local aggregation request.");
+			KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
+		}
+	}
+
+	KSI_ERR_clearErrors(c->ctx);
+	res = c->dispatch(c->clientImpl);
+	asyncClient_processTransport(c, handleResp, res);
+
 	if (handle != NULL) {
 		KSI_ERR_clearErrors(c->ctx);
 		res = asyncClient_findNextResponse(c, handle);
@@ -1450,7 +2172,113 @@ static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient
 			KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
 		}
 	}
-	if (waiting != NULL) *waiting = (c->pending + c->received);
+	if (waiting != NULL) {
+		*waiting = (c->pending - c->localAggrRoots + c->localAggrPending) + (c->received + c->localAggrReceived);
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_getSockets(KSI_AsyncClient *c, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (c == NULL || (sockets == NULL && size != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Transports without event loop support do not expose any sockets. */
+	if (c->clientImpl == NULL || c->getSockets == NULL) {
+		*count = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = c->getSockets(c->clientImpl, sockets, size, count);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_getTimeout(KSI_AsyncClient *c, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	long tmp = -1;
+	size_t pending = 0;
+
+	if (c == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Finalized requests are waiting to be collected. */
+	if (c->cmplCount > 0 || c->localAggrDonePos < KSI_AsyncHandleList_length(c->localAggrDone) ||
+			(c->serverConf != NULL && c->serverConf->state != KSI_ASYNC_STATE_WAITING_FOR_RESPONSE)) {
+		*timeout = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* The local aggregation batch has to be sent out at the end of its time window. */
+	if (c->localAggr != NULL) {
+		uint64_t elapsed = KSI_getMonotonicTimeMs() - c->localAggr->openTime;
+
+		if (c->options[KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT] <= 1 || elapsed >= c->options[KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD]) {
+			tmp = 0;
+		} else {
+			tmp = (long)(c->options[KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD] - elapsed);
+		}
+	}
+
+	pending = c->pending - c->localAggrRoots + c->localAggrPending;
+	if (pending > 0) {
+		long transportTimeout = 0;
+
+		/* Transports without event loop support have to be polled continuously. */
+		if (c->clientImpl != NULL && c->getTimeout != NULL) {
+			res = c->getTimeout(c->clientImpl, &transportTimeout);
+			if (res != KSI_OK) goto cleanup;
+		}
+		tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, transportTimeout);
+
+		/* Wake up when the next request can time out. */
+		if (c->nextSweep == 0) {
+			tmp = 0;
+		} else {
+			double left = difftime(c->nextSweep, time(NULL));
+			tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, (left > 0) ? (long)(left * 1000) : 0);
+		}
+	}
+	*timeout = tmp;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_socketReady(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient *), int fd, int events) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (c == NULL || handleResp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(c->ctx);
+	if (c->clientImpl == NULL || c->dispatch == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not properly initialized.");
+		goto cleanup;
+	}
+
+	if (c->socketReady != NULL) {
+		res = c->socketReady(c->clientImpl, fd, events);
+	} else {
+		res = c->dispatch(c->clientImpl);
+	}
+	asyncClient_processTransport(c, handleResp, res);
 
 	res = KSI_OK;
 cleanup:
@@ -1465,7 +2293,8 @@ int asyncClient_getPendingCount(KSI_AsyncClient *c, size_t *count) {
 		goto cleanup;
 	}
 
-	*count = c->pending;
+	/* Local aggregation root requests are accounted via the aggregated requests. */
+	*count = c->pending - c->localAggrRoots + c->localAggrPending;
 
 	res = KSI_OK;
 cleanup:
@@ -1480,7 +2309,22 @@ static int asyncClient_getReceivedCount(KSI_AsyncClient *c, size_t *count) {
 		goto cleanup;
 	}
 
-	*count = c->received;
+	*count = c->received + c->localAggrReceived;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_getStatistics(KSI_AsyncClient *c, KSI_AsyncStatistics *stats) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (c == NULL || stats == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*stats = c->stats;
 
 	res = KSI_OK;
 cleanup:
@@ -1490,6 +2334,7 @@ cleanup:
 static int asyncClient_setOption(KSI_AsyncClient *c, const int opt, void *param) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_AsyncHandle **tmpCache = NULL;
+	KSI_AsyncHandle **tmpQueue = NULL;
 
 	if (c == NULL || opt >= __NOF_KSI_ASYNC_OPT) {
 		res = KSI_INVALID_ARGUMENT;
@@ -1510,7 +2355,8 @@ static int asyncClient_setOption(KSI_AsyncClient *c, const int opt, void *param)
 
 					if (count > c->options[opt]) {
 						tmpCache = KSI_calloc(count, sizeof(KSI_AsyncHandle *));
-						if (tmpCache == NULL) {
+						tmpQueue = KSI_calloc(count, sizeof(KSI_AsyncHandle *));
+						if (tmpCache == NULL || tmpQueue == NULL) {
 							res = KSI_OUT_OF_MEMORY;
 							goto cleanup;
 						}
@@ -1521,22 +2367,47 @@ static int asyncClient_setOption(KSI_AsyncClient *c, const int opt, void *param)
 						KSI_free(c->reqCache);
 						c->reqCache = tmpCache;
 						tmpCache = NULL;
+
+						/* Keep the order of the completion queue. */
+						for (i = 0; i < c->cmplCount; i++) {
+							tmpQueue[i] = c->cmplQueue[(c->cmplHead + i) % c->options[opt]];
+						}
+						KSI_free(c->cmplQueue);
+						c->cmplQueue = tmpQueue;
+						c->cmplHead = 0;
+						tmpQueue = NULL;
 					}
 				}
 				c->options[opt] = count;
 			}
 			break;
 
-		case KSI_ASYNC_OPT_CON_TIMEOUT:
+		case KSI_ASYNC_OPT_CONNECTION_COUNT:
+			if ((size_t)param == 0) {
+				KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, "At least one connection is required.");
+				goto cleanup;
+			}
+			c->options[opt] = (size_t)param;
+			break;
+
 		case KSI_ASYNC_OPT_RCV_TIMEOUT:
+			c->options[opt] = (size_t)param;
+			/* The deadlines of the pending requests have changed. */
+			c->nextSweep = 0;
+			break;
+
+		case KSI_ASYNC_OPT_CON_TIMEOUT:
 		case KSI_ASYNC_OPT_SND_TIMEOUT:
 		case KSI_ASYNC_OPT_MAX_REQUEST_COUNT:
 		case KSI_ASYNC_OPT_CALLBACK_USERDATA:
+		case KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT:
+		case KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD:
 			c->options[opt] = (size_t)param;
 			break;
 
 		case KSI_ASYNC_OPT_PUSH_CONF_CALLBACK:
 		case KSI_ASYNC_OPT_CONNECTION_STATE_CALLBACK:
+		case KSI_ASYNC_OPT_COMPLETION_CALLBACK:
 			c->options[opt] = (size_t)param;
 			break;
 
@@ -1544,6 +2415,7 @@ static int asyncClient_setOption(KSI_AsyncClient *c, const int opt, void *param)
 		case KSI_ASYNC_PRIVOPT_ROUND_DURATION:
 		case KSI_ASYNC_PRIVOPT_INVOKE_CONF_RECEIVED_CALLBACK:
 		case KSI_ASYNC_PRIVOPT_ENDPOINT_ID:
+		case KSI_ASYNC_PRIVOPT_SEND_LIMIT:
 			c->options[opt] = (size_t)param;
 			break;
 
@@ -1556,6 +2428,7 @@ static int asyncClient_setOption(KSI_AsyncClient *c, const int opt, void *param)
 cleanup:
 
 	KSI_free(tmpCache);
+	KSI_free(tmpQueue);
 
 	return res;
 }
@@ -1577,10 +2450,14 @@ static int asyncClient_getOption(KSI_AsyncClient *c, const int opt, void *param)
 		case KSI_ASYNC_OPT_SND_TIMEOUT:
 		case KSI_ASYNC_OPT_MAX_REQUEST_COUNT:
 		case KSI_ASYNC_OPT_CALLBACK_USERDATA:
+		case KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT:
+		case KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD:
+		case KSI_ASYNC_OPT_CONNECTION_COUNT:
 			*(size_t*)param = c->options[opt];
 			break;
 		case KSI_ASYNC_OPT_PUSH_CONF_CALLBACK:
 		case KSI_ASYNC_OPT_CONNECTION_STATE_CALLBACK:
+		case KSI_ASYNC_OPT_COMPLETION_CALLBACK:
 			*(size_t*)param = c->options[opt];
 			break;
 		case KSI_ASYNC_OPT_REQUEST_CACHE_SIZE:
@@ -1591,6 +2468,7 @@ static int asyncClient_getOption(KSI_AsyncClient *c, const int opt, void *param)
 		case KSI_ASYNC_PRIVOPT_ROUND_DURATION:
 		case KSI_ASYNC_PRIVOPT_INVOKE_CONF_RECEIVED_CALLBACK:
 		case KSI_ASYNC_PRIVOPT_ENDPOINT_ID:
+		case KSI_ASYNC_PRIVOPT_SEND_LIMIT:
 			*(size_t*)param = c->options[opt];
 			break;
 
@@ -1617,9 +2495,14 @@ static int asyncClient_setDefaultOptions(KSI_AsyncClient *c) {
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_PUSH_CONF_CALLBACK, (void *)NULL)) != KSI_OK) goto cleanup;
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_CONNECTION_STATE_CALLBACK, (void *)NULL)) != KSI_OK) goto cleanup;
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_CALLBACK_USERDATA, (void *)NULL)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT, (void *)0)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD, (void *)0)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_COMPLETION_CALLBACK, (void *)NULL)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)KSI_ASYNC_DEFAULT_CONNECTION_COUNT)) != KSI_OK) goto cleanup;
 	/* Private options. */
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_PRIVOPT_ROUND_DURATION, (void *)KSI_ASYNC_ROUND_DURATION_SEC)) != KSI_OK) goto cleanup;
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_PRIVOPT_INVOKE_CONF_RECEIVED_CALLBACK, (void *)true)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_PRIVOPT_SEND_LIMIT, (void *)0)) != KSI_OK) goto cleanup;
 cleanup:
 	return res;
 }
@@ -1634,7 +2517,12 @@ void KSI_AsyncClient_free(KSI_AsyncClient *c) {
 			for (i = 0; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) KSI_AsyncHandle_free(c->reqCache[i]);
 			KSI_free(c->reqCache);
 		}
+		/* Completion queue holds only references to the cached handles. */
+		KSI_free(c->cmplQueue);
 		KSI_AsyncHandle_free(c->serverConf);
+		KSI_AsyncLocalAggr_free(c->localAggr);
+		KSI_AsyncHandleList_free(c->localAggrDone);
+		KSI_AsyncHandleList_free(c->cbQueue);
 
 		KSI_free(c);
 	}
@@ -1660,16 +2548,34 @@ int KSI_AbstractAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 
 	tmp->requestCountOffset = 0;
 	tmp->requestCount = 0;
-	tmp->tail = 1;
 
 	tmp->reqCache = NULL;
 	tmp->pending = 0;
 	tmp->received = 0;
 	tmp->serverConf = NULL;
 
+	tmp->cmplQueue = NULL;
+	tmp->cmplHead = 0;
+	tmp->cmplCount = 0;
+	tmp->nextSweep = 0;
+	memset(&tmp->stats, 0, sizeof(tmp->stats));
+
+	tmp->localAggr = NULL;
+	tmp->localAggrDone = NULL;
+	tmp->localAggrDonePos = 0;
+	tmp->cbQueue = NULL;
+	tmp->cbActive = false;
+	tmp->localAggrRoots = 0;
+	tmp->localAggrPending = 0;
+	tmp->localAggrReceived = 0;
+
 	tmp->addRequest = NULL;
 	tmp->getResponse = NULL;
+	tmp->getResponseRaw = NULL;
 	tmp->dispatch = NULL;
+	tmp->getSockets = NULL;
+	tmp->getTimeout = NULL;
+	tmp->socketReady = NULL;
 	tmp->getCredentials = NULL;
 
 	tmp->instanceId = time(NULL);
@@ -1679,11 +2585,18 @@ int KSI_AbstractAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	if (res != KSI_OK) goto cleanup;
 
 	tmp->reqCache = KSI_calloc(tmp->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE], sizeof(KSI_AsyncHandle *));
-	if (tmp->reqCache == NULL) {
+	tmp->cmplQueue = KSI_calloc(tmp->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE], sizeof(KSI_AsyncHandle *));
+	if (tmp->reqCache == NULL || tmp->cmplQueue == NULL) {
 		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
+	res = KSI_AsyncHandleList_new(&tmp->localAggrDone);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AsyncHandleList_new(&tmp->cbQueue);
+	if (res != KSI_OK) goto cleanup;
+
 	*c = tmp;
 	tmp = NULL;
 	res = KSI_OK;
@@ -1742,6 +2655,88 @@ cleanup:
 	return res;
 }
 
+int KSI_AsyncService_getSockets(KSI_AsyncService *service, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t tmp = 0;
+
+	if (service == NULL || (sockets == NULL && size != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(service->ctx);
+
+	if (service->impl == NULL || service->getSockets == NULL) {
+		KSI_pushError(service->ctx, res = KSI_INVALID_STATE, "Async service client is not properly initialized.");
+		goto cleanup;
+	}
+
+	res = service->getSockets(service->impl, sockets, size, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(service->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*count = tmp;
+	if (tmp > size) {
+		KSI_pushError(service->ctx, res = KSI_BUFFER_OVERFLOW, "Socket array is too small.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+int KSI_AsyncService_getTimeout(KSI_AsyncService *service, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (service == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(service->ctx);
+
+	if (service->impl == NULL || service->getTimeout == NULL) {
+		KSI_pushError(service->ctx, res = KSI_INVALID_STATE, "Async service client is not properly initialized.");
+		goto cleanup;
+	}
+
+	res = service->getTimeout(service->impl, timeout);
+	if (res != KSI_OK) {
+		KSI_pushError(service->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+int KSI_AsyncService_socketReady(KSI_AsyncService *service, int fd, int events) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (service == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(service->ctx);
+
+	if (service->impl == NULL || service->socketReady == NULL) {
+		KSI_pushError(service->ctx, res = KSI_INVALID_STATE, "Async service client is not properly initialized.");
+		goto cleanup;
+	}
+
+	res = service->socketReady(service->impl, service->responseHandler, fd, events);
+	if (res != KSI_OK) {
+		KSI_pushError(service->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int asyncService_setupAsyncClient(KSI_AsyncService *service, const char *uri, const char *loginId, const char *key) {
 	int res = KSI_UNKNOWN_ERROR;
 	char *schm = NULL;
@@ -1916,9 +2911,13 @@ int KSI_SigningAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))asyncClient_addAggregatorRequest;
 	tmp->responseHandler = (int (*)(void *))asyncClient_processAggregationResponseQueue;
 	tmp->run = (int (*)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *))asyncClient_run;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))asyncClient_getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))asyncClient_getTimeout;
+	tmp->socketReady = (int (*)(void *, int (*)(void *), int, int))asyncClient_socketReady;
 
 	tmp->getPendingCount = (int (*)(void *, size_t *))asyncClient_getPendingCount;
 	tmp->getReceivedCount = (int (*)(void *, size_t *))asyncClient_getReceivedCount;
+	tmp->getStatistics = (int (*)(void *, KSI_AsyncStatistics *))asyncClient_getStatistics;
 
 	tmp->setOption = (int (*)(void *, int, void *))asyncClient_setOption;
 	tmp->getOption = (int (*)(void *, int, void *))asyncClient_getOption;
@@ -1954,9 +2953,13 @@ int KSI_ExtendingAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))asyncClient_addExtenderRequest;
 	tmp->responseHandler = (int (*)(void *))asyncClient_processExtenderResponseQueue;
 	tmp->run = (int (*)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *))asyncClient_run;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))asyncClient_getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))asyncClient_getTimeout;
+	tmp->socketReady = (int (*)(void *, int (*)(void *), int, int))asyncClient_socketReady;
 
 	tmp->getPendingCount = (int (*)(void *, size_t *))asyncClient_getPendingCount;
 	tmp->getReceivedCount = (int (*)(void *, size_t *))asyncClient_getReceivedCount;
+	tmp->getStatistics = (int (*)(void *, KSI_AsyncStatistics *))asyncClient_getStatistics;
 
 	tmp->setOption = (int (*)(void *, int, void *))asyncClient_setOption;
 	tmp->getOption = (int (*)(void *, int, void *))asyncClient_getOption;
@@ -1983,6 +2986,11 @@ int KSI_AsyncService_getReceivedCount(KSI_AsyncService *s, size_t *count) {
 	return s->getReceivedCount(s->impl, count);
 }
 
+int KSI_AsyncService_getStatistics(KSI_AsyncService *s, KSI_AsyncStatistics *stats) {
+	if (s == NULL || s->impl == NULL || s->getStatistics == NULL) return KSI_INVALID_ARGUMENT;
+	return s->getStatistics(s->impl, stats);
+}
+
 int KSI_AsyncService_setOption(KSI_AsyncService *s, const int option, void *value) {
 	if ((s == NULL || s->impl == NULL || s->setOption == NULL) || (size_t)option >= __NOF_KSI_ASYNC_OPT) return KSI_INVALID_ARGUMENT;
 	return s->setOption(s->impl, option, value);
@@ -134,6 +134,35 @@ extern "C" {
 	 */
 	int KSI_AsyncHandle_getRequestCtx(const KSI_AsyncHandle *o, const void **reqCtx);
 
+	/**
+	 * Async request completion callback. The callback is invoked with the handle that has reached its final state,
+	 * instead of returning the handle via #KSI_AsyncService_run.
+	 * \param[in]		ctx				KSI context object.
+	 * \param[in]		handle			Finalized async handle.
+	 * \param[in]		state			Final state of the handle (see #KSI_AsyncHandleState).
+	 * \param[in]		userp			Contains whatever user-defined value set using the KSI_ASYNC_OPT_CALLBACK_USERDATA.
+	 * \return Implementation must return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The handle is released after the callback returns. Use #KSI_AsyncHandle_ref in order to keep a reference.
+	 * \note The request context set via #KSI_AsyncHandle_setRequestCtx is accessible via #KSI_AsyncHandle_getRequestCtx.
+	 * \note The callback is invoked from #KSI_AsyncService_run or #KSI_AsyncService_socketReady, thus it may not call
+	 * either of these functions. New requests may be added via #KSI_AsyncService_addRequest.
+	 * \see #KSI_AsyncHandle_getSignature for extracting the KSI signature.
+	 * \see #KSI_AsyncHandle_getExtendResp for extracting the extending response.
+	 * \see #KSI_AsyncHandle_setCompletionCallback for setting up the callback per request.
+	 * \see #KSI_ASYNC_OPT_COMPLETION_CALLBACK for setting up the callback per service.
+	 */
+	typedef int (*KSI_AsyncServiceCallback_Completion)(KSI_CTX *ctx, KSI_AsyncHandle *handle, int state, void *userp);
+
+	/**
+	 * Setter for the request completion callback. Overrides the #KSI_ASYNC_OPT_COMPLETION_CALLBACK of the service for
+	 * the given request.
+	 * \param[in]		o				Async handle object.
+	 * \param[in]		callback		Completion callback. NULL for returning the handle via #KSI_AsyncService_run.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The callback has to be set before the handle is added to the service via #KSI_AsyncService_addRequest.
+	 */
+	int KSI_AsyncHandle_setCompletionCallback(KSI_AsyncHandle *o, KSI_AsyncServiceCallback_Completion callback);
+
 	/**
 	 * Get the state of the request handle.
 	 * \param[in]		h				Async handle.
@@ -330,6 +359,75 @@ extern "C" {
 	 */
 	int KSI_AsyncService_run(KSI_AsyncService *service, KSI_AsyncHandle **handle, size_t *waiting);
 
+	/**
+	 * Socket readiness events used for driving the async service from an external event loop.
+	 * \see #KSI_AsyncService_getSockets
+	 * \see #KSI_AsyncService_socketReady
+	 */
+	typedef enum KSI_AsyncSocketEvent_en {
+		/** The socket is readable. */
+		KSI_ASYNC_SOCKET_EVENT_READ = 0x01,
+		/** The socket is writable. */
+		KSI_ASYNC_SOCKET_EVENT_WRITE = 0x02,
+		/** An error or hang-up condition has occurred on the socket. */
+		KSI_ASYNC_SOCKET_EVENT_ERROR = 0x04
+	} KSI_AsyncSocketEvent;
+
+	/**
+	 * Socket descriptor with the events the async service is interested in.
+	 */
+	typedef struct KSI_AsyncSocket_st {
+		/** Socket descriptor. */
+		int fd;
+		/** Bitmask of #KSI_AsyncSocketEvent values. */
+		int events;
+	} KSI_AsyncSocket;
+
+	/**
+	 * Returns the sockets the async service is currently using, together with the events it is waiting for.
+	 * The socket list may change after any call to the async service, thus it should be requested again before
+	 * each wait in the event loop.
+	 * \param[in]		service			Async service instance.
+	 * \param[out]		sockets			Array of size \c size for the socket descriptors.
+	 * \param[in]		size			Size of the \c sockets array.
+	 * \param[out]		count			Number of sockets in use.
+	 * \return #KSI_OK, when operation succeeded;
+	 * \return #KSI_BUFFER_OVERFLOW, if the \c sockets array is too small. In this case the \c count is set to
+	 *         the required size and the array is filled up to \c size;
+	 * \return otherwise an error code.
+	 * \note The \c sockets may be NULL in case \c size is 0.
+	 * \note Only the TCP and cURL based clients expose their sockets. Other clients report zero sockets and
+	 *         rely on #KSI_AsyncService_getTimeout.
+	 * \see #KSI_AsyncService_getTimeout for the maximum wait time.
+	 * \see #KSI_AsyncService_socketReady for handling a socket event.
+	 */
+	int KSI_AsyncService_getSockets(KSI_AsyncService *service, KSI_AsyncSocket *sockets, size_t size, size_t *count);
+
+	/**
+	 * Returns the maximum time the event loop may wait for socket events before #KSI_AsyncService_run has to be
+	 * called in order to handle timeouts, throttling, local aggregation or finalized requests.
+	 * \param[in]		service			Async service instance.
+	 * \param[out]		timeout			Timeout in milliseconds. -1 if there is no need to wake up without a
+	 *									socket event.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note A timeout of 0 means that #KSI_AsyncService_run should be called without waiting.
+	 * \see #KSI_AsyncService_getSockets for the sockets to wait for.
+	 */
+	int KSI_AsyncService_getTimeout(KSI_AsyncService *service, long *timeout);
+
+	/**
+	 * Non-blocking socket event handler. Performs the input and output on the socket reported ready by the event
+	 * loop and maps the received responses. The finalized requests are returned by #KSI_AsyncService_run.
+	 * \param[in]		service			Async service instance.
+	 * \param[in]		fd				Socket descriptor returned by #KSI_AsyncService_getSockets.
+	 * \param[in]		events			Bitmask of the #KSI_AsyncSocketEvent values that occurred on the socket.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Unknown socket descriptors are ignored.
+	 * \see #KSI_AsyncService_getSockets for the sockets in use.
+	 * \see #KSI_AsyncService_run for collecting the finalized requests.
+	 */
+	int KSI_AsyncService_socketReady(KSI_AsyncService *service, int fd, int events);
+
 	/**
 	 * Enum defining async handle state.
 	 * \note User must process only those handles that have reached there final states.
@@ -430,6 +528,47 @@ extern "C" {
 	 */
 	int KSI_AsyncService_getReceivedCount(KSI_AsyncService *s, size_t *count);
 
+	/** Number of buckets in the #KSI_AsyncStatistics histograms. */
+	#define KSI_ASYNC_STAT_HISTOGRAM_SIZE 16
+
+	/**
+	 * Async service statistics. The values are accumulated since the service has been created.
+	 * The histogram bucket \c i counts the durations in range [2^(i-1), 2^i) milliseconds, the bucket 0 counts the
+	 * durations below 1 millisecond and the last bucket counts all of the longer durations.
+	 * \see #KSI_AsyncService_getStatistics
+	 */
+	typedef struct KSI_AsyncStatistics_st {
+		/** Nof requests sent out. */
+		size_t sent;
+		/** Nof responses received. */
+		size_t received;
+		/** Nof requests that have failed due to a timeout. */
+		size_t timedOut;
+		/** Nof requests that have failed due to any other error. */
+		size_t failed;
+		/** Nof bytes sent out. */
+		KSI_uint64_t bytesOut;
+		/** Nof bytes received. */
+		KSI_uint64_t bytesIn;
+		/** Time from adding the request to the service until the request is handed to the network. */
+		size_t queueTime[KSI_ASYNC_STAT_HISTOGRAM_SIZE];
+		/** Time spent on writing the request to the network. Only measured by the TCP client. */
+		size_t sendTime[KSI_ASYNC_STAT_HISTOGRAM_SIZE];
+		/** Time from handing the request to the network until the response has been received. */
+		size_t roundTripTime[KSI_ASYNC_STAT_HISTOGRAM_SIZE];
+	} KSI_AsyncStatistics;
+
+	/**
+	 * Get the statistics of async service \c s.
+	 * \param[in]		s				Async service instance.
+	 * \param[out]		stats			Pointer to the receiving statistics structure.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note In case of a high availability service the statistics of all of the subservices are summed up.
+	 * The per endpoint statistics can be extracted from the subservices.
+	 * \see #KSI_ASYNC_OPT_HA_SUBSERVICE_LIST for getting the list of high availability subservices.
+	 */
+	int KSI_AsyncService_getStatistics(KSI_AsyncService *s, KSI_AsyncStatistics *stats);
+
 	/**
 	 * Async service network connection establishment listener callback.
 	 * \param[in]		ctx				KSI context object.
@@ -453,6 +592,28 @@ extern "C" {
 	 */
 	typedef int (*KSI_AsyncServiceCallback_configConsolidate)(KSI_CTX *ctx, size_t id, void *userp, KSI_Config *haConfig, KSI_Config *respConfig);
 
+	/**
+	 * High availability #KSI_AsyncService request routing modes.
+	 * \see #KSI_ASYNC_OPT_HA_ROUTING_MODE
+	 */
+	typedef enum KSI_AsyncHaRouting_en {
+		/** Every request is sent to all of the subservices, the first received response is returned. */
+		KSI_ASYNC_HA_ROUTING_BROADCAST = 0,
+		/**
+		 * Every request is sent only to the subservice with the lowest average response time. In case the subservice
+		 * fails to process the request, it is resent to the next subservice.
+		 */
+		KSI_ASYNC_HA_ROUTING_LOWEST_LATENCY,
+		/**
+		 * Same as #KSI_ASYNC_HA_ROUTING_LOWEST_LATENCY, additionally a second copy of the request is sent to the next
+		 * subservice in case the response has not been received within the response time percentile of the first
+		 * subservice.
+		 * \see #KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE
+		 */
+		KSI_ASYNC_HA_ROUTING_HEDGED,
+		__KSI_ASYNC_HA_ROUTING_COUNT
+	} KSI_AsyncHaRouting;
+
 	/**
 	 * Enum defining async service options. Pay attention to the used parameter type.
 	 * \see #KSI_AsyncService_setOption for applying option values.
@@ -552,6 +713,8 @@ extern "C" {
 		 * The callback is invoked when the network connection state to a server has changed.
 		 * \param		p_func			Paramer of type #KSI_AsyncServiceConnectState_Callback.
 		 * \note Only applicable in case of TCP client.
+		 * \note In case of multiple connections per endpoint, the callback is invoked when the first connection has been
+		 * established and when the last connection has been closed.
 		 * \note For reading the stored value via #KSI_AsyncService_getOption a parameter of type size_t should be used,
 		 * and casted to #KSI_AsyncServiceConnectState_Callback before use.
 		 */
@@ -563,6 +726,74 @@ extern "C" {
 		 */
 		KSI_ASYNC_OPT_CALLBACK_USERDATA,
 
+		/**
+		 * Maximum number of signing requests that are aggregated locally into a single aggregation request.
+		 * The request hashes are collected into a hash tree and only the root hash is sent to the aggregator.
+		 * On response every request handle receives its own signature, which is composed from the aggregation
+		 * response and the hash chain from the request hash to the local tree root.
+		 * Default setting is 0 (local aggregation is disabled).
+		 * \param		count			Paramer of type size_t.
+		 * \note Only applicable to a signing service. Not applicable to a high availability service.
+		 * \note Requests that contain a configuration request are not aggregated locally.
+		 * \note The hashes of other requests in the same batch are revealed in the signature hash chain.
+		 * \see #KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD for the local aggregation time window.
+		 */
+		KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT,
+
+		/**
+		 * Maximum time the first request of a local aggregation batch is kept waiting for other requests
+		 * before the batch is sent out. The batch is sent out earlier in case #KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT
+		 * requests have been collected.
+		 * Default setting is 0 (the batch is sent out on the next #KSI_AsyncService_run call).
+		 * \param		period			Time in milliseconds. Paramer of type size_t.
+		 */
+		KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD,
+
+		/**
+		 * The callback is invoked for every request that has reached its final state. All of the finalized requests
+		 * are delivered on a single #KSI_AsyncService_run or #KSI_AsyncService_socketReady call, and are not returned
+		 * via the \c handle parameter of #KSI_AsyncService_run.
+		 * \param		p_func			Paramer of type #KSI_AsyncServiceCallback_Completion.
+		 * \note For reading the stored value via #KSI_AsyncService_getOption a parameter of type size_t should be used,
+		 * and casted to #KSI_AsyncServiceCallback_Completion before use.
+		 * \see #KSI_AsyncHandle_setCompletionCallback for setting up the callback per request.
+		 */
+		KSI_ASYNC_OPT_COMPLETION_CALLBACK,
+
+		/**
+		 * Number of parallel network connections per endpoint. The requests are spread over the connections,
+		 * a new request is assigned to the connection with the least number of queued and unresponded requests.
+		 * The connections are opened on demand. Decreasing the value does not close the allready opened connections,
+		 * however new requests are only assigned to the first \c count connections.
+		 * Default setting is 1.
+		 * \param		count			Paramer of type size_t.
+		 * \note Only applicable in case of TCP client.
+		 * \note In case one of the connections is closed, only the requests sent out over that connection
+		 * are set into error state.
+		 * \see #KSI_ASYNC_OPT_MAX_REQUEST_COUNT is applied to the endpoint, not to a single connection.
+		 */
+		KSI_ASYNC_OPT_CONNECTION_COUNT,
+
+		/**
+		 * High availability service request routing mode.
+		 * Default setting is #KSI_ASYNC_HA_ROUTING_BROADCAST.
+		 * \param		mode			Routing mode from #KSI_AsyncHaRouting. Paramer of type size_t.
+		 * \note Only applicable to a high availability #KSI_AsyncService created via
+		 * #KSI_SigningHighAvailabilityService_new or #KSI_ExtendingHighAvailabilityService_new.
+		 * \note Configuration requests are always sent to all of the subservices.
+		 * \note In the routed modes only the first 64 subservices are used.
+		 */
+		KSI_ASYNC_OPT_HA_ROUTING_MODE,
+
+		/**
+		 * Response time percentile after which a hedged copy of the request is sent out. The percentile is
+		 * calculated from the most recent response times of the subservice the request was routed to.
+		 * Default setting is 95.
+		 * \param		percentile		Value in range 1..100. Paramer of type size_t.
+		 * \note Only applicable in case #KSI_ASYNC_OPT_HA_ROUTING_MODE is set to #KSI_ASYNC_HA_ROUTING_HEDGED.
+		 */
+		KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE,
+
 		__KSI_ASYNC_OPT_COUNT
 	} KSI_AsyncOption;
 
@@ -624,6 +855,68 @@ extern "C" {
 	 */
 	int KSI_AsyncService_addEndpoint(KSI_AsyncService *service, const char *uri, const char *loginId, const char *key);
 
+	/**
+	 * Constructor for the thread-safe submission queue of the async service. The queue enables any number of
+	 * producer threads to submit requests without external locking, while the requests are moved into the
+	 * \c service by the thread that owns the service via #KSI_AsyncSubmitQueue_drain.
+	 * \param[in]		service			Async service instance the requests are submitted to.
+	 * \param[out]		queue			Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Only the submit functions are thread-safe. All other functions have to be called from the thread
+	 * that owns the \c service.
+	 * \see #KSI_AsyncSubmitQueue_free for cleaning up resources.
+	 */
+	int KSI_AsyncSubmitQueue_new(KSI_AsyncService *service, KSI_AsyncSubmitQueue **queue);
+
+	/**
+	 * Cleanup method for the submission queue. The requests that have not been drained are discarded.
+	 * \param[in]		queue			Instance to be freed.
+	 * \note The producer threads must have stopped submitting requests before the queue is freed.
+	 */
+	void KSI_AsyncSubmitQueue_free(KSI_AsyncSubmitQueue *queue);
+
+	/**
+	 * Thread-safe submission of a signing request.
+	 * \param[in]		queue			Submission queue.
+	 * \param[in]		imprint			Imprint of the data hash to be signed.
+	 * \param[in]		imprint_len		Length of the \c imprint.
+	 * \param[in]		level			Aggregation level of the request hash.
+	 * \param[in]		reqCtx			Request context (see #KSI_AsyncHandle_setRequestCtx).
+	 * \param[in]		reqCtx_free		Pointer to the context cleanup method.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The function does not use the KSI context, thus no error is pushed to the error stack.
+	 * \note The ownership of \c reqCtx is taken only in case of success.
+	 */
+	int KSI_AsyncSubmitQueue_addSigningRequest(KSI_AsyncSubmitQueue *queue, const unsigned char *imprint, size_t imprint_len,
+			KSI_uint64_t level, void *reqCtx, void (*reqCtx_free)(void*));
+
+	/**
+	 * Thread-safe submission of an extending request.
+	 * \param[in]		queue			Submission queue.
+	 * \param[in]		aggrTime		Aggregation time of the signature to be extended.
+	 * \param[in]		pubTime			Publication time to extend to. 0 for extending to the head of the calendar.
+	 * \param[in]		reqCtx			Request context (see #KSI_AsyncHandle_setRequestCtx).
+	 * \param[in]		reqCtx_free		Pointer to the context cleanup method.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The function does not use the KSI context, thus no error is pushed to the error stack.
+	 * \note The ownership of \c reqCtx is taken only in case of success.
+	 */
+	int KSI_AsyncSubmitQueue_addExtendingRequest(KSI_AsyncSubmitQueue *queue, KSI_uint64_t aggrTime, KSI_uint64_t pubTime,
+			void *reqCtx, void (*reqCtx_free)(void*));
+
+	/**
+	 * Moves the submitted requests into the async service. The requests are added in the order of submission per
+	 * producer thread. In case the request cache of the service is full, the remaining requests are kept in the
+	 * queue until the next call.
+	 * \param[in]		queue			Submission queue.
+	 * \param[out]		count			Number of requests added to the service. Can be NULL.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note In case the service rejects a request with an error other than #KSI_ASYNC_REQUEST_CACHE_FULL, the
+	 * request is discarded and the error is returned.
+	 * \note Must be called from the thread that owns the service, eg. before #KSI_AsyncService_run.
+	 */
+	int KSI_AsyncSubmitQueue_drain(KSI_AsyncSubmitQueue *queue, size_t *count);
+
 	/**
 	 * @}
 	 */
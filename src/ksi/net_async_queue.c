@@ -0,0 +1,342 @@
+/*
+ * Copyright 2013-2018 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include "net_async.h"
+
+#include <string.h>
+
+#include "internal.h"
+#include "impl/net_async_impl.h"
+
+/* Atomic pointer operations used by the producers and the consumer of the submission queue. */
+#if defined(_WIN32)
+#  include <windows.h>
+#  define ATOMIC_EXCHANGE_PTR(p, v) InterlockedExchangePointer((PVOID volatile *)(p), (PVOID)(v))
+#  define ATOMIC_LOAD_PTR(p) InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL)
+#  define ATOMIC_STORE_PTR(p, v) ((void)InterlockedExchangePointer((PVOID volatile *)(p), (PVOID)(v)))
+#elif defined(__GNUC__)
+#  define ATOMIC_EXCHANGE_PTR(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#  define ATOMIC_LOAD_PTR(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#  define ATOMIC_STORE_PTR(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#  error Atomic operations are not supported by the compiler.
+#endif
+
+static void KSI_AsyncSubmitEntry_free(KSI_AsyncSubmitEntry *o) {
+	if (o != NULL) {
+		if (o->reqCtx_free != NULL) o->reqCtx_free(o->reqCtx);
+		KSI_free(o);
+	}
+}
+
+static void submitQueue_push(KSI_AsyncSubmitQueue *q, KSI_AsyncSubmitEntry *entry) {
+	KSI_AsyncSubmitEntry *prev = NULL;
+
+	entry->next = NULL;
+	/* Serialize the producers on the head. The queue is briefly disconnected until the link is stored. */
+	prev = (KSI_AsyncSubmitEntry *)ATOMIC_EXCHANGE_PTR(&q->head, entry);
+	ATOMIC_STORE_PTR(&prev->next, entry);
+}
+
+static KSI_AsyncSubmitEntry *submitQueue_pop(KSI_AsyncSubmitQueue *q) {
+	KSI_AsyncSubmitEntry *tail = q->tail;
+	KSI_AsyncSubmitEntry *next = (KSI_AsyncSubmitEntry *)ATOMIC_LOAD_PTR(&tail->next);
+
+	/* Skip the placeholder entry. */
+	if (tail == &q->stub) {
+		if (next == NULL) return NULL;
+		q->tail = next;
+		tail = next;
+		next = (KSI_AsyncSubmitEntry *)ATOMIC_LOAD_PTR(&tail->next);
+	}
+
+	if (next != NULL) {
+		q->tail = next;
+		return tail;
+	}
+
+	/* A producer has exchanged the head, but has not linked the entry yet. */
+	if (tail != (KSI_AsyncSubmitEntry *)ATOMIC_LOAD_PTR(&q->head)) return NULL;
+
+	/* The last entry can only be removed after the placeholder has been put behind it. */
+	submitQueue_push(q, &q->stub);
+	next = (KSI_AsyncSubmitEntry *)ATOMIC_LOAD_PTR(&tail->next);
+	if (next != NULL) {
+		q->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+static int submitQueue_add(KSI_AsyncSubmitQueue *q, KSI_AsyncSubmitEntry *entry) {
+	if (q == NULL || entry == NULL) return KSI_INVALID_ARGUMENT;
+	submitQueue_push(q, entry);
+	return KSI_OK;
+}
+
+int KSI_AsyncSubmitQueue_new(KSI_AsyncService *service, KSI_AsyncSubmitQueue **queue) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncSubmitQueue *tmp = NULL;
+
+	if (service == NULL || queue == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(service->ctx);
+
+	tmp = KSI_new(KSI_AsyncSubmitQueue);
+	if (tmp == NULL) {
+		KSI_pushError(service->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->service = service;
+	memset(&tmp->stub, 0, sizeof(tmp->stub));
+	tmp->head = &tmp->stub;
+	tmp->tail = &tmp->stub;
+	tmp->held = NULL;
+
+	*queue = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncSubmitQueue_free(tmp);
+	return res;
+}
+
+void KSI_AsyncSubmitQueue_free(KSI_AsyncSubmitQueue *queue) {
+	if (queue != NULL) {
+		KSI_AsyncSubmitEntry *entry = NULL;
+
+		KSI_AsyncSubmitEntry_free(queue->held);
+		while ((entry = submitQueue_pop(queue)) != NULL) {
+			KSI_AsyncSubmitEntry_free(entry);
+		}
+		KSI_free(queue);
+	}
+}
+
+int KSI_AsyncSubmitQueue_addSigningRequest(KSI_AsyncSubmitQueue *queue, const unsigned char *imprint, size_t imprint_len,
+		KSI_uint64_t level, void *reqCtx, void (*reqCtx_free)(void*)) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncSubmitEntry *tmp = NULL;
+
+	if (queue == NULL || imprint == NULL || imprint_len == 0 || imprint_len > KSI_MAX_IMPRINT_LEN) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_AsyncSubmitEntry);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->isExtend = false;
+	memcpy(tmp->imprint, imprint, imprint_len);
+	tmp->imprint_len = imprint_len;
+	tmp->level = level;
+	tmp->aggrTime = 0;
+	tmp->pubTime = 0;
+	tmp->reqCtx = reqCtx;
+	tmp->reqCtx_free = reqCtx_free;
+
+	res = submitQueue_add(queue, tmp);
+	if (res != KSI_OK) goto cleanup;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(tmp);
+	return res;
+}
+
+int KSI_AsyncSubmitQueue_addExtendingRequest(KSI_AsyncSubmitQueue *queue, KSI_uint64_t aggrTime, KSI_uint64_t pubTime,
+		void *reqCtx, void (*reqCtx_free)(void*)) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncSubmitEntry *tmp = NULL;
+
+	if (queue == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_AsyncSubmitEntry);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->isExtend = true;
+	tmp->imprint_len = 0;
+	tmp->level = 0;
+	tmp->aggrTime = aggrTime;
+	tmp->pubTime = pubTime;
+	tmp->reqCtx = reqCtx;
+	tmp->reqCtx_free = reqCtx_free;
+
+	res = submitQueue_add(queue, tmp);
+	if (res != KSI_OK) goto cleanup;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(tmp);
+	return res;
+}
+
+static int submitQueue_createAggregationHandle(KSI_CTX *ctx, KSI_AsyncSubmitEntry *entry, KSI_AsyncHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationReq *req = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *lvl = NULL;
+
+	res = KSI_AggregationReq_new(ctx, &req);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_fromImprint(ctx, entry->imprint, entry->imprint_len, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_setRequestHash(req, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	if (entry->level > 0) {
+		res = KSI_Integer_new(ctx, entry->level, &lvl);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationReq_setRequestLevel(req, lvl);
+		if (res != KSI_OK) goto cleanup;
+		lvl = NULL;
+	}
+
+	res = KSI_AsyncAggregationHandle_new(ctx, req, handle);
+	if (res != KSI_OK) goto cleanup;
+	req = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_Integer_free(lvl);
+	KSI_DataHash_free(hsh);
+	KSI_AggregationReq_free(req);
+	return res;
+}
+
+static int submitQueue_createExtendHandle(KSI_CTX *ctx, KSI_AsyncSubmitEntry *entry, KSI_AsyncHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_ExtendReq *req = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *pubTime = NULL;
+
+	res = KSI_ExtendReq_new(ctx, &req);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(ctx, entry->aggrTime, &aggrTime);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_setAggregationTime(req, aggrTime);
+	if (res != KSI_OK) goto cleanup;
+	aggrTime = NULL;
+
+	if (entry->pubTime > 0) {
+		res = KSI_Integer_new(ctx, entry->pubTime, &pubTime);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendReq_setPublicationTime(req, pubTime);
+		if (res != KSI_OK) goto cleanup;
+		pubTime = NULL;
+	}
+
+	res = KSI_AsyncExtendHandle_new(ctx, req, handle);
+	if (res != KSI_OK) goto cleanup;
+	req = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_Integer_free(aggrTime);
+	KSI_Integer_free(pubTime);
+	KSI_ExtendReq_free(req);
+	return res;
+}
+
+int KSI_AsyncSubmitQueue_drain(KSI_AsyncSubmitQueue *queue, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncSubmitEntry *entry = NULL;
+	size_t added = 0;
+
+	if (queue == NULL || queue->service == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	ctx = queue->service->ctx;
+	KSI_ERR_clearErrors(ctx);
+
+	while ((entry = (queue->held != NULL ? queue->held : submitQueue_pop(queue))) != NULL) {
+		queue->held = NULL;
+
+		res = (entry->isExtend ?
+				submitQueue_createExtendHandle(ctx, entry, &handle) :
+				submitQueue_createAggregationHandle(ctx, entry, &handle));
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, "Unable to create async handle for the submitted request.");
+			goto cleanup;
+		}
+
+		/* The handle takes over the request context. */
+		res = KSI_AsyncHandle_setRequestCtx(handle, entry->reqCtx, entry->reqCtx_free);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		entry->reqCtx = NULL;
+		entry->reqCtx_free = NULL;
+
+		res = KSI_AsyncService_addRequest(queue->service, handle);
+		if (res == KSI_ASYNC_REQUEST_CACHE_FULL) {
+			/* Keep the request context with the entry until the next drain. */
+			entry->reqCtx = handle->userCtx;
+			entry->reqCtx_free = handle->userCtx_free;
+			handle->userCtx = NULL;
+			handle->userCtx_free = NULL;
+
+			queue->held = entry;
+			entry = NULL;
+			KSI_ERR_clearErrors(ctx);
+			break;
+		} else if (res != KSI_OK) {
+			KSI_pushError(ctx, res, "Async service rejected the submitted request.");
+			goto cleanup;
+		}
+		handle = NULL;
+
+		KSI_AsyncSubmitEntry_free(entry);
+		entry = NULL;
+		added++;
+	}
+	if (count != NULL) *count = added;
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncHandle_free(handle);
+	KSI_AsyncSubmitEntry_free(entry);
+	return res;
+}
@@ -30,6 +30,16 @@
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
+/* Maximum number of subservices used in the routed modes (size of the routing bitmask). */
+#define KSI_HA_ROUTING_MAX_SERVICES 64
+#define KSI_HA_DEFAULT_HEDGE_PERCENTILE 95
+/* Hedging delay used until the first response times have been measured. */
+#define KSI_HA_DEFAULT_HEDGE_DELAY_MS 1000
+/* Response time recorded for a failed request, so that the failing subservice is not preferred. */
+#define KSI_HA_ERROR_PENALTY_MS 10000
+/* Weight of the most recent response time in the moving average. */
+#define KSI_HA_LATENCY_EWMA_WEIGHT 0.125
+
 
 
 void KSI_HighAvailabilityRequest_free(KSI_HighAvailabilityRequest *o) {
@@ -79,6 +89,8 @@ int KSI_HighAvailabilityRequest_new(KSI_CTX *ctx, KSI_AsyncHandle *asyncHandle,
 	tmp->expectedRespCount = 0;
 	tmp->hasReq = false;
 	tmp->hasCnf = false;
+	tmp->routedMask = 0;
+	tmp->hedgeAt = 0;
 
 	*o = tmp;
 	tmp = NULL;
@@ -91,14 +103,176 @@ cleanup:
 
 static KSI_IMPLEMENT_REF(KSI_HighAvailabilityRequest)
 
+static int KSI_HighAvailabilityService_routeRequest(KSI_HighAvailabilityService *has, KSI_HighAvailabilityRequest *haRequest,
+		size_t i, int *addRes) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncHandle *tmp = NULL;
+	KSI_AsyncService *as = NULL;
+	KSI_HighAvailabilityRequest *haReqRef = NULL;
+
+	if (has == NULL || haRequest == NULL || addRes == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	handle = haRequest->asyncHandle;
+
+	/* Create a new async handle to be passed to the subservice. */
+	res = KSI_AbstractAsyncHandle_new(has->ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(has->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Clone the original request and copy additional request data. */
+	if (handle->aggrReq != NULL) {
+		res = KSI_AggregationReq_clone(handle->aggrReq, &tmp->aggrReq);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+	if (handle->extReq != NULL) {
+		res = KSI_ExtendReq_clone(handle->extReq, &tmp->extReq);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+		/* Not necessary, but copy anyway. */
+		tmp->signature = handle->signature;
+		tmp->pubRec = handle->pubRec;
+	}
+
+	res = KSI_AsyncHandle_setRequestCtx(tmp,
+			(void *)(haReqRef = KSI_HighAvailabilityRequest_ref(haRequest)),
+			(void (*)(void*))KSI_HighAvailabilityRequest_free);
+	if (res != KSI_OK) {
+		KSI_HighAvailabilityRequest_free(haReqRef);
+		KSI_pushError(has->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
+	if (res != KSI_OK) {
+		KSI_pushError(has->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Add the newly created async handle to the subservice request queue. */
+	KSI_ERR_clearErrors(has->ctx);
+	*addRes = KSI_AsyncService_addRequest(as, tmp);
+	if (*addRes != KSI_OK) {
+		KSI_pushError(has->ctx, *addRes, NULL);
+		KSI_LOG_debug(has->ctx, "Request rejected by sub-service %d.", (int)i);
+		KSI_LOG_logCtxError(has->ctx, KSI_LOG_DEBUG);
+	} else {
+		/* The request handle was succesfully added to the async service. */
+		haRequest->expectedRespCount++;
+		if (i < KSI_HA_ROUTING_MAX_SERVICES) haRequest->routedMask |= ((KSI_uint64_t)1 << i);
+		tmp = NULL;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncHandle_free(tmp);
+	return res;
+}
+
+static uint64_t KSI_HighAvailabilityService_hedgeDelay(const KSI_HighAvailabilityService *has, size_t i) {
+	if (i >= KSI_HA_ROUTING_MAX_SERVICES || has->latency[i].count == 0) return KSI_HA_DEFAULT_HEDGE_DELAY_MS;
+	return has->latency[i].hedgeDelay;
+}
+
+static void KSI_HighAvailabilityService_updateLatency(KSI_HighAvailabilityService *has, size_t i, uint64_t sample) {
+	KSI_HighAvailabilityLatency *latency = NULL;
+	uint64_t sorted[KSI_HA_LATENCY_WINDOW];
+	size_t n;
+	size_t j;
+	size_t k;
+
+	if (has == NULL || i >= KSI_HA_ROUTING_MAX_SERVICES) return;
+	latency = &has->latency[i];
+
+	if (latency->count == 0) {
+		latency->avg = (double)sample;
+	} else {
+		latency->avg += ((double)sample - latency->avg) * KSI_HA_LATENCY_EWMA_WEIGHT;
+	}
+	latency->samples[latency->count % KSI_HA_LATENCY_WINDOW] = sample;
+	latency->count++;
+
+	/* Recalculate the percentile. The window is small, thus use insertion sort. */
+	n = (latency->count < KSI_HA_LATENCY_WINDOW) ? latency->count : KSI_HA_LATENCY_WINDOW;
+	for (j = 0; j < n; j++) {
+		uint64_t val = latency->samples[j];
+
+		for (k = j; k > 0 && sorted[k - 1] > val; k--) {
+			sorted[k] = sorted[k - 1];
+		}
+		sorted[k] = val;
+	}
+	k = (n * has->hedgePercentile + 99) / 100;
+	latency->hedgeDelay = sorted[(k > 0 ? k : 1) - 1];
+}
+
+static int KSI_HighAvailabilityService_routeToFastest(KSI_HighAvailabilityService *has, KSI_HighAvailabilityRequest *haRequest,
+		int *addRes, size_t *routedTo) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_uint64_t skip = 0;
+	size_t count = 0;
+
+	if (has == NULL || haRequest == NULL || addRes == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	count = KSI_AsyncServiceList_length(has->services);
+	if (count > KSI_HA_ROUTING_MAX_SERVICES) count = KSI_HA_ROUTING_MAX_SERVICES;
+
+	/* Skip the subservices the request has already been routed to. */
+	skip = haRequest->routedMask;
+	*addRes = KSI_UNKNOWN_ERROR;
+
+	for (;;) {
+		size_t i;
+		size_t best = count;
+
+		for (i = 0; i < count; i++) {
+			if (skip & ((KSI_uint64_t)1 << i)) continue;
+			if (best == count) {
+				best = i;
+				continue;
+			}
+			/* The subservices without any measurements are preferred, so that those will get measured. */
+			if (has->latency[best].count == 0) continue;
+			if (has->latency[i].count == 0 || has->latency[i].avg < has->latency[best].avg) best = i;
+		}
+		if (best == count) break;
+
+		res = KSI_HighAvailabilityService_routeRequest(has, haRequest, best, addRes);
+		if (res != KSI_OK) goto cleanup;
+
+		if (*addRes == KSI_OK) {
+			if (routedTo != NULL) *routedTo = best;
+			break;
+		}
+		/* Try the next fastest subservice. */
+		skip |= ((KSI_uint64_t)1 << best);
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int KSI_HighAvailabilityService_addRequest(KSI_HighAvailabilityService *has, KSI_AsyncHandle *handle){
 	int res = KSI_UNKNOWN_ERROR;
 	int addRes = KSI_UNKNOWN_ERROR;
 	size_t i;
-	KSI_AsyncHandle *tmp = NULL;
 	KSI_AsyncHandle *hndlRef = NULL;
 	bool added = false;
 	KSI_HighAvailabilityRequest *haRequest = NULL;
+	KSI_HighAvailabilityRequest *haReqRef = NULL;
 
 	if (has == NULL || handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -157,68 +331,28 @@ static int KSI_HighAvailabilityService_addRequest(KSI_HighAvailabilityService *h
 		haRequest->hasCnf = (reqConf != NULL);
 	}
 
-	for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
-		KSI_AsyncService *as = NULL;
-		KSI_HighAvailabilityRequest *haReqRef = NULL;
-
-		/* Create a new async handle to be passed to the subservice. */
-		res = KSI_AbstractAsyncHandle_new(has->ctx, &tmp);
-		if (res != KSI_OK) {
-			KSI_pushError(has->ctx, res, NULL);
-			goto cleanup;
+	if (has->routingMode == KSI_ASYNC_HA_ROUTING_BROADCAST || !haRequest->hasReq) {
+		for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
+			res = KSI_HighAvailabilityService_routeRequest(has, haRequest, i, &addRes);
+			if (res != KSI_OK) goto cleanup;
+			/* In case of a rejection, try to add the original request to the next async service. */
+			if (addRes == KSI_OK) added = true;
 		}
+	} else {
+		res = KSI_HighAvailabilityService_routeToFastest(has, haRequest, &addRes, &i);
+		if (res != KSI_OK) goto cleanup;
+		added = (addRes == KSI_OK);
 
-		/* Clone the original request and copy additional request data. */
-		if (handle->aggrReq != NULL) {
-			res = KSI_AggregationReq_clone(handle->aggrReq, &tmp->aggrReq);
-			if (res != KSI_OK) {
-				KSI_pushError(has->ctx, res, NULL);
-				goto cleanup;
-			}
-		}
-		if (handle->extReq != NULL) {
-			res = KSI_ExtendReq_clone(handle->extReq, &tmp->extReq);
+		if (added && has->routingMode == KSI_ASYNC_HA_ROUTING_HEDGED) {
+			haRequest->hedgeAt = KSI_getMonotonicTimeMs() + KSI_HighAvailabilityService_hedgeDelay(has, i);
+
+			res = KSI_HighAvailabilityRequestList_append(has->hedgeQueue, (haReqRef = KSI_HighAvailabilityRequest_ref(haRequest)));
 			if (res != KSI_OK) {
+				KSI_HighAvailabilityRequest_free(haReqRef);
 				KSI_pushError(has->ctx, res, NULL);
 				goto cleanup;
 			}
-			/* Not necessary, but copy anyway. */
-			tmp->signature = handle->signature;
-			tmp->pubRec = handle->pubRec;
-		}
-
-		res = KSI_AsyncHandle_setRequestCtx(tmp,
-				(void *)(haReqRef = KSI_HighAvailabilityRequest_ref(haRequest)),
-				(void (*)(void*))KSI_HighAvailabilityRequest_free);
-		if (res != KSI_OK) {
-			KSI_HighAvailabilityRequest_free(haReqRef);
-			KSI_pushError(has->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
-		if (res != KSI_OK) {
-			KSI_pushError(has->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		/* Add the newly created async handle to the subservice request queue. */
-		KSI_ERR_clearErrors(has->ctx);
-		addRes = KSI_AsyncService_addRequest(as, tmp);
-		if (addRes != KSI_OK) {
-			KSI_pushError(has->ctx, addRes, NULL);
-			KSI_LOG_debug(has->ctx, "Request rejected by sub-service %d.", (int)i);
-			KSI_LOG_logCtxError(has->ctx, KSI_LOG_DEBUG);
-
-			KSI_AsyncHandle_free(tmp);
-			tmp = NULL;
-			/* Try to add the original request to the next async service. */
-			continue;
 		}
-		/* The request handle was succesfully added to the async service. */
-		haRequest->expectedRespCount++;
-		tmp = NULL;
-		added = true;
 	}
 	/* If all clients have failed to accept the request, then fail with the returned error. */
 	if (added == false) {
@@ -233,7 +367,6 @@ cleanup:
 	/* In case of an error do not take ownership of the original handle. */
 	if (res == KSI_OK) KSI_AsyncHandle_free(handle);
 	KSI_HighAvailabilityRequest_free(haRequest);
-	KSI_AsyncHandle_free(tmp);
 	return res;
 }
 
@@ -648,7 +781,12 @@ static int KSI_HighAvailabilityService_getPendingCount(KSI_HighAvailabilityServi
 			goto cleanup;
 		}
 
-		pending = MAX(pending, srvPending);
+		/* In the routed modes the requests are spread over the subservices. */
+		if (has->routingMode != KSI_ASYNC_HA_ROUTING_BROADCAST) {
+			pending += srvPending;
+		} else {
+			pending = MAX(pending, srvPending);
+		}
 	}
 	*count = pending;
 
@@ -689,7 +827,11 @@ static int KSI_HighAvailabilityService_getReceivedCount(KSI_HighAvailabilityServ
 			goto cleanup;
 		}
 
-		received = MAX(received, srvReceived);
+		if (has->routingMode != KSI_ASYNC_HA_ROUTING_BROADCAST) {
+			received += srvReceived;
+		} else {
+			received = MAX(received, srvReceived);
+		}
 	}
 	*count = received + KSI_AsyncHandleList_length(has->respQueue);
 
@@ -698,6 +840,54 @@ cleanup:
 	return res;
 }
 
+static int KSI_HighAvailabilityService_getStatistics(KSI_HighAvailabilityService *has, KSI_AsyncStatistics *stats) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i = 0;
+	size_t j = 0;
+	KSI_AsyncStatistics total;
+
+	if (has == NULL || stats == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(has->ctx);
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
+		KSI_AsyncService *as = NULL;
+		KSI_AsyncStatistics srvStats;
+
+		res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_AsyncService_getStatistics(as, &srvStats);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		total.sent += srvStats.sent;
+		total.received += srvStats.received;
+		total.timedOut += srvStats.timedOut;
+		total.failed += srvStats.failed;
+		total.bytesOut += srvStats.bytesOut;
+		total.bytesIn += srvStats.bytesIn;
+		for (j = 0; j < KSI_ASYNC_STAT_HISTOGRAM_SIZE; j++) {
+			total.queueTime[j] += srvStats.queueTime[j];
+			total.sendTime[j] += srvStats.sendTime[j];
+			total.roundTripTime[j] += srvStats.roundTripTime[j];
+		}
+	}
+	*stats = total;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int KSI_HighAvailabilityService_reportErrorNotice(KSI_HighAvailabilityService *has,
 		KSI_AsyncHandle *reqHndl, size_t origin,
 		int err, long errExt, KSI_Utf8String *errMsg) {
@@ -857,7 +1047,7 @@ cleanup:
 	return res;
 }
 
-static int handleReqResponse(KSI_HighAvailabilityService *has, KSI_AsyncHandle *respHndl) {
+static int handleReqResponse(KSI_HighAvailabilityService *has, size_t from, KSI_AsyncHandle *respHndl) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_HighAvailabilityRequest *haRequest = NULL;
 	KSI_AsyncHandle *reqHndl = NULL;
@@ -881,6 +1071,8 @@ static int handleReqResponse(KSI_HighAvailabilityService *has, KSI_AsyncHandle *
 	haRequest->expectedRespCount--;
 	reqHndl = haRequest->asyncHandle;
 
+	KSI_HighAvailabilityService_updateLatency(has, from, KSI_getMonotonicTimeMs() - respHndl->reqTimeMs);
+
 	res = KSI_AsyncHandle_getState(reqHndl, &reqState);
 	if (res != KSI_OK) {
 		KSI_pushError(has->ctx, res, NULL);
@@ -938,7 +1130,7 @@ cleanup:
 	return res;
 }
 
-static int handleErrorResponse(KSI_HighAvailabilityService *has, KSI_AsyncHandle *respHndl) {
+static int handleErrorResponse(KSI_HighAvailabilityService *has, size_t from, KSI_AsyncHandle *respHndl) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_HighAvailabilityRequest *haRequest = NULL;
 	KSI_AsyncHandle *reqHndl = NULL;
@@ -962,6 +1154,10 @@ static int handleErrorResponse(KSI_HighAvailabilityService *has, KSI_AsyncHandle
 	haRequest->expectedRespCount--;
 	reqHndl = haRequest->asyncHandle;
 
+	/* Penalize the failing subservice, so that it is not preferred by the routed modes. */
+	KSI_HighAvailabilityService_updateLatency(has, from,
+			MAX(KSI_getMonotonicTimeMs() - respHndl->reqTimeMs, KSI_HA_ERROR_PENALTY_MS));
+
 	res = KSI_AsyncHandle_getState(reqHndl, &reqState);
 	if (res != KSI_OK) {
 		KSI_pushError(has->ctx, res, NULL);
@@ -986,6 +1182,18 @@ static int handleErrorResponse(KSI_HighAvailabilityService *has, KSI_AsyncHandle
 		}
 	}
 
+	/* In the routed modes resend the request to the next subservice. */
+	if (reqState == KSI_ASYNC_STATE_ERROR && haRequest->expectedRespCount == 0 &&
+			has->routingMode != KSI_ASYNC_HA_ROUTING_BROADCAST && haRequest->hasReq) {
+		int addRes = KSI_UNKNOWN_ERROR;
+
+		res = KSI_HighAvailabilityService_routeToFastest(has, haRequest, &addRes, NULL);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
 	/* In case all of the relevant subservices have returned an error,
 	 * move the request to the response queue. */
 	if (reqState == KSI_ASYNC_STATE_ERROR && haRequest->expectedRespCount == 0) {
@@ -1004,6 +1212,64 @@ cleanup:
 	return res;
 }
 
+static int KSI_HighAvailabilityService_hedgeRequests(KSI_HighAvailabilityService *has) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HighAvailabilityRequest *haRequest = NULL;
+	uint64_t now;
+	size_t i = 0;
+
+	if (has == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (KSI_HighAvailabilityRequestList_length(has->hedgeQueue) == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+	now = KSI_getMonotonicTimeMs();
+
+	while (i < KSI_HighAvailabilityRequestList_length(has->hedgeQueue)) {
+		int addRes = KSI_UNKNOWN_ERROR;
+		KSI_HighAvailabilityRequest *pending = NULL;
+
+		res = KSI_HighAvailabilityRequestList_elementAt(has->hedgeQueue, i, &pending);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Keep waiting in case the request is still in progress and the delay has not expired. */
+		if (pending->asyncHandle->state != KSI_ASYNC_STATE_RESPONSE_RECEIVED && pending->expectedRespCount > 0 &&
+				now < pending->hedgeAt) {
+			i++;
+			continue;
+		}
+
+		res = KSI_HighAvailabilityRequestList_remove(has->hedgeQueue, i, &haRequest);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (haRequest->asyncHandle->state != KSI_ASYNC_STATE_RESPONSE_RECEIVED && haRequest->expectedRespCount > 0) {
+			res = KSI_HighAvailabilityService_routeToFastest(has, haRequest, &addRes, NULL);
+			if (res != KSI_OK) {
+				KSI_pushError(has->ctx, res, NULL);
+				goto cleanup;
+			}
+			if (addRes != KSI_OK) KSI_LOG_debug(has->ctx, "Hedged request rejected by all sub-services.");
+		}
+		KSI_HighAvailabilityRequest_free(haRequest);
+		haRequest = NULL;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_HighAvailabilityRequest_free(haRequest);
+	return res;
+}
+
 static int responseHandler(KSI_HighAvailabilityService *has, KSI_Config_Callback confCallback) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_AsyncHandle *respHndl = NULL;
@@ -1046,11 +1312,11 @@ static int responseHandler(KSI_HighAvailabilityService *has, KSI_Config_Callback
 				break;
 
 			case KSI_ASYNC_STATE_RESPONSE_RECEIVED:
-				handleReqResponse(has, respHndl);
+				handleReqResponse(has, i, respHndl);
 				break;
 
 			case KSI_ASYNC_STATE_ERROR:
-				handleErrorResponse(has, respHndl);
+				handleErrorResponse(has, i, respHndl);
 				break;
 
 			default:
@@ -1062,6 +1328,12 @@ static int responseHandler(KSI_HighAvailabilityService *has, KSI_Config_Callback
 		respHndl = NULL;
 	}
 
+	res = KSI_HighAvailabilityService_hedgeRequests(has);
+	if (res != KSI_OK) {
+		KSI_pushError(has->ctx, res, NULL);
+		goto cleanup;
+	}
+
 	res = KSI_OK;
 cleanup:
 	KSI_AsyncHandle_free(respHndl);
@@ -1078,6 +1350,45 @@ static int KSI_HighAvailabilityService_extRespHandler(KSI_HighAvailabilityServic
 			(KSI_Config_Callback)has->ctx->options[KSI_OPT_EXT_CONF_RECEIVED_CALLBACK]));
 }
 
+static int KSI_HighAvailabilityService_getOption(const KSI_HighAvailabilityService *has, const int option, void *value);
+
+static void KSI_HighAvailabilityService_invokeCallbacks(KSI_HighAvailabilityService *has) {
+	size_t i = 0;
+	size_t userp = 0;
+
+	if (has == NULL || has->cbActive) return;
+
+	has->cbActive = true;
+	/* The user data is shared with the subservices. */
+	if (KSI_HighAvailabilityService_getOption(has, KSI_ASYNC_OPT_CALLBACK_USERDATA, &userp) != KSI_OK) userp = 0;
+
+	while (i < KSI_AsyncHandleList_length(has->respQueue)) {
+		int res;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_AsyncServiceCallback_Completion callback = NULL;
+
+		if (KSI_AsyncHandleList_elementAt(has->respQueue, i, &handle) != KSI_OK || handle == NULL) break;
+
+		callback = (handle->cmplCallback != NULL ? handle->cmplCallback : has->cmplCallback);
+		if (callback == NULL) {
+			/* Leave the handle to be returned via run. */
+			i++;
+			continue;
+		}
+
+		if (KSI_AsyncHandleList_remove(has->respQueue, i, &handle) != KSI_OK) break;
+
+		KSI_ERR_clearErrors(has->ctx);
+		res = callback(has->ctx, handle, handle->state, (void *)userp);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, "Async request completion callback returned error.");
+			KSI_LOG_logCtxError(has->ctx, KSI_LOG_ERROR);
+		}
+		KSI_AsyncHandle_free(handle);
+	}
+	has->cbActive = false;
+}
+
 static int KSI_HighAvailabilityService_run(KSI_HighAvailabilityService *has,
 		int (*respHandler)(KSI_HighAvailabilityService *), KSI_AsyncHandle **handle, size_t *waiting) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -1099,6 +1410,9 @@ static int KSI_HighAvailabilityService_run(KSI_HighAvailabilityService *has,
 		goto cleanup;
 	}
 
+	/* Deliver the finalized requests with a completion callback. */
+	KSI_HighAvailabilityService_invokeCallbacks(has);
+
 	if (handle != NULL && KSI_AsyncHandleList_length(has->respQueue) > 0) {
 		res = KSI_AsyncHandleList_remove(has->respQueue, 0, handle);
 		if (res != KSI_OK) {
@@ -1127,6 +1441,148 @@ cleanup:
 	return res;
 }
 
+static int KSI_HighAvailabilityService_getSockets(KSI_HighAvailabilityService *has, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i = 0;
+	size_t total = 0;
+
+	if (has == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(has->ctx);
+
+	for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
+		KSI_AsyncService *as = NULL;
+		size_t srvCount = 0;
+
+		res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Fill the remaining part of the array. The required size is accumulated even if it does not fit. */
+		res = KSI_AsyncService_getSockets(as, (total < size ? sockets + total : NULL), (total < size ? size - total : 0), &srvCount);
+		if (res != KSI_OK && res != KSI_BUFFER_OVERFLOW) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+		KSI_ERR_clearErrors(has->ctx);
+
+		total += srvCount;
+	}
+	*count = total;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int KSI_HighAvailabilityService_getTimeout(KSI_HighAvailabilityService *has, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i = 0;
+	long tmp = -1;
+
+	if (has == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(has->ctx);
+
+	/* Responses are waiting to be collected. */
+	if (KSI_AsyncHandleList_length(has->respQueue) > 0) {
+		*timeout = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
+		KSI_AsyncService *as = NULL;
+		long srvTimeout = -1;
+
+		res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_AsyncService_getTimeout(as, &srvTimeout);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, srvTimeout);
+	}
+
+	/* Wake up for sending out the hedged requests. */
+	if (KSI_HighAvailabilityRequestList_length(has->hedgeQueue) > 0) {
+		uint64_t now = KSI_getMonotonicTimeMs();
+
+		for (i = 0; i < KSI_HighAvailabilityRequestList_length(has->hedgeQueue); i++) {
+			KSI_HighAvailabilityRequest *haRequest = NULL;
+			long left = 0;
+
+			res = KSI_HighAvailabilityRequestList_elementAt(has->hedgeQueue, i, &haRequest);
+			if (res != KSI_OK) {
+				KSI_pushError(has->ctx, res, NULL);
+				goto cleanup;
+			}
+			if (haRequest->hedgeAt > now) left = (long)(haRequest->hedgeAt - now);
+			tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, left);
+		}
+	}
+	*timeout = tmp;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int KSI_HighAvailabilityService_socketReady(KSI_HighAvailabilityService *has,
+		int (*respHandler)(KSI_HighAvailabilityService *), int fd, int events) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i = 0;
+
+	if (has == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(has->ctx);
+
+	/* The subservices ignore the sockets they do not own. */
+	for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
+		KSI_AsyncService *as = NULL;
+
+		res = KSI_AsyncServiceList_elementAt(has->services, i, &as);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_AsyncService_socketReady(as, fd, events);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	/* Collect the subservice responses for the completion callbacks. */
+	if (respHandler != NULL) {
+		res = respHandler(has);
+		if (res != KSI_OK) {
+			KSI_pushError(has->ctx, res, NULL);
+			goto cleanup;
+		}
+		KSI_HighAvailabilityService_invokeCallbacks(has);
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int KSI_HighAvailabilityService_setOption(KSI_HighAvailabilityService *has, const int option, void *value) {
 	int res = KSI_UNKNOWN_ERROR;
 	size_t i = 0;
@@ -1150,11 +1606,36 @@ static int KSI_HighAvailabilityService_setOption(KSI_HighAvailabilityService *ha
 		case KSI_ASYNC_OPT_CONF_CONSOLIDATE_CALLBACK:
 			has->confConsolidateCallback = (KSI_AsyncServiceCallback_configConsolidate)value;
 			break;
+		/* The subservices operate on cloned handles, thus the callback is invoked by the HA service. */
+		case KSI_ASYNC_OPT_COMPLETION_CALLBACK:
+			has->cmplCallback = (KSI_AsyncServiceCallback_Completion)value;
+			break;
 
 		case KSI_ASYNC_OPT_HA_SUBSERVICE_LIST:
 			res = KSI_INVALID_ARGUMENT;
 			goto cleanup;
 
+		case KSI_ASYNC_OPT_HA_ROUTING_MODE:
+			if ((size_t)value >= __KSI_ASYNC_HA_ROUTING_COUNT) {
+				KSI_pushError(has->ctx, res = KSI_INVALID_ARGUMENT, "Unknown routing mode.");
+				goto cleanup;
+			}
+			has->routingMode = (size_t)value;
+			break;
+		case KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE:
+			if ((size_t)value == 0 || (size_t)value > 100) {
+				KSI_pushError(has->ctx, res = KSI_INVALID_ARGUMENT, "Percentile must be in range 1..100.");
+				goto cleanup;
+			}
+			has->hedgePercentile = (size_t)value;
+			break;
+
+		/* The request handles are cloned for the subservices, thus local aggregation is not supported. */
+		case KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT:
+		case KSI_ASYNC_OPT_LOCAL_AGGR_PERIOD:
+			KSI_pushError(has->ctx, res = KSI_INVALID_ARGUMENT, "Local aggregation is not supported by high availability service.");
+			goto cleanup;
+
 		/* All other options route to the subservices. */
 		default:
 			for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
@@ -1204,10 +1685,19 @@ static int KSI_HighAvailabilityService_getOption(const KSI_HighAvailabilityServi
 		case KSI_ASYNC_OPT_CONF_CONSOLIDATE_CALLBACK:
 			tmp = (size_t)has->confConsolidateCallback;
 			break;
+		case KSI_ASYNC_OPT_COMPLETION_CALLBACK:
+			tmp = (size_t)has->cmplCallback;
+			break;
 
 		case KSI_ASYNC_OPT_HA_SUBSERVICE_LIST:
 			tmp = (size_t)has->services;
 			break;
+		case KSI_ASYNC_OPT_HA_ROUTING_MODE:
+			tmp = has->routingMode;
+			break;
+		case KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE:
+			tmp = has->hedgePercentile;
+			break;
 
 		default:
 			for (i = 0; i < KSI_AsyncServiceList_length(has->services); i++) {
@@ -1248,6 +1738,8 @@ static void KSI_HighAvailabilityService_free(KSI_HighAvailabilityService *servic
 		KSI_AsyncServiceList_free(service->services);
 		KSI_AsyncHandleList_free(service->respQueue);
 		KSI_Config_free(service->consolidatedConfig);
+		KSI_HighAvailabilityRequestList_free(service->hedgeQueue);
+		KSI_free(service->latency);
 
 		KSI_free(service);
 	}
@@ -1275,6 +1767,12 @@ static int KSI_AbstractHighAvailabilityService_new(KSI_CTX *ctx, KSI_HighAvailab
 	tmp->consolidatedConfig = NULL;
 	tmp->confCallback = NULL;
 	tmp->confConsolidateCallback = NULL;
+	tmp->cmplCallback = NULL;
+	tmp->cbActive = false;
+	tmp->routingMode = KSI_ASYNC_HA_ROUTING_BROADCAST;
+	tmp->hedgePercentile = KSI_HA_DEFAULT_HEDGE_PERCENTILE;
+	tmp->latency = NULL;
+	tmp->hedgeQueue = NULL;
 
 	tmp->subservice_new = NULL;
 
@@ -1296,6 +1794,18 @@ static int KSI_AbstractHighAvailabilityService_new(KSI_CTX *ctx, KSI_HighAvailab
 		goto cleanup;
 	}
 
+	res = KSI_HighAvailabilityRequestList_new(&tmp->hedgeQueue);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->latency = KSI_calloc(KSI_HA_ROUTING_MAX_SERVICES, sizeof(KSI_HighAvailabilityLatency));
+	if (tmp->latency == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
 	*service = tmp;
 	tmp = NULL;
 
@@ -1388,6 +1898,12 @@ static int KSI_HighAvailabilityService_setEndpoint(KSI_AsyncService *service, co
 		KSI_AsyncServiceList_remove(has->respQueue, KSI_AsyncServiceList_length(has->respQueue) - 1, NULL);
 	}
 
+	/* Reset routing state. */
+	while (KSI_HighAvailabilityRequestList_length(has->hedgeQueue)) {
+		KSI_HighAvailabilityRequestList_remove(has->hedgeQueue, KSI_HighAvailabilityRequestList_length(has->hedgeQueue) - 1, NULL);
+	}
+	memset(has->latency, 0, KSI_HA_ROUTING_MAX_SERVICES * sizeof(KSI_HighAvailabilityLatency));
+
 	res = KSI_HighAvailabilityService_addEndpoint(service, uri, loginId, key);
 	if (res != KSI_OK) {
 		KSI_pushError(service->ctx, res, NULL);
@@ -1430,9 +1946,13 @@ int KSI_SigningHighAvailabilityService_new(KSI_CTX *ctx, KSI_AsyncService **serv
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))KSI_HighAvailabilityService_addRequest;
 	tmp->responseHandler = (int (*)(void *))KSI_HighAvailabilityService_aggrRespHandler;
 	tmp->run = (int (*)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *))KSI_HighAvailabilityService_run;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))KSI_HighAvailabilityService_getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))KSI_HighAvailabilityService_getTimeout;
+	tmp->socketReady = (int (*)(void *, int (*)(void *), int, int))KSI_HighAvailabilityService_socketReady;
 
 	tmp->getPendingCount = (int (*)(void *, size_t *))KSI_HighAvailabilityService_getPendingCount;
 	tmp->getReceivedCount = (int (*)(void *, size_t *))KSI_HighAvailabilityService_getReceivedCount;
+	tmp->getStatistics = (int (*)(void *, KSI_AsyncStatistics *))KSI_HighAvailabilityService_getStatistics;
 
 	tmp->setOption = (int (*)(void *, int, void *))KSI_HighAvailabilityService_setOption;
 	tmp->getOption = (int (*)(void *, int, void *))KSI_HighAvailabilityService_getOption;
@@ -1481,9 +2001,13 @@ int KSI_ExtendingHighAvailabilityService_new(KSI_CTX *ctx, KSI_AsyncService **se
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))KSI_HighAvailabilityService_addRequest;
 	tmp->responseHandler = (int (*)(void *))KSI_HighAvailabilityService_extRespHandler;
 	tmp->run = (int (*)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *))KSI_HighAvailabilityService_run;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))KSI_HighAvailabilityService_getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))KSI_HighAvailabilityService_getTimeout;
+	tmp->socketReady = (int (*)(void *, int (*)(void *), int, int))KSI_HighAvailabilityService_socketReady;
 
 	tmp->getPendingCount = (int (*)(void *, size_t *))KSI_HighAvailabilityService_getPendingCount;
 	tmp->getReceivedCount = (int (*)(void *, size_t *))KSI_HighAvailabilityService_getReceivedCount;
+	tmp->getStatistics = (int (*)(void *, KSI_AsyncStatistics *))KSI_HighAvailabilityService_getStatistics;
 
 	tmp->setOption = (int (*)(void *, int, void *))KSI_HighAvailabilityService_setOption;
 	tmp->getOption = (int (*)(void *, int, void *))KSI_HighAvailabilityService_getOption;
@@ -80,6 +80,10 @@ struct HttpAsyncCtx_st {
 
 	/* Poiter to the async options. */
 	size_t *options;
+	/* Poiter to the async client statistics. */
+	KSI_AsyncStatistics *stats;
+	/* Pointer to the time of the next request cache check of the async client. */
+	time_t *nextSweep;
 
 	/* Endpoint data. */
 	char *ksi_user;
@@ -203,6 +207,7 @@ static int CurlAsyncRequest_processResponse(CurlAsyncRequest *curlResponse) {
 						clientCtx, curlResponse);
 				handle->state = KSI_ASYNC_STATE_ERROR;
 				handle->err = KSI_NETWORK_ERROR;
+				*clientCtx->nextSweep = 0;
 				break;
 			}
 			tlvSize = ftlv.hdr_len + ftlv.dat_len;
@@ -292,10 +297,14 @@ cleanup:
 	return totalCount;
 }
 
-static void reqQueue_clearWithError(KSI_AsyncHandleList *reqQueue, int err, long ext, const char *msg) {
+static void reqQueue_clearWithError(HttpAsyncCtx *clientCtx, int err, long ext, const char *msg) {
+	KSI_AsyncHandleList *reqQueue = clientCtx->reqQueue;
 	size_t size = 0;
 
-	if (reqQueue == NULL) return;
+	if (reqQueue == NULL || KSI_AsyncHandleList_length(reqQueue) == 0) return;
+
+	/* Let the async client collect the failed requests on the next cache check. */
+	*clientCtx->nextSweep = 0;
 
 	while ((size = KSI_AsyncHandleList_length(reqQueue)) > 0) {
 		int res;
@@ -361,6 +370,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 				/* Set error. */
 				req->state = KSI_ASYNC_STATE_ERROR;
 				req->err = KSI_NETWORK_SEND_TIMEOUT;
+				*clientCtx->nextSweep = 0;
 				/* Just remove the request from the request queue. */
 				KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
 			} else {
@@ -418,7 +428,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 				if (curlmCode != CURLM_OK) {
 					KSI_LOG_error(clientCtx->ctx, "[%p] Async Curl HTTP: returned error. Error: %d (%s).",
 							clientCtx, curlmCode, curl_multi_strerror(curlmCode));
-					reqQueue_clearWithError(clientCtx->reqQueue, KSI_NETWORK_ERROR, curlmCode, curl_multi_strerror(curlmCode));
+					reqQueue_clearWithError(clientCtx, KSI_NETWORK_ERROR, curlmCode, curl_multi_strerror(curlmCode));
 					res = KSI_OK;
 					goto cleanup;
 				}
@@ -430,6 +440,11 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 				req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
 				/* Start receive timeout. */
 				req->sndTime = curTime;
+				/* Update statistics. */
+				req->sndTimeMs = KSI_getMonotonicTimeMs();
+				clientCtx->stats->sent++;
+				clientCtx->stats->bytesOut += req->len;
+				KSI_AsyncStatistics_addSample(clientCtx->stats->queueTime, req->sndTimeMs - req->reqTimeMs);
 				/* The request has been successfully dispatched. Remove it from the request queue. */
 				KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
 			}
@@ -443,7 +458,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 	if (curlmCode != CURLM_OK) {
 		KSI_LOG_error(clientCtx->ctx, "[%p] Async Curl HTTP: returned error. Error: %d (%s).",
 				clientCtx, curlmCode, curl_multi_strerror(curlmCode));
-		reqQueue_clearWithError(clientCtx->reqQueue, KSI_NETWORK_ERROR, curlmCode, curl_multi_strerror(curlmCode));
+		reqQueue_clearWithError(clientCtx, KSI_NETWORK_ERROR, curlmCode, curl_multi_strerror(curlmCode));
 		res = KSI_OK;
 		goto cleanup;
 	}
@@ -473,6 +488,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 						clientCtx, curlMsg->data.result, curlResponse->errMsg);
 				handle->state = KSI_ASYNC_STATE_ERROR;
 				handle->err = KSI_NETWORK_ERROR;
+				*clientCtx->nextSweep = 0;
 				handle->errExt = curlMsg->data.result;
 				if (len) KSI_Utf8String_new(clientCtx->ctx, curlResponse->errMsg, len + 1, &handle->errMsg);
 			} else {
@@ -490,6 +506,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 					KSI_LOG_debug(clientCtx->ctx, "[%p] Async Curl HTTP: received HTTP code %ld.", clientCtx, httpCode);
 					handle->state = KSI_ASYNC_STATE_ERROR;
 					handle->err = KSI_HTTP_ERROR;
+					*clientCtx->nextSweep = 0;
 					handle->errExt = httpCode;
 					if (len) KSI_Utf8String_new(clientCtx->ctx, curlResponse->errMsg, len + 1, &handle->errMsg);
 				} else {
@@ -523,6 +540,131 @@ cleanup:
 	return res;
 }
 
+static void addSocket(int fd, int events, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	size_t i;
+
+	/* Merge the events of a socket that is already in the list. */
+	for (i = 0; i < *count && i < size; i++) {
+		if (sockets[i].fd == fd) {
+			sockets[i].events |= events;
+			return;
+		}
+	}
+	if (*count < size) {
+		sockets[*count].fd = fd;
+		sockets[*count].events = events;
+	}
+	(*count)++;
+}
+
+static int getSockets(HttpAsyncCtx *clientCtx, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	CURLMcode curlmCode;
+	fd_set fdRead;
+	fd_set fdWrite;
+	fd_set fdExcept;
+	int maxFd = -1;
+	size_t tmp = 0;
+
+	if (clientCtx == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (clientCtx->curl == NULL) {
+		KSI_pushError(clientCtx->ctx, res = KSI_INVALID_STATE, "Curl multi handle is not initialized.");
+		goto cleanup;
+	}
+
+	FD_ZERO(&fdRead);
+	FD_ZERO(&fdWrite);
+	FD_ZERO(&fdExcept);
+
+	curlmCode = curl_multi_fdset(clientCtx->curl->handle, &fdRead, &fdWrite, &fdExcept, &maxFd);
+	if (curlmCode != CURLM_OK) {
+		KSI_LOG_error(clientCtx->ctx, "[%p] Async Curl HTTP: returned error. Error: %d (%s).",
+				clientCtx, curlmCode, curl_multi_strerror(curlmCode));
+		KSI_pushError(clientCtx->ctx, res = KSI_NETWORK_ERROR, "Unable to get the sockets of the curl multi handle.");
+		goto cleanup;
+	}
+
+	/* Note that the multi handle is shared between the clients, thus all of the sockets in use are reported. */
+#ifdef _WIN32
+	{
+		u_int i;
+		for (i = 0; i < fdRead.fd_count; i++) addSocket((int)fdRead.fd_array[i], KSI_ASYNC_SOCKET_EVENT_READ, sockets, size, &tmp);
+		for (i = 0; i < fdWrite.fd_count; i++) addSocket((int)fdWrite.fd_array[i], KSI_ASYNC_SOCKET_EVENT_WRITE, sockets, size, &tmp);
+		for (i = 0; i < fdExcept.fd_count; i++) addSocket((int)fdExcept.fd_array[i], KSI_ASYNC_SOCKET_EVENT_ERROR, sockets, size, &tmp);
+	}
+#else
+	{
+		int fd;
+		for (fd = 0; fd <= maxFd; fd++) {
+			int events = 0;
+
+			if (FD_ISSET(fd, &fdRead)) events |= KSI_ASYNC_SOCKET_EVENT_READ;
+			if (FD_ISSET(fd, &fdWrite)) events |= KSI_ASYNC_SOCKET_EVENT_WRITE;
+			if (FD_ISSET(fd, &fdExcept)) events |= KSI_ASYNC_SOCKET_EVENT_ERROR;
+			if (events != 0) addSocket(fd, events, sockets, size, &tmp);
+		}
+	}
+#endif
+	*count = tmp;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getTimeout(HttpAsyncCtx *clientCtx, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	CURLMcode curlmCode;
+	long tmp = -1;
+
+	if (clientCtx == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (clientCtx->curl == NULL) {
+		KSI_pushError(clientCtx->ctx, res = KSI_INVALID_STATE, "Curl multi handle is not initialized.");
+		goto cleanup;
+	}
+
+	/* Requests in the output queue are added to the multi handle on the next dispatch. */
+	if (KSI_AsyncHandleList_length(clientCtx->reqQueue) > 0) {
+		double left = 0;
+
+		if (clientCtx->roundCount >= clientCtx->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT]) {
+			left = clientCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION] - difftime(time(NULL), clientCtx->roundStartAt);
+		}
+		tmp = (left > 0) ? (long)(left * 1000) : 0;
+	}
+
+	if (tmp != 0) {
+		long curlTimeout = -1;
+
+		curlmCode = curl_multi_timeout(clientCtx->curl->handle, &curlTimeout);
+		if (curlmCode != CURLM_OK) {
+			KSI_LOG_error(clientCtx->ctx, "[%p] Async Curl HTTP: returned error. Error: %d (%s).",
+					clientCtx, curlmCode, curl_multi_strerror(curlmCode));
+			KSI_pushError(clientCtx->ctx, res = KSI_NETWORK_ERROR, "Unable to get the timeout of the curl multi handle.");
+			goto cleanup;
+		}
+		tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, curlTimeout);
+	}
+	*timeout = tmp;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int socketReady(HttpAsyncCtx *clientCtx, int fd, int events) {
+	/* The multi handle performs the transfers on all of its sockets at once. */
+	return dispatch(clientCtx);
+}
+
 static int addToSendQueue(HttpAsyncCtx *clientCtx, KSI_AsyncHandle *request) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -697,6 +839,8 @@ static int HttpAsyncCtx_new(KSI_CTX *ctx, HttpAsyncCtx **clientCtx) {
 	tmp->curl = NULL;
 
 	tmp->options = NULL;
+	tmp->stats = NULL;
+	tmp->nextSweep = NULL;
 	tmp->userAgent = NULL;
 	tmp->httpHeaders = NULL;
 	tmp->roundStartAt = 0;
@@ -765,12 +909,17 @@ int KSI_HttpAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))addToSendQueue;
 	tmp->getResponse = (int (*)(void *, KSI_OctetString **, size_t *))getResponse;
 	tmp->dispatch = (int (*)(void *))dispatch;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))getTimeout;
+	tmp->socketReady = (int (*)(void *, int, int))socketReady;
 	tmp->getCredentials = (int (*)(void *, const char **, const char **))getCredentials;
 
 	res = HttpAsyncCtx_new(ctx, &netImpl);
 	if (res != KSI_OK) goto cleanup;
 
 	netImpl->options = tmp->options;
+	netImpl->stats = &tmp->stats;
+	netImpl->nextSweep = &tmp->nextSweep;
 
 	tmp->clientImpl_free = (void (*)(void*))HttpAsyncCtx_free;
 	tmp->clientImpl = netImpl;
@@ -75,6 +75,10 @@ typedef struct {
 
 	/* Poiter to the async options. */
 	size_t *options;
+	/* Poiter to the async client statistics. */
+	KSI_AsyncStatistics *stats;
+	/* Pointer to the time of the next request cache check of the async client. */
+	time_t *nextSweep;
 
 	/* Endpoint data. */
 	char *ksi_user;
@@ -370,10 +374,14 @@ cleanup:
 	LeaveCriticalSection(&CriticalSection);
 }
 
-static void reqQueue_clearWithError(KSI_AsyncHandleList *reqQueue, int err, long ext) {
+static void reqQueue_clearWithError(HttpAsyncCtx *clientCtx, int err, long ext) {
+	KSI_AsyncHandleList *reqQueue = clientCtx->reqQueue;
 	size_t size = 0;
 
-	if (reqQueue == NULL) return;
+	if (reqQueue == NULL || KSI_AsyncHandleList_length(reqQueue) == 0) return;
+
+	/* Let the async client collect the failed requests on the next cache check. */
+	*clientCtx->nextSweep = 0;
 
 	while ((size = KSI_AsyncHandleList_length(reqQueue)) > 0) {
 		int res;
@@ -632,6 +640,7 @@ static int WinINet_handleResponse(HttpAsyncCtx *clientCtx) {
 					clientCtx, httpReq->status, httpReq->errExt);
 			handle->state = KSI_ASYNC_STATE_ERROR;
 			handle->err = httpReq->status;
+			*clientCtx->nextSweep = 0;
 			handle->errExt = httpReq->errExt;
 		} else {
 			size_t count = 0;
@@ -654,6 +663,7 @@ static int WinINet_handleResponse(HttpAsyncCtx *clientCtx) {
 							clientCtx);
 					handle->state = KSI_ASYNC_STATE_ERROR;
 					handle->err = KSI_NETWORK_ERROR;
+					*clientCtx->nextSweep = 0;
 					break;
 				}
 				tlvSize = ftlv.hdr_len + ftlv.dat_len;
@@ -719,7 +729,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 
 		res = WinINet_init(clientCtx);
 		if (res != KSI_OK) {
-			reqQueue_clearWithError(clientCtx->reqQueue, res, GetLastError());
+			reqQueue_clearWithError(clientCtx, res, GetLastError());
 			KSI_pushError(clientCtx->ctx, res, "Failed to init WinINet.");
 			res = KSI_OK;
 			goto cleanup;
@@ -745,6 +755,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 			/* Set error. */
 			req->state = KSI_ASYNC_STATE_ERROR;
 			req->err = KSI_NETWORK_SEND_TIMEOUT;
+			*clientCtx->nextSweep = 0;
 			/* Just remove the request from the request queue. */
 			KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
 			continue;
@@ -771,6 +782,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 			/* Set error. */
 			req->state = KSI_ASYNC_STATE_ERROR;
 			req->err = res;
+			*clientCtx->nextSweep = 0;
 			req->errExt = error;
 			/* Just remove the request from the request queue. */
 			KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
@@ -781,6 +793,11 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 		req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
 		/* Start receive timeout. */
 		req->sndTime = curTime;
+		/* Update statistics. */
+		req->sndTimeMs = KSI_getMonotonicTimeMs();
+		clientCtx->stats->sent++;
+		clientCtx->stats->bytesOut += req->len;
+		KSI_AsyncStatistics_addSample(clientCtx->stats->queueTime, req->sndTimeMs - req->reqTimeMs);
 
 		/* The request has been successfully dispatched. Remove it from the request queue. */
 		KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
@@ -953,6 +970,8 @@ static int HttpAsyncCtx_new(KSI_CTX *ctx, HttpAsyncCtx **clientCtx) {
 	tmp->connectHandle = NULL;
 
 	tmp->options = NULL;
+	tmp->stats = NULL;
+	tmp->nextSweep = NULL;
 	tmp->roundStartAt = 0;
 	tmp->roundCount = 0;
 
@@ -1022,6 +1041,8 @@ int KSI_HttpAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	if (res != KSI_OK) goto cleanup;
 
 	netImpl->options = tmp->options;
+	netImpl->stats = &tmp->stats;
+	netImpl->nextSweep = &tmp->nextSweep;
 
 	tmp->clientImpl_free = (void (*)(void*))HttpAsyncCtx_free;
 	tmp->clientImpl = netImpl;
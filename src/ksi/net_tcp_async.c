@@ -44,27 +44,50 @@ int KSI_TcpAsyncClient_setService(KSI_AsyncClient *c, const char *host, unsigned
 #include "impl/net_sock_impl.h"
 
 #define KSI_TLV_MAX_SIZE (0xffff + 4)
+#define KSI_TCP_INBUF_SIZE (KSI_TLV_MAX_SIZE * 4)
+/* Maximum number of requests sent out with a single system call. */
+#define KSI_TCP_SEND_IOV_MAX 64
 
-typedef struct TcpClientCtx_st {
-	KSI_CTX *ctx;
+typedef struct TcpClientCtx_st TcpAsyncCtx;
+
+typedef struct TcpConnection_st {
+	/* Pointer to the owning endpoint context. */
+	TcpAsyncCtx *owner;
 	/* Socket descriptor. */
 	int sockfd;
 	/* Output queue. */
 	KSI_LIST(KSI_AsyncHandle) *reqQueue;
-	/* Input queue. */
-	KSI_LIST(KSI_OctetString) *respQueue;
-	/* Input read buffer. */
-	unsigned char inBuf[KSI_TLV_MAX_SIZE * 2];
-	size_t inLen;
-
-	/* Round throttling. */
-	time_t roundStartAt;
-	size_t roundCount;
+	/* Input read buffer. Complete PDUs are kept in range [rdPos, frmPos), the partially received
+	 * PDU in range [frmPos, wrPos). */
+	unsigned char inBuf[KSI_TCP_INBUF_SIZE];
+	size_t rdPos;
+	size_t frmPos;
+	size_t wrPos;
+	/* Number of complete PDUs in the input buffer. */
+	size_t frmCount;
 
 	/* Connect timeout. */
 	time_t connectedAt;
 	bool socketReady;
 
+	/* Number of requests sent out over the connection that have not been responded yet. */
+	size_t outstanding;
+} TcpConnection;
+
+struct TcpClientCtx_st {
+	KSI_CTX *ctx;
+	/* Connection pool. */
+	TcpConnection **conn;
+	size_t connCount;
+	/* Index of the connection the last request has been assigned to. */
+	size_t connLast;
+	/* Number of established connections. */
+	size_t connReady;
+
+	/* Round throttling. */
+	time_t roundStartAt;
+	size_t roundCount;
+
 	/* Poiter to the parent async client. */
 	KSI_AsyncClient *parent;
 
@@ -73,21 +96,23 @@ typedef struct TcpClientCtx_st {
 	char *ksi_pass;
 	char *host;
 	unsigned port;
-} TcpAsyncCtx;
+};
 
 
-static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
+static int openSocket(TcpConnection *conn, int *sockfd) {
 	int res;
 	int tmpfd = KSI_INVALID_SOCKET;
+	TcpAsyncCtx *tcpCtx = NULL;
 	struct addrinfo hints;
 	struct addrinfo *result = NULL;
 	struct addrinfo *pr = NULL;
 	char portStr[6];
 
-	if (tcpCtx == NULL || sockfd == NULL) {
+	if (conn == NULL || sockfd == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
+	tcpCtx = conn->owner;
 	KSI_ERR_clearErrors(tcpCtx->ctx);
 
 	memset(&hints, 0, sizeof(struct addrinfo));
@@ -106,6 +131,9 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 
 	for (pr = result; pr != NULL; pr = pr->ai_next) {
 		unsigned nbMode = 1;
+#ifdef SO_NOSIGPIPE
+		int sigpipeOff = 1;
+#endif
 
 		if (pr->ai_protocol != IPPROTO_TCP) continue;
 
@@ -122,6 +150,15 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 			goto cleanup;
 		}
 
+#ifdef SO_NOSIGPIPE
+		/* Platforms without MSG_NOSIGNAL disable SIGPIPE on the socket. */
+		res = setsockopt(tmpfd, SOL_SOCKET, SO_NOSIGPIPE, (void *)&sigpipeOff, sizeof(sigpipeOff));
+		if (res == KSI_SCK_SOCKET_ERROR) {
+			KSI_ERR_push(tcpCtx->ctx, res = KSI_IO_ERROR, KSI_SCK_errno, __FILE__, __LINE__, "Async TCP unable to disable SIGPIPE.");
+			goto cleanup;
+		}
+#endif
+
 #ifdef _WIN32
 		res = connect(tmpfd, pr->ai_addr, (int) pr->ai_addrlen);
 #else
@@ -133,7 +170,7 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 				goto cleanup;
 			}
 		}
-		time(&tcpCtx->connectedAt);
+		time(&conn->connectedAt);
 
 		/* Succeedded to connect. */
 		break;
@@ -164,26 +201,78 @@ static int connectionStateListener(TcpAsyncCtx *tcpCtx, int state) {
 	return stateListener(tcpCtx->ctx, (size_t)tcpCtx, userp, tcpCtx->host, state);
 }
 
-static void closeSocket(TcpAsyncCtx *tcpCtx, unsigned int lineNr) {
-	if (tcpCtx != NULL) {
+static void resetSentCount(KSI_LIST(KSI_AsyncHandle) *reqQueue) {
+	size_t i;
+
+	for (i = 0; i < KSI_AsyncHandleList_length(reqQueue); i++) {
+		KSI_AsyncHandle *req = NULL;
+
+		if (KSI_AsyncHandleList_elementAt(reqQueue, i, &req) == KSI_OK && req != NULL) req->sentCount = 0;
+	}
+}
+
+static void closeSocket(TcpConnection *conn, unsigned int lineNr) {
+	if (conn != NULL) {
+		TcpAsyncCtx *tcpCtx = conn->owner;
 
-		KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP close socket at: L%u", tcpCtx, lineNr);
+		KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP close socket at: L%u", conn, lineNr);
 
 		/* Close socket. */
-		if (tcpCtx->sockfd != KSI_INVALID_SOCKET) close(tcpCtx->sockfd);
-		tcpCtx->sockfd = KSI_INVALID_SOCKET;
-		/* Inform listener if set. Do not care about returned error. */
-		if (tcpCtx->socketReady) connectionStateListener(tcpCtx, false);
-		tcpCtx->socketReady = false;
-		/* Clear input buffer. */
-		tcpCtx->inLen = 0;
+		if (conn->sockfd != KSI_INVALID_SOCKET) close(conn->sockfd);
+		conn->sockfd = KSI_INVALID_SOCKET;
+		if (conn->socketReady) {
+			/* Inform listener if the last established connection has been closed. Do not care about returned error. */
+			if (--tcpCtx->connReady == 0) connectionStateListener(tcpCtx, false);
+		}
+		conn->socketReady = false;
+		conn->outstanding = 0;
+		/* Drop the partially received PDU. The complete PDUs are kept until processed. */
+		conn->wrPos = conn->frmPos;
+		/* A partially sent request has to be resent as a whole over the next connection. */
+		resetSentCount(conn->reqQueue);
+	}
+}
+
+static void setResponseError(TcpConnection *conn, int err) {
+	KSI_AsyncClient *c = conn->owner->parent;
+	size_t i;
+
+	for (i = KSI_ASYNC_CACHE_START_POS; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
+		KSI_AsyncHandle *handle = c->reqCache[i];
+
+		if (handle != NULL && handle->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE && handle->connId == (size_t)conn) {
+			handle->state = KSI_ASYNC_STATE_ERROR;
+			handle->err = err;
+		}
+	}
+	if (c->serverConf != NULL && c->serverConf->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE &&
+			c->serverConf->connId == (size_t)conn) {
+		c->serverConf->state = KSI_ASYNC_STATE_ERROR;
+		c->serverConf->err = err;
 	}
+	/* Let the async client collect the failed requests on the next cache check. */
+	c->nextSweep = 0;
+}
+
+static int closeConnection(TcpConnection *conn, unsigned int lineNr) {
+	closeSocket(conn, lineNr);
+
+	/* With a single connection all of the requests waiting for response are failed by the async client. */
+	if (conn->owner->connCount <= 1) return KSI_ASYNC_CONNECTION_CLOSED;
+
+	/* Only fail the requests that have been sent out over the closed connection. */
+	setResponseError(conn, KSI_ASYNC_CONNECTION_CLOSED);
+	return KSI_OK;
 }
 
-static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err, long ext, char *msg) {
+static void reqQueue_clearWithError(TcpConnection *conn, int err, long ext, char *msg) {
+	KSI_LIST(KSI_AsyncHandle) *reqQueue = conn->reqQueue;
 	size_t size = 0;
 
-	if (reqQueue == NULL) return;
+	if (reqQueue == NULL || KSI_AsyncHandleList_length(reqQueue) == 0) return;
+
+	/* Let the async client collect the failed requests on the next cache check. */
+	conn->owner->parent->nextSweep = 0;
 
 	while ((size = KSI_AsyncHandleList_length(reqQueue)) > 0) {
 		int res;
@@ -202,99 +291,78 @@ static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err
 	}
 }
 
-static int dispatch(TcpAsyncCtx *tcpCtx) {
+static long sendVector(TcpConnection *conn, KSI_SCK_IOVEC *iov, size_t count) {
+#ifdef _WIN32
+	DWORD c = 0;
+
+	if (WSASend(conn->sockfd, iov, (DWORD)count, &c, 0, NULL, NULL) == SOCKET_ERROR) return KSI_SCK_SOCKET_ERROR;
+	return (long)c;
+#else
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	return (long)sendmsg(conn->sockfd, &msg, KSI_SCK_SEND_FLAGS);
+#endif
+}
+
+static int handleEvents(TcpConnection *conn, short revents) {
 	int res = KSI_UNKNOWN_ERROR;
-	struct pollfd pfd;
+	TcpAsyncCtx *tcpCtx = NULL;
 	KSI_AsyncHandle *req = NULL;
-	KSI_OctetString *resp = NULL;
 	bool inputProcessed = true;
 
-	if (tcpCtx == NULL) {
+	if (conn == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
-	KSI_ERR_clearErrors(tcpCtx->ctx);
-
-	/* Check connection. */
-	if (tcpCtx->sockfd == KSI_INVALID_SOCKET) {
-		/* Only open connection if there is anything in request queue. */
-		if (KSI_AsyncHandleList_length(tcpCtx->reqQueue) == 0) {
-			KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP: not ready, request queue is empty.", tcpCtx);
-			res = KSI_OK;
-			goto cleanup;
-		}
-
-		res = openSocket(tcpCtx, &tcpCtx->sockfd);
-		if (res != KSI_OK) {
-			reqQueue_clearWithError(tcpCtx->reqQueue, res, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-			closeSocket(tcpCtx, __LINE__);
-			res = KSI_OK;
+	tcpCtx = conn->owner;
+
+	if (!conn->socketReady) {
+		/* Check if connection has been refused. */
+		if (revents & POLLHUP) {
+			KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP peer closed its end of the channel (POLLHUP).", conn);
+			reqQueue_clearWithError(conn, KSI_NETWORK_ERROR, 0, "Connection refused.");
+			res = closeConnection(conn, __LINE__);
 			goto cleanup;
 		}
-	}
 
-	pfd.fd = tcpCtx->sockfd;
-	pfd.events = POLLIN | POLLOUT;
-	pfd.revents = 0;
-
-	res = poll(&pfd, 1, 0);
-	switch (res) {
-		case 0:
-			if (!tcpCtx->socketReady &&
-						(tcpCtx->parent->options[KSI_ASYNC_OPT_CON_TIMEOUT] == 0 ||
-						(difftime(time(NULL), tcpCtx->connectedAt) > tcpCtx->parent->options[KSI_ASYNC_OPT_CON_TIMEOUT]))) {
-				closeSocket(tcpCtx, __LINE__);
-				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection timeout.", tcpCtx);
-				reqQueue_clearWithError(tcpCtx->reqQueue, KSI_NETWORK_CONNECTION_TIMEOUT, 0, NULL);
-				res = KSI_OK;
-			} else {
-				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection not ready.", tcpCtx);
-				res = KSI_OK;
-			}
-			goto cleanup;
-		case KSI_SCK_SOCKET_ERROR:
-			closeSocket(tcpCtx, __LINE__);
-			KSI_LOG_error(tcpCtx->ctx, "[%p] Async TCP failed to test socket. Error: %d (%s).", tcpCtx, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-			res = KSI_ASYNC_CONNECTION_CLOSED;
-			goto cleanup;
-		default:
-			if (!tcpCtx->socketReady) {
-				/* Check if connection has been refused. */
-				if (pfd.revents & POLLHUP) {
-					KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP peer closed its end of the channel (POLLHUP).", tcpCtx);
-					reqQueue_clearWithError(tcpCtx->reqQueue, KSI_NETWORK_ERROR, 0, "Connection refused.");
-					closeSocket(tcpCtx, __LINE__);
-					res = KSI_ASYNC_CONNECTION_CLOSED;
-					goto cleanup;
-				}
-
-				/* Connection has been established. */
-				tcpCtx->socketReady = true;
-				/* Inform listener about connection state change. */
-				res = connectionStateListener(tcpCtx, true);
-				if (res != KSI_OK) {
-					KSI_pushError(tcpCtx->ctx, res, "Connection state listener returned error.");
-					reqQueue_clearWithError(tcpCtx->reqQueue, res, 0, NULL);
-					closeSocket(tcpCtx, __LINE__);
-					goto cleanup;
-				}
+		/* Connection has been established. */
+		conn->socketReady = true;
+		/* Inform listener about connection state change. */
+		if (tcpCtx->connReady++ == 0) {
+			res = connectionStateListener(tcpCtx, true);
+			if (res != KSI_OK) {
+				KSI_pushError(tcpCtx->ctx, res, "Connection state listener returned error.");
+				reqQueue_clearWithError(conn, res, 0, NULL);
+				closeSocket(conn, __LINE__);
+				goto cleanup;
 			}
-			break;
+		}
 	}
 
 	/* Handle input. */
 	do {
-		if (pfd.revents & POLLIN) {
+		if (revents & POLLIN) {
 			inputProcessed = false;
-			if ((tcpCtx->inLen + KSI_TLV_MAX_SIZE) <= sizeof(tcpCtx->inBuf)) {
+
+			/* Make room for a large read. Only the unprocessed data is moved to the beginning of the buffer. */
+			if (sizeof(conn->inBuf) - conn->wrPos < KSI_TLV_MAX_SIZE && conn->rdPos > 0) {
+				memmove(conn->inBuf, conn->inBuf + conn->rdPos, conn->wrPos - conn->rdPos);
+				conn->frmPos -= conn->rdPos;
+				conn->wrPos -= conn->rdPos;
+				conn->rdPos = 0;
+			}
+
+			if (conn->wrPos < sizeof(conn->inBuf)) {
 				int c = 0;
-				/* Read data from socket. */
-				c = recv(tcpCtx->sockfd, (tcpCtx->inBuf + tcpCtx->inLen), KSI_TLV_MAX_SIZE, 0);
+				/* Read as much data from socket as fits into the buffer. */
+				c = recv(conn->sockfd, (conn->inBuf + conn->wrPos), sizeof(conn->inBuf) - conn->wrPos, 0);
 				if (c == 0) {
 					/* Connection has been closed unexpectedly. */
-					KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection closed.", tcpCtx);
-					closeSocket(tcpCtx, __LINE__);
-					res = KSI_ASYNC_CONNECTION_CLOSED;
+					KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection closed.", conn);
+					res = closeConnection(conn, __LINE__);
 					goto cleanup;
 				} else if (c == KSI_SCK_SOCKET_ERROR) {
 					if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
@@ -303,40 +371,35 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 					} else {
 						/* Non-recoverable error has occurred. */
 						KSI_LOG_error(tcpCtx->ctx,
-									  "[%p] Async TCP closing connection. Unrecoverable error has occured: %d (%s).", tcpCtx,
+									  "[%p] Async TCP closing connection. Unrecoverable error has occured: %d (%s).", conn,
 									  KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-						closeSocket(tcpCtx, __LINE__);
-						res = KSI_ASYNC_CONNECTION_CLOSED;
+						res = closeConnection(conn, __LINE__);
 						goto cleanup;
 					}
 				} else {
-					tcpCtx->inLen += c;
-					if (tcpCtx->inLen > sizeof(tcpCtx->inBuf)) {
-						KSI_pushError(tcpCtx->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
-						goto cleanup;
-					}
+					conn->wrPos += c;
 				}
 			} else {
 				inputProcessed = true;
-				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP input stream would not fit into buffer.", tcpCtx);
+				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP input stream would not fit into buffer.", conn);
 			}
 		}
 
-		/* Handle read buffer. */
-		while (tcpCtx->inLen > 0) {
+		/* Mark all of the complete PDUs in the read buffer. The PDUs are parsed directly from the buffer. */
+		while (conn->frmPos < conn->wrPos) {
 			KSI_FTLV ftlv;
 			size_t count = 0;
 
 			/* Traverse through the input stream and verify that a complete TLV is present. */
 			memset(&ftlv, 0, sizeof(KSI_FTLV));
-			res = KSI_FTLV_memRead(tcpCtx->inBuf, tcpCtx->inLen, &ftlv);
+			res = KSI_FTLV_memRead(conn->inBuf + conn->frmPos, conn->wrPos - conn->frmPos, &ftlv);
 			count = ftlv.hdr_len + ftlv.dat_len;
 			/* Verify if the input byte stream is long enought for extacting a PDU. */
-			if (count != 0 && tcpCtx->inLen >= count) {
+			if (count != 0 && conn->wrPos - conn->frmPos >= count) {
 				if (res != KSI_OK) {
-					KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_ERROR, "[%p] Async TCP closing connection. Unable to extract TLV from input stream", tcpCtx->inBuf, tcpCtx->inLen, tcpCtx);
-					closeSocket(tcpCtx, __LINE__);
-					res = KSI_ASYNC_CONNECTION_CLOSED;
+					KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_ERROR, "[%p] Async TCP closing connection. Unable to extract TLV from input stream",
+							conn->inBuf + conn->frmPos, conn->wrPos - conn->frmPos, conn);
+					res = closeConnection(conn, __LINE__);
 					goto cleanup;
 				}
 			} else {
@@ -344,44 +407,30 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 				break;
 			}
 
-			if (count > UINT_MAX){
-				KSI_pushError(tcpCtx->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
-				goto cleanup;
-			}
-
-			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "[%p] Async TCP received response", tcpCtx->inBuf, count, tcpCtx);
-
-			/* A complete PDU is in cache. Move it into the receive queue. */
-			res = KSI_OctetString_new(tcpCtx->ctx, tcpCtx->inBuf, count, &resp);
-			if (res != KSI_OK) {
-				KSI_LOG_error(tcpCtx->ctx, "[%p] Async TCP unable to create new KSI_OctetString object. Error: 0x%x.", tcpCtx, res);
-				res = KSI_OK;
-				goto cleanup;
-			}
-
-			res = KSI_OctetStringList_append(tcpCtx->respQueue, resp);
-			if (res != KSI_OK) {
-				KSI_LOG_error(tcpCtx->ctx, "[%p] Async TCP unable to add new response to queue. Error: 0x%x.", tcpCtx, res);
-				res = KSI_OK;
-				goto cleanup;
-			}
-			resp = NULL;
+			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "[%p] Async TCP received response", conn->inBuf + conn->frmPos, count, conn);
 
-			/* The response has been successfully moved to the input queue. Remove the data from the input stream. */
-			tcpCtx->inLen -= count;
-			memmove(tcpCtx->inBuf, tcpCtx->inBuf + count, tcpCtx->inLen);
+			conn->frmPos += count;
+			conn->frmCount++;
+			/* Server pushed configurations are not requested, thus the count is only an estimate for load balancing. */
+			if (conn->outstanding > 0) conn->outstanding--;
 		}
 	} while (!inputProcessed);
 
 	/* Handle output. */
-	if (!(pfd.revents & POLLOUT)) {
-		KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP output buffer not ready.", tcpCtx);
+	if (!(revents & POLLOUT)) {
+		KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP output buffer not ready.", conn);
 		res = KSI_OK;
 		goto cleanup;
 	}
-	while (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0 &&
-			KSI_AsyncHandleList_elementAt(tcpCtx->reqQueue, 0, &req) == KSI_OK && req != NULL) {
+	while (KSI_AsyncHandleList_length(conn->reqQueue) > 0) {
+		KSI_SCK_IOVEC iov[KSI_TCP_SEND_IOV_MAX];
+		size_t iovCount = 0;
+		size_t iovBytes = 0;
+		size_t sendLimit = tcpCtx->parent->options[KSI_ASYNC_PRIVOPT_SEND_LIMIT];
+		size_t i;
+		long c;
 		time_t curTime = 0;
+		uint64_t now = 0;
 
 		/* Check if the request count can be restarted. */
 		if (difftime(time(&curTime), tcpCtx->roundStartAt) >= tcpCtx->parent->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]) {
@@ -389,62 +438,108 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 			tcpCtx->roundCount = 0;
 			tcpCtx->roundStartAt = curTime;
 		}
-		/* Check if more requests can be sent within the given timeframe. */
-		if (!(tcpCtx->roundCount < tcpCtx->parent->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT])) {
-			KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP round max request count reached.", tcpCtx);
-			break;
-		}
 
-		if (req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
-			/* The state could have been changed in application layer. Just remove the request from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
-			continue;
-		}
+		/* Collect the pending requests from the head of the request queue into a single vectored send. */
+		while (iovCount < KSI_TCP_SEND_IOV_MAX && iovCount < KSI_AsyncHandleList_length(conn->reqQueue) &&
+				(sendLimit == 0 || iovBytes < sendLimit)) {
+			size_t chunk = 0;
 
-		/* Verify that the send timeout has not elapsed. */
-		if (tcpCtx->parent->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
-			(difftime(curTime, req->reqTime) > tcpCtx->parent->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
-			/* Set error. */
-			req->state = KSI_ASYNC_STATE_ERROR;
-			req->err = KSI_NETWORK_SEND_TIMEOUT;
-			/* Just remove the request from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
-			continue;
-		}
+			req = NULL;
+			if (KSI_AsyncHandleList_elementAt(conn->reqQueue, iovCount, &req) != KSI_OK || req == NULL) break;
 
-		KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "[%p] Async TCP: sending request.", req->raw, req->len, tcpCtx);
+			/* Check if more requests can be sent within the given timeframe. */
+			if (!(tcpCtx->roundCount + iovCount < tcpCtx->parent->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT])) {
+				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP round max request count reached.", tcpCtx);
+				break;
+			}
 
-		while (req->sentCount < req->len) {
-			int c;
-#ifdef _WIN32
-			if (req->len - req->sentCount > INT_MAX) {
-				c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, (int) (INT_MAX), 0);
-			} else {
-				c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, (int) (req->len - req->sentCount), 0);
+			/* A partially sent request has to be completed unless it has timed out. */
+			if (req->sentCount == 0 && req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
+				/* The state could have been changed in application layer. Just remove the request from the request queue. */
+				KSI_AsyncHandleList_remove(conn->reqQueue, iovCount, NULL);
+				continue;
 			}
-#else
-			c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, req->len - req->sentCount, 0);
-#endif
-			if (c == KSI_SCK_SOCKET_ERROR) {
-				if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
-					KSI_LOG_info(tcpCtx->ctx,
-							"[%p] Async TCP send would block. Bytes sent so far %d/%d. Error: %d (%s).", tcpCtx,
-							(unsigned)req->sentCount, (unsigned)req->len, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-					goto cleanup;
-				} else {
-					KSI_LOG_error(tcpCtx->ctx,
-							"[%p] Async TCP closing connection. Unable to write to socket. Error: %d (%s).", tcpCtx,
-							KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-					closeSocket(tcpCtx, __LINE__);
-					res = KSI_ASYNC_CONNECTION_CLOSED;
+
+			/* Verify that the send timeout has not elapsed. */
+			if (tcpCtx->parent->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
+				(difftime(curTime, req->reqTime) > tcpCtx->parent->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
+				bool partial = (req->sentCount > 0);
+
+				/* Set error. */
+				req->state = KSI_ASYNC_STATE_ERROR;
+				req->err = KSI_NETWORK_SEND_TIMEOUT;
+				tcpCtx->parent->nextSweep = 0;
+				/* Just remove the request from the request queue. */
+				KSI_AsyncHandleList_remove(conn->reqQueue, iovCount, NULL);
+
+				/* The rest of the stream would be corrupted by the incomplete request, thus start over. */
+				if (partial) {
+					KSI_LOG_info(tcpCtx->ctx, "[%p] Async TCP closing connection. Partially sent request timed out.", conn);
+					res = closeConnection(conn, __LINE__);
 					goto cleanup;
 				}
+				continue;
 			}
-			req->sentCount += c;
+
+			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "[%p] Async TCP: sending request.", req->raw, req->len, conn);
+
+			/* Reference the serialized request directly. */
+			chunk = req->len - req->sentCount;
+			if (sendLimit > 0 && chunk > sendLimit - iovBytes) chunk = sendLimit - iovBytes;
+			KSI_SCK_IOVEC_SET(iov[iovCount], req->raw + req->sentCount, chunk);
+			iovBytes += chunk;
+			iovCount++;
 		}
+		if (iovCount == 0) break;
+
+		c = sendVector(conn, iov, iovCount);
+		if (c == KSI_SCK_SOCKET_ERROR) {
+			if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
+				KSI_LOG_info(tcpCtx->ctx,
+						"[%p] Async TCP send would block. Error: %d (%s).", conn,
+						KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+				res = KSI_OK;
+				goto cleanup;
+			} else {
+				KSI_LOG_error(tcpCtx->ctx,
+						"[%p] Async TCP closing connection. Unable to write to socket. Error: %d (%s).", conn,
+						KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+				res = closeConnection(conn, __LINE__);
+				goto cleanup;
+			}
+		}
+
+		now = KSI_getMonotonicTimeMs();
+		tcpCtx->parent->stats.bytesOut += (KSI_uint64_t)c;
+
+		/* Account the sent bytes to the requests in the order of the vector. */
+		for (i = 0; i < iovCount; i++) {
+			size_t left = 0;
+
+			req = NULL;
+			if (KSI_AsyncHandleList_elementAt(conn->reqQueue, 0, &req) != KSI_OK || req == NULL) break;
+
+			/* The first bytes of the request have been written. */
+			if (req->sentCount == 0 && c > 0) {
+				req->sndTimeMs = now;
+				KSI_AsyncStatistics_addSample(tcpCtx->parent->stats.queueTime, now - req->reqTimeMs);
+			}
+
+			left = req->len - req->sentCount;
+			if ((size_t)c < left) {
+				req->sentCount += (size_t)c;
+				KSI_LOG_info(tcpCtx->ctx,
+						"[%p] Async TCP send would block. Bytes sent so far %d/%d.", conn,
+						(unsigned)req->sentCount, (unsigned)req->len);
+				res = KSI_OK;
+				goto cleanup;
+			}
+			c -= (long)left;
 
-		if (req->sentCount == req->len) {
 			tcpCtx->roundCount++;
+			conn->outstanding++;
+			tcpCtx->parent->stats.sent++;
+			KSI_AsyncStatistics_addSample(tcpCtx->parent->stats.sendTime, now - req->sndTimeMs);
 
 			/* Release the serialized payload. */
 			KSI_free(req->raw);
@@ -456,26 +551,321 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 			req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
 			/* Start receive timeout. */
 			req->sndTime = curTime;
+			/* Remember the connection the response is expected from. */
+			req->connId = (size_t)conn;
 			/* The request has been successfully dispatched. Remove it from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+			KSI_AsyncHandleList_remove(conn->reqQueue, 0, NULL);
+		}
+
+		/* The round limit has been reached. */
+		if (iovCount < KSI_TCP_SEND_IOV_MAX && iovCount < KSI_AsyncHandleList_length(conn->reqQueue)) break;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int dispatchConnection(TcpConnection *conn) {
+	int res = KSI_UNKNOWN_ERROR;
+	TcpAsyncCtx *tcpCtx = conn->owner;
+	struct pollfd pfd;
+
+	/* Check connection. */
+	if (conn->sockfd == KSI_INVALID_SOCKET) {
+		/* Only open connection if there is anything in request queue. */
+		if (KSI_AsyncHandleList_length(conn->reqQueue) == 0) {
+			KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP: not ready, request queue is empty.", conn);
+			res = KSI_OK;
+			goto cleanup;
+		}
+
+		res = openSocket(conn, &conn->sockfd);
+		if (res != KSI_OK) {
+			reqQueue_clearWithError(conn, res, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+			closeSocket(conn, __LINE__);
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	pfd.fd = conn->sockfd;
+	pfd.events = POLLIN | POLLOUT;
+	pfd.revents = 0;
+
+	res = poll(&pfd, 1, 0);
+	switch (res) {
+		case 0:
+			if (!conn->socketReady &&
+						(tcpCtx->parent->options[KSI_ASYNC_OPT_CON_TIMEOUT] == 0 ||
+						(difftime(time(NULL), conn->connectedAt) > tcpCtx->parent->options[KSI_ASYNC_OPT_CON_TIMEOUT]))) {
+				closeSocket(conn, __LINE__);
+				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection timeout.", conn);
+				reqQueue_clearWithError(conn, KSI_NETWORK_CONNECTION_TIMEOUT, 0, NULL);
+				res = KSI_OK;
+			} else {
+				KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection not ready.", conn);
+				res = KSI_OK;
+			}
+			goto cleanup;
+		case KSI_SCK_SOCKET_ERROR:
+			KSI_LOG_error(tcpCtx->ctx, "[%p] Async TCP failed to test socket. Error: %d (%s).", conn, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+			res = closeConnection(conn, __LINE__);
+			goto cleanup;
+		default:
+			res = handleEvents(conn, pfd.revents);
+			goto cleanup;
+	}
+
+cleanup:
+	return res;
+}
+
+static int dispatch(TcpAsyncCtx *tcpCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+
+	if (tcpCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(tcpCtx->ctx);
+
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		res = dispatchConnection(tcpCtx->conn[i]);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static bool isRoundLimitReached(TcpAsyncCtx *tcpCtx) {
+	return (tcpCtx->roundCount >= tcpCtx->parent->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT] &&
+			difftime(time(NULL), tcpCtx->roundStartAt) < tcpCtx->parent->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]);
+}
+
+static int getSockets(TcpAsyncCtx *tcpCtx, KSI_AsyncSocket *sockets, size_t size, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+	size_t n = 0;
+
+	if (tcpCtx == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpConnection *conn = tcpCtx->conn[i];
+		int events = KSI_ASYNC_SOCKET_EVENT_READ;
+
+		if (conn->sockfd == KSI_INVALID_SOCKET) continue;
+
+		/* Wait for the connection to be established or for the output buffer to be ready for pending requests. */
+		if (!conn->socketReady ||
+				(KSI_AsyncHandleList_length(conn->reqQueue) > 0 && !isRoundLimitReached(tcpCtx))) {
+			events |= KSI_ASYNC_SOCKET_EVENT_WRITE;
+		}
+
+		if (n < size) {
+			sockets[n].fd = conn->sockfd;
+			sockets[n].events = events;
+		}
+		n++;
+	}
+	*count = n;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getTimeout(TcpAsyncCtx *tcpCtx, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	long tmp = -1;
+	size_t i;
+
+	if (tcpCtx == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpConnection *conn = tcpCtx->conn[i];
+		long connTimeout = -1;
+
+		if (conn->sockfd == KSI_INVALID_SOCKET) {
+			/* The connection is opened on the next dispatch. */
+			if (KSI_AsyncHandleList_length(conn->reqQueue) > 0) connTimeout = 0;
+		} else if (!conn->socketReady) {
+			/* Wake up when the connect timeout elapses. */
+			double left = tcpCtx->parent->options[KSI_ASYNC_OPT_CON_TIMEOUT] - difftime(time(NULL), conn->connectedAt);
+			connTimeout = (left > 0) ? (long)(left * 1000) : 0;
+		} else if (KSI_AsyncHandleList_length(conn->reqQueue) > 0 && isRoundLimitReached(tcpCtx)) {
+			/* Wake up when the next round is started. */
+			double left = tcpCtx->parent->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION] - difftime(time(NULL), tcpCtx->roundStartAt);
+			connTimeout = (left > 0) ? (long)(left * 1000) : 0;
 		}
+
+		tmp = KSI_ASYNC_TIMEOUT_MIN(tmp, connTimeout);
 	}
+	*timeout = tmp;
 
 	res = KSI_OK;
 cleanup:
-	KSI_OctetString_free(resp);
 	return res;
 }
 
+static int socketReady(TcpAsyncCtx *tcpCtx, int fd, int events) {
+	TcpConnection *conn = NULL;
+	short revents = 0;
+	size_t i;
+
+	if (tcpCtx == NULL) return KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(tcpCtx->ctx);
+
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		if (tcpCtx->conn[i]->sockfd != KSI_INVALID_SOCKET && tcpCtx->conn[i]->sockfd == fd) {
+			conn = tcpCtx->conn[i];
+			break;
+		}
+	}
+	/* Ignore events of unknown sockets. */
+	if (conn == NULL) return KSI_OK;
+
+	if (events & KSI_ASYNC_SOCKET_EVENT_READ) revents |= POLLIN;
+	if (events & KSI_ASYNC_SOCKET_EVENT_WRITE) revents |= POLLOUT;
+	/* Read out the pending data and the error condition. */
+	if (events & KSI_ASYNC_SOCKET_EVENT_ERROR) revents |= POLLHUP | POLLIN;
+	if (revents == 0) return KSI_OK;
+
+	return handleEvents(conn, revents);
+}
+
+static void TcpConnection_free(TcpConnection *t) {
+	if (t != NULL) {
+		KSI_AsyncHandleList_free(t->reqQueue);
+		if (t->sockfd != KSI_INVALID_SOCKET) close(t->sockfd);
+		KSI_free(t);
+	}
+}
+
+static int TcpConnection_new(TcpAsyncCtx *owner, TcpConnection **conn) {
+	int res = KSI_UNKNOWN_ERROR;
+	TcpConnection *tmp = NULL;
+
+	tmp = KSI_malloc(sizeof(TcpConnection));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	tmp->owner = owner;
+	tmp->sockfd = KSI_INVALID_SOCKET;
+	tmp->reqQueue = NULL;
+	tmp->rdPos = 0;
+	tmp->frmPos = 0;
+	tmp->wrPos = 0;
+	tmp->frmCount = 0;
+	tmp->connectedAt = 0;
+	tmp->socketReady = false;
+	tmp->outstanding = 0;
+
+	res = KSI_AsyncHandleList_new(&tmp->reqQueue);
+	if (res != KSI_OK) goto cleanup;
+
+	*conn = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	TcpConnection_free(tmp);
+	return res;
+}
+
+static int growConnectionPool(TcpAsyncCtx *tcpCtx, size_t count) {
+	int res = KSI_UNKNOWN_ERROR;
+	TcpConnection **tmp = NULL;
+	size_t i;
+
+	if (count <= tcpCtx->connCount) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	tmp = KSI_calloc(count, sizeof(TcpConnection *));
+	if (tmp == NULL) {
+		KSI_pushError(tcpCtx->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		tmp[i] = tcpCtx->conn[i];
+	}
+	KSI_free(tcpCtx->conn);
+	tcpCtx->conn = tmp;
+	tmp = NULL;
+
+	/* The connections are opened on demand. */
+	for (; tcpCtx->connCount < count; tcpCtx->connCount++) {
+		res = TcpConnection_new(tcpCtx, &tcpCtx->conn[tcpCtx->connCount]);
+		if (res != KSI_OK) {
+			KSI_pushError(tcpCtx->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+	KSI_LOG_debug(tcpCtx->ctx, "[%p] Async TCP connection pool size: %llu.", tcpCtx, (unsigned long long)tcpCtx->connCount);
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(tmp);
+	return res;
+}
+
+static TcpConnection *selectConnection(TcpAsyncCtx *tcpCtx, size_t count) {
+	TcpConnection *best = NULL;
+	size_t bestIdx = 0;
+	size_t bestLoad = 0;
+	size_t i;
+
+	if (count > tcpCtx->connCount) count = tcpCtx->connCount;
+
+	/* Pick the least loaded connection. Equally loaded connections are used in round-robin order. */
+	for (i = 1; i <= count; i++) {
+		size_t idx = (tcpCtx->connLast + i) % count;
+		TcpConnection *conn = tcpCtx->conn[idx];
+		size_t load = KSI_AsyncHandleList_length(conn->reqQueue) + conn->outstanding;
+
+		if (best == NULL || load < bestLoad) {
+			best = conn;
+			bestIdx = idx;
+			bestLoad = load;
+		}
+	}
+	if (best != NULL) tcpCtx->connLast = bestIdx;
+	return best;
+}
+
 static int addToSendQueue(TcpAsyncCtx *tcpCtx, KSI_AsyncHandle *request) {
 	int res = KSI_UNKNOWN_ERROR;
+	TcpConnection *conn = NULL;
+	size_t count = 0;
 
-	if (tcpCtx == NULL || tcpCtx->reqQueue == NULL || request == NULL) {
+	if (tcpCtx == NULL || request == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	res = KSI_AsyncHandleList_append(tcpCtx->reqQueue, request);
+	count = tcpCtx->parent->options[KSI_ASYNC_OPT_CONNECTION_COUNT];
+	res = growConnectionPool(tcpCtx, count);
+	if (res != KSI_OK) goto cleanup;
+
+	conn = selectConnection(tcpCtx, count);
+	if (conn == NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	res = KSI_AsyncHandleList_append(conn->reqQueue, request);
 	if (res != KSI_OK) goto cleanup;
 
 	request->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
@@ -487,23 +877,48 @@ cleanup:
 	return res;
 }
 
-static int getResponse(TcpAsyncCtx *tcpCtx, KSI_OctetString **response, size_t *left) {
+static int getResponseRaw(TcpAsyncCtx *tcpCtx, const unsigned char **raw, size_t *len, size_t *left) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_OctetString *tmp = NULL;
+	const unsigned char *tmp = NULL;
+	size_t tmpLen = 0;
+	size_t count = 0;
+	size_t i;
 
-	if (tcpCtx == NULL || tcpCtx->respQueue == NULL || response == NULL || left == NULL) {
+	if (tcpCtx == NULL || raw == NULL || len == NULL || left == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	if (KSI_OctetStringList_length(tcpCtx->respQueue)) {
-		/* Responses should be processed in the same order as received. */
-		res = KSI_OctetStringList_remove(tcpCtx->respQueue, 0, &tmp);
-		if (res != KSI_OK) goto cleanup;
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpConnection *conn = tcpCtx->conn[i];
+
+		if (conn->frmCount == 0) continue;
+
+		if (tmp == NULL) {
+			KSI_FTLV ftlv;
+
+			/* Responses of a connection should be processed in the same order as received. */
+			res = KSI_FTLV_memRead(conn->inBuf + conn->rdPos, conn->frmPos - conn->rdPos, &ftlv);
+			if (res != KSI_OK) goto cleanup;
+
+			tmp = conn->inBuf + conn->rdPos;
+			tmpLen = ftlv.hdr_len + ftlv.dat_len;
+
+			conn->rdPos += tmpLen;
+			conn->frmCount--;
+			/* The buffer is not overwritten until the next read, thus it can be rewound right away. */
+			if (conn->rdPos == conn->wrPos) {
+				conn->rdPos = 0;
+				conn->frmPos = 0;
+				conn->wrPos = 0;
+			}
+		}
+		count += conn->frmCount;
 	}
 
-	*response = tmp;
-	*left = KSI_OctetStringList_length(tcpCtx->respQueue);
+	*raw = tmp;
+	*len = tmpLen;
+	*left = count;
 
 	res = KSI_OK;
 cleanup:
@@ -547,10 +962,12 @@ static int getCredentials(TcpAsyncCtx *tcpCtx, const char **user, const char **p
 
 static void TcpAsyncCtx_free(TcpAsyncCtx *t) {
 	if (t != NULL) {
-		KSI_AsyncHandleList_free(t->reqQueue);
-		KSI_OctetStringList_free(t->respQueue);
+		size_t i;
 
-		if (t->sockfd != KSI_INVALID_SOCKET) close(t->sockfd);
+		for (i = 0; i < t->connCount; i++) {
+			TcpConnection_free(t->conn[i]);
+		}
+		KSI_free(t->conn);
 
 		KSI_free(t->host);
 		KSI_free(t->ksi_user);
@@ -575,31 +992,21 @@ static int TcpAsyncCtx_new(KSI_CTX *ctx, TcpAsyncCtx **tcpCtx) {
 		goto cleanup;
 	}
 	tmp->ctx = ctx;
-	tmp->sockfd = KSI_INVALID_SOCKET;
-
-	tmp->reqQueue = NULL;
-	tmp->respQueue = NULL;
-
-	tmp->inLen = 0;
+	tmp->conn = NULL;
+	tmp->connCount = 0;
+	tmp->connLast = 0;
+	tmp->connReady = 0;
 
 	tmp->ksi_user = NULL;
 	tmp->ksi_pass = NULL;
 	tmp->host = NULL;
 	tmp->port = 0;
 
-	tmp->socketReady = false;
-	tmp->connectedAt = 0;
 	tmp->roundStartAt = 0;
 	tmp->roundCount = 0;
 
 	tmp->parent = NULL;
 
-	/* Initialize io queues. */
-	res = KSI_AsyncHandleList_new(&tmp->reqQueue);
-	if (res != KSI_OK) goto cleanup;
-	res = KSI_OctetStringList_new(&tmp->respQueue);
-	if (res != KSI_OK) goto cleanup;
-
 	*tcpCtx = tmp;
 	tmp = NULL;
 
@@ -623,8 +1030,11 @@ int KSI_TcpAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	if (res != KSI_OK) goto cleanup;
 
 	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))addToSendQueue;
-	tmp->getResponse = (int (*)(void *, KSI_OctetString **, size_t *))getResponse;
+	tmp->getResponseRaw = (int (*)(void *, const unsigned char **, size_t *, size_t *))getResponseRaw;
 	tmp->dispatch = (int (*)(void *))dispatch;
+	tmp->getSockets = (int (*)(void *, KSI_AsyncSocket *, size_t, size_t *))getSockets;
+	tmp->getTimeout = (int (*)(void *, long *))getTimeout;
+	tmp->socketReady = (int (*)(void *, int, int))socketReady;
 	tmp->getCredentials = (int (*)(void *, const char **, const char **))getCredentials;
 
 
@@ -42,6 +42,7 @@ KSI_IMPORT_TLV_TEMPLATE(KSI_PublicationRecord);
 KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationAuthRec);
 KSI_IMPORT_TLV_TEMPLATE(KSI_CalendarAuthRec);
 KSI_IMPORT_TLV_TEMPLATE(KSI_RFC3161);
+KSI_IMPORT_TLV_TEMPLATE(KSI_CalendarHashChain);
 
 KSI_IMPLEMENT_REF(KSI_Signature);
 
@@ -324,6 +325,66 @@ cleanup:
 	return res;
 }
 
+/* Decodes the signature directly from the serialized bytes, the base TLV is kept unexpanded. */
+static int parseSignature(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_Signature **signature) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureBuilder *builder = NULL;
+	KSI_TLV *tlv = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || raw_len == 0 || signature == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_parseBlob(ctx, raw, raw_len, &tlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (KSI_TLV_getTag(tlv) != 0x800) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Uni-Signature element is missing.");
+		goto cleanup;
+	}
+
+	/* Create a new signature builder object. */
+	res = KSI_SignatureBuilder_open(ctx, &builder);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Parse and extract the signature. */
+	res = KSI_TlvTemplate_parse(ctx, raw, raw_len, KSI_TLV_TEMPLATE(KSI_Signature), builder->sig);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	builder->sig->baseTlv = tlv;
+	tlv = NULL;
+
+	/* Turn off the verification. */
+	builder->noVerify = 1;
+	res = KSI_SignatureBuilder_close(builder, 0, signature);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	KSI_LOG_debug(ctx, "Finished parsing successfully.");
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TLV_free(tlv);
+	KSI_SignatureBuilder_free(builder);
+
+	return res;
+}
+
 /***************
  * SIGN REQUEST
  ***************/
@@ -1040,7 +1101,6 @@ cleanup:
 }
 
 int KSI_Signature_parseWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_Policy *policy, KSI_VerificationContext *context, KSI_Signature **sig) {
-	KSI_TLV *tlv = NULL;
 	KSI_Signature *tmp = NULL;
 	int res;
 
@@ -1050,19 +1110,211 @@ int KSI_Signature_parseWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t
 		goto cleanup;
 	}
 
-	res = KSI_TLV_parseBlob(ctx, raw, raw_len, &tlv);
+	res = parseSignature(ctx, raw, raw_len, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	res = extractSignature(ctx, tlv, &tmp);
+	res = KSI_Signature_verifyWithPolicy(tmp, NULL, 0, policy, context);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_Signature_verifyWithPolicy(tmp, NULL, 0, policy, context);
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Signature_free(tmp);
+
+	return res;
+}
+
+
+/*****************
+ * LAZY SIGNATURE
+ *****************/
+
+/* Finds the first nested element with the given tag from the TLV payload. */
+static int lazy_findChild(const unsigned char *buf, size_t buf_len, unsigned tag, const unsigned char **val, size_t *val_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	size_t off = 0;
+
+	*val = NULL;
+	*val_len = 0;
+
+	while (off < buf_len) {
+		res = KSI_FTLV_memRead(buf + off, buf_len - off, &ftlv);
+		if (res != KSI_OK) goto cleanup;
+
+		if (ftlv.tag == tag) {
+			*val = buf + off + ftlv.hdr_len;
+			*val_len = ftlv.dat_len;
+			break;
+		}
+
+		off += ftlv.hdr_len + ftlv.dat_len;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int lazy_countChildren(const unsigned char *buf, size_t buf_len, unsigned tag, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	size_t off = 0;
+	size_t n = 0;
+
+	while (off < buf_len) {
+		res = KSI_FTLV_memRead(buf + off, buf_len - off, &ftlv);
+		if (res != KSI_OK) goto cleanup;
+
+		if (ftlv.tag == tag) n++;
+
+		off += ftlv.hdr_len + ftlv.dat_len;
+	}
+
+	*count = n;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int lazy_decodeInteger(KSI_CTX *ctx, const unsigned char *buf, size_t buf_len, KSI_Integer **value) {
+	KSI_uint64_t val = 0;
+	size_t i;
+
+	if (buf_len > 8) return KSI_INVALID_FORMAT;
+
+	for (i = 0; i < buf_len; i++) {
+		val = (val << 8) | buf[i];
+	}
+
+	return KSI_Integer_new(ctx, val, value);
+}
+
+/* Returns the first (or only) element with the given tag. */
+static const KSI_FTLV *lazy_getComponent(const KSI_LazySignature *sig, unsigned tag) {
+	size_t i;
+
+	for (i = 0; i < sig->index_len; i++) {
+		if (sig->index[i].tag == tag) return &sig->index[i];
+	}
+
+	return NULL;
+}
+
+/* Returns the aggregation hash chain closest to the document - the one with the longest chain index. */
+static int lazy_getFirstAggregationChain(const KSI_LazySignature *sig, const KSI_FTLV **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_FTLV *tmp = NULL;
+	size_t maxIndex = 0;
+	size_t i;
+
+	for (i = 0; i < sig->index_len; i++) {
+		const KSI_FTLV *el = &sig->index[i];
+		size_t count = 0;
+
+		if (el->tag != 0x0801) continue;
+
+		res = lazy_countChildren(sig->payload + el->off + el->hdr_len, el->dat_len, 0x03, &count);
+		if (res != KSI_OK) goto cleanup;
+
+		if (tmp == NULL || count > maxIndex) {
+			tmp = el;
+			maxIndex = count;
+		}
+	}
+
+	if (tmp == NULL) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	*chain = tmp;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_LazySignature_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_LazySignature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_LazySignature *tmp = NULL;
+	KSI_FTLV ftlv;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || raw_len == 0 || sig == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FTLV_memRead(raw, raw_len, &ftlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, "Unable to read signature header.");
+		goto cleanup;
+	}
+
+	if (ftlv.tag != 0x800) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Uni-Signature element is missing.");
+		goto cleanup;
+	}
+
+	if (ftlv.hdr_len + ftlv.dat_len != raw_len) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Unexpected data after the signature.");
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_LazySignature);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->raw = raw;
+	tmp->raw_len = raw_len;
+	tmp->payload = raw + ftlv.hdr_len;
+	tmp->index = NULL;
+	tmp->index_len = 0;
+	tmp->signingTime = NULL;
+	tmp->documentHash = NULL;
+	tmp->calendarChain = NULL;
+	tmp->signature = NULL;
+
+	if (ftlv.dat_len == 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Empty signature.");
+		goto cleanup;
+	}
+
+	/* Count the components, then index them. */
+	res = KSI_FTLV_memReadN(tmp->payload, ftlv.dat_len, NULL, 0, &tmp->index_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->index = KSI_calloc(tmp->index_len, sizeof(KSI_FTLV));
+	if (tmp->index == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FTLV_memReadN(tmp->payload, ftlv.dat_len, tmp->index, tmp->index_len, NULL);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -1075,12 +1327,197 @@ int KSI_Signature_parseWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t
 
 cleanup:
 
+	KSI_LazySignature_free(tmp);
+
+	return res;
+}
+
+int KSI_LazySignature_getCalendarChain(KSI_LazySignature *sig, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_FTLV *el = NULL;
+	KSI_TLV *tlv = NULL;
+	KSI_CalendarHashChain *tmp = NULL;
+
+	if (sig == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->calendarChain == NULL && (el = lazy_getComponent(sig, 0x0802)) != NULL) {
+		/* The TLV does not own nor modify the memory, it is released right after the extraction. */
+		res = KSI_TLV_parseBlob2(sig->ctx, (unsigned char *)sig->payload + el->off, el->hdr_len + el->dat_len, 0, &tlv);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_CalendarHashChain_new(sig->ctx, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_TlvTemplate_extract(sig->ctx, tmp, tlv, KSI_TLV_TEMPLATE(KSI_CalendarHashChain));
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		sig->calendarChain = tmp;
+		tmp = NULL;
+	}
+
+	*chain = sig->calendarChain;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(tmp);
 	KSI_TLV_free(tlv);
-	KSI_Signature_free(tmp);
 
 	return res;
 }
 
+int KSI_LazySignature_getSigningTime(KSI_LazySignature *sig, KSI_Integer **signTime) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_FTLV *el = NULL;
+	const unsigned char *val = NULL;
+	size_t val_len = 0;
+
+	if (sig == NULL || signTime == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->signingTime == NULL) {
+		el = lazy_getComponent(sig, 0x0802);
+		if (el != NULL) {
+			/* Aggregation time is optional, default to publication time. */
+			res = lazy_findChild(sig->payload + el->off + el->hdr_len, el->dat_len, 0x02, &val, &val_len);
+			if (res == KSI_OK && val == NULL) {
+				res = lazy_findChild(sig->payload + el->off + el->hdr_len, el->dat_len, 0x01, &val, &val_len);
+			}
+		} else {
+			res = lazy_getFirstAggregationChain(sig, &el);
+			if (res == KSI_OK) {
+				res = lazy_findChild(sig->payload + el->off + el->hdr_len, el->dat_len, 0x02, &val, &val_len);
+			}
+		}
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (val == NULL) {
+			KSI_pushError(sig->ctx, res = KSI_INVALID_FORMAT, "Signing time is missing.");
+			goto cleanup;
+		}
+
+		res = lazy_decodeInteger(sig->ctx, val, val_len, &sig->signingTime);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*signTime = sig->signingTime;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_LazySignature_getDocumentHash(KSI_LazySignature *sig, KSI_DataHash **hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_FTLV *el = NULL;
+	const unsigned char *val = NULL;
+	size_t val_len = 0;
+
+	if (sig == NULL || hsh == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->documentHash == NULL) {
+		/* The legacy RFC3161 record precedes the aggregation hash chains. */
+		el = lazy_getComponent(sig, 0x0806);
+		if (el == NULL) {
+			res = lazy_getFirstAggregationChain(sig, &el);
+			if (res != KSI_OK) {
+				KSI_pushError(sig->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		res = lazy_findChild(sig->payload + el->off + el->hdr_len, el->dat_len, 0x05, &val, &val_len);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (val == NULL) {
+			KSI_pushError(sig->ctx, res = KSI_INVALID_FORMAT, "Input hash is missing.");
+			goto cleanup;
+		}
+
+		res = KSI_DataHash_fromImprint(sig->ctx, val, val_len, &sig->documentHash);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*hsh = sig->documentHash;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_LazySignature_getSignature(KSI_LazySignature *sig, KSI_Signature **signature) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (sig == NULL || signature == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->signature == NULL) {
+		res = KSI_Signature_parse(sig->ctx, sig->raw, sig->raw_len, &sig->signature);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*signature = sig->signature;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+void KSI_LazySignature_free(KSI_LazySignature *sig) {
+	if (sig != NULL) {
+		KSI_free(sig->index);
+		KSI_Integer_free(sig->signingTime);
+		KSI_DataHash_free(sig->documentHash);
+		KSI_CalendarHashChain_free(sig->calendarChain);
+		KSI_Signature_free(sig->signature);
+		KSI_free(sig);
+	}
+}
 
 int KSI_Signature_serialize(const KSI_Signature *sig, unsigned char **raw, size_t *raw_len) {
 	int res;
@@ -1123,6 +1560,33 @@ cleanup:
 
 }
 
+int KSI_Signature_writeBytes(const KSI_Signature *sig, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (sig == NULL || (buf == NULL && buf_size != 0) || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->baseTlv != NULL) {
+		/* We assume that the baseTlv tree is up to date! */
+		res = KSI_TLV_writeBytes(sig->baseTlv, buf, buf_size, buf_len, opt);
+	} else {
+		res = KSI_TlvTemplate_writeBytes(sig->ctx, sig, 0x0800, 0, 0, KSI_TLV_TEMPLATE(KSI_Signature), buf, buf_size, buf_len, opt);
+	}
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_Signature_getAggregationHashChainIdentity(const KSI_Signature *sig, KSI_HashChainLinkIdentityList **identity) {
 	int res = KSI_UNKNOWN_ERROR;
 	size_t i;
@@ -70,6 +70,76 @@ extern "C" {
 
 #define KSI_Signature_parse(ctx, raw, raw_len, sig) KSI_Signature_parseWithPolicy(ctx, raw, raw_len, KSI_VERIFICATION_POLICY_INTERNAL, NULL, sig)
 
+	/**
+	 * Lazily parsed KSI signature, meant for scanning signature metadata. Parsing only indexes the
+	 * signature components over the raw buffer; each component is decoded on first access.
+	 * \see #KSI_LazySignature_parse
+	 */
+	typedef struct KSI_LazySignature_st KSI_LazySignature;
+
+	/**
+	 * Indexes the top-level components of the raw signature without copying or decoding them.
+	 * The signature is not verified.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		raw			Pointer to the raw signature.
+	 * \param[in]		raw_len		Length of the raw signature.
+	 * \param[out]		sig			Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note The raw buffer is not copied and must stay valid until the lazy signature is freed.
+	 * \see #KSI_LazySignature_free
+	 */
+	int KSI_LazySignature_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_LazySignature **sig);
+
+	/**
+	 * Lazy counterpart of #KSI_Signature_getSigningTime.
+	 * \param[in]		sig			Lazy signature.
+	 * \param[out]		signTime	Pointer to the receiving pointer, the value belongs to the signature.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 */
+	int KSI_LazySignature_getSigningTime(KSI_LazySignature *sig, KSI_Integer **signTime);
+
+	/**
+	 * Lazy counterpart of #KSI_Signature_getDocumentHash.
+	 * \param[in]		sig			Lazy signature.
+	 * \param[out]		hsh			Pointer to the receiving pointer, the value belongs to the signature.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 */
+	int KSI_LazySignature_getDocumentHash(KSI_LazySignature *sig, KSI_DataHash **hsh);
+
+	/**
+	 * Returns the calendar hash chain of the signature, decoding it on first access.
+	 * \param[in]		sig			Lazy signature.
+	 * \param[out]		chain		Pointer to the receiving pointer, the value belongs to the signature
+	 * 								and is \c NULL if the signature does not contain a calendar hash chain.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 */
+	int KSI_LazySignature_getCalendarChain(KSI_LazySignature *sig, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Returns the fully parsed signature, parsing and verifying it with the internal policy on first access.
+	 * \param[in]		sig			Lazy signature.
+	 * \param[out]		signature	Pointer to the receiving pointer, the value belongs to the lazy signature.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \see #KSI_Signature_parse
+	 */
+	int KSI_LazySignature_getSignature(KSI_LazySignature *sig, KSI_Signature **signature);
+
+	/**
+	 * Frees the lazy signature and the components materialized by it.
+	 * \param[in]		sig			Lazy signature.
+	 */
+	void KSI_LazySignature_free(KSI_LazySignature *sig);
+
 	/**
 	 * This function serializes the signature object into raw data. To deserialize it again
 	 * use #KSI_Signature_parse.
@@ -85,6 +155,22 @@ extern "C" {
 	 */
 	int KSI_Signature_serialize(const KSI_Signature *sig, unsigned char **raw, size_t *raw_len);
 
+	/**
+	 * This function serializes the signature object into a buffer provided by the caller. To
+	 * find out the exact size of the buffer needed, call the function with \c buf set to \c NULL
+	 * and \c buf_size set to 0 - only the serialized length is calculated and returned via \c buf_len.
+	 * \param[in]		sig			Signature object.
+	 * \param[in]		buf			Pointer to the pre-allocated buffer, may be \c NULL if \c buf_size is 0.
+	 * \param[in]		buf_size	Size of the buffer.
+	 * \param[out]		buf_len		Length of the serialized signature.
+	 * \param[in]		opt			Serialization options (see #KSI_Serialize_Opt_en).
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, #KSI_BUFFER_OVERFLOW if the buffer
+	 * is too small, otherwise an error code).
+	 * \see #KSI_Signature_serialize
+	 */
+	int KSI_Signature_writeBytes(const KSI_Signature *sig, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt);
+
 	/**
 	 * This function signs the given root hash value (\c rootHash) with the aggregation level (\c rootLevel)
 	 * of a locally aggregated hash tree. This function requires access to a working aggregaton and fails if
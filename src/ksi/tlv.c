@@ -23,6 +23,7 @@
 #include "fast_tlv.h"
 #include "tlv.h"
 #include "io.h"
+#include "impl/ctx_impl.h"
 
 #define KSI_BUFFER_SIZE 0xffff + 1
 
@@ -59,12 +60,12 @@ KSI_IMPLEMENT_LIST(KSI_TLV, KSI_TLV_free);
 /**
  *
  */
-static int createOwnBuffer(KSI_TLV *tlv, int copy) {
+static int createOwnBuffer(KSI_TLV *tlv, size_t buf_size, int copy) {
 	int res = KSI_UNKNOWN_ERROR;
 	unsigned char *buf = NULL;
 	size_t buf_len = 0;
 
-	if (tlv == NULL) {
+	if (tlv == NULL || buf_size == 0 || buf_size > KSI_BUFFER_SIZE) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
@@ -75,7 +76,12 @@ static int createOwnBuffer(KSI_TLV *tlv, int copy) {
 		goto cleanup;
 	}
 
-	buf = KSI_malloc(KSI_BUFFER_SIZE);
+	if (copy && tlv->datap != NULL && tlv->datap_len > buf_size) {
+		KSI_pushError(tlv->ctx, res = KSI_BUFFER_OVERFLOW, NULL);
+		goto cleanup;
+	}
+
+	buf = KSI_malloc(buf_size);
 	if (buf == NULL) {
 		KSI_pushError(tlv->ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
@@ -93,7 +99,7 @@ static int createOwnBuffer(KSI_TLV *tlv, int copy) {
 	tlv->datap = tlv->buffer;
 	tlv->datap_len = buf_len;
 
-	tlv->buffer_size = KSI_BUFFER_SIZE;
+	tlv->buffer_size = buf_size;
 
 	res = KSI_OK;
 
@@ -124,8 +130,15 @@ static int encodeAsRaw(KSI_TLV *tlv) {
 		goto cleanup;
 	}
 
-	if (tlv->buffer == NULL) {
-		buf_size = 0xffff + 1;
+	/* Calculate the exact payload size, to avoid allocating more than needed. */
+	res = KSI_TLV_writeBytes(tlv, NULL, 0, &payloadLength, KSI_TLV_OPT_NO_HEADER);
+	if (res != KSI_OK) {
+		KSI_pushError(tlv->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (tlv->buffer == NULL || tlv->buffer_size < payloadLength) {
+		buf_size = payloadLength > 0 ? payloadLength : 1;
 		buf = KSI_calloc(buf_size, 1);
 		if (buf == NULL) {
 			KSI_pushError(tlv->ctx, res = KSI_OUT_OF_MEMORY, NULL);
@@ -139,10 +152,16 @@ static int encodeAsRaw(KSI_TLV *tlv) {
 	payloadLength = buf_size;
 	res = KSI_TLV_serializePayload(tlv, buf, &payloadLength);
 	if (res != KSI_OK) {
+		/* Do not release the buffer still owned by the TLV. */
+		if (buf == tlv->buffer) buf = NULL;
 		KSI_pushError(tlv->ctx, res, NULL);
 		goto cleanup;
 	}
 
+	/* The nested TLVs may point into the previous buffer, release it only after serializing. */
+	if (tlv->buffer != buf) {
+		KSI_free(tlv->buffer);
+	}
 	tlv->buffer = buf;
 	tlv->buffer_size = buf_size;
 
@@ -280,8 +299,13 @@ int KSI_TLV_setRawValue(KSI_TLV *tlv, const void *data, size_t data_len) {
 		goto cleanup;
 	}
 
-	if (tlv->buffer == NULL && data != NULL && data_len != 0) {
-		res = createOwnBuffer(tlv, 0);
+	/* Allocate only as much as the value needs, growing the buffer when a longer value is set. */
+	if (data != NULL && data_len != 0 && (tlv->buffer == NULL || tlv->buffer_size < data_len)) {
+		KSI_free(tlv->buffer);
+		tlv->buffer = NULL;
+		tlv->buffer_size = 0;
+
+		res = createOwnBuffer(tlv, data_len, 0);
 		if (res != KSI_OK) {
 			KSI_pushError(tlv->ctx, res, NULL);
 			goto cleanup;
@@ -327,7 +351,7 @@ int KSI_TLV_new(KSI_CTX *ctx, unsigned tag, int isLenient, int isForward, KSI_TL
 		goto cleanup;
 	}
 
-	tmp = KSI_new(KSI_TLV);
+	tmp = KSI_CTX_poolAlloc(ctx, sizeof(KSI_TLV));
 	if (tmp == NULL) {
 		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
@@ -373,7 +397,7 @@ void KSI_TLV_free(KSI_TLV *tlv) {
 		/* Free nested data. */
 
 		KSI_TLVList_free(tlv->nested);
-		KSI_free(tlv);
+		KSI_CTX_poolFree(tlv->ctx, tlv, sizeof(KSI_TLV));
 	}
 }
 
@@ -618,7 +642,7 @@ static int serializeRaw(const KSI_TLV *tlv, unsigned char *buf, size_t buf_size,
 
 	if (buf != NULL) {
 		if (buf_size < payloadLength) {
-			KSI_pushError(tlv->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			KSI_pushError(tlv->ctx, res = KSI_BUFFER_OVERFLOW, NULL);
 			goto cleanup;
 		}
 		memcpy(buf + buf_size - payloadLength, tlv->datap, payloadLength);
@@ -825,13 +849,22 @@ int KSI_TLV_serialize(const KSI_TLV *tlv, unsigned char **buf, size_t *buf_len)
 
 	unsigned char *tmp = NULL;
 
-	tmp = KSI_calloc(4 + KSI_BUFFER_SIZE, 1);
+	if (tlv == NULL || buf == NULL || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Calculate the exact length first, so only the serialized value is allocated. */
+	res = KSI_TLV_writeBytes(tlv, NULL, 0, &tmp_len, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp = KSI_malloc(tmp_len);
 	if (tmp == NULL) {
 		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
-	res = KSI_TLV_serialize_ex(tlv, tmp, 4 + KSI_BUFFER_SIZE, &tmp_len);
+	res = KSI_TLV_serialize_ex(tlv, tmp, tmp_len, &tmp_len);
 	if (res != KSI_OK) goto cleanup;
 
 
@@ -229,6 +229,19 @@ extern "C" {
 	 */
 	int KSI_TLV_appendNestedTlv(KSI_TLV *target, KSI_TLV *tlv);
 
+	/**
+	 * Serializes the TLV into a pre-allocated buffer. The value is written to the end of the buffer and,
+	 * unless #KSI_TLV_OPT_NO_MOVE is set, moved to its beginning afterwards. When \c buf is \c NULL and
+	 * \c buf_size is 0, only the length of the serialized value is calculated.
+	 * \param[in]	tlv			The TLV to be serialized.
+	 * \param[in]	buf			Pointer to pre-allocated buffer.
+	 * \param[in]	buf_size	Buffer size.
+	 * \param[out]	buf_len		Serialized value length.
+	 * \param[in]	opt			Serialization options (see #KSI_Serialize_Opt_en).
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \return #KSI_BUFFER_OVERFLOW if the buffer is too small (earlier versions returned
+	 * #KSI_INVALID_ARGUMENT when a raw value did not fit).
+	 */
 	int KSI_TLV_writeBytes(const KSI_TLV *tlv, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt);
 
 	/**
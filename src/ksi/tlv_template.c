@@ -26,6 +26,7 @@
 #include "hashchain.h"
 #include "pkitruststore.h"
 #include "fast_tlv.h"
+#include "impl/ctx_impl.h"
 
 /* At the moment value 0xff should be enough for everyone (actually less than 10 is used). */
 #define MAX_TEMPLATE_SIZE 0xff
@@ -483,38 +484,6 @@ int KSI_TlvTemplate_extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI
 	return res;
 }
 
-int KSI_TlvTemplate_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_TlvTemplate *tmpl, void *payload) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
-	struct tlv_track_s tr[0xf];
-
-	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || raw == NULL || tmpl == NULL || payload == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
-		goto cleanup;
-	}
-
-	res = KSI_TLV_parseBlob2(ctx, (unsigned char *)raw, raw_len, 0, &tlv);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
-	res = extract(ctx, payload, tlv, tmpl, tr, 0, sizeof(tr));
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
-	res = KSI_OK;
-
-cleanup:
-
-	KSI_TLV_free(tlv);
-
-	return res;
-}
-
 static size_t getTemplateLength(const KSI_TlvTemplate *tmpl) {
 	const KSI_TlvTemplate *tmp = NULL;
 	size_t len = 0;
@@ -610,44 +579,308 @@ cleanup:
 	return res;
 }
 
-static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, int (*generator)(void *, KSI_TLV **), struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
-	char buf[1024];
+#define TEMPLATE_INDEX_BUCKET(tag) ((((tag) & 0x7f) ^ ((tag) >> 7)) & (KSI_TLV_TEMPLATE_INDEX_BUCKETS - 1))
 
-	void *valuep = NULL;
-	KSI_TLV *tlvVal = NULL;
+void KSI_TlvTemplateIndex_free(KSI_TlvTemplateIndex *idx) {
+	KSI_free(idx);
+}
 
-	size_t template_len = 0;
-	bool templateHit[MAX_TEMPLATE_SIZE];
-	bool groupHit[2] = {false, false};
-	bool oneOf[2] = {false, false};
+static int TemplateIndex_compile(const KSI_TlvTemplate *tmpl, size_t template_len, KSI_TlvTemplateIndex **out) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TlvTemplateIndex *tmp = NULL;
 	size_t i;
-	size_t tmplStart = 0;
-	size_t maxOrder = 0;
-	bool firstHit = false;
-	bool lastHit = false;
 
-	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || payload == NULL || generatorCtx == NULL || tmpl == NULL || generator == NULL || tr == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	tmp = KSI_new(KSI_TlvTemplateIndex);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
+	tmp->tmpl = tmpl;
+	tmp->template_len = template_len;
+	tmp->mandatory = 0;
+	tmp->hasGroup[0] = tmp->hasGroup[1] = false;
+	memset(tmp->bucketTag, 0, sizeof(tmp->bucketTag));
+	memset(tmp->bucketSlot, KSI_TLV_TEMPLATE_INDEX_NONE, sizeof(tmp->bucketSlot));
+
+	for (i = 0; i < template_len; i++) {
+		size_t b = TEMPLATE_INDEX_BUCKET(tmpl[i].tag);
+
+		tmp->nextSlot[i] = KSI_TLV_TEMPLATE_INDEX_NONE;
+
+		/* Find the bucket of the tag, or the first free one. */
+		while (tmp->bucketSlot[b] != KSI_TLV_TEMPLATE_INDEX_NONE && tmp->bucketTag[b] != tmpl[i].tag) {
+			b = (b + 1) & (KSI_TLV_TEMPLATE_INDEX_BUCKETS - 1);
+		}
+
+		if (tmp->bucketSlot[b] == KSI_TLV_TEMPLATE_INDEX_NONE) {
+			tmp->bucketTag[b] = (unsigned short)tmpl[i].tag;
+			tmp->bucketSlot[b] = (unsigned char)i;
+		} else {
+			/* Keep the slots with the same tag in the template order. */
+			size_t last = tmp->bucketSlot[b];
+			while (tmp->nextSlot[last] != KSI_TLV_TEMPLATE_INDEX_NONE) last = tmp->nextSlot[last];
+			tmp->nextSlot[last] = (unsigned char)i;
+		}
+
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MANDATORY)) tmp->mandatory |= (KSI_uint64_t)1 << i;
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) tmp->hasGroup[0] = true;
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) tmp->hasGroup[1] = true;
+	}
+
+	*out = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TlvTemplateIndex_free(tmp);
+
+	return res;
+}
+
+/* Returns the compiled index of the template, or NULL if the template can not be indexed. */
+static const KSI_TlvTemplateIndex *getTemplateIndex(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl) {
+	size_t addr = (size_t)tmpl;
+	size_t h = ((addr >> 4) ^ (addr >> 11)) & (KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE - 1);
+	size_t i;
+
+	for (i = 0; i < KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE; i++) {
+		KSI_TlvTemplateIndex **slot = &ctx->templateIndex[(h + i) & (KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE - 1)];
+
+		if (*slot == NULL) {
+			size_t template_len = getTemplateLength(tmpl);
+
+			if (template_len == 0 || template_len > KSI_TLV_TEMPLATE_INDEX_MAX_LEN) return NULL;
+			if (TemplateIndex_compile(tmpl, template_len, slot) != KSI_OK) return NULL;
+		}
+
+		if ((*slot)->tmpl == tmpl) return *slot;
+	}
+
+	/* The cache is full - fall back to scanning the template. */
+	return NULL;
+}
+
+/* State of matching the elements of a single composite TLV against its template. */
+typedef struct TemplateMatch_st {
+	const KSI_TlvTemplateIndex *idx;
+	size_t template_len;
+	bool templateHit[MAX_TEMPLATE_SIZE];
+	KSI_uint64_t hitMask;
+	bool groupHit[2];
+	bool oneOf[2];
+	size_t tmplStart;
+	size_t maxOrder;
+	bool firstHit;
+	bool lastHit;
+} TemplateMatch;
+
+static int TemplateMatch_init(KSI_CTX *ctx, TemplateMatch *m, const KSI_TlvTemplate *tmpl) {
+	int res = KSI_UNKNOWN_ERROR;
+
 	/* Analyze the template. */
-	template_len = getTemplateLength(tmpl);
+	m->idx = getTemplateIndex(ctx, tmpl);
+	m->template_len = m->idx != NULL ? m->idx->template_len : getTemplateLength(tmpl);
 
-	if (template_len == 0) {
+	if (m->template_len == 0) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Empty template suggests invalid state.");
 		goto cleanup;
 	}
 
 	/* Make sure there will be no buffer overflow. */
-	if (template_len > MAX_TEMPLATE_SIZE) {
+	if (m->template_len > MAX_TEMPLATE_SIZE) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Template too big.");
 		goto cleanup;
 	}
-	memset(templateHit, 0, sizeof(templateHit));
+	memset(m->templateHit, 0, m->template_len * sizeof(bool));
+
+	m->hitMask = 0;
+	m->groupHit[0] = m->groupHit[1] = false;
+	m->oneOf[0] = m->oneOf[1] = false;
+	m->tmplStart = 0;
+	m->maxOrder = 0;
+	m->firstHit = false;
+	m->lastHit = false;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Returns the first template slot starting from \c from with the given tag, or the template length if there is none. */
+static size_t TemplateMatch_find(const TemplateMatch *m, const KSI_TlvTemplate *tmpl, unsigned tag, size_t from) {
+	size_t i;
+
+	if (m->idx != NULL) {
+		size_t b = TEMPLATE_INDEX_BUCKET(tag);
+
+		while (m->idx->bucketSlot[b] != KSI_TLV_TEMPLATE_INDEX_NONE) {
+			if (m->idx->bucketTag[b] == tag) {
+				for (i = m->idx->bucketSlot[b]; i != KSI_TLV_TEMPLATE_INDEX_NONE; i = m->idx->nextSlot[i]) {
+					if (i >= from) return i;
+				}
+				break;
+			}
+			b = (b + 1) & (KSI_TLV_TEMPLATE_INDEX_BUCKETS - 1);
+		}
+		return m->template_len;
+	}
+
+	for (i = from; i < m->template_len; i++) {
+		if (tmpl[i].tag == tag) return i;
+	}
+	return m->template_len;
+}
+
+/* Validates the placement rules of the template element \c i for the current TLV. */
+static int TemplateMatch_hit(KSI_CTX *ctx, TemplateMatch *m, const KSI_TlvTemplate *tmpl, size_t i, void *payload) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *valuep = NULL;
+
+	m->templateHit[i] = true;
+	if (i < KSI_TLV_TEMPLATE_INDEX_MAX_LEN) m->hitMask |= (KSI_uint64_t)1 << i;
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) m->groupHit[0] = true;
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) m->groupHit[1] = true;
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIXED_ORDER)) {
+		if (i < m->maxOrder) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element at wrong position.");
+			goto cleanup;
+		}
+		m->maxOrder = i;
+	}
+
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIRST)) {
+		if (m->firstHit) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at first position.");
+			goto cleanup;
+		}
+	}
+	m->firstHit = true;
+
+	if (m->lastHit) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at last position.");
+		goto cleanup;
+	}
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LAST)) {
+		m->lastHit = true;
+	}
+
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G0)) {
+		if (m->oneOf[0]) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mutually exclusive elements present within group 0.");
+			goto cleanup;
+		}
+		m->oneOf[0] = true;
+	}
+
+	if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G1)) {
+		if (m->oneOf[1]) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mutually exclusive elements present within group 0.");
+			goto cleanup;
+		}
+		m->oneOf[1] = true;
+	}
+
+	if (tmpl[i].getValue != NULL) {
+		/* Validate the value has not been set. */
+		res = tmpl[i].getValue(payload, (void **)&valuep);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (valuep != NULL && !tmpl[i].multiple) {
+		KSI_LOG_debug(ctx, "Multiple occurrences of a unique tag 0x%02x.", tmpl[i].tag);
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "To avoid memory leaks, a value may not be set more than once while parsing.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Raises an error if the unmatched TLV is marked as critical. */
+static int TemplateMatch_unknown(KSI_CTX *ctx, int isNonCritical, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	char buf[1024];
+	char msg[1024];
+
+	if (isNonCritical) {
+		KSI_snprintf(msg, sizeof(msg), "Ignoring unknown non-critical tag: %s", track_str(tr, tr_len + 1, tr_size, buf, sizeof(buf)));
+		KSI_LOG_warn(ctx, "%s", msg);
+	} else {
+		KSI_snprintf(msg, sizeof(msg), "Unknown critical tag: %s", track_str(tr, tr_len + 1, tr_size, buf, sizeof(buf)));
+		KSI_LOG_debug(ctx, "%s", msg);
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, msg);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Check that every mandatory component was present. */
+static int TemplateMatch_finish(KSI_CTX *ctx, const TemplateMatch *m, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	char buf[1024];
+	size_t i;
+
+	/* Fast path - all the mandatory elements and groups are present. */
+	if (m->idx != NULL && (m->hitMask & m->idx->mandatory) == m->idx->mandatory &&
+			(!m->idx->hasGroup[0] || m->groupHit[0]) && (!m->idx->hasGroup[1] || m->groupHit[1])) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	for (i = 0; i < m->template_len; i++) {
+		char errm[100];
+		if ((tmpl[i].flags & KSI_TLV_TMPL_FLG_MANDATORY) != 0 && !m->templateHit[i]) {
+			KSI_snprintf(errm, sizeof(errm), "Mandatory element missing: %s->[0x%x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr != NULL ? tmpl[i].descr : "");
+			KSI_LOG_debug(ctx, "%s", errm);
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+			goto cleanup;
+		}
+		if (((tmpl[i].flags & KSI_TLV_TMPL_FLG_LEAST_ONE_G0) != 0 && !m->groupHit[0]) ||
+				((tmpl[i].flags & KSI_TLV_TMPL_FLG_LEAST_ONE_G1) != 0 && !m->groupHit[1])) {
+			KSI_snprintf(errm, sizeof(errm), "Mandatory group missing: %s->[0x%x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr != NULL ? tmpl[i].descr : "");
+			KSI_LOG_debug(ctx, "%s", errm);
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, int (*generator)(void *, KSI_TLV **), struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+	TemplateMatch match;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || payload == NULL || generatorCtx == NULL || tmpl == NULL || generator == NULL || tr == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = TemplateMatch_init(ctx, &match, tmpl);
+	if (res != KSI_OK) goto cleanup;
 
 	for (;;) {
 		int matchCount = 0;
@@ -664,71 +897,15 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 			tr[tr_len].desc = NULL;
 		}
 
-		for (i = tmplStart; i < template_len; i++) {
-			if (tmpl[i].tag != KSI_TLV_getTag(tlv)) continue;
-			if (i == tmplStart && !tmpl[i].multiple) tmplStart++;
+		for (i = TemplateMatch_find(&match, tmpl, KSI_TLV_getTag(tlv), match.tmplStart); i < match.template_len; i = TemplateMatch_find(&match, tmpl, KSI_TLV_getTag(tlv), i + 1)) {
+			if (i == match.tmplStart && !tmpl[i].multiple) match.tmplStart++;
 
 			tr[tr_len].desc = tmpl[i].descr;
 
 			matchCount++;
-			templateHit[i] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) groupHit[0] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) groupHit[1] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIXED_ORDER)) {
-				if (i < maxOrder) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element at wrong position.");
-					goto cleanup;
-				}
-				maxOrder = i;
-			}
+			res = TemplateMatch_hit(ctx, &match, tmpl, i, payload);
+			if (res != KSI_OK) goto cleanup;
 
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIRST)) {
-				if (firstHit) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at first position.");
-					goto cleanup;
-				}
-			}
-			firstHit = true;
-
-			if (lastHit) {
-				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at last position.");
-				goto cleanup;
-			}
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LAST)) {
-				lastHit = true;
-			}
-
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G0)) {
-				if (oneOf[0]) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mutually exclusive elements present within group 0.");
-					goto cleanup;
-				}
-				oneOf[0] = true;
-			}
-
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G1)) {
-				if (oneOf[1]) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mutually exclusive elements present within group 0.");
-					goto cleanup;
-				}
-				oneOf[1] = true;
-			}
-
-			valuep = NULL;
-			if (tmpl[i].getValue != NULL) {
-				/* Validate the value has not been set. */
-				res = tmpl[i].getValue(payload, (void **)&valuep);
-				if (res != KSI_OK) {
-					KSI_pushError(ctx, res, NULL);
-					goto cleanup;
-				}
-			}
-
-			if (valuep != NULL && !tmpl[i].multiple) {
-				KSI_LOG_debug(ctx, "Multiple occurrences of a unique tag 0x%02x.", tmpl[i].tag);
-				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "To avoid memory leaks, a value may not be set more than once while parsing.");
-				goto cleanup;
-			}
 			/* Parse the current TLV. */
 			switch (tmpl[i].type) {
 				case KSI_TLV_TEMPLATE_OBJECT:
@@ -758,43 +935,18 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 
 		/* Check if a match was found, an raise an error if the TLV is marked as critical. */
 		if (matchCount == 0) {
-			char msg[1024];
-			if (KSI_TLV_isNonCritical(tlv)) {
-				KSI_snprintf(msg, sizeof(msg), "Ignoring unknown non-critical tag: %s", track_str(tr, tr_len + 1, tr_size, buf, sizeof(buf)));
-				KSI_LOG_warn(ctx, "%s", msg);
-			} else {
-				KSI_snprintf(msg, sizeof(msg), "Unknown critical tag: %s", track_str(tr, tr_len + 1, tr_size, buf, sizeof(buf)));
-				KSI_LOG_debug(ctx, "%s", msg);
-				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, msg);
-				goto cleanup;
-			}
+			res = TemplateMatch_unknown(ctx, KSI_TLV_isNonCritical(tlv), tr, tr_len, tr_size);
+			if (res != KSI_OK) goto cleanup;
 		}
 	}
 
-	/* Check that every mandatory component was present. */
-	for (i = 0; i < template_len; i++) {
-		char errm[100];
-		if ((tmpl[i].flags & KSI_TLV_TMPL_FLG_MANDATORY) != 0 && !templateHit[i]) {
-			KSI_snprintf(errm, sizeof(errm), "Mandatory element missing: %s->[0x%x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr != NULL ? tmpl[i].descr : "");
-			KSI_LOG_debug(ctx, "%s", errm);
-			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
-			goto cleanup;
-		}
-		if (((tmpl[i].flags & KSI_TLV_TMPL_FLG_LEAST_ONE_G0) != 0 && !groupHit[0]) ||
-				((tmpl[i].flags & KSI_TLV_TMPL_FLG_LEAST_ONE_G1) != 0 && !groupHit[1])) {
-			KSI_snprintf(errm, sizeof(errm), "Mandatory group missing: %s->[0x%x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr != NULL ? tmpl[i].descr : "");
-			KSI_LOG_debug(ctx, "%s", errm);
-			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
-			goto cleanup;
-		}
-	}
+	res = TemplateMatch_finish(ctx, &match, tmpl, tr, tr_len, tr_size);
+	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_TLV_free(tlvVal);
-
 	return res;
 }
 
@@ -803,44 +955,388 @@ int KSI_TlvTemplate_extractGenerator(KSI_CTX *ctx, void *payload, void *generato
 	return extractGenerator(ctx, payload, generatorCtx, tmpl, generator, buf, 0, sizeof(buf));
 }
 
-static int construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, const size_t tr_size) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tmp = NULL;
-	void *payloadp = NULL;
-	int isNonCritical = 0;
-	int isForward = 0;
+/*
+ * Direct decoder.
+ *
+ * The functions below fill the template objects straight from the serialized
+ * bytes, without building the intermediate #KSI_TLV tree first. Only objects
+ * that keep (parts of) their TLV are converted through a temporary #KSI_TLV.
+ */
 
-	size_t template_len = 0;
-	bool templateHit[MAX_TEMPLATE_SIZE];
-	bool groupHit[2] = {false, false};
-	bool oneOf[2] = {false, false};
+static int decodeValue(KSI_CTX *ctx, void *payload, const unsigned char *buf, size_t buf_len, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size);
 
+static int decodeInteger(KSI_CTX *ctx, const unsigned char *raw, size_t len, void **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_uint64_t val = 0;
 	size_t i;
-	char buf[1000];
 
-	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || tlv == NULL || payload == NULL || tmpl == NULL || tr == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	if (len > 8) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Integer larger than 64bit.");
 		goto cleanup;
 	}
 
-	/* Calculate the template length. */
-	template_len = getTemplateLength(tmpl);
-
-	if (template_len == 0) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "A template may not be empty.");
-		goto cleanup;
+	for (i = 0; i < len; i++) {
+		val = val << 8 | raw[i];
 	}
 
-	if (template_len > MAX_TEMPLATE_SIZE) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Template too big.");
+	/* Make sure the integer was coded properly. */
+	if (len > 0 && len != KSI_UINT64_MINSIZE(val)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Integer not properly formated.");
 		goto cleanup;
 	}
 
-	memset(templateHit, 0, sizeof(templateHit));
+	res = KSI_Integer_new(ctx, val, (KSI_Integer **)o);
 
+cleanup:
+
+	return res;
+}
+
+static int decodeOctetString(KSI_CTX *ctx, const unsigned char *raw, size_t len, void **o) {
+	return KSI_OctetString_new(ctx, raw, len, (KSI_OctetString **)o);
+}
+
+static int decodeUtf8String(KSI_CTX *ctx, const unsigned char *raw, size_t len, void **o) {
+	return KSI_Utf8String_new(ctx, (const char *)raw, len, (KSI_Utf8String **)o);
+}
+
+static int decodeUtf8StringNZ(KSI_CTX *ctx, const unsigned char *raw, size_t len, void **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Utf8String *tmp = NULL;
+
+	res = KSI_Utf8String_new(ctx, (const char *)raw, len, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	if (KSI_Utf8String_size(tmp) == 0 || (KSI_Utf8String_size(tmp) == 1 && KSI_Utf8String_cstr(tmp)[0] == 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Empty string value not allowed.");
+		goto cleanup;
+	}
+
+	*o = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Utf8String_free(tmp);
+
+	return res;
+}
+
+static int decodeImprint(KSI_CTX *ctx, const unsigned char *raw, size_t len, void **o) {
+	return KSI_DataHash_fromImprint(ctx, raw, len, (KSI_DataHash **)o);
+}
+
+/* Primitive types that can be decoded from the value bytes, keyed by their template conversion function. */
+static const struct {
+	int (*fromTlv)(KSI_TLV *, void **);
+	int (*decode)(KSI_CTX *, const unsigned char *, size_t, void **);
+} primitiveDecoders[] = {
+	{ (int (*)(KSI_TLV *, void **))KSI_Integer_fromTlv, decodeInteger },
+	{ (int (*)(KSI_TLV *, void **))KSI_OctetString_fromTlv, decodeOctetString },
+	{ (int (*)(KSI_TLV *, void **))KSI_Utf8String_fromTlv, decodeUtf8String },
+	{ (int (*)(KSI_TLV *, void **))KSI_Utf8StringNZ_fromTlv, decodeUtf8StringNZ },
+	{ (int (*)(KSI_TLV *, void **))KSI_DataHash_fromTlv, decodeImprint },
+	{ NULL, NULL }
+};
+
+static int decodeLink(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, const KSI_FTLV *ftlv, const unsigned char *val, void **link, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HashChainLink *tmp = NULL;
+	KSI_DataHash *hsh = NULL;
+	int isLeft;
+
+	switch (ftlv->tag) {
+		case 0x07: isLeft = 1; break;
+		case 0x08: isLeft = 0; break;
+		default: {
+			char errm[0xff];
+			KSI_snprintf(errm, sizeof(errm), "Unknown tag for hash chain link: 0x%02x", ftlv->tag);
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_HashChainLink_new(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (tmpl->fromTlv == (int (*)(KSI_TLV *, void **))KSI_CalendarHashChainLink_fromTlv) {
+		/* Calendar hash chain links are plain imprints. */
+		res = KSI_DataHash_fromImprint(ctx, val, ftlv->dat_len, &hsh);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_HashChainLink_setImprint(tmp, hsh);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		hsh = NULL;
+	} else {
+		res = decodeValue(ctx, tmp, val, ftlv->dat_len, KSI_TLV_TEMPLATE(KSI_HashChainLink), tr, tr_len + 1, tr_size);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_HashChainLink_setIsLeft(tmp, isLeft);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*link = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(hsh);
+	KSI_HashChainLink_free(tmp);
+
+	return res;
+}
+
+static int decodeObject(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, const unsigned char *raw, const KSI_FTLV *ftlv, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *val = raw + ftlv->hdr_len;
+	KSI_TLV *tlv = NULL;
+	void *tmp = NULL;
+	size_t i;
+
+	if (tmpl->fromTlv == NULL && tmpl->parser == NULL) {
+		KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR,
+				"Invalid template: no method for converting from tlv to object.");
+		goto cleanup;
+	}
+
+	if (tmpl->parser != NULL) {
+		/* The parser does not modify the input. */
+		res = tmpl->parser(ctx, (unsigned char *)val, ftlv->dat_len, tmpl->parser_opt, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else if (tmpl->fromTlv == (int (*)(KSI_TLV *, void **))KSI_HashChainLink_fromTlv ||
+			tmpl->fromTlv == (int (*)(KSI_TLV *, void **))KSI_CalendarHashChainLink_fromTlv) {
+		res = decodeLink(ctx, tmpl, ftlv, val, &tmp, tr, tr_len, tr_size);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		for (i = 0; primitiveDecoders[i].fromTlv != NULL; i++) {
+			if (primitiveDecoders[i].fromTlv == tmpl->fromTlv) break;
+		}
+
+		if (primitiveDecoders[i].decode != NULL) {
+			res = primitiveDecoders[i].decode(ctx, val, ftlv->dat_len, &tmp);
+		} else {
+			/* The object needs the TLV itself - the TLV only references the input buffer. */
+			res = KSI_TLV_parseBlob2(ctx, (unsigned char *)raw, ftlv->hdr_len + ftlv->dat_len, 0, &tlv);
+			if (res == KSI_OK) res = tmpl->fromTlv(tlv, &tmp);
+		}
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = storeObjectValue(ctx, tmpl, payload, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TLV_free(tlv);
+	tmpl->destruct(tmp);
+
+	return res;
+}
+
+static int decodeComposite(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, const unsigned char *raw, const KSI_FTLV *ftlv, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	char buf[1024];
+	void *tmp = NULL;
+
+	res = tmpl->construct(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = decodeValue(ctx, tmp, raw + ftlv->hdr_len, ftlv->dat_len, tmpl->subTemplate, tr, tr_len + 1, tr_size);
+	if (res != KSI_OK) {
+		KSI_LOG_debug(ctx, "Unable to parse composite TLV: %s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = storeObjectValue(ctx, tmpl, payload, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	tmpl->destruct(tmp);
+
+	return res;
+}
+
+/* Decodes the nested TLVs of a composite element value. */
+static int decodeValue(KSI_CTX *ctx, void *payload, const unsigned char *buf, size_t buf_len, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	TemplateMatch match;
+	KSI_FTLV ftlv;
+	size_t off = 0;
+	size_t i;
+
+	res = TemplateMatch_init(ctx, &match, tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	while (off < buf_len) {
+		int matchCount = 0;
+		const unsigned char *raw = buf + off;
+
+		res = KSI_FTLV_memRead(raw, buf_len - off, &ftlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Failed to read nested TLV.");
+			goto cleanup;
+		}
+		off += ftlv.hdr_len + ftlv.dat_len;
+
+		if (tr_len < tr_size) {
+			tr[tr_len].tag = ftlv.tag;
+			tr[tr_len].desc = NULL;
+		}
+
+		for (i = TemplateMatch_find(&match, tmpl, ftlv.tag, match.tmplStart); i < match.template_len; i = TemplateMatch_find(&match, tmpl, ftlv.tag, i + 1)) {
+			if (i == match.tmplStart && !tmpl[i].multiple) match.tmplStart++;
+
+			if (tr_len < tr_size) tr[tr_len].desc = tmpl[i].descr;
+
+			matchCount++;
+			res = TemplateMatch_hit(ctx, &match, tmpl, i, payload);
+			if (res != KSI_OK) goto cleanup;
+
+			switch (tmpl[i].type) {
+				case KSI_TLV_TEMPLATE_OBJECT:
+					res = decodeObject(ctx, &tmpl[i], payload, raw, &ftlv, tr, tr_len, tr_size);
+					break;
+				case KSI_TLV_TEMPLATE_COMPOSITE:
+					res = decodeComposite(ctx, &tmpl[i], payload, raw, &ftlv, tr, tr_len, tr_size);
+					break;
+				default:
+					KSI_LOG_error(ctx, "No template found - this might be caused by memory corruption.");
+					res = KSI_UNKNOWN_ERROR;
+			}
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			if ((tmpl[i].flags & KSI_TLV_TMPL_FLG_MORE_DEFS) == 0) break;
+		}
+
+		if (matchCount == 0) {
+			res = TemplateMatch_unknown(ctx, ftlv.is_nc, tr, tr_len, tr_size);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+	res = TemplateMatch_finish(ctx, &match, tmpl, tr, tr_len, tr_size);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_TlvTemplate_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_TlvTemplate *tmpl, void *payload) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FTLV ftlv;
+	struct tlv_track_s tr[0xf];
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || tmpl == NULL || payload == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FTLV_memRead(raw, raw_len, &ftlv);
+	if (res != KSI_OK || ftlv.hdr_len + ftlv.dat_len != raw_len) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Data size mismatch.");
+		goto cleanup;
+	}
+
+	tr[0].tag = ftlv.tag;
+	tr[0].desc = NULL;
+
+	res = decodeValue(ctx, payload, raw + ftlv.hdr_len, ftlv.dat_len, tmpl, tr, 1, sizeof(tr) / sizeof(tr[0]));
+	if (res != KSI_OK) {
+		char buf[1024];
+		KSI_LOG_debug(ctx, "Unable to parse TLV: %s", track_str(tr, 1, sizeof(tr) / sizeof(tr[0]), buf, sizeof(buf)));
+		KSI_pushError(ctx, res, buf);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Collects the values of the template elements to be serialized and checks them against the
+ * template constraints. The value of an element not to be serialized is set to \c NULL.
+ */
+static int collectValues(KSI_CTX *ctx, const void *payload, const KSI_TlvTemplate *tmpl, size_t *template_len, void **values, struct tlv_track_s *tr, size_t tr_len, const size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *payloadp = NULL;
+	bool groupHit[2] = {false, false};
+	bool oneOf[2] = {false, false};
+	size_t len;
+	size_t i;
+	char buf[1000];
+
+	/* Calculate the template length. */
+	len = getTemplateLength(tmpl);
+
+	if (len == 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "A template may not be empty.");
+		goto cleanup;
+	}
+
+	if (len > MAX_TEMPLATE_SIZE) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Template too big.");
+		goto cleanup;
+	}
+
+	for (i = 0; i < len; i++) {
+		values[i] = NULL;
 
-	for (i = 0; i < template_len; i++) {
 		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NO_SERIALIZE)) continue;
 
 		payloadp = NULL;
@@ -858,7 +1354,7 @@ static int construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_
 				tr[tr_len].desc = tmpl[i].descr;
 			}
 
-			templateHit[i] = true;
+			values[i] = payloadp;
 
 			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) {
 				if (tmpl[i].listLength != NULL && tmpl[i].listLength(payloadp) == 0) {
@@ -897,126 +1393,13 @@ static int construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_
 					oneOf[1] = true;
 				}
 			}
-
-			isNonCritical = IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NONCRITICAL);
-			isForward = IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FORWARD);
-
-			switch (tmpl[i].type) {
-				case KSI_TLV_TEMPLATE_OBJECT:
-					if (tmpl[i].toTlv == NULL) {
-						KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Invalid template: toTlv not set.");
-						goto cleanup;
-					}
-
-					if (tmpl[i].listLength != NULL) {
-						int j;
-						for (j = 0; j < tmpl[i].listLength(payloadp); j++) {
-							void *listElement = NULL;
-							res = tmpl[i].listElementAt(payloadp, j, &listElement);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							res = tmpl[i].toTlv(ctx, listElement, tmpl[i].tag, isNonCritical, isForward != 0, &tmp);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							res = KSI_TLV_appendNestedTlv(tlv, tmp);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							tmp = NULL;
-						}
-
-
-					} else {
-						res = tmpl[i].toTlv(ctx, payloadp, tmpl[i].tag, isNonCritical, isForward, &tmp);
-						if (res != KSI_OK) {
-							KSI_pushError(ctx, res, NULL);
-							goto cleanup;
-						}
-
-						res = KSI_TLV_appendNestedTlv(tlv, tmp);
-						if (res != KSI_OK) {
-							KSI_pushError(ctx, res, NULL);
-							goto cleanup;
-						}
-						tmp = NULL;
-					}
-
-					break;
-				case KSI_TLV_TEMPLATE_COMPOSITE:
-					if (tmpl[i].listLength != NULL) {
-						int j;
-
-						for (j = 0; j < tmpl[i].listLength(payloadp); j++) {
-							void *listElement = NULL;
-
-							res = KSI_TLV_new(ctx, tmpl[i].tag, isNonCritical, isForward, &tmp);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							res = tmpl[i].listElementAt(payloadp, j, &listElement);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							res = construct(ctx, tmp, listElement, tmpl[i].subTemplate, tr, tr_len + 1, tr_size);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-
-							res = KSI_TLV_appendNestedTlv(tlv, tmp);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-							tmp = NULL;
-						}
-					} else {
-						res = KSI_TLV_new(ctx, tmpl[i].tag, isNonCritical, isForward, &tmp);
-						if (res != KSI_OK) {
-							KSI_pushError(ctx, res, NULL);
-							goto cleanup;
-						}
-
-						if (!IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NO_VALUE)) {
-							res = construct(ctx, tmp, payloadp, tmpl[i].subTemplate, tr, tr_len + 1, tr_size);
-							if (res != KSI_OK) {
-								KSI_pushError(ctx, res, NULL);
-								goto cleanup;
-							}
-						}
-
-						res = KSI_TLV_appendNestedTlv(tlv, tmp);
-						if (res != KSI_OK) {
-							KSI_pushError(ctx, res, NULL);
-							goto cleanup;
-						}
-						tmp = NULL;
-					}
-					break;
-				default:
-					KSI_LOG_error(ctx, "Unimplemented template type: %d - possible MEMORY CURRUPTION.", tmpl[i].type);
-					KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Unimplemented template type.");
-					goto cleanup;
-			}
 		}
 	}
 
 	/* Check that every mandatory component was present. */
-	for (i = 0; i < template_len; i++) {
+	for (i = 0; i < len; i++) {
 		char errm[1000];
-		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MANDATORY) && !templateHit[i]) {
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MANDATORY) && values[i] == NULL) {
 			KSI_snprintf(errm, sizeof(errm), "Mandatory element missing: %s->[0x%02x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr == NULL ? "" : tmpl[i].descr);
 			KSI_LOG_debug(ctx, "%s", errm);
 			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
@@ -1031,25 +1414,430 @@ static int construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_
 		}
 	}
 
+	*template_len = len;
+
 	res = KSI_OK;
 
 cleanup:
 
 	KSI_nofree(payloadp);
 
-	KSI_TLV_free(tmp);
+	return res;
+}
+
+/*
+ * Template based encoder.
+ *
+ * The functions below write the template objects straight into the output
+ * buffer, without building the intermediate #KSI_TLV tree first. As with
+ * #KSI_TLV_writeBytes, the values are written to the end of the buffer, so the
+ * length of a value is known by the time its header is written. If the buffer
+ * is \c NULL, only the length of the encoding is calculated. Only objects with
+ * a custom #KSI_TLV conversion are written through a temporary #KSI_TLV.
+ * #KSI_TlvTemplate_construct uses the same encoder and stores the result as the
+ * raw value of the #KSI_TLV, which is parsed into nested TLVs only on demand.
+ */
+
+static int encodeValue(KSI_CTX *ctx, const void *payload, const KSI_TlvTemplate *tmpl, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size);
+
+/* Writes the TLV header in front of the \c dat_len bytes of value at the end of the buffer. */
+static int encodeHeader(KSI_CTX *ctx, unsigned tag, int isNc, int isFwd, size_t dat_len, unsigned char *buf, size_t buf_size, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *ptr = NULL;
+	size_t hdr_len;
+
+	if (dat_len > 0xffff) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "TLV value too long.");
+		goto cleanup;
+	}
+
+	hdr_len = (dat_len > 0xff || tag > KSI_TLV_MASK_TLV8_TYPE) ? 4 : 2;
+
+	if (buf != NULL) {
+		if (buf_size < hdr_len + dat_len) {
+			KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, NULL);
+			goto cleanup;
+		}
+
+		ptr = buf + buf_size - dat_len - hdr_len;
+		if (hdr_len == 4) {
+			/* Encode as TLV16. */
+			ptr[0] = (unsigned char) (KSI_TLV_MASK_TLV16 | (isNc ? KSI_TLV_MASK_LENIENT : 0) | (isFwd ? KSI_TLV_MASK_FORWARD : 0) | (tag >> 8));
+			ptr[1] = tag & 0xff;
+			ptr[2] = 0xff & dat_len >> 8;
+			ptr[3] = 0xff & dat_len;
+		} else {
+			/* Encode as TLV8. */
+			ptr[0] = (unsigned char) ((isNc ? KSI_TLV_MASK_LENIENT : 0) | (isFwd ? KSI_TLV_MASK_FORWARD : 0) | tag);
+			ptr[1] = 0xff & dat_len;
+		}
+	}
+
+	*len = hdr_len + dat_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int encodeRaw(KSI_CTX *ctx, unsigned tag, int isNc, int isFwd, const unsigned char *val, size_t val_len, unsigned char *buf, size_t buf_size, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (buf != NULL && val_len > 0) {
+		if (buf_size < val_len) {
+			KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, NULL);
+			goto cleanup;
+		}
+		memcpy(buf + buf_size - val_len, val, val_len);
+	}
+
+	res = encodeHeader(ctx, tag, isNc, isFwd, val_len, buf, buf_size, len);
+
+cleanup:
+
+	return res;
+}
+
+static int encodeIntegerValue(KSI_CTX *KSI_UNUSED(ctx), const void *o, unsigned char *tmp, const unsigned char **val, size_t *val_len) {
+	KSI_uint64_t v = KSI_Integer_getUInt64(o);
+	size_t len = 0;
+
+	while (v != 0) {
+		tmp[7 - len++] = v & 0xff;
+		v >>= 8;
+	}
+
+	*val = tmp + 8 - len;
+	*val_len = len;
+
+	return KSI_OK;
+}
+
+static int encodeOctetStringValue(KSI_CTX *KSI_UNUSED(ctx), const void *o, unsigned char *KSI_UNUSED(tmp), const unsigned char **val, size_t *val_len) {
+	return KSI_OctetString_extract(o, val, val_len);
+}
+
+static int encodeUtf8StringValue(KSI_CTX *ctx, const void *o, unsigned char *KSI_UNUSED(tmp), const unsigned char **val, size_t *val_len) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (KSI_Utf8String_size(o) > 0xffff) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "UTF8 string too long for TLV conversion.");
+		goto cleanup;
+	}
+
+	*val = (const unsigned char *)KSI_Utf8String_cstr(o);
+	*val_len = KSI_Utf8String_size(o);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int encodeUtf8StringNZValue(KSI_CTX *ctx, const void *o, unsigned char *tmp, const unsigned char **val, size_t *val_len) {
+	if (KSI_Utf8String_size(o) == 0 || (KSI_Utf8String_size(o) == 1 && KSI_Utf8String_cstr(o)[0] == 0)) {
+		KSI_pushError(ctx, KSI_INVALID_FORMAT, "Empty string value not allowed.");
+		return KSI_INVALID_FORMAT;
+	}
+
+	return encodeUtf8StringValue(ctx, o, tmp, val, val_len);
+}
+
+static int encodeImprintValue(KSI_CTX *KSI_UNUSED(ctx), const void *o, unsigned char *KSI_UNUSED(tmp), const unsigned char **val, size_t *val_len) {
+	return KSI_DataHash_getImprint(o, val, val_len);
+}
+
+/* Primitive types that can be encoded from the value bytes, keyed by their template conversion function. */
+static const struct {
+	int (*toTlv)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **);
+	int (*encode)(KSI_CTX *, const void *, unsigned char *, const unsigned char **, size_t *);
+} primitiveEncoders[] = {
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_Integer_toTlv, encodeIntegerValue },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_OctetString_toTlv, encodeOctetStringValue },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_HashChainLink_LegacyId_toTlv, encodeOctetStringValue },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_Utf8String_toTlv, encodeUtf8StringValue },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_Utf8StringNZ_toTlv, encodeUtf8StringNZValue },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_DataHash_toTlv, encodeImprintValue },
+	{ NULL, NULL }
+};
+
+static int getHeaderTemplate(KSI_CTX *KSI_UNUSED(ctx), const void *KSI_UNUSED(o), const KSI_TlvTemplate **tmpl) {
+	*tmpl = KSI_TLV_TEMPLATE(KSI_Header);
+	return KSI_OK;
+}
+
+static int getPublicationDataTemplate(KSI_CTX *KSI_UNUSED(ctx), const void *KSI_UNUSED(o), const KSI_TlvTemplate **tmpl) {
+	*tmpl = KSI_TLV_TEMPLATE(KSI_PublicationData);
+	return KSI_OK;
+}
+
+/* Objects converted to TLV with a template, keyed by their template conversion function. */
+static const struct {
+	int (*toTlv)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **);
+	int (*getTemplate)(KSI_CTX *, const void *, const KSI_TlvTemplate **);
+} objectEncoders[] = {
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_Header_toTlv, getHeaderTemplate },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_PublicationData_toTlv, getPublicationDataTemplate },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_AggregationReq_toTlv, (int (*)(KSI_CTX *, const void *, const KSI_TlvTemplate **))KSI_AggregationReq_getTemplate },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_AggregationResp_toTlv, (int (*)(KSI_CTX *, const void *, const KSI_TlvTemplate **))KSI_AggregationResp_getTemplate },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_ExtendReq_toTlv, (int (*)(KSI_CTX *, const void *, const KSI_TlvTemplate **))KSI_ExtendReq_getTemplate },
+	{ (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_ExtendResp_toTlv, (int (*)(KSI_CTX *, const void *, const KSI_TlvTemplate **))KSI_ExtendResp_getTemplate },
+	{ NULL, NULL }
+};
+
+static int encodeComposite(KSI_CTX *ctx, const void *payload, const KSI_TlvTemplate *sub, unsigned tag, int isNc, int isFwd, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t dat_len = 0;
+
+	if (sub != NULL) {
+		res = encodeValue(ctx, payload, sub, buf, buf_size, &dat_len, tr, tr_len + 1, tr_size);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = encodeHeader(ctx, tag, isNc, isFwd, dat_len, buf, buf_size, len);
+
+cleanup:
+
+	return res;
+}
+
+static int encodeLink(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, const KSI_HashChainLink *link, int isNc, int isFwd, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	int isLeft = 0;
+	unsigned tag;
+
+	res = KSI_HashChainLink_getIsLeft(link, &isLeft);
+	if (res != KSI_OK) goto cleanup;
+
+	tag = isLeft ? 0x07 : 0x08;
+
+	if (tmpl->toTlv == (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_CalendarHashChainLink_toTlv) {
+		/* Calendar hash chain links are plain imprints. */
+		res = KSI_HashChainLink_getImprint(link, &hsh);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+		if (res != KSI_OK) goto cleanup;
+
+		res = encodeRaw(ctx, tag, isNc, isFwd, imprint, imprint_len, buf, buf_size, len);
+	} else {
+		res = encodeComposite(ctx, link, KSI_TLV_TEMPLATE(KSI_HashChainLink), tag, isNc, isFwd, buf, buf_size, len, tr, tr_len, tr_size);
+	}
+
+cleanup:
+
+	KSI_nofree(hsh);
+
+	return res;
+}
+
+static int encodeObject(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, const void *obj, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	int isNc = IS_FLAG_SET(*tmpl, KSI_TLV_TMPL_FLG_NONCRITICAL);
+	int isFwd = IS_FLAG_SET(*tmpl, KSI_TLV_TMPL_FLG_FORWARD);
+	const unsigned char *val = NULL;
+	size_t val_len = 0;
+	unsigned char tmp[8];
+	const KSI_TlvTemplate *sub = NULL;
+	KSI_TLV *tlv = NULL;
+	size_t i;
+
+	if (tmpl->toTlv == NULL) {
+		KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Invalid template: toTlv not set.");
+		goto cleanup;
+	}
+
+	if (tmpl->toTlv == (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_HashChainLink_toTlv ||
+			tmpl->toTlv == (int (*)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **))KSI_CalendarHashChainLink_toTlv) {
+		res = encodeLink(ctx, tmpl, obj, isNc, isFwd, buf, buf_size, len, tr, tr_len, tr_size);
+		goto cleanup;
+	}
+
+	for (i = 0; primitiveEncoders[i].toTlv != NULL; i++) {
+		if (primitiveEncoders[i].toTlv == tmpl->toTlv) {
+			res = primitiveEncoders[i].encode(ctx, obj, tmp, &val, &val_len);
+			if (res != KSI_OK) goto cleanup;
+
+			res = encodeRaw(ctx, tmpl->tag, isNc, isFwd, val, val_len, buf, buf_size, len);
+			goto cleanup;
+		}
+	}
+
+	for (i = 0; objectEncoders[i].toTlv != NULL; i++) {
+		if (objectEncoders[i].toTlv == tmpl->toTlv) {
+			res = objectEncoders[i].getTemplate(ctx, obj, &sub);
+			if (res != KSI_OK) goto cleanup;
+
+			res = encodeComposite(ctx, obj, sub, tmpl->tag, isNc, isFwd, buf, buf_size, len, tr, tr_len, tr_size);
+			goto cleanup;
+		}
+	}
+
+	/* The object has its own conversion - write it through a temporary TLV. */
+	res = tmpl->toTlv(ctx, (void *)obj, tmpl->tag, isNc, isFwd, &tlv);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TLV_writeBytes(tlv, buf, buf_size, len, KSI_TLV_OPT_NO_MOVE);
+
+cleanup:
+
+	KSI_TLV_free(tlv);
+
+	return res;
+}
+
+static int encodeElement(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, const void *obj, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	switch (tmpl->type) {
+		case KSI_TLV_TEMPLATE_OBJECT:
+			res = encodeObject(ctx, tmpl, obj, buf, buf_size, len, tr, tr_len, tr_size);
+			break;
+		case KSI_TLV_TEMPLATE_COMPOSITE:
+			res = encodeComposite(ctx, obj, IS_FLAG_SET(*tmpl, KSI_TLV_TMPL_FLG_NO_VALUE) ? NULL : tmpl->subTemplate, tmpl->tag,
+					IS_FLAG_SET(*tmpl, KSI_TLV_TMPL_FLG_NONCRITICAL), IS_FLAG_SET(*tmpl, KSI_TLV_TMPL_FLG_FORWARD), buf, buf_size, len, tr, tr_len, tr_size);
+			break;
+		default:
+			KSI_LOG_error(ctx, "Unimplemented template type: %d - possible MEMORY CURRUPTION.", tmpl->type);
+			KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Unimplemented template type.");
+	}
+
+	return res;
+}
+
+/* Encodes the nested TLVs of a composite element value. */
+static int encodeValue(KSI_CTX *ctx, const void *payload, const KSI_TlvTemplate *tmpl, unsigned char *buf, size_t buf_size, size_t *len, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *values[MAX_TEMPLATE_SIZE];
+	size_t template_len = 0;
+	size_t dat_len = 0;
+	size_t tmp_len = 0;
+	size_t i;
+
+	res = collectValues(ctx, payload, tmpl, &template_len, values, tr, tr_len, tr_size);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The elements are written from the last to the first, as the buffer is filled from the end. */
+	for (i = template_len; i > 0; i--) {
+		const KSI_TlvTemplate *t = &tmpl[i - 1];
+
+		if (values[i - 1] == NULL) continue;
+
+		if (tr_len < tr_size) {
+			tr[tr_len].tag = t->tag;
+			tr[tr_len].desc = t->descr;
+		}
+
+		if (t->listLength != NULL) {
+			int j;
+
+			for (j = t->listLength(values[i - 1]); j > 0; j--) {
+				void *listElement = NULL;
+
+				res = t->listElementAt(values[i - 1], j - 1, &listElement);
+				if (res != KSI_OK) {
+					KSI_pushError(ctx, res, NULL);
+					goto cleanup;
+				}
+
+				res = encodeElement(ctx, t, listElement, buf, (buf == NULL ? 0 : buf_size - dat_len), &tmp_len, tr, tr_len, tr_size);
+				if (res != KSI_OK) {
+					KSI_pushError(ctx, res, NULL);
+					goto cleanup;
+				}
+
+				dat_len += tmp_len;
+			}
+		} else {
+			res = encodeElement(ctx, t, values[i - 1], buf, (buf == NULL ? 0 : buf_size - dat_len), &tmp_len, tr, tr_len, tr_size);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			dat_len += tmp_len;
+		}
+	}
+
+	*len = dat_len;
+
+	res = KSI_OK;
+
+cleanup:
 
 	return res;
 }
 
 int KSI_TlvTemplate_construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_TlvTemplate *tmpl) {
+	int res = KSI_UNKNOWN_ERROR;
 	struct tlv_track_s tr[0xf];
-	return construct(ctx, tlv, payload, tmpl, tr, 0, sizeof(tr));
+	const unsigned char *prev = NULL;
+	size_t prev_len = 0;
+	unsigned char *buf = NULL;
+	size_t dat_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || tlv == NULL || payload == NULL || tmpl == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* Calculate the length of the value. */
+	res = encodeValue(ctx, payload, tmpl, NULL, 0, &dat_len, tr, 0, sizeof(tr) / sizeof(tr[0]));
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (dat_len == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* The new elements are appended to the ones already in the TLV. */
+	res = KSI_TLV_getRawValue(tlv, &prev, &prev_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	buf = KSI_malloc(prev_len + dat_len);
+	if (buf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	if (prev_len > 0) memcpy(buf, prev, prev_len);
+
+	res = encodeValue(ctx, payload, tmpl, buf, prev_len + dat_len, &dat_len, tr, 0, sizeof(tr) / sizeof(tr[0]));
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_setRawValue(tlv, buf, prev_len + dat_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(buf);
+
+	return res;
 }
 
 int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char **raw, size_t *raw_len) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
 	unsigned char *tmp = NULL;
 	size_t tmp_len = 0;
 
@@ -1059,22 +1847,20 @@ int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag,
 		goto cleanup;
 	}
 
-	/* Create TLV for the PDU object. */
-	res = KSI_TLV_new(ctx, tag, isNc, isFwd, &tlv);
+	/* Calculate the serialized length. */
+	res = KSI_TlvTemplate_writeBytes(ctx, obj, tag, isNc, isFwd, tmpl, NULL, 0, &tmp_len, 0);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Evaluate the TLV. */
-	res = KSI_TlvTemplate_construct(ctx, tlv, obj, tmpl);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+	tmp = KSI_malloc(tmp_len);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
 	}
 
-	/* Serialize the TLV. */
-	res = KSI_TLV_serialize(tlv, &tmp, &tmp_len);
+	res = KSI_TlvTemplate_writeBytes(ctx, obj, tag, isNc, isFwd, tmpl, tmp, tmp_len, &tmp_len, KSI_TLV_OPT_NO_MOVE);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -1089,14 +1875,15 @@ int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag,
 cleanup:
 
 	KSI_free(tmp);
-	KSI_TLV_free(tlv);
 
 	return res;
 }
 
 int KSI_TlvTemplate_writeBytes(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char *raw, size_t raw_size, size_t *raw_len, int opt) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
+	struct tlv_track_s tr[0xf];
+	size_t dat_len = 0;
+	size_t len = 0;
 
 	KSI_ERR_clearErrors(ctx);
 	if (ctx == NULL || obj == NULL || tmpl == NULL || (raw == NULL && raw_size != 0) || raw_len == NULL) {
@@ -1104,33 +1891,33 @@ int KSI_TlvTemplate_writeBytes(KSI_CTX *ctx, const void *obj, unsigned tag, int
 		goto cleanup;
 	}
 
-	/* Create TLV for the PDU object. */
-	res = KSI_TLV_new(ctx, tag, isNc, isFwd, &tlv);
+	/* Encode the object straight into the buffer. */
+	res = encodeValue(ctx, obj, tmpl, raw, raw_size, &dat_len, tr, 0, sizeof(tr) / sizeof(tr[0]));
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Evaluate the TLV. */
-	res = KSI_TlvTemplate_construct(ctx, tlv, obj, tmpl);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	if ((opt & KSI_TLV_OPT_NO_HEADER) == 0) {
+		res = encodeHeader(ctx, tag, isNc, isFwd, dat_len, raw, raw_size, &len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		len = dat_len;
 	}
 
-	/* Serialize the TLV. */
-	res = KSI_TLV_writeBytes(tlv, raw, raw_size, raw_len, opt);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	if ((opt & KSI_TLV_OPT_NO_MOVE) == 0 && raw != NULL) {
+		/* Move the serialized value to the begin of the buffer. */
+		memmove(raw, raw + raw_size - len, len);
 	}
 
+	*raw_len = len;
+
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_TLV_free(tlv);
-
 	return res;
 }
-
@@ -461,6 +461,8 @@ extern "C" {
 
 	/**
 	 * Parses a given raw data into a pre-existing element. The caller needs to know the outcome type and create it.
+	 * The values are decoded directly from \c raw in a single pass without building the intermediate #KSI_TLV tree,
+	 * the same template rules apply as for #KSI_TlvTemplate_extract.
 	 * \param[in]	ctx			KSI context.
 	 * \param[in]	raw			Pointer to the raw data.
 	 * \param[in]	raw_len		Length of the raw data.
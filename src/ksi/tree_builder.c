@@ -22,6 +22,7 @@
 #include "internal.h"
 #include "tree_builder.h"
 #include "hashchain.h"
+#include "impl/hash_impl.h"
 #include "impl/meta_data_impl.h"
 
 KSI_IMPLEMENT_LIST(KSI_TreeBuilderLeafProcessor, NULL)
@@ -34,7 +35,23 @@ struct KSI_TreeLeafHandle_st {
 KSI_IMPLEMENT_REF(KSI_TreeLeafHandle)
 KSI_IMPLEMENT_LIST(KSI_TreeLeafHandle, KSI_TreeLeafHandle_free)
 
-static int KSI_TreeNode_join(KSI_CTX *ctx, KSI_DataHasher *hsr,
+/** Number of nodes in the first node block of a tree builder. */
+#define TREE_NODE_BLOCK_MIN_LEN 64
+/** Upper limit for the number of nodes in a single node block. */
+#define TREE_NODE_BLOCK_MAX_LEN 0x10000
+
+struct KSI_TreeNodeBlock_st {
+	/** The previously allocated block. */
+	KSI_TreeNodeBlock *next;
+	/** Number of nodes in this block. */
+	size_t size;
+	/** Number of nodes handed out from this block. */
+	size_t used;
+	/** The nodes, the actual length of the array is #size. */
+	KSI_TreeNode nodes[1];
+};
+
+static int KSI_TreeNode_join(KSI_TreeBuilder *builder,
 		KSI_TreeNode *leftSibling, KSI_TreeNode *rightSibling, KSI_TreeNode **root);
 
 void KSI_TreeNode_free(KSI_TreeNode *node) {
@@ -43,8 +60,75 @@ void KSI_TreeNode_free(KSI_TreeNode *node) {
 		KSI_MetaData_free(node->metaData);
 		KSI_TreeNode_free(node->leftChild);
 		KSI_TreeNode_free(node->rightChild);
-		KSI_free(node);
+		/* Nodes in a node block are released together with the tree builder. */
+		if (!node->inBlock) KSI_free(node);
+	}
+}
+
+static void KSI_TreeNodeBlock_free(KSI_TreeNodeBlock *block) {
+	while (block != NULL) {
+		KSI_TreeNodeBlock *next = block->next;
+		KSI_free(block);
+		block = next;
+	}
+}
+
+/**
+ * Creates a new tree node in the node blocks of the builder. The block memory is allocated
+ * in geometrically growing chunks, so a tree of n leaves needs O(log n) allocations and
+ * neighbouring nodes are close to each other in memory.
+ */
+static int newBuilderNode(KSI_TreeBuilder *builder, KSI_DataHash *hash, KSI_MetaData *metaData, int level, KSI_TreeNode **node) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TreeNodeBlock *block = NULL;
+	KSI_TreeNode *tmp = NULL;
+
+	if (builder == NULL || (hash == NULL && metaData == NULL) || (hash != NULL && metaData != NULL) || !KSI_IS_VALID_TREE_LEVEL(level) || node == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	block = builder->nodeBlocks;
+	if (block == NULL || block->used == block->size) {
+		size_t size = TREE_NODE_BLOCK_MIN_LEN;
+
+		if (block != NULL && block->size < TREE_NODE_BLOCK_MAX_LEN) {
+			size = block->size * 2;
+		} else if (block != NULL) {
+			size = TREE_NODE_BLOCK_MAX_LEN;
+		}
+
+		block = KSI_malloc(sizeof(KSI_TreeNodeBlock) + (size - 1) * sizeof(KSI_TreeNode));
+		if (block == NULL) {
+			KSI_pushError(builder->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		block->next = builder->nodeBlocks;
+		block->size = size;
+		block->used = 0;
+
+		builder->nodeBlocks = block;
 	}
+
+	tmp = &block->nodes[block->used++];
+
+	tmp->ctx = builder->ctx;
+	tmp->hash = KSI_DataHash_ref(hash);
+	tmp->metaData = KSI_MetaData_ref(metaData);
+	tmp->level = level;
+	tmp->parent = NULL;
+	tmp->leftChild = NULL;
+	tmp->rightChild = NULL;
+	tmp->inBlock = 1;
+
+	*node = tmp;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
 }
 
 
@@ -72,6 +156,7 @@ int KSI_TreeNode_new(KSI_CTX *ctx, KSI_DataHash *hash, KSI_MetaData *metaData, i
 	tmp->parent = NULL;
 	tmp->leftChild = NULL;
 	tmp->rightChild = NULL;
+	tmp->inBlock = 0;
 
 	*node = tmp;
 	tmp = NULL;
@@ -163,18 +248,21 @@ cleanup:
 	return res;
 }
 
-static int KSI_TreeNode_join(KSI_CTX *ctx, KSI_DataHasher *hsr,
+static int KSI_TreeNode_join(KSI_TreeBuilder *builder,
 		KSI_TreeNode *leftSibling, KSI_TreeNode *rightSibling, KSI_TreeNode **root) {
 	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
 	KSI_TreeNode *tmp = NULL;
 	int level;
 	KSI_DataHash *hsh = NULL;
 
-	if (ctx == NULL || leftSibling == NULL || rightSibling == NULL || root == NULL) {
+	if (builder == NULL || leftSibling == NULL || rightSibling == NULL || root == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
+	ctx = builder->ctx;
+
 	if (!KSI_IS_VALID_TREE_LEVEL(leftSibling->level) || !KSI_IS_VALID_TREE_LEVEL(rightSibling->level)) {
 		KSI_pushError(ctx, res = KSI_INVALID_STATE, "One of the subtrees has an invalid level.");
 		goto cleanup;
@@ -191,14 +279,14 @@ static int KSI_TreeNode_join(KSI_CTX *ctx, KSI_DataHasher *hsr,
 	}
 
 	/* Create the root hash value. */
-	res = joinHashes(ctx, hsr, leftSibling, rightSibling, level, &hsh);
+	res = joinHashes(ctx, builder->hsr, leftSibling, rightSibling, level, &hsh);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Create a new tree node. */
-	res = KSI_TreeNode_new(ctx, hsh, NULL, level, &tmp);
+	res = newBuilderNode(builder, hsh, NULL, level, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -255,6 +343,10 @@ int KSI_TreeBuilder_new(KSI_CTX *ctx, KSI_HashAlgorithm algo, KSI_TreeBuilder **
 	tmp->cbList = NULL;
 	tmp->hsr = NULL;
 	memset(tmp->stack, 0, sizeof(tmp->stack));
+	tmp->nodeBlocks = NULL;
+	tmp->subtrees = NULL;
+	tmp->nextSubtree = NULL;
+	tmp->mergedInto = NULL;
 
 	tmp->maxTreeLevel = 0;
 
@@ -292,6 +384,14 @@ void KSI_TreeBuilder_free(KSI_TreeBuilder *builder) {
 			KSI_TreeNode_free(builder->stack[i]);
 		}
 
+		/* The subtree nodes have been released with the tree, free the node blocks of the subtrees. */
+		while (builder->subtrees != NULL) {
+			KSI_TreeBuilder *next = builder->subtrees->nextSubtree;
+			KSI_TreeBuilder_free(builder->subtrees);
+			builder->subtrees = next;
+		}
+
+		KSI_TreeNodeBlock_free(builder->nodeBlocks);
 		KSI_DataHasher_free(builder->hsr);
 		KSI_TreeBuilderLeafProcessorList_free(builder->cbList);
 
@@ -322,7 +422,7 @@ static int insertNode(KSI_TreeBuilder *builder, KSI_TreeNode *node, int at) {
 		builder->stack[at] = node;
 	} else {
 		/* The slot is taken - create a new node from the existing ones. */
-		res = KSI_TreeNode_join(builder->ctx, builder->hsr, pSlot, node, &root);
+		res = KSI_TreeNode_join(builder, pSlot, node, &root);
 		if (res != KSI_OK) {
 			KSI_pushError(builder->ctx, res, NULL);
 			goto cleanup;
@@ -380,7 +480,7 @@ static int processAndInsertNode(KSI_TreeBuilder *builder, KSI_TreeNode *node) {
 		if (res != KSI_OK) goto cleanup;
 
 		if (tmp != NULL) {
-			res = KSI_TreeNode_join(builder->ctx, builder->hsr, tmp, localRoot == NULL ? node : localRoot, &localRoot);
+			res = KSI_TreeNode_join(builder, tmp, localRoot == NULL ? node : localRoot, &localRoot);
 			if (res != KSI_OK) goto cleanup;
 		}
 	}
@@ -488,13 +588,13 @@ static int addLeaf(KSI_TreeBuilder *builder, KSI_DataHash *hsh, KSI_MetaData *me
 	}
 
 	/* Make sure the builder is in a correct state. */
-	if (builder->rootNode != NULL) {
+	if (builder->rootNode != NULL || builder->mergedInto != NULL) {
 		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been finished, new leafs may not be added.");
 		goto cleanup;
 	}
 
 	/* Create new leaf node. */
-	res = KSI_TreeNode_new(builder->ctx, hsh, metaData, level, &node);
+	res = newBuilderNode(builder, hsh, metaData, level, &node);
 	if (res != KSI_OK) {
 		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
@@ -542,6 +642,216 @@ int KSI_TreeBuilder_addMetaData(KSI_TreeBuilder *builder, KSI_MetaData *metaData
 	return addLeaf(builder, NULL, metaData, level, leaf);
 }
 
+/**
+ * Moves the hash value into the context \c ctx. A hash that is referenced only by the tree is
+ * moved as is, otherwise it is replaced by a copy and the reference to the shared one is dropped.
+ */
+static int adoptDataHash(KSI_CTX *ctx, KSI_DataHash **hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *tmp = NULL;
+
+	if (*hsh == NULL || (*hsh)->ctx == ctx) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if ((*hsh)->ref == 1) {
+		(*hsh)->ctx = ctx;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_fromImprint(ctx, (*hsh)->imprint, (*hsh)->imprint_length, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	/* As the hash is still referenced elsewhere, this does not release it to the context. */
+	KSI_DataHash_free(*hsh);
+	*hsh = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(tmp);
+
+	return res;
+}
+
+static int copyUtf8String(KSI_CTX *ctx, const KSI_Utf8String *str, KSI_Utf8String **copy) {
+	if (str == NULL) return KSI_OK;
+	return KSI_Utf8String_new(ctx, KSI_Utf8String_cstr(str), KSI_Utf8String_size(str), copy);
+}
+
+static int copyInteger(KSI_CTX *ctx, const KSI_Integer *val, KSI_Integer **copy) {
+	if (val == NULL) return KSI_OK;
+	return KSI_Integer_new(ctx, KSI_Integer_getUInt64(val), copy);
+}
+
+/**
+ * Replaces the meta-data with a copy in the context \c ctx.
+ */
+static int adoptMetaData(KSI_CTX *ctx, KSI_MetaData **metaData) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_MetaData *tmp = NULL;
+	const KSI_MetaData *md = *metaData;
+
+	if (md == NULL || md->ctx == ctx) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_MetaData_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = copyUtf8String(ctx, md->clientId, &tmp->clientId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = copyUtf8String(ctx, md->machineId, &tmp->machineId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = copyInteger(ctx, md->sequenceNr, &tmp->sequenceNr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = copyInteger(ctx, md->reqTimeInMicros, &tmp->reqTimeInMicros);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->toMetaDataElement = md->toMetaDataElement;
+	tmp->serializePayload = md->serializePayload;
+
+	KSI_MetaData_free(*metaData);
+	*metaData = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_MetaData_free(tmp);
+
+	return res;
+}
+
+/**
+ * Moves the values of the node and its descendants into the context of the builder, so the
+ * tree does not depend on the context the nodes were created in.
+ */
+static int adoptNode(KSI_TreeBuilder *builder, KSI_TreeNode *node) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (node == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = adoptDataHash(builder->ctx, &node->hash);
+	if (res != KSI_OK) goto cleanup;
+
+	res = adoptMetaData(builder->ctx, &node->metaData);
+	if (res != KSI_OK) goto cleanup;
+
+	node->ctx = builder->ctx;
+
+	res = adoptNode(builder, node->leftChild);
+	if (res != KSI_OK) goto cleanup;
+
+	res = adoptNode(builder, node->rightChild);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_TreeBuilder_addSubtree(KSI_TreeBuilder *builder, KSI_TreeBuilder *subtree) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TreeNode *node = NULL;
+	int at = -1;
+	int i;
+
+	if (builder == NULL || subtree == NULL || builder == subtree) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	if (builder->rootNode != NULL || builder->mergedInto != NULL) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been finished, new leafs may not be added.");
+		goto cleanup;
+	}
+
+	if (subtree->rootNode != NULL || subtree->mergedInto != NULL) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The subtree has already been finished.");
+		goto cleanup;
+	}
+
+	if (subtree->algo != builder->algo) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_ARGUMENT, "The subtree uses a different hash algorithm.");
+		goto cleanup;
+	}
+
+	/* A subtree of 2^k leaves is a single complete binary tree in the stack slot k. */
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		if (subtree->stack[i] == NULL) continue;
+
+		if (at != -1) {
+			KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The number of leaves in the subtree is not a power of two.");
+			goto cleanup;
+		}
+		at = i;
+	}
+
+	if (at == -1) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The subtree has no leafs.");
+		goto cleanup;
+	}
+
+	/* The subtree has to continue exactly where the sequential builder would have built it. */
+	for (i = 0; i < at; i++) {
+		if (builder->stack[i] != NULL) {
+			KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The number of leaves in the tree is not a multiple of the subtree size.");
+			goto cleanup;
+		}
+	}
+
+	node = subtree->stack[at];
+
+	if (builder->maxTreeLevel > 0 && calculateHighestLevel(builder, node->level) > (unsigned)builder->maxTreeLevel) {
+		KSI_pushError(builder->ctx, res = KSI_BUFFER_OVERFLOW, "The maximum height passed.");
+		goto cleanup;
+	}
+
+	/* Detach the subtree from the context it was built in. */
+	res = adoptNode(builder, node);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Take the ownership of the subtree nodes. */
+	subtree->stack[at] = NULL;
+	subtree->ctx = builder->ctx;
+	subtree->mergedInto = builder;
+	subtree->ref++;
+	subtree->nextSubtree = builder->subtrees;
+	builder->subtrees = subtree;
+
+	res = insertNode(builder, node, at);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_TreeBuilder_close(KSI_TreeBuilder *builder) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_TreeNode *root = NULL;
@@ -554,6 +864,11 @@ int KSI_TreeBuilder_close(KSI_TreeBuilder *builder) {
 
 	KSI_ERR_clearErrors(builder->ctx);
 
+	if (builder->mergedInto != NULL) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been merged into another tree.");
+		goto cleanup;
+	}
+
 	if (builder->rootNode == NULL) {
 		size_t i;
 
@@ -567,7 +882,7 @@ int KSI_TreeBuilder_close(KSI_TreeBuilder *builder) {
 			if (root == NULL) {
 				root = node;
 			} else {
-				res = KSI_TreeNode_join(builder->ctx, builder->hsr, node, root, &tmp);
+				res = KSI_TreeNode_join(builder, node, root, &tmp);
 				if (res != KSI_OK) goto cleanup;
 
 				root = tmp;
@@ -602,7 +917,7 @@ void KSI_TreeLeafHandle_free(KSI_TreeLeafHandle *handle) {
 	}
 }
 
-static int getHashChainLinks(const KSI_TreeNode *node, KSI_LIST(KSI_HashChainLink) *links) {
+static int getHashChainLinks(KSI_CTX *ctx, const KSI_TreeNode *node, KSI_LIST(KSI_HashChainLink) *links) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_HashChainLink *link = NULL;
 	bool isLeft;
@@ -611,14 +926,14 @@ static int getHashChainLinks(const KSI_TreeNode *node, KSI_LIST(KSI_HashChainLin
 	KSI_TreeNode *pSibling = NULL;
 	KSI_MetaDataElement *mdEl = NULL;
 
-	if (node == NULL || links == NULL) {
+	if (ctx == NULL || node == NULL || links == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
 	if (node->parent != NULL) {
 
-		res = KSI_HashChainLink_new(node->ctx, &link);
+		res = KSI_HashChainLink_new(ctx, &link);
 		if (res != KSI_OK) goto cleanup;
 
 
@@ -695,7 +1010,7 @@ static int getHashChainLinks(const KSI_TreeNode *node, KSI_LIST(KSI_HashChainLin
 		levelGap = node->parent->level - node->level - 1;
 
 		if (levelGap > 0) {
-			res = KSI_Integer_new(node->ctx, levelGap, &levelCorrection);
+			res = KSI_Integer_new(ctx, levelGap, &levelCorrection);
 			if (res != KSI_OK) goto cleanup;
 
 			res = KSI_HashChainLink_setLevelCorrection(link, levelCorrection);
@@ -708,7 +1023,7 @@ static int getHashChainLinks(const KSI_TreeNode *node, KSI_LIST(KSI_HashChainLin
 		if (res != KSI_OK) goto cleanup;
 		link = NULL;
 
-		res = getHashChainLinks(node->parent, links);
+		res = getHashChainLinks(ctx, node->parent, links);
 		if (res != KSI_OK) goto cleanup;
 	}
 
@@ -732,37 +1047,42 @@ int KSI_TreeLeafHandle_getAggregationChain(const KSI_TreeLeafHandle *handle, KSI
 	KSI_AggregationHashChain *tmp = NULL;
 	KSI_LIST(KSI_HashChainLink) *links = NULL;
 	KSI_Integer *algoId = NULL;
+	KSI_TreeBuilder *builder = NULL;
 
 	if (handle == NULL || chain == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
+	/* The leaf may belong to a subtree that has been merged into another tree. */
+	builder = handle->pBuilder;
+	while (builder->mergedInto != NULL) builder = builder->mergedInto;
+
 	/* Create new object. */
-	res = KSI_AggregationHashChain_new(handle->pBuilder->ctx, &tmp);
+	res = KSI_AggregationHashChain_new(builder->ctx, &tmp);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Create new list. */
 	res = KSI_HashChainLinkList_new(&links);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Extract the hash chain links. */
-	res = getHashChainLinks(handle->leafNode, links);
+	res = getHashChainLinks(builder->ctx, handle->leafNode, links);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Set the hash chain links to the container. */
 	res = KSI_AggregationHashChain_setChain(tmp, links);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 
@@ -775,21 +1095,21 @@ int KSI_TreeLeafHandle_getAggregationChain(const KSI_TreeLeafHandle *handle, KSI
 			/* Cleanup the reference. */
 			KSI_DataHash_free(ref);
 
-			KSI_pushError(handle->pBuilder->ctx, res, NULL);
+			KSI_pushError(builder->ctx, res, NULL);
 			goto cleanup;
 		}
 	}
 
 	/* Set the aggregation algorithm. */
-	res = KSI_Integer_new(handle->pBuilder->ctx, (KSI_uint64_t)handle->pBuilder->algo, &algoId);
+	res = KSI_Integer_new(builder->ctx, (KSI_uint64_t)builder->algo, &algoId);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	res = KSI_AggregationHashChain_setAggrHashId(tmp, algoId);
 	if (res != KSI_OK) {
-		KSI_pushError(handle->pBuilder->ctx, res, NULL);
+		KSI_pushError(builder->ctx, res, NULL);
 		goto cleanup;
 	}
 	algoId = NULL;
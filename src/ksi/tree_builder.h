@@ -49,6 +49,11 @@ typedef struct KSI_TreeNode_st KSI_TreeNode;
  */
 typedef struct KSI_TreeBuilderLeafProcessor_st KSI_TreeBuilderLeafProcessor;
 
+/**
+ * A contiguous block of tree nodes, allocated at once by the tree builder.
+ */
+typedef struct KSI_TreeNodeBlock_st KSI_TreeNodeBlock;
+
 struct KSI_TreeNode_st {
 	/** KSI context. */
 	KSI_CTX *ctx;
@@ -64,6 +69,8 @@ struct KSI_TreeNode_st {
 	KSI_TreeNode *leftChild;
 	/** The right child node. */
 	KSI_TreeNode *rightChild;
+	/** Set if the memory of the node belongs to a #KSI_TreeNodeBlock of a tree builder. */
+	int inBlock;
 };
 
 struct KSI_TreeBuilderLeafProcessor_st {
@@ -115,6 +122,14 @@ struct KSI_TreeBuilder_st {
 	/** Maximum level of the root hash. If adding a leaf would make the level of the root hash greater than this
 	 * parameter, an error is returned. If the value is less or equal to 0 it is ignored. */
 	short maxTreeLevel;
+	/** Blocks of the nodes created by the builder. The blocks are released together with the builder. */
+	KSI_TreeNodeBlock *nodeBlocks;
+	/** The first of the subtree builders merged into this builder (see #KSI_TreeBuilder_addSubtree). */
+	struct KSI_TreeBuilder_st *subtrees;
+	/** The next subtree builder merged into the same builder. */
+	struct KSI_TreeBuilder_st *nextSubtree;
+	/** The builder this builder has been merged into, or \c NULL. */
+	struct KSI_TreeBuilder_st *mergedInto;
 };
 
 /**
@@ -219,6 +234,30 @@ int KSI_TreeBuilder_addDataHash(KSI_TreeBuilder *builder, KSI_DataHash *hsh, int
  */
 int KSI_TreeBuilder_addMetaData(KSI_TreeBuilder *builder, KSI_MetaData *metaData, int level, KSI_TreeLeafHandle **leaf);
 
+/**
+ * Appends the leaves of an independently built subtree to the tree. The result - the root hash and
+ * the aggregation hash chains of all the leaves - is identical to adding the same leaves to \c builder
+ * one by one. This makes it possible to hash large batches on several threads: every worker thread
+ * fills its own subtree builder with a consecutive range of the leaves (using its own #KSI_CTX) and
+ * the owner of \c builder merges the subtrees in the order of the ranges.
+ *
+ * The number of leaves in \c subtree must be a power of two, 2^k, and the number of leaves already
+ * in \c builder must be a multiple of 2^k. Thus a batch is split into equally sized subtrees followed
+ * by the remainder, which can be added leaf by leaf or as subtrees of decreasing size.
+ * \param[in]	builder		The builder.
+ * \param[in]	subtree		The subtree builder, using the same hash algorithm as \c builder.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ * \note The leaf processors of \c builder are not applied to the leaves of \c subtree, as they
+ * have already been processed by the leaf processors of \c subtree when added.
+ * \note The builder takes a reference to \c subtree, no more leaves may be added to it. The leaf
+ * handles of \c subtree remain valid and yield the aggregation hash chains up to the root of \c builder.
+ * \note The hash values and meta-data of the subtree nodes are moved into the context of \c builder,
+ * values still referenced outside of the subtree are copied. After the call the subtree does not
+ * depend on its own context any more, which may be reused or freed. The subtree and the objects
+ * referenced by it may not be accessed by other threads during the call.
+ */
+int KSI_TreeBuilder_addSubtree(KSI_TreeBuilder *builder, KSI_TreeBuilder *subtree);
+
 /**
  * This function finalizes the building of the tree. After calling this function no more leafs
  * may be added to the computation and doing so would result in an error.
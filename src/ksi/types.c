@@ -34,6 +34,7 @@
 #include "impl/ctx_impl.h"
 #include "impl/meta_data_impl.h"
 #include "impl/meta_data_element_impl.h"
+#include "impl/tlv_template_impl.h"
 
 KSI_IMPORT_TLV_TEMPLATE(KSI_ExtendPdu);
 KSI_IMPORT_TLV_TEMPLATE(KSI_ExtendReqPdu);
@@ -1314,28 +1315,66 @@ cleanup:
 	return res;
 }
 
-int KSI_ExtendPdu_serialize(const KSI_ExtendPdu *t, unsigned char **raw, size_t *len) {
-	int res = KSI_UNKNOWN_ERROR;
-	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
+/* Selects the outer tag and the template of the extend PDU, depending on the PDU version in use. */
+static int getExtendPduTemplate(const KSI_ExtendPdu *t, unsigned *tag, const KSI_TlvTemplate **tmpl) {
 	if (t->ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
 		KSI_LOG_warn(t->ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x300, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendPdu), raw, len);
+		*tag = 0x300;
+		*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendPdu);
 	} else if (t->ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
 		if (t->request != NULL || t->confRequest != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x320, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendReqPdu), raw, len);
+			*tag = 0x320;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendReqPdu);
 		} else if (t->response != NULL || t->confResponse != NULL || t->error != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x321, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendRespPdu), raw, len);
+			*tag = 0x321;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendRespPdu);
 		} else {
-			res = KSI_INVALID_FORMAT;
+			return KSI_INVALID_FORMAT;
 		}
 	} else {
-		res = KSI_INVALID_FORMAT;
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
+int KSI_ExtendPdu_serialize(const KSI_ExtendPdu *t, unsigned char **raw, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned tag = 0;
+	const KSI_TlvTemplate *tmpl = NULL;
+
+	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = getExtendPduTemplate(t, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_serializeObject(t->ctx, t, tag, 0, 0, tmpl, raw, len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_ExtendPdu_writeBytes(KSI_ExtendPdu *o, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned tag = 0;
+	const KSI_TlvTemplate *tmpl = NULL;
+
+	if (o == NULL || o->ctx == NULL || (buf == NULL && buf_size != 0) || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
+	res = getExtendPduTemplate(o, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_writeBytes(o->ctx, o, tag, 0, 0, tmpl, buf, buf_size, buf_len, opt);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -1735,28 +1774,66 @@ cleanup:
 	return res;
 }
 
-int KSI_AggregationPdu_serialize(const KSI_AggregationPdu *t, unsigned char **raw, size_t *len) {
-	int res = KSI_UNKNOWN_ERROR;
-	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
+/* Selects the outer tag and the template of the aggregation PDU, depending on the PDU version in use. */
+static int getAggregationPduTemplate(const KSI_AggregationPdu *t, unsigned *tag, const KSI_TlvTemplate **tmpl) {
 	if (t->ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
 		KSI_LOG_warn(t->ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x200, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationPdu), raw, len);
+		*tag = 0x200;
+		*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationPdu);
 	} else if (t->ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
 		if (t->request != NULL || t->confRequest != NULL || t->ackRequest != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x220, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationReqPdu), raw, len);
+			*tag = 0x220;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationReqPdu);
 		} else if (t->response != NULL || t->confResponse != NULL || t->ackResponse != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x221, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), raw, len);
+			*tag = 0x221;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationRespPdu);
 		} else {
-			res = KSI_INVALID_FORMAT;
+			return KSI_INVALID_FORMAT;
 		}
 	} else {
-		res = KSI_INVALID_FORMAT;
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
+int KSI_AggregationPdu_serialize(const KSI_AggregationPdu *t, unsigned char **raw, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned tag = 0;
+	const KSI_TlvTemplate *tmpl = NULL;
+
+	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = getAggregationPduTemplate(t, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_serializeObject(t->ctx, t, tag, 0, 0, tmpl, raw, len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_AggregationPdu_writeBytes(KSI_AggregationPdu *o, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned tag = 0;
+	const KSI_TlvTemplate *tmpl = NULL;
+
+	if (o == NULL || o->ctx == NULL || (buf == NULL && buf_size != 0) || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
+	res = getAggregationPduTemplate(o, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_writeBytes(o->ctx, o, tag, 0, 0, tmpl, buf, buf_size, buf_len, opt);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -2063,9 +2140,26 @@ cleanup:
 	return res;
 }
 
+int KSI_AggregationReq_getTemplate(KSI_CTX *ctx, const KSI_AggregationReq *data, const KSI_TlvTemplate **tmpl) {
+	if (ctx == NULL || data == NULL || tmpl == NULL) return KSI_INVALID_ARGUMENT;
+
+	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
+		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
+		*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationReq);
+	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
+		/* A request without a hash is written as an empty element. */
+		*tmpl = data->requestHash != NULL ? KSI_TLV_TEMPLATE(KSI_AggregationReq_v2) : NULL;
+	} else {
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
 int KSI_AggregationReq_toTlv(KSI_CTX *ctx, const KSI_AggregationReq *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv) {
 	int res;
 	KSI_TLV *tmp = NULL;
+	const KSI_TlvTemplate *tmpl = NULL;
 
 	KSI_ERR_clearErrors(ctx);
 
@@ -2080,24 +2174,18 @@ int KSI_AggregationReq_toTlv(KSI_CTX *ctx, const KSI_AggregationReq *data, unsig
 		goto cleanup;
 	}
 
-	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
-		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_AggregationReq));
+	res = KSI_AggregationReq_getTemplate(ctx, data, &tmpl);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (tmpl != NULL) {
+		res = KSI_TlvTemplate_construct(ctx, tmp, data, tmpl);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
-	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
-		if (data->requestHash != NULL) {
-			res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_AggregationReq_v2));
-			if (res != KSI_OK) {
-				KSI_pushError(ctx, res, NULL);
-				goto cleanup;
-			}
-		}
-	} else {
-		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, NULL);
-		goto cleanup;
 	}
 
 	*tlv = tmp;
@@ -2364,9 +2452,25 @@ cleanup:
 	return res;
 }
 
+int KSI_AggregationResp_getTemplate(KSI_CTX *ctx, const KSI_AggregationResp *data, const KSI_TlvTemplate **tmpl) {
+	if (ctx == NULL || data == NULL || tmpl == NULL) return KSI_INVALID_ARGUMENT;
+
+	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
+		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
+		*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationResp);
+	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
+		*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationResp_v2);
+	} else {
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
 int KSI_AggregationResp_toTlv(KSI_CTX *ctx, const KSI_AggregationResp *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv) {
 	int res;
 	KSI_TLV *tmp = NULL;
+	const KSI_TlvTemplate *tmpl = NULL;
 
 	KSI_ERR_clearErrors(ctx);
 
@@ -2381,15 +2485,8 @@ int KSI_AggregationResp_toTlv(KSI_CTX *ctx, const KSI_AggregationResp *data, uns
 		goto cleanup;
 	}
 
-	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
-		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_AggregationResp));
-	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_AggregationResp_v2));
-	} else {
-		res = KSI_INVALID_FORMAT;
-	}
-
+	res = KSI_AggregationResp_getTemplate(ctx, data, &tmpl);
+	if (res == KSI_OK) res = KSI_TlvTemplate_construct(ctx, tmp, data, tmpl);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -2520,9 +2617,26 @@ cleanup:
 	return res;
 }
 
+int KSI_ExtendReq_getTemplate(KSI_CTX *ctx, const KSI_ExtendReq *data, const KSI_TlvTemplate **tmpl) {
+	if (ctx == NULL || data == NULL || tmpl == NULL) return KSI_INVALID_ARGUMENT;
+
+	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
+		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
+		*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendReq);
+	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
+		/* A request without the aggregation time is written as an empty element. */
+		*tmpl = data->aggregationTime != NULL ? KSI_TLV_TEMPLATE(KSI_ExtendReq) : NULL;
+	} else {
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
 int KSI_ExtendReq_toTlv(KSI_CTX *ctx, const KSI_ExtendReq *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv) {
 	int res;
 	KSI_TLV *tmp = NULL;
+	const KSI_TlvTemplate *tmpl = NULL;
 
 	KSI_ERR_clearErrors(ctx);
 
@@ -2537,27 +2651,17 @@ int KSI_ExtendReq_toTlv(KSI_CTX *ctx, const KSI_ExtendReq *data, unsigned tag, i
 		goto cleanup;
 	}
 
-	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
-		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_ExtendReq));
+	res = KSI_ExtendReq_getTemplate(ctx, data, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	if (tmpl != NULL) {
+		res = KSI_TlvTemplate_construct(ctx, tmp, data, tmpl);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
-	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
-		if (data->aggregationTime != NULL) {
-			res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_ExtendReq));
-			if (res != KSI_OK) {
-				KSI_pushError(ctx, res, NULL);
-				goto cleanup;
-			}
-		}
-	} else {
-		res = KSI_INVALID_FORMAT;
-		goto cleanup;
 	}
 
-
 	*tlv = tmp;
 	tmp = NULL;
 
@@ -2803,9 +2907,25 @@ cleanup:
 	return res;
 }
 
+int KSI_ExtendResp_getTemplate(KSI_CTX *ctx, const KSI_ExtendResp *data, const KSI_TlvTemplate **tmpl) {
+	if (ctx == NULL || data == NULL || tmpl == NULL) return KSI_INVALID_ARGUMENT;
+
+	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
+		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
+		*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendResp);
+	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
+		*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendResp_v2);
+	} else {
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
 int KSI_ExtendResp_toTlv(KSI_CTX *ctx, const KSI_ExtendResp *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv) {
 	int res;
 	KSI_TLV *tmp = NULL;
+	const KSI_TlvTemplate *tmpl = NULL;
 
 	KSI_ERR_clearErrors(ctx);
 
@@ -2820,15 +2940,8 @@ int KSI_ExtendResp_toTlv(KSI_CTX *ctx, const KSI_ExtendResp *data, unsigned tag,
 		goto cleanup;
 	}
 
-	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
-		KSI_LOG_warn(ctx, "PDU v1 is deprecated!");
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_ExtendResp));
-	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
-		res = KSI_TlvTemplate_construct(ctx, tmp, data, KSI_TLV_TEMPLATE(KSI_ExtendResp_v2));
-	} else {
-		res = KSI_INVALID_FORMAT;
-	}
-
+	res = KSI_ExtendResp_getTemplate(ctx, data, &tmpl);
+	if (res == KSI_OK) res = KSI_TlvTemplate_construct(ctx, tmp, data, tmpl);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -125,6 +125,7 @@ extern "C" {
 	typedef struct KSI_AsyncService_st KSI_AsyncService;
 	typedef struct KSI_AsyncClient_st KSI_AsyncClient;
 	typedef struct KSI_AsyncHandle_st KSI_AsyncHandle;
+	typedef struct KSI_AsyncSubmitQueue_st KSI_AsyncSubmitQueue;
 
 	/**
 	 * Representation of the aggregation hash chain.
@@ -654,6 +655,7 @@ int KSI_ExtendReq_encloseWithHeader(KSI_ExtendReq *req, KSI_Header *hdr, const c
 
 KSI_DEFINE_OBJECT_PARSE(KSI_ExtendPdu);
 KSI_DEFINE_OBJECT_SERIALIZE(KSI_ExtendPdu);
+KSI_DEFINE_WRITE_BYTES(KSI_ExtendPdu);
 
 /*
  * KSI_ErrorPdu
@@ -697,6 +699,7 @@ int KSI_AggregationReq_encloseWithHeader(KSI_AggregationReq *req, KSI_Header *hd
 int KSI_AggregationReq_enclose(KSI_AggregationReq *req, const char *loginId, const char *key, KSI_AggregationPdu **pdu);
 KSI_DEFINE_OBJECT_PARSE(KSI_AggregationPdu);
 KSI_DEFINE_OBJECT_SERIALIZE(KSI_AggregationPdu);
+KSI_DEFINE_WRITE_BYTES(KSI_AggregationPdu);
 
 /*
  * KSI_Header
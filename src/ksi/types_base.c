@@ -22,6 +22,7 @@
 
 #include "internal.h"
 #include "tlv.h"
+#include "impl/ctx_impl.h"
 
 struct KSI_OctetString_st {
 	KSI_CTX *ctx;
@@ -92,8 +93,8 @@ KSI_IMPLEMENT_LIST(KSI_OctetString, KSI_OctetString_free);
  */
 void KSI_OctetString_free(KSI_OctetString *o) {
 	if (o != NULL && --o->ref == 0) {
-		KSI_free(o->data);
-		KSI_free(o);
+		KSI_CTX_poolFree(o->ctx, o->data, o->data_len);
+		KSI_CTX_poolFree(o->ctx, o, sizeof(KSI_OctetString));
 	}
 }
 
@@ -107,7 +108,7 @@ int KSI_OctetString_new(KSI_CTX *ctx, const unsigned char *data, size_t data_len
 		goto cleanup;
 	}
 
-	tmp = KSI_new(KSI_OctetString);
+	tmp = KSI_CTX_poolAlloc(ctx, sizeof(KSI_OctetString));
 	if (tmp == NULL) {
 		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
@@ -119,7 +120,7 @@ int KSI_OctetString_new(KSI_CTX *ctx, const unsigned char *data, size_t data_len
 	tmp->ref = 1;
 
 	if (data_len > 0) {
-		tmp->data = KSI_malloc(data_len);
+		tmp->data = KSI_CTX_poolAlloc(ctx, data_len);
 		if (tmp->data == NULL) {
 			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
 			goto cleanup;
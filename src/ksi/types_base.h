@@ -89,12 +89,14 @@ int typ##_toTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int
 #define KSI_DEFINE_WRITE_BYTES(typ) \
 	/*!
 	 * This function serializes the #typ object and writes the result into a pre-allocated buffer.
+	 * When \c buf is \c NULL and \c buf_size is 0, only the exact serialized length is calculated.
 	 * \param[in]	o			Object to be serialized.
 	 * \param[in]	buf			Pointer to pre-allocated buffer.
 	 * \param[in]	buf_size	Buffer size.
 	 * \param[out]	buf_len		Serialized buffer length.
 	 * \param[in]	opt			Serialization options.
 	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \return #KSI_BUFFER_OVERFLOW if \c buf is too small for the serialized value.
 	 */\
 	 int typ##_writeBytes(typ *o, unsigned char *buf, size_t buf_size, size_t *buf_len, int opt)
 
@@ -33,6 +33,25 @@
 #  endif
 #endif
 
+/* Threads for the concurrency tests, only available where the platform supports them. */
+#if defined(_WIN32)
+#  include <windows.h>
+#  define TEST_THREADS_SUPPORTED
+#  define TEST_THREAD_FUNC(name, arg) static DWORD WINAPI name(LPVOID arg)
+#  define TEST_THREAD_RETURN return 0
+typedef HANDLE TestThread;
+#  define TestThread_create(t, fn, arg) ((*(t) = CreateThread(NULL, 0, (fn), (arg), 0, NULL)) != NULL ? 0 : -1)
+#  define TestThread_join(t) ((void)WaitForSingleObject((t), INFINITE), (void)CloseHandle((t)))
+#elif defined(HAVE_PTHREAD)
+#  include <pthread.h>
+#  define TEST_THREADS_SUPPORTED
+#  define TEST_THREAD_FUNC(name, arg) static void *name(void *arg)
+#  define TEST_THREAD_RETURN return NULL
+typedef pthread_t TestThread;
+#  define TestThread_create(t, fn, arg) pthread_create((t), NULL, (fn), (arg))
+#  define TestThread_join(t) ((void)pthread_join((t), NULL))
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,11 +18,20 @@
  */
 
 #include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#  define sleep_ms(x) Sleep((x))
+#else
+#  include <unistd.h>
+#  define sleep_ms(x) usleep((x)*1000)
+#endif
 #include <ksi/ksi.h>
 #include <ksi/blocksigner.h>
+#include <ksi/net_async.h>
 
 #include "cutest/CuTest.h"
 #include "all_tests.h"
+#include "test_mock_async.h"
 
 #include "../src/ksi/impl/ctx_impl.h"
 #include "../src/ksi/impl/net_http_impl.h"
@@ -305,6 +314,756 @@ static void testMaskingWithMetaDataAndLevel(CuTest *tc) {
 #undef TEST_AGGR_RESPONSE_FILE
 }
 
+struct SignatureSink_st {
+	KSI_BlockSignerHandle **hndl;
+	size_t count;
+	int mismatch;
+};
+
+static int compareSignatureSink(void *c, size_t i, const unsigned char *raw, size_t raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	struct SignatureSink_st *sink = c;
+	KSI_Signature *sig = NULL;
+	unsigned char *ref = NULL;
+	size_t ref_len = 0;
+
+	res = KSI_BlockSignerHandle_getSignature(sink->hndl[i], &sig);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Signature_serialize(sig, &ref, &ref_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (ref_len != raw_len || memcmp(ref, raw, raw_len)) sink->mismatch++;
+	sink->count++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(ref);
+	KSI_Signature_free(sig);
+
+	return res;
+}
+
+static void testWriteSignatures(CuTest *tc) {
+#define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/test-masking-lvl-metadata-root-sig-lvl-12-hash-1e1587ca82-response.tlv"
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	int i;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *prev = NULL;
+	KSI_OctetString *iv = NULL;
+	const char *userId[] = { "Alice", "Bob", "Claire", "Delta", "Mansion", "Nugget", "Kate", "Redis", NULL };
+	KSI_BlockSignerHandle *hndl[sizeof(userId)] = {NULL};
+	KSI_MetaData *md = NULL;
+	struct SignatureSink_st sink;
+	const unsigned char ivDat[] = {0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1};
+
+	KSI_OctetString_new(ctx, ivDat, sizeof(ivDat), &iv);
+	KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &prev);
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, prev, iv, &bs);
+	CuAssert(tc, "Unable to create data hash with masking.", res == KSI_OK && bs != NULL);
+
+	for (i = 0; userId[i] != NULL; ++i) {
+		res = createMetaData(userId[i], &md);
+		CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+		res = KSI_BlockSigner_addLeaf(bs, hsh, i, md, &hndl[i]);
+		CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK && hndl[i] != NULL);
+
+		KSI_MetaData_free(md);
+		md = NULL;
+	}
+
+	sink.hndl = hndl;
+	sink.count = 0;
+	sink.mismatch = 0;
+
+	res = KSI_BlockSigner_writeSignatures(bs, compareSignatureSink, &sink);
+	CuAssert(tc, "Signatures may not be written before the block signer is closed.", res == KSI_INVALID_STATE);
+
+	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Failed to set aggregator.", res == KSI_OK);
+
+	res = KSI_BlockSigner_closeAndSign(bs);
+	CuAssert(tc, "Unable to close the blocksigner.", res == KSI_OK);
+
+	/* The bulk output must match the signatures extracted one by one. */
+	res = KSI_BlockSigner_writeSignatures(bs, compareSignatureSink, &sink);
+	CuAssert(tc, "Unable to write the signatures.", res == KSI_OK);
+	CuAssert(tc, "Signature count mismatch.", sink.count == (size_t)i);
+	CuAssert(tc, "Bulk signature output differs from the extracted signatures.", sink.mismatch == 0);
+
+	for (i = 0; userId[i] != NULL; i++) {
+		KSI_BlockSignerHandle_free(hndl[i]);
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_BlockSigner_free(bs);
+	KSI_OctetString_free(iv);
+	KSI_DataHash_free(prev);
+#undef TEST_AGGR_RESPONSE_FILE
+}
+
+struct ProofBuffer_st {
+	unsigned char buf[0x20000];
+	size_t len;
+};
+
+static int proofSink(void *c, const unsigned char *raw, size_t raw_len) {
+	struct ProofBuffer_st *proof = c;
+
+	if (sizeof(proof->buf) - proof->len < raw_len) return KSI_BUFFER_OVERFLOW;
+
+	memcpy(proof->buf + proof->len, raw, raw_len);
+	proof->len += raw_len;
+
+	return KSI_OK;
+}
+
+/* Reads the header of a TLV, returns the header length. */
+static size_t readTlvHeader(const unsigned char *raw, unsigned *tag, size_t *len) {
+	if (raw[0] & 0x80) {
+		*tag = ((raw[0] & 0x1f) << 8) | raw[1];
+		*len = ((size_t)raw[2] << 8) | raw[3];
+		return 4;
+	}
+	*tag = raw[0] & 0x1f;
+	*len = raw[1];
+	return 2;
+}
+
+/* Returns the offset of the last value byte of the first element with the given tag in the chain template. */
+static size_t findTemplateElement(CuTest *tc, const struct ProofBuffer_st *buf, unsigned tag) {
+	unsigned t;
+	size_t len;
+	size_t offset = 8 + readTlvHeader(buf->buf + 8, &t, &len);
+	size_t end = offset + len;
+
+	CuAssert(tc, "Proof magic expected.", memcmp(buf->buf, "KSIBLKPF", 8) == 0);
+	CuAssert(tc, "Proof header expected.", t == 0x0b01);
+
+	while (offset < end) {
+		size_t hdr_len = readTlvHeader(buf->buf + offset, &t, &len);
+
+		if (t == 0x03) {
+			size_t tmplEnd = offset + hdr_len + len;
+
+			offset += hdr_len;
+			while (offset < tmplEnd) {
+				hdr_len = readTlvHeader(buf->buf + offset, &t, &len);
+				if (t == tag) return offset + hdr_len + len - 1;
+				offset += hdr_len + len;
+			}
+			break;
+		}
+		offset += hdr_len + len;
+	}
+
+	CuFail(tc, "Chain template element not found.");
+	return 0;
+}
+
+static void assertAlteredProofFails(CuTest *tc, struct ProofBuffer_st *buf, size_t offset, KSI_VerificationContext *context, KSI_VerificationErrorCode error) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockProof *proof = NULL;
+	KSI_PolicyVerificationResult *result = NULL;
+
+	buf->buf[offset] ^= 0x01;
+
+	res = KSI_BlockProof_parse(ctx, buf->buf, buf->len, &proof);
+	CuAssert(tc, "Unable to parse the block proof.", res == KSI_OK && proof != NULL);
+
+	res = KSI_BlockProof_verify(proof, KSI_VERIFICATION_POLICY_INTERNAL, context, &result);
+	CuAssert(tc, "Unable to verify the block proof.", res == KSI_OK && result != NULL);
+	CuAssert(tc, "Altered block proof must not verify.", result->finalResult.resultCode == KSI_VER_RES_FAIL);
+	CuAssert(tc, "Unexpected verification error.", result->finalResult.errorCode == error);
+
+	KSI_PolicyVerificationResult_free(result);
+	KSI_BlockProof_free(proof);
+
+	buf->buf[offset] ^= 0x01;
+}
+
+static void testBlockProof(CuTest *tc) {
+#define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/test-masking-lvl-metadata-root-sig-lvl-12-hash-1e1587ca82-response.tlv"
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	size_t i;
+	size_t count = 0;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *prev = NULL;
+	KSI_OctetString *iv = NULL;
+	const char *userId[] = { "Alice", "Bob", "Claire", "Delta", "Mansion", "Nugget", "Kate", "Redis", NULL };
+	KSI_BlockSignerHandle *hndl[sizeof(userId)] = {NULL};
+	KSI_MetaData *md = NULL;
+	KSI_BlockProof *proof = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_PolicyVerificationResult *result = NULL;
+	KSI_VerificationContext context;
+	struct SignatureSink_st sink;
+	static struct ProofBuffer_st buf;
+	const unsigned char ivDat[] = {0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1,
+		0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1};
+
+	buf.len = 0;
+
+	KSI_OctetString_new(ctx, ivDat, sizeof(ivDat), &iv);
+	KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &prev);
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, prev, iv, &bs);
+	CuAssert(tc, "Unable to create data hash with masking.", res == KSI_OK && bs != NULL);
+
+	for (i = 0; userId[i] != NULL; ++i) {
+		res = createMetaData(userId[i], &md);
+		CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+		res = KSI_BlockSigner_addLeaf(bs, hsh, (int)i, md, &hndl[i]);
+		CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK && hndl[i] != NULL);
+
+		KSI_MetaData_free(md);
+		md = NULL;
+	}
+
+	res = KSI_BlockSigner_writeProof(bs, proofSink, &buf);
+	CuAssert(tc, "Block proof may not be written before the block signer is closed.", res == KSI_INVALID_STATE);
+
+	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Failed to set aggregator.", res == KSI_OK);
+
+	res = KSI_BlockSigner_closeAndSign(bs);
+	CuAssert(tc, "Unable to close the blocksigner.", res == KSI_OK);
+
+	res = KSI_BlockSigner_writeProof(bs, proofSink, &buf);
+	CuAssert(tc, "Unable to write the block proof.", res == KSI_OK && buf.len > 0);
+
+	res = KSI_BlockProof_parse(ctx, buf.buf, buf.len, &proof);
+	CuAssert(tc, "Unable to parse the block proof.", res == KSI_OK && proof != NULL);
+
+	res = KSI_BlockProof_getLeafCount(proof, &count);
+	CuAssert(tc, "Leaf count mismatch.", res == KSI_OK && count == i);
+
+	/* The reconstructed signatures must match the signatures extracted one by one. */
+	sink.hndl = hndl;
+	sink.count = 0;
+	sink.mismatch = 0;
+
+	for (i = 0; i < count; i++) {
+		unsigned char *raw = NULL;
+		size_t raw_len = 0;
+
+		res = KSI_BlockProof_getSignature(proof, i, &sig);
+		CuAssert(tc, "Unable to reconstruct the leaf signature.", res == KSI_OK && sig != NULL);
+
+		res = KSI_Signature_serialize(sig, &raw, &raw_len);
+		CuAssert(tc, "Unable to serialize the leaf signature.", res == KSI_OK);
+
+		res = compareSignatureSink(&sink, i, raw, raw_len);
+		CuAssert(tc, "Unable to compare the leaf signature.", res == KSI_OK);
+
+		KSI_free(raw);
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+	CuAssert(tc, "Reconstructed signatures differ from the extracted signatures.", sink.count == count && sink.mismatch == 0);
+
+	res = KSI_BlockProof_getSignature(proof, count, &sig);
+	CuAssert(tc, "Leaf index out of range must fail.", res == KSI_INVALID_ARGUMENT && sig == NULL);
+
+	res = KSI_VerificationContext_init(&context, ctx);
+	CuAssert(tc, "Unable to initialize the verification context.", res == KSI_OK);
+
+	res = KSI_BlockProof_verify(proof, KSI_VERIFICATION_POLICY_INTERNAL, &context, &result);
+	CuAssert(tc, "Unable to verify the block proof.", res == KSI_OK && result != NULL);
+	CuAssert(tc, "Block proof verification failed.", result->finalResult.resultCode == KSI_VER_RES_OK);
+	CuAssert(tc, "Verification context must be left unchanged.", context.signature == NULL);
+
+	KSI_PolicyVerificationResult_free(result);
+	result = NULL;
+	KSI_BlockProof_free(proof);
+	proof = NULL;
+
+	/* The shared header elements must match the block signature. */
+	assertAlteredProofFails(tc, &buf, findTemplateElement(tc, &buf, 0x02), &context, KSI_VER_ERR_INT_2);
+	assertAlteredProofFails(tc, &buf, findTemplateElement(tc, &buf, 0x03), &context, KSI_VER_ERR_INT_12);
+
+	/* Alter the sibling hash of the last link of the last leaf. */
+	assertAlteredProofFails(tc, &buf, buf.len - 1, &context, KSI_VER_ERR_INT_1);
+	buf.buf[buf.len - 1] ^= 0x01;
+
+	res = KSI_BlockProof_parse(ctx, buf.buf, buf.len - 1, &proof);
+	CuAssert(tc, "Truncated block proof must not parse.", res != KSI_OK && proof == NULL);
+
+	/* The magic is followed by the header, starting with the format version. */
+	CuAssert(tc, "Version field expected.", buf.buf[12] == 0x04 && buf.buf[13] == 0x01 && buf.buf[14] == 0x01);
+	buf.buf[14] = 0x02;
+	res = KSI_BlockProof_parse(ctx, buf.buf, buf.len, &proof);
+	CuAssert(tc, "Unknown block proof version must not parse.", res == KSI_INVALID_FORMAT && proof == NULL);
+	buf.buf[14] = 0x01;
+
+	buf.buf[0] ^= 0x01;
+	res = KSI_BlockProof_parse(ctx, buf.buf, buf.len, &proof);
+	CuAssert(tc, "Block proof without the magic must not parse.", res == KSI_INVALID_FORMAT && proof == NULL);
+	buf.buf[0] ^= 0x01;
+
+	KSI_VerificationContext_clean(&context);
+
+	for (i = 0; userId[i] != NULL; i++) {
+		KSI_BlockSignerHandle_free(hndl[i]);
+	}
+
+	KSI_BlockProof_free(proof);
+	KSI_DataHash_free(hsh);
+	KSI_BlockSigner_free(bs);
+	KSI_OctetString_free(iv);
+	KSI_DataHash_free(prev);
+#undef TEST_AGGR_RESPONSE_FILE
+}
+
+struct PipelineResult_st {
+	struct SignatureSink_st sink;
+	size_t blocks;
+	int error;
+	int writeRes;
+};
+
+static int pipelineCallback(KSI_BlockSigner *block, int error, void *userp) {
+	struct PipelineResult_st *result = userp;
+
+	result->blocks++;
+	result->error = error;
+	if (error == KSI_OK) {
+		result->writeRes = KSI_BlockSigner_writeSignatures(block, compareSignatureSink, &result->sink);
+	}
+
+	return KSI_OK;
+}
+
+static void testPipelined(CuTest *tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/test_masking_response.tlv",
+	};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSignerHandle *hndl[101];
+	size_t i;
+	size_t pending = 0;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *prev = NULL;
+	KSI_OctetString *iv = NULL;
+	const unsigned char ivDat[] = {0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1};
+	struct PipelineResult_st result;
+
+	result.sink.hndl = hndl;
+	result.sink.count = 0;
+	result.sink.mismatch = 0;
+	result.blocks = 0;
+	result.error = KSI_UNKNOWN_ERROR;
+	result.writeRes = KSI_UNKNOWN_ERROR;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 1, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	/* Same input as in testMasking, thus the root of the first block matches the response. */
+	KSI_OctetString_new(ctx, ivDat, sizeof(ivDat), &iv);
+	KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &prev);
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, prev, iv, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	res = KSI_BlockSigner_setAsyncService(bs, as, pipelineCallback, &result);
+	CuAssert(tc, "Unable to set async service.", res == KSI_OK);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)101);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	for (i = 0; i < 101; i++) {
+		res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &hndl[i]);
+		CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK && hndl[i] != NULL);
+	}
+
+	res = KSI_BlockSigner_getPendingCount(bs, &pending);
+	CuAssert(tc, "The block should have been sealed.", res == KSI_OK && pending == 1);
+
+	res = KSI_BlockSigner_closeAndSign(bs);
+	CuAssert(tc, "Synchronous signing is not available in the pipelined mode.", res == KSI_INVALID_STATE);
+
+	/* New leafs go into the next block while the first one is being signed. */
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add leaf hash to the next block.", res == KSI_OK);
+
+	res = KSI_BlockSigner_seal(bs, 0);
+	CuAssert(tc, "The next block should not be sealed yet.", res == KSI_OK && KSI_BlockSigner_getPendingCount(bs, &pending) == KSI_OK && pending == 1);
+
+	for (i = 0; i < 10 && result.blocks == 0; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+	}
+
+	CuAssert(tc, "The block was not delivered.", result.blocks == 1);
+	CuAssert(tc, "The block was not signed.", result.error == KSI_OK);
+	CuAssert(tc, "Unable to write the signatures.", result.writeRes == KSI_OK && result.sink.count == 101 && result.sink.mismatch == 0);
+
+	res = KSI_BlockSigner_getPendingCount(bs, &pending);
+	CuAssert(tc, "No blocks should be pending.", res == KSI_OK && pending == 0);
+
+	for (i = 0; i < 101; i++) {
+		KSI_BlockSignerHandle_free(hndl[i]);
+	}
+
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+	KSI_DataHash_free(prev);
+	KSI_OctetString_free(iv);
+}
+
+static void testPipelinedMaskingChain(CuTest *tc) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSigner *pbs = NULL;
+	size_t pending = 0;
+	KSI_DataHash *prev = NULL;
+	KSI_DataHash *expected = NULL;
+	KSI_DataHash *actual = NULL;
+	KSI_OctetString *iv = NULL;
+	const unsigned char ivDat[] = {0x01, 0x02, 0xff, 0xfe, 0xaa, 0xa9, 0xf1, 0x55, 0x23, 0x51, 0xa1};
+	struct PipelineResult_st result;
+
+	result.blocks = 0;
+
+	KSI_OctetString_new(ctx, ivDat, sizeof(ivDat), &iv);
+	KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &prev);
+
+	/* The masking chain of a single synchronous block. */
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, prev, iv, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	addInput(tc, bs, 1);
+
+	res = KSI_BlockSigner_getPrevLeaf(bs, &expected);
+	CuAssert(tc, "Unable to get the last leaf.", res == KSI_OK && expected != NULL);
+
+	/* The same leafs split into blocks of three leafs. */
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)10);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, prev, iv, &pbs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && pbs != NULL);
+
+	res = KSI_BlockSigner_setAsyncService(pbs, as, pipelineCallback, &result);
+	CuAssert(tc, "Unable to set async service.", res == KSI_OK);
+
+	res = KSI_BlockSigner_setOption(pbs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)3);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	addInput(tc, pbs, 1);
+
+	res = KSI_BlockSigner_getPendingCount(pbs, &pending);
+	CuAssert(tc, "Two blocks should have been sealed.", res == KSI_OK && pending == 2);
+
+	res = KSI_BlockSigner_getPrevLeaf(pbs, &actual);
+	CuAssert(tc, "Unable to get the last leaf.", res == KSI_OK && actual != NULL);
+	CuAssert(tc, "The masking chain was not carried over.", KSI_DataHash_equals(expected, actual));
+
+	/* Flush the last block. */
+	res = KSI_BlockSigner_seal(pbs, 1);
+	CuAssert(tc, "Unable to seal the block.", res == KSI_OK && KSI_BlockSigner_getPendingCount(pbs, &pending) == KSI_OK && pending == 3);
+
+	/* The pending blocks are dropped together with the signer. */
+	KSI_BlockSigner_free(pbs);
+	KSI_AsyncService_free(as);
+	CuAssert(tc, "No blocks should have been delivered.", result.blocks == 0);
+
+	KSI_BlockSigner_free(bs);
+	KSI_DataHash_free(expected);
+	KSI_DataHash_free(actual);
+	KSI_DataHash_free(prev);
+	KSI_OctetString_free(iv);
+}
+
+static void newPipelinedSigner(CuTest *tc, KSI_AsyncService *as, struct PipelineResult_st *result, KSI_BlockSigner **bs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	result->sink.count = 0;
+	result->blocks = 0;
+	result->error = KSI_OK;
+	result->writeRes = KSI_OK;
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && *bs != NULL);
+
+	res = KSI_BlockSigner_setAsyncService(*bs, as, pipelineCallback, result);
+	CuAssert(tc, "Unable to set async service.", res == KSI_OK);
+}
+
+static void assertPendingCount(CuTest *tc, const char *msg, KSI_BlockSigner *bs, size_t expected) {
+	size_t pending = 0;
+
+	CuAssert(tc, msg, KSI_BlockSigner_getPendingCount(bs, &pending) == KSI_OK && pending == expected);
+}
+
+static void testPipelinedMaxBytes(CuTest *tc) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_DataHash *hsh = NULL;
+	struct PipelineResult_st result;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	newPipelinedSigner(tc, as, &result, &bs);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_BYTES, (void *)100);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addInputSize(bs, 60);
+	CuAssert(tc, "Unable to add input size.", res == KSI_OK);
+	assertPendingCount(tc, "The block should not be sealed below the threshold.", bs, 0);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addInputSize(bs, 40);
+	CuAssert(tc, "Unable to add input size.", res == KSI_OK);
+	assertPendingCount(tc, "The block should be sealed at the threshold.", bs, 1);
+
+	/* The input size of the next block starts from zero. */
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addInputSize(bs, 60);
+	CuAssert(tc, "Unable to add input size.", res == KSI_OK);
+	assertPendingCount(tc, "The next block should not be sealed yet.", bs, 1);
+
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+	CuAssert(tc, "No blocks should have been delivered.", result.blocks == 0);
+}
+
+static void testPipelinedMaxAge(CuTest *tc) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_DataHash *hsh = NULL;
+	struct PipelineResult_st result;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	newPipelinedSigner(tc, as, &result, &bs);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_AGE, (void *)50);
+	CuAssert(tc, "Unable to set block age.", res == KSI_OK);
+
+	/* An empty block is never sealed. */
+	sleep_ms(60);
+	res = KSI_BlockSigner_seal(bs, 0);
+	CuAssert(tc, "Unable to seal the block.", res == KSI_OK);
+	assertPendingCount(tc, "An empty block should not be sealed.", bs, 0);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add leaf hash to the block signer.", res == KSI_OK);
+
+	res = KSI_BlockSigner_seal(bs, 0);
+	CuAssert(tc, "Unable to seal the block.", res == KSI_OK);
+	assertPendingCount(tc, "A fresh block should not be sealed.", bs, 0);
+
+	sleep_ms(60);
+	res = KSI_BlockSigner_seal(bs, 0);
+	CuAssert(tc, "Unable to seal the block.", res == KSI_OK);
+	assertPendingCount(tc, "The expired block should be sealed.", bs, 1);
+
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+}
+
+static void testPipelinedSealFailure(CuTest *tc) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSignerHandle *hndl = NULL;
+	KSI_DataHash *hsh = NULL;
+	struct PipelineResult_st result;
+
+	/* The service without an endpoint rejects the requests. */
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	newPipelinedSigner(tc, as, &result, &bs);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)1);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	/* The leaf is accepted, the failure is only reported via the completion callback. */
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &hndl);
+	CuAssert(tc, "The leaf should have been accepted.", res == KSI_OK && hndl != NULL);
+	CuAssert(tc, "The failure was not reported.", result.blocks == 1 && result.error != KSI_OK);
+	assertPendingCount(tc, "The failed block should not be pending.", bs, 0);
+
+	/* An explicit seal also returns the error. */
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)0);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "The leaf should have been accepted.", res == KSI_OK);
+
+	res = KSI_BlockSigner_seal(bs, 1);
+	CuAssert(tc, "The seal failure was not returned.", res != KSI_OK && res == result.error);
+	CuAssert(tc, "The failure was not reported.", result.blocks == 2);
+	assertPendingCount(tc, "The failed block should not be pending.", bs, 0);
+
+	KSI_BlockSignerHandle_free(hndl);
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+}
+
+static void testPipelinedCacheFull(CuTest *tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+	};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_DataHash *hsh = NULL;
+	size_t i;
+	size_t count = 0;
+	struct PipelineResult_st result;
+
+	/* The default request cache holds a single request. */
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	newPipelinedSigner(tc, as, &result, &bs);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)1);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+		CuAssert(tc, "The leaf should have been accepted.", res == KSI_OK);
+	}
+	CuAssert(tc, "The queued blocks should not be failed.", result.blocks == 0);
+	assertPendingCount(tc, "The blocks should be queued.", bs, 3);
+
+	/* Finish the first block, which frees the cache slot for the next one. */
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 1, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, NULL, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+	CuAssert(tc, "The first block was not delivered.", result.blocks == 1 && result.error != KSI_OK);
+	assertPendingCount(tc, "The rest of the blocks should still be waiting.", bs, 2);
+
+	res = KSI_AsyncService_getPendingCount(as, &count);
+	CuAssert(tc, "The next queued block should have been submitted.", res == KSI_OK && count == 1);
+
+	res = KSI_BlockSigner_seal(bs, 0);
+	CuAssert(tc, "Unable to seal the block.", res == KSI_OK);
+	assertPendingCount(tc, "The rest of the blocks should still be waiting.", bs, 2);
+
+	res = KSI_AsyncService_getPendingCount(as, &count);
+	CuAssert(tc, "The cache should still hold a single request.", res == KSI_OK && count == 1);
+
+	/* The queued blocks are dropped together with the signer. */
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+	CuAssert(tc, "No more blocks should have been delivered.", result.blocks == 1);
+}
+
+static void testPipelinedCacheFullDrain(CuTest *tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+	};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *as = NULL;
+	KSI_BlockSigner *bs = NULL;
+	KSI_DataHash *hsh = NULL;
+	size_t i;
+	size_t count = 0;
+	struct PipelineResult_st result;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	KSITest_DataHash_fromStr(ctx, "01004313f53502a18fe4a31ae0197ab09d4597042942a3a54e846fa01ff5479fa2", &hsh);
+	newPipelinedSigner(tc, as, &result, &bs);
+
+	res = KSI_BlockSigner_setOption(bs, KSI_BLOCK_SIGNER_OPT_MAX_LEAVES, (void *)1);
+	CuAssert(tc, "Unable to set block size.", res == KSI_OK);
+
+	for (i = 0; i < 5; i++) {
+		res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+		CuAssert(tc, "The leaf should have been accepted.", res == KSI_OK);
+	}
+	assertPendingCount(tc, "The blocks should be queued.", bs, 5);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 5, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	/* No signer calls, each finished block makes room for the next queued one. */
+	for (i = 0; i < 20 && result.blocks < 5; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+	}
+
+	CuAssert(tc, "Not all of the queued blocks were delivered.", result.blocks == 5);
+	assertPendingCount(tc, "No blocks should be pending.", bs, 0);
+
+	res = KSI_AsyncService_getPendingCount(as, &count);
+	CuAssert(tc, "No requests should be pending.", res == KSI_OK && count == 0);
+
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+}
+
 static void testIdentityMedaData(CuTest *tc) {
 #define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/test_meta_data_response.tlv"
 	int res = KSI_UNKNOWN_ERROR;
@@ -400,6 +1159,7 @@ static void testSingle(CuTest *tc) {
 	KSI_Signature *sig = NULL;
 	unsigned char *raw = NULL;
 	size_t len = 0;
+	struct SignatureSink_st sink;
 
 	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
 	CuAssert(tc, "Unable to set aggregator file URI.", res == KSI_OK);
@@ -424,6 +1184,13 @@ static void testSingle(CuTest *tc) {
 
 	KSI_LOG_logBlob(ctx, KSI_LOG_DEBUG, "Serialized single signature from block signer.", raw, len);
 
+	sink.hndl = &h;
+	sink.count = 0;
+	sink.mismatch = 0;
+
+	res = KSI_BlockSigner_writeSignatures(bs, compareSignatureSink, &sink);
+	CuAssert(tc, "Unable to write the signatures.", res == KSI_OK && sink.count == 1 && sink.mismatch == 0);
+
 	KSI_BlockSignerHandle_free(h);
 	KSI_Signature_free(sig);
 	KSI_BlockSigner_free(bs);
@@ -656,6 +1423,15 @@ CuSuite* KSITest_Blocksigner_getSuite(void) {
 	SUITE_ADD_TEST(suite, testMaskingWithMetaDataAndLevel);
 	SUITE_ADD_TEST(suite, testMedaData);
 	SUITE_ADD_TEST(suite, testIdentityMedaData);
+	SUITE_ADD_TEST(suite, testWriteSignatures);
+	SUITE_ADD_TEST(suite, testBlockProof);
+	SUITE_ADD_TEST(suite, testPipelined);
+	SUITE_ADD_TEST(suite, testPipelinedMaskingChain);
+	SUITE_ADD_TEST(suite, testPipelinedMaxBytes);
+	SUITE_ADD_TEST(suite, testPipelinedMaxAge);
+	SUITE_ADD_TEST(suite, testPipelinedSealFailure);
+	SUITE_ADD_TEST(suite, testPipelinedCacheFull);
+	SUITE_ADD_TEST(suite, testPipelinedCacheFullDrain);
 	SUITE_ADD_TEST(suite, testSingle);
 	SUITE_ADD_TEST(suite, testReset);
 	SUITE_ADD_TEST(suite, testCreateBlockSigner);
@@ -23,6 +23,7 @@
 #include "all_tests.h"
 
 #include "../src/ksi/internal.h"
+#include "../src/ksi/tlv.h"
 #include "../src/ksi/impl/ctx_impl.h"
 
 static int mockInitCount = 0;
@@ -201,6 +202,50 @@ static void TestCtxOptions_hmacAlgorithm(CuTest *tc) {
 	KSI_CTX_free(ctx);
 }
 
+static void TestCtxObjectPool(CuTest *tc) {
+	int res;
+	KSI_CTX *ctx = NULL;
+	KSI_OctetString *a = NULL;
+	KSI_OctetString *b = NULL;
+	unsigned char data[] = {0x01, 0x02, 0x03, 0x04};
+	void *first = NULL;
+	size_t pooled = 0;
+	size_t i;
+
+	res = KSITest_CTX_clone(&ctx);
+	CuAssert(tc, "Unable to create KSI context.", res == KSI_OK && ctx != NULL);
+	CuAssert(tc, "Object pool should be disabled by default.", ctx->options[KSI_OPT_OBJECT_POOL_SIZE] == 0);
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_OBJECT_POOL_SIZE, (void*)16);
+	CuAssert(tc, "Unable to set object pool size.", res == KSI_OK);
+
+	res = KSI_OctetString_new(ctx, data, sizeof(data), &a);
+	CuAssert(tc, "Unable to create octet string.", res == KSI_OK && a != NULL);
+	first = a;
+	KSI_OctetString_free(a);
+
+	res = KSI_OctetString_new(ctx, data, sizeof(data), &b);
+	CuAssert(tc, "Unable to create octet string.", res == KSI_OK && b != NULL);
+	CuAssert(tc, "Released object should have been reused.", (void *)b == first);
+	KSI_OctetString_free(b);
+	b = NULL;
+
+	/* Disable the pool - released objects must not be kept. */
+	res = KSI_CTX_setOption(ctx, KSI_OPT_OBJECT_POOL_SIZE, (void*)0);
+	CuAssert(tc, "Unable to set object pool size.", res == KSI_OK);
+
+	for (i = 0; i < KSI_OBJECT_POOL_CLASSES; i++) pooled += ctx->objectPoolLen[i];
+
+	res = KSI_OctetString_new(ctx, data, sizeof(data), &a);
+	CuAssert(tc, "Unable to create octet string.", res == KSI_OK && a != NULL);
+	KSI_OctetString_free(a);
+
+	for (i = 0; i < KSI_OBJECT_POOL_CLASSES; i++) pooled -= ctx->objectPoolLen[i];
+	CuAssert(tc, "Object pool should not grow when disabled.", pooled == 2);
+
+	KSI_CTX_free(ctx);
+}
+
 CuSuite* KSITest_CTX_getSuite(void)
 {
 	CuSuite* suite = CuSuiteNew();
@@ -211,6 +256,7 @@ CuSuite* KSITest_CTX_getSuite(void)
 	SUITE_ADD_TEST(suite, TestGetBaseError);
 	SUITE_ADD_TEST(suite, TestCtxOptions_pduVersion);
 	SUITE_ADD_TEST(suite, TestCtxOptions_hmacAlgorithm);
+	SUITE_ADD_TEST(suite, TestCtxObjectPool);
 
 	return suite;
 }
@@ -22,6 +22,7 @@
 
 #include "cutest/CuTest.h"
 #include "all_tests.h"
+#include <ksi/io.h>
 
 extern KSI_CTX *ctx;
 
@@ -729,6 +730,255 @@ void testOpenCloseNoContext(CuTest *tc) {
 	KSI_DataHash_free(hsh);
 }
 
+static void testCreateBatch(CuTest *tc) {
+	const char *input[] = {"LAPTOP", "", "correct horse battery staple", NULL};
+	const void *data[4];
+	size_t data_len[4];
+	unsigned char imprints[4 * (KSI_MAX_IMPRINT_LEN + 1)];
+	size_t imprint_len = KSI_getHashLength(KSI_HASHALG_SHA2_256) + 1;
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *exp = NULL;
+	size_t exp_len = 0;
+	size_t i;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 4; i++) {
+		data[i] = input[i];
+		data_len[i] = input[i] == NULL ? 0 : strlen(input[i]);
+	}
+
+	res = KSI_DataHash_createBatch(ctx, data, data_len, 4, KSI_HASHALG_SHA2_256, imprints, sizeof(imprints));
+	CuAssert(tc, "Unable to create hashes in batch.", res == KSI_OK);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_DataHash_create(ctx, input[i], data_len[i], KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_DataHash_getImprint(hsh, &exp, &exp_len);
+		CuAssert(tc, "Unable to get imprint.", res == KSI_OK && exp_len == imprint_len);
+		CuAssert(tc, "Batch imprint mismatch.", !memcmp(exp, imprints + i * imprint_len, imprint_len));
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	res = KSI_DataHash_createBatch(ctx, data, data_len, 4, KSI_HASHALG_SHA2_256, imprints, 4 * imprint_len - 1);
+	CuAssert(tc, "Short imprint buffer must be rejected.", res == KSI_BUFFER_OVERFLOW);
+
+	/* A missing input with a non-zero length may not be hashed as an empty input. */
+	memset(imprints, 0, sizeof(imprints));
+	data[2] = NULL;
+	res = KSI_DataHash_createBatch(ctx, data, data_len, 4, KSI_HASHALG_SHA2_256, imprints, sizeof(imprints));
+	CuAssert(tc, "Missing input data must be rejected.", res == KSI_INVALID_ARGUMENT);
+	for (i = 0; i < sizeof(imprints); i++) {
+		CuAssert(tc, "No imprints may be written for rejected inputs.", imprints[i] == 0);
+	}
+}
+
+static void testImprintValue(CuTest *tc) {
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *left = NULL;
+	KSI_DataHash *right = NULL;
+	KSI_DataHash *exp = NULL;
+	KSI_Imprint leftImprint;
+	KSI_Imprint rightImprint;
+	KSI_Imprint root;
+	unsigned char level = 1;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_DataHash_create(ctx, "LEFT", 4, KSI_HASHALG_SHA2_256, &left);
+	CuAssert(tc, "Unable to create hash.", res == KSI_OK && left != NULL);
+
+	res = KSI_DataHash_create(ctx, "RIGHT", 5, KSI_HASHALG_SHA2_256, &right);
+	CuAssert(tc, "Unable to create hash.", res == KSI_OK && right != NULL);
+
+	/* Reference value calculated with the heap allocated objects. */
+	res = KSI_DataHasher_open(ctx, KSI_HASHALG_SHA2_256, &hsr);
+	CuAssert(tc, "Unable to open hasher.", res == KSI_OK && hsr != NULL);
+
+	res = KSI_DataHasher_addImprint(hsr, left);
+	CuAssert(tc, "Unable to add imprint.", res == KSI_OK);
+
+	res = KSI_DataHasher_addImprint(hsr, right);
+	CuAssert(tc, "Unable to add imprint.", res == KSI_OK);
+
+	res = KSI_DataHasher_add(hsr, &level, 1);
+	CuAssert(tc, "Unable to add level.", res == KSI_OK);
+
+	res = KSI_DataHasher_close(hsr, &exp);
+	CuAssert(tc, "Unable to close hasher.", res == KSI_OK && exp != NULL);
+
+	res = KSI_Imprint_fromDataHash(left, &leftImprint);
+	CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+
+	res = KSI_Imprint_fromDataHash(right, &rightImprint);
+	CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+	CuAssert(tc, "Different imprints must not be equal.", !KSI_Imprint_equals(&leftImprint, &rightImprint));
+
+	res = KSI_Imprint_aggregate(hsr, &leftImprint, &rightImprint, level, &root);
+	CuAssert(tc, "Unable to aggregate imprints.", res == KSI_OK);
+
+	res = KSI_Imprint_fromDataHash(exp, &rightImprint);
+	CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+	CuAssert(tc, "Aggregated imprint mismatch.", KSI_Imprint_equals(&root, &rightImprint));
+
+	/* The output may alias one of the inputs. */
+	res = KSI_Imprint_fromDataHash(right, &rightImprint);
+	CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+
+	res = KSI_Imprint_aggregate(hsr, &leftImprint, &rightImprint, level, &leftImprint);
+	CuAssert(tc, "Unable to aggregate imprints in place.", res == KSI_OK);
+	CuAssert(tc, "Aggregated imprint mismatch.", KSI_Imprint_equals(&root, &leftImprint));
+
+	KSI_DataHash_free(exp);
+	exp = NULL;
+
+	res = KSI_Imprint_toDataHash(ctx, &root, &exp);
+	CuAssert(tc, "Unable to create data hash from imprint.", res == KSI_OK && exp != NULL);
+
+	res = KSI_Imprint_fromDataHash(exp, &rightImprint);
+	CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+	CuAssert(tc, "Imprint and data hash differ.", KSI_Imprint_equals(&root, &rightImprint));
+
+	KSI_DataHash_free(exp);
+	KSI_DataHash_free(left);
+	KSI_DataHash_free(right);
+	KSI_DataHasher_free(hsr);
+}
+
+static void testResetFromPrototype(CuTest *tc) {
+	KSI_HashAlgorithm algos[] = {KSI_HASHALG_SHA1, KSI_HASHALG_SHA2_256, KSI_HASHALG_SHA2_512};
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *exp = NULL;
+	size_t i;
+	size_t j;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < sizeof(algos) / sizeof(algos[0]); i++) {
+		if (!KSI_isHashAlgorithmSupported(algos[i])) continue;
+
+		/* Without a context the hasher is initialized from scratch. */
+		res = KSI_DataHash_create(NULL, "LAPTOP", 6, algos[i], &exp);
+		CuAssert(tc, "Unable to create hash.", res == KSI_OK && exp != NULL);
+
+		res = KSI_DataHasher_open(ctx, algos[i], &hsr);
+		CuAssert(tc, "Unable to open hasher.", res == KSI_OK && hsr != NULL);
+
+		for (j = 0; j < 3; j++) {
+			/* Leave some garbage in the hasher before resetting. */
+			res = KSI_DataHasher_add(hsr, "garbage", 7);
+			CuAssert(tc, "Unable to add data.", res == KSI_OK);
+
+			res = KSI_DataHasher_reset(hsr);
+			CuAssert(tc, "Unable to reset hasher.", res == KSI_OK);
+
+			res = KSI_DataHasher_add(hsr, "LAPTOP", 6);
+			CuAssert(tc, "Unable to add data.", res == KSI_OK);
+
+			res = KSI_DataHasher_close(hsr, &hsh);
+			CuAssert(tc, "Unable to close hasher.", res == KSI_OK && hsh != NULL);
+			CuAssert(tc, "Hash values do not match.", KSI_DataHash_equals(hsh, exp));
+
+			KSI_DataHash_free(hsh);
+			hsh = NULL;
+
+			res = KSI_DataHasher_reset(hsr);
+			CuAssert(tc, "Unable to reset hasher.", res == KSI_OK);
+		}
+
+		KSI_DataHasher_free(hsr);
+		hsr = NULL;
+		KSI_DataHash_free(exp);
+		exp = NULL;
+	}
+}
+
+static void testHashFile(CuTest *tc) {
+	const char *fileName = getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1.ksig");
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *exp = NULL;
+	unsigned char buf[0x1ffff];
+	size_t buf_len;
+	FILE *f = NULL;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	f = fopen(fileName, "rb");
+	CuAssert(tc, "Unable to open file.", f != NULL);
+	buf_len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	res = KSI_DataHash_create(ctx, buf, buf_len, KSI_HASHALG_SHA2_256, &exp);
+	CuAssert(tc, "Unable to create hash.", res == KSI_OK && exp != NULL);
+
+	res = KSI_IO_hashFile(ctx, fileName, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to hash file.", res == KSI_OK && hsh != NULL);
+	CuAssert(tc, "Hash values do not match.", KSI_DataHash_equals(hsh, exp));
+
+	KSI_DataHash_free(hsh);
+	hsh = NULL;
+
+	res = KSI_IO_hashFile(ctx, getFullResourcePath("resource/tlv/no-such-file.ksig"), KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Hashing a missing file must fail.", res == KSI_IO_ERROR && hsh == NULL);
+
+	KSI_DataHash_free(exp);
+}
+
+static void assertHashFileWithMapWindow(CuTest *tc, const char *fileName, size_t window) {
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *exp = NULL;
+	unsigned char buf[0x1ffff];
+	size_t buf_len;
+	FILE *f = NULL;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	f = fopen(fileName, "rb");
+	CuAssert(tc, "Unable to open file.", f != NULL);
+	buf_len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+	CuAssert(tc, "Test file must not be a multiple of the window size.", buf_len % window != 0);
+
+	res = KSI_DataHash_create(ctx, buf, buf_len, KSI_HASHALG_SHA2_256, &exp);
+	CuAssert(tc, "Unable to create hash.", res == KSI_OK && exp != NULL);
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_IO_MAP_WINDOW_SIZE, (void*)window);
+	CuAssert(tc, "Unable to set map window size.", res == KSI_OK);
+
+	res = KSI_IO_hashFile(ctx, fileName, KSI_HASHALG_SHA2_256, &hsh);
+
+	KSI_CTX_setOption(ctx, KSI_OPT_IO_MAP_WINDOW_SIZE, (void*)0);
+
+	CuAssert(tc, "Unable to hash file.", res == KSI_OK && hsh != NULL);
+	CuAssert(tc, "Hash values do not match.", KSI_DataHash_equals(hsh, exp));
+
+	KSI_DataHash_free(hsh);
+	KSI_DataHash_free(exp);
+}
+
+static void testHashFileMappedWindows(CuTest *tc) {
+	/* The file spans several windows of a page, and ends with a partial one. The next window is
+	 * prefetched before each but the last window is hashed. */
+	assertHashFileWithMapWindow(tc, getFullResourcePath("resource/tlv/publications.tlv"), 4096);
+	/* The window size is rounded down to a multiple of the page size. */
+	assertHashFileWithMapWindow(tc, getFullResourcePath("resource/tlv/publications.tlv"), 4096 + 1000);
+}
+
+static void testHashFileMappedSingleWindow(CuTest *tc) {
+	/* The whole file fits into the first window, nothing is prefetched. */
+	assertHashFileWithMapWindow(tc, getFullResourcePath("resource/tlv/publications.tlv"), 64 * 1024 * 1024);
+	assertHashFileWithMapWindow(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1.ksig"), 64 * 1024 * 1024);
+}
+
 
 CuSuite* KSITest_Hash_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
@@ -759,6 +1009,12 @@ CuSuite* KSITest_Hash_getSuite(void) {
 	SUITE_ADD_TEST(suite, testAddToCloseAndReset);
 	SUITE_ADD_TEST(suite, testCreateHashNoContext);
 	SUITE_ADD_TEST(suite, testOpenCloseNoContext);
+	SUITE_ADD_TEST(suite, testCreateBatch);
+	SUITE_ADD_TEST(suite, testImprintValue);
+	SUITE_ADD_TEST(suite, testResetFromPrototype);
+	SUITE_ADD_TEST(suite, testHashFile);
+	SUITE_ADD_TEST(suite, testHashFileMappedWindows);
+	SUITE_ADD_TEST(suite, testHashFileMappedSingleWindow);
 
 	return suite;
 }
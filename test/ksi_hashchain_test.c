@@ -261,6 +261,23 @@ static void testAggrChainBuilt(CuTest *tc) {
 	res = KSI_DataHash_fromImprint(ctx, buf, buf_len, &exp);
 	CuAssert(tc, "Unable to create expected output data hash.", res == KSI_OK && exp != NULL);
 
+	/* Aggregate the same chain into caller storage. */
+	{
+		KSI_LIST(KSI_HashChainLink) *links = NULL;
+		KSI_Imprint outImprint;
+		KSI_Imprint expImprint;
+
+		res = KSI_AggregationHashChain_getChain(ac, &links);
+		CuAssert(tc, "Unable to get chain links.", res == KSI_OK && links != NULL);
+
+		res = KSI_HashChain_aggregateInto(ctx, links, in, 0, KSI_HASHALG_SHA2_256, NULL, &outImprint);
+		CuAssert(tc, "Unable to aggregate chain into imprint.", res == KSI_OK);
+
+		res = KSI_Imprint_fromDataHash(out, &expImprint);
+		CuAssert(tc, "Unable to get imprint value.", res == KSI_OK);
+		CuAssert(tc, "Aggregation results mismatch.", KSI_Imprint_equals(&outImprint, &expImprint));
+	}
+
 	KSI_DataHash_free(exp);
 	KSI_DataHash_free(in);
 	KSI_DataHash_free(out);
@@ -155,6 +155,42 @@ static void TestSHA256Reset(CuTest* tc) {
 	KSI_DataHash_free(hmac);
 }
 
+static void TestCreateReusesKey(CuTest* tc) {
+	int res;
+	KSI_DataHash *hmac = NULL;
+	const unsigned char *data = (const unsigned char *)MESSAGE;
+	size_t data_len = strlen(MESSAGE);
+	const char *otherKeys[] = {"key1", "key2", "key3", "key4", "key5"};
+	size_t i;
+	size_t j;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_HMAC_create(ctx, KSI_HASHALG_SHA2_256, KEY, data, data_len, &hmac);
+		CuAssert(tc, "Failed to create HMAC.", res == KSI_OK && hmac != NULL);
+		CuAssert(tc, "HMAC mismatch.", CompareHmac(hmac, SHA256_MESSAGE_HMAC) == KSI_OK);
+		KSI_DataHash_free(hmac);
+		hmac = NULL;
+
+		/* Same key with a different algorithm must not reuse the SHA-256 state. */
+		res = KSI_HMAC_create(ctx, KSI_HASHALG_SHA1, KEY, data, data_len, &hmac);
+		CuAssert(tc, "Failed to create HMAC.", res == KSI_OK && hmac != NULL);
+		CuAssert(tc, "HMAC mismatch.", CompareHmac(hmac, SHA1_MESSAGE_HMAC) == KSI_OK);
+		KSI_DataHash_free(hmac);
+		hmac = NULL;
+
+		/* Evict the cached keys. */
+		for (j = 0; j < i * 2 && j < sizeof(otherKeys) / sizeof(otherKeys[0]); j++) {
+			res = KSI_HMAC_create(ctx, KSI_HASHALG_SHA2_256, otherKeys[j], data, data_len, &hmac);
+			CuAssert(tc, "Failed to create HMAC.", res == KSI_OK && hmac != NULL);
+			CuAssert(tc, "HMAC must depend on the key.", CompareHmac(hmac, SHA256_MESSAGE_HMAC) != KSI_OK);
+			KSI_DataHash_free(hmac);
+			hmac = NULL;
+		}
+	}
+}
+
 static void TestSHA256NoData(CuTest* tc) {
 	int res;
 	KSI_HmacHasher *hasher = NULL;
@@ -377,6 +413,7 @@ CuSuite* KSITest_HMAC_getSuite(void) {
 	SUITE_ADD_TEST(suite, TestSHA256AddEmptyData);
 	SUITE_ADD_TEST(suite, TestSHA256AddMany);
 	SUITE_ADD_TEST(suite, TestSHA256Reset);
+	SUITE_ADD_TEST(suite, TestCreateReusesKey);
 	SUITE_ADD_TEST(suite, TestSHA256NoData);
 	SUITE_ADD_TEST(suite, TestAllAlgorithms);
 	SUITE_ADD_TEST(suite, TestSHA512LongKey);
@@ -18,6 +18,25 @@
  */
 
 #include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#  ifdef HAVE_CONFIG_H
+#    include "../src/ksi/config.h"
+#  endif
+#endif
+
+#ifdef _WIN32
+#  include <windows.h>
+#  define sleep_ms(x) Sleep((x))
+#else
+#  include <unistd.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#  define sleep_ms(x) usleep((x)*1000)
+#endif
 
 #include <ksi/hash.h>
 #include <ksi/net.h>
@@ -29,6 +48,8 @@
 #include "all_tests.h"
 #include "test_mock_async.h"
 
+#include "../src/ksi/impl/net_async_impl.h"
+
 
 extern KSI_CTX *ctx;
 
@@ -154,6 +175,10 @@ void Test_AsyncSingningService_verifyOptions(CuTest* tc) {
 	verifyOption(tc, as, KSI_ASYNC_OPT_SND_TIMEOUT, 10, 15);
 	verifyOption(tc, as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, 1, 15);
 	verifyOption(tc, as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, 1, 15);
+	verifyOption(tc, as, KSI_ASYNC_OPT_CONNECTION_COUNT, 1, 4);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)0);
+	CuAssert(tc, "Connection count may not be zero.", res == KSI_INVALID_ARGUMENT);
 
 	KSI_AsyncService_free(as);
 }
@@ -508,6 +533,124 @@ static void Test_AsyncSign_oneRequest_verifySignature(CuTest* tc) {
 #undef TEST_SIGNATURE_FILE
 }
 
+static size_t histogramCount(const size_t *histogram) {
+	size_t i;
+	size_t count = 0;
+
+	for (i = 0; i < KSI_ASYNC_STAT_HISTOGRAM_SIZE; i++) {
+		count += histogram[i];
+	}
+	return count;
+}
+
+static void Test_AsyncSign_oneRequest_verifyStatistics(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_AsyncStatistics stats;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_getStatistics(as, &stats);
+	CuAssert(tc, "Unable to get statistics.", res == KSI_OK);
+	CuAssert(tc, "Statistics not empty.", stats.sent == 0 && stats.received == 0 && stats.bytesOut == 0 && stats.bytesIn == 0);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle == reqHandle);
+
+	res = KSI_AsyncService_getStatistics(as, &stats);
+	CuAssert(tc, "Unable to get statistics.", res == KSI_OK);
+	CuAssert(tc, "Request count mismatch.", stats.sent == 1 && stats.received == 1);
+	CuAssert(tc, "Error count mismatch.", stats.timedOut == 0 && stats.failed == 0);
+	CuAssert(tc, "Byte count mismatch.", stats.bytesOut > 0 && stats.bytesIn > 0);
+	CuAssert(tc, "Queue time histogram mismatch.", histogramCount(stats.queueTime) == 1);
+	CuAssert(tc, "Round-trip time histogram mismatch.", histogramCount(stats.roundTripTime) == 1);
+
+	res = KSI_AsyncService_getStatistics(as, NULL);
+	CuAssert(tc, "Statistics output may not be NULL.", res == KSI_INVALID_ARGUMENT);
+
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncSign_oneRequest_eventLoop(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_AsyncSocket sockets[4];
+	size_t count = 0;
+	long timeout = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Idle service should not require a wake up.", res == KSI_OK && timeout == -1);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	/* The mock client does not expose any sockets, thus it has to be polled. */
+	res = KSI_AsyncService_getSockets(as, sockets, TEST_RESP_COUNT(sockets), &count);
+	CuAssert(tc, "Unable to get sockets.", res == KSI_OK && count == 0);
+
+	res = KSI_AsyncService_getSockets(as, NULL, 0, &count);
+	CuAssert(tc, "Unable to get socket count.", res == KSI_OK && count == 0);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Pending request should require a wake up.", res == KSI_OK && timeout == 0);
+
+	res = KSI_AsyncService_socketReady(as, -1, KSI_ASYNC_SOCKET_EVENT_READ | KSI_ASYNC_SOCKET_EVENT_WRITE);
+	CuAssert(tc, "Unable to handle socket event.", res == KSI_OK);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Received response should require a wake up.", res == KSI_OK && timeout == 0);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Idle service should not require a wake up.", res == KSI_OK && timeout == -1);
+
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
 static void Test_AsyncSign_oneRequest_multipleResponses_verifySignature(CuTest* tc) {
 #define TEST_SIGNATURE_FILE     "resource/tlv/ok-sig-2014-07-01.1.ksig"
 	static const char *TEST_AGGR_RESPONSE_FILES[] = {
@@ -925,6 +1068,7 @@ static void Test_AsyncSign_oneRequest_wrongResponse_getSignatureFail(CuTest* tc)
 	KSI_AsyncService_free(as);
 }
 
+#define TEST_RCV_TIMEOUT 10
 static void Test_AsyncSign_oneRequest_wrongResponseReqId(CuTest* tc) {
 	static const char *TEST_AGGR_RESPONSE_FILES[] = {
 		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response-wrong-id.tlv",
@@ -934,6 +1078,8 @@ static void Test_AsyncSign_oneRequest_wrongResponseReqId(CuTest* tc) {
 	KSI_AsyncService *as = NULL;
 	KSI_AsyncHandle *reqHandle = NULL;
 	KSI_AsyncHandle *respHandle = NULL;
+	KSI_AsyncClient *client = NULL;
+	time_t now;
 
 	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
 
@@ -949,12 +1095,23 @@ static void Test_AsyncSign_oneRequest_wrongResponseReqId(CuTest* tc) {
 	res = KSI_AsyncService_addRequest(as, reqHandle);
 	CuAssert(tc, "Unable to add request.", res == KSI_OK);
 
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_RCV_TIMEOUT, (void *)TEST_RCV_TIMEOUT);
+	CuAssert(tc, "Unable to set option.", res == KSI_OK);
+
 	res = KSI_AsyncService_run(as, &respHandle, NULL);
 	CuAssert(tc, "Failed to run async service.", res == KSI_OK);
 	CuAssert(tc, "Nothing to be returned.", respHandle == NULL);
 
+	/* The request cache is not checked again before the request can time out. */
+	time(&now);
+	client = (KSI_AsyncClient *)as->impl;
+	CuAssert(tc, "Request cache check should be postponed.", client->nextSweep > now);
+	CuAssert(tc, "Request cache check is postponed past the receive timeout.",
+			difftime(client->nextSweep, now) <= TEST_RCV_TIMEOUT + 1);
+
 	KSI_AsyncHandle_free(respHandle);
 	KSI_AsyncService_free(as);
+#undef TEST_RCV_TIMEOUT
 }
 
 static void Test_AsyncSign_oneRequest_wrongResponseReqId_rcvTimeout0(CuTest* tc) {
@@ -1548,157 +1705,1083 @@ static void Test_AsyncSign_multipleRequests_collect(CuTest* tc) {
 	KSI_AsyncService_free(as);
 }
 
-static void Test_AsyncSign_multipleRequests_collect_aggrResp301(CuTest* tc) {
+typedef struct CompletionCallbackCtx_st {
+	size_t calls;
+	size_t received;
+	size_t signatures;
+	size_t reqCtxMatch;
+} CompletionCallbackCtx;
+
+static int KSITest_completionCallback(KSI_CTX *ctx, KSI_AsyncHandle *handle, int state, void *userp) {
+	int res;
+	CompletionCallbackCtx *cbCtx = (CompletionCallbackCtx *)userp;
+	KSI_Signature *signature = NULL;
+	const char *reqCtx = NULL;
+
+	if (ctx == NULL || handle == NULL || cbCtx == NULL) return KSI_INVALID_ARGUMENT;
+
+	cbCtx->calls++;
+	if (state != KSI_ASYNC_STATE_RESPONSE_RECEIVED) return KSI_OK;
+	cbCtx->received++;
+
+	res = KSI_AsyncHandle_getSignature(handle, &signature);
+	if (res == KSI_OK && signature != NULL) cbCtx->signatures++;
+	KSI_Signature_free(signature);
+
+	res = KSI_AsyncHandle_getRequestCtx(handle, (const void **)&reqCtx);
+	if (res == KSI_OK && reqCtx != NULL && TEST_REQ_DATA[cbCtx->reqCtxMatch] == reqCtx) cbCtx->reqCtxMatch++;
+
+	return KSI_OK;
+}
+
+static void Test_AsyncSign_multipleRequests_completionCallback(CuTest* tc) {
 	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
-		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv"
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_02h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_03h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_04h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_05h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_06h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_07h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_08h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_09h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Ah.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Bh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Ch.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Dh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Eh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Fh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_10h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_11h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_12h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_13h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_14h.tlv",
 	};
 
 	int res;
 	KSI_AsyncService *as = NULL;
 	const char **p_req = NULL;
-	size_t added = 0;
-	size_t i;
+	size_t waiting = 0;
+	size_t runs = 0;
+	CompletionCallbackCtx cbCtx;
 
 	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
 	KSI_ERR_clearErrors(ctx);
 
+	memset(&cbCtx, 0, sizeof(cbCtx));
+
 	res = KSI_SigningAsyncService_new(ctx, &as);
 	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
 
-	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, 1, "anon", "anon");
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_REQ_DATA_COUNT, "anon", "anon");
 	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
 
 	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_DATA_COUNT));
 	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
 
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_COMPLETION_CALLBACK, (void*)KSITest_completionCallback);
+	CuAssert(tc, "Unable to set completion callback.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_CALLBACK_USERDATA, (void*)&cbCtx);
+	CuAssert(tc, "Unable to set callback user data.", res == KSI_OK);
+
 	p_req = TEST_REQ_DATA;
 	while (*p_req != NULL) {
-		size_t pendingCount = 0;
 		KSI_AsyncHandle *reqHandle = NULL;
 
 		res = KSITest_createAggrAsyncHandle(ctx, 0, (unsigned char *)*p_req, strlen(*p_req), KSI_HASHALG_SHA2_256, NULL, 0, 0, &reqHandle);
 		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
 
+		res = KSI_AsyncHandle_setRequestCtx(reqHandle, (void*)*p_req, NULL);
+		CuAssert(tc, "Unable to set request context.", res == KSI_OK);
+
 		res = KSI_AsyncService_addRequest(as, reqHandle);
 		CuAssert(tc, "Unable to add request.", res == KSI_OK);
 		p_req++;
-
-		res = KSI_AsyncService_getPendingCount(as, &pendingCount);
-		CuAssert(tc, "Unable to get pending count.", res == KSI_OK);
-		CuAssert(tc, "Pending count mitmatch.", pendingCount == ++added);
 	}
 
-	for (i = 0; i < added; i++) {
-		int state = KSI_ASYNC_STATE_UNDEFINED;
+	do {
 		KSI_AsyncHandle *handle = NULL;
-		KSI_Signature *signature = NULL;
-		int error = 0;
-		long errorExt = 0;
-		KSI_Utf8String *msg = NULL;
 
-		res = KSI_AsyncService_run(as, &handle, NULL);
+		res = KSI_AsyncService_run(as, &handle, &waiting);
 		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		CuAssert(tc, "Handle should be delivered via callback.", handle == NULL);
+	} while (waiting > 0 && ++runs <= TEST_REQ_DATA_COUNT);
 
-		res = KSI_AsyncHandle_getState(handle, &state);
-		CuAssert(tc, "Unable to get request state.", res == KSI_OK);
-		CuAssert(tc, "State should be ERROR.", state == KSI_ASYNC_STATE_ERROR);
-
-		res = KSI_AsyncHandle_getError(handle, &error);
-		CuAssert(tc, "Signing should fail with error.", res == KSI_OK && error == KSI_SERVICE_UPSTREAM_TIMEOUT);
-
-		res = KSI_AsyncHandle_getExtError(handle, &errorExt);
-		CuAssert(tc, "There should be external error.", res == KSI_OK && errorExt == 0x301);
-
-		res = KSI_AsyncHandle_getErrorMessage(handle, &msg);
-		CuAssert(tc, "There should be error message.", res == KSI_OK && msg != NULL);
-		CuAssert(tc, "Error message mismatch.", strcmp("No response from upstream servers", KSI_Utf8String_cstr(msg)) == 0);
-
-		res = KSI_AsyncHandle_getSignature(handle, &signature);
-		CuAssert(tc, "No signature in error state.", res == KSI_INVALID_STATE && signature == NULL);
-
-		KSI_Signature_free(signature);
-		KSI_AsyncHandle_free(handle);
-	}
+	CuAssert(tc, "Requests are still waiting.", waiting == 0);
+	CuAssert(tc, "Callback count mismatch.", cbCtx.calls == TEST_REQ_DATA_COUNT);
+	CuAssert(tc, "Response count mismatch.", cbCtx.received == TEST_REQ_DATA_COUNT);
+	CuAssert(tc, "Signature count mismatch.", cbCtx.signatures == TEST_REQ_DATA_COUNT);
+	CuAssert(tc, "Request context mismatch.", cbCtx.reqCtxMatch == TEST_REQ_DATA_COUNT);
 
 	KSI_AsyncService_free(as);
 }
 
-static void Test_HASign_confRequest_responseConfDefaultConsolidate(CuTest* tc) {
-	static const char *TEST_AGGR_RESPONSE_FILES1[] = {"resource/tlv/" TEST_RESOURCE_AGGR_VER "/aggr_conf_response-max_req_512.tlv"};
-	static const char *TEST_AGGR_RESPONSE_FILES2[] = {"resource/tlv/" TEST_RESOURCE_AGGR_VER "/aggr_conf_response-max_req_1024.tlv"};
+static void Test_AsyncSign_submitQueue_collect(CuTest* tc) {
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_02h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_03h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_04h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_05h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_06h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_07h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_08h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_09h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Ah.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Bh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Ch.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Dh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Eh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0Fh.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_10h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_11h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_12h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_13h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_14h.tlv",
+	};
 
 	int res;
 	KSI_AsyncService *as = NULL;
-	KSI_Integer *intVal = NULL;
-	KSI_AsyncHandle *respHandle = NULL;
-	int state = KSI_ASYNC_STATE_UNDEFINED;
-	KSI_Config *cfg = NULL;
-	KSI_AsyncHandle *cfgHandle = NULL;
-	KSI_AggregationReq *cfgReq = NULL;
+	KSI_AsyncSubmitQueue *queue = NULL;
+	const char **p_req = NULL;
+	size_t added = 0;
+	size_t received = 0;
+	size_t runs = 0;
 
-	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
 
-	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	res = KSI_SigningAsyncService_new(ctx, &as);
 	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
 
-	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES1, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES1), "anon", "anon");
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_REQ_DATA_COUNT, "anon", "anon");
 	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
 
-	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES2, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES2), "anon", "anon");
-	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_DATA_COUNT - 1));
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
 
-	res = KSI_AggregationReq_new(ctx, &cfgReq);
-	CuAssert(tc, "Unable to create aggregation request.", res == KSI_OK && cfgReq != NULL);
+	res = KSI_AsyncSubmitQueue_new(as, &queue);
+	CuAssert(tc, "Unable to create submission queue.", res == KSI_OK && queue != NULL);
 
-	res = KSI_Config_new(ctx, &cfg);
-	CuAssert(tc, "Unable to create config object.", res == KSI_OK && cfg != NULL);
+	p_req = TEST_REQ_DATA;
+	while (*p_req != NULL) {
+		KSI_DataHash *hsh = NULL;
+		const unsigned char *imprint = NULL;
+		size_t imprint_len = 0;
 
-	res = KSI_AggregationReq_setConfig(cfgReq, cfg);
-	CuAssert(tc, "Unable to set request data hash.", res == KSI_OK);
+		res = KSI_DataHash_create(ctx, *p_req, strlen(*p_req), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
 
-	res = KSI_AsyncAggregationHandle_new(ctx, cfgReq, &cfgHandle);
-	CuAssert(tc, "Unable to create async request.", res == KSI_OK && cfgHandle != NULL);
+		res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+		CuAssert(tc, "Unable to get imprint.", res == KSI_OK && imprint != NULL);
 
-	res = KSI_AsyncService_addRequest(as, cfgHandle);
-	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+		res = KSI_AsyncSubmitQueue_addSigningRequest(queue, imprint, imprint_len, 0, (void*)*p_req, NULL);
+		CuAssert(tc, "Unable to submit request.", res == KSI_OK);
 
-	callbackCalls = 0;
-	res = KSI_AsyncService_run(as, &respHandle, NULL);
-	CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		KSI_DataHash_free(hsh);
+		p_req++;
+	}
 
-	CuAssert(tc, "Conf callback has been invoked.", callbackCalls == 0);
+	/* The last request does not fit into the cache and must be kept in the queue. */
+	res = KSI_AsyncSubmitQueue_drain(queue, &added);
+	CuAssert(tc, "Unable to drain submission queue.", res == KSI_OK);
+	CuAssert(tc, "Drained request count mismatch.", added == TEST_REQ_DATA_COUNT - 1);
 
-	res = KSI_AsyncHandle_getState(respHandle, &state);
-	CuAssert(tc, "Request state mismatch.", state == KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED);
+	res = KSI_AsyncSubmitQueue_drain(queue, &added);
+	CuAssert(tc, "Unable to drain submission queue.", res == KSI_OK);
+	CuAssert(tc, "Request should be held in the queue.", added == 0);
 
-	cfg = NULL;
-	res = KSI_AsyncHandle_getConfig(respHandle, &cfg);
-	CuAssert(tc, "Unable to get server config.", res == KSI_OK && cfg != NULL);
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_DATA_COUNT));
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
 
-	res = KSI_Config_getMaxRequests(cfg, &intVal);
-	CuAssert(tc, "Conf max requests value mismatch.", res == KSI_OK && KSI_Integer_getUInt64(intVal) == 1024);
+	res = KSI_AsyncSubmitQueue_drain(queue, &added);
+	CuAssert(tc, "Unable to drain submission queue.", res == KSI_OK);
+	CuAssert(tc, "Held request should be added.", added == 1);
 
-	intVal = NULL;
-	res = KSI_Config_getAggrPeriod(cfg, &intVal);
-	CuAssert(tc, "Conf aggregation period value mismatch.", res == KSI_OK && KSI_Integer_getUInt64(intVal) == 400);
+	do {
+		KSI_AsyncHandle *handle = NULL;
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+		const char *reqCtx = NULL;
 
-	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+		res = KSI_AsyncService_run(as, &handle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		if (handle == NULL) continue;
 
-	KSI_AsyncHandle_free(respHandle);
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "State should be RESPONSE_RECEIVED.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+		res = KSI_AsyncHandle_getRequestCtx(handle, (const void **)&reqCtx);
+		CuAssert(tc, "Request context mismatch.", res == KSI_OK && reqCtx == TEST_REQ_DATA[received]);
+
+		received++;
+		KSI_AsyncHandle_free(handle);
+	} while (received < TEST_REQ_DATA_COUNT && ++runs <= 2 * TEST_REQ_DATA_COUNT);
+	CuAssert(tc, "Response count mismatch.", received == TEST_REQ_DATA_COUNT);
+
+	KSI_AsyncSubmitQueue_free(queue);
 	KSI_AsyncService_free(as);
 }
 
-static int KSITest_configConsolidateCallback(KSI_CTX *ctx, size_t id, void *userp, KSI_Config *haConfig, KSI_Config *respConfig) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_Integer *haVal = NULL;
-	KSI_Integer *respVal = NULL;
+#ifdef TEST_THREADS_SUPPORTED
+#define TEST_SUBMIT_PRODUCER_COUNT 4
+#define TEST_SUBMIT_PRODUCER_REQ_COUNT 256
 
-	KSI_LOG_debug(ctx, "%s: from %p (callback count %llu)", __FUNCTION__, (void*)id, (unsigned long long)++callbackCalls);
+typedef struct {
+	size_t producer;
+	size_t seq;
+	size_t freeCount;
+} TestSubmitReqCtx;
 
-	if (ctx == NULL || haConfig == NULL || respConfig == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
+typedef struct {
+	KSI_AsyncSubmitQueue *queue;
+	size_t producer;
+	TestSubmitReqCtx *reqCtx;
+	int res;
+} TestSubmitProducer;
+
+static void TestSubmitReqCtx_free(TestSubmitReqCtx *o) {
+	if (o != NULL) o->freeCount++;
+}
+
+TEST_THREAD_FUNC(submitQueueProducer, arg) {
+	TestSubmitProducer *p = (TestSubmitProducer *)arg;
+	unsigned char imprint[33];
+	size_t i;
+
+	p->res = KSI_OK;
+	for (i = 0; i < TEST_SUBMIT_PRODUCER_REQ_COUNT; i++) {
+		int res;
+
+		memset(imprint, 0, sizeof(imprint));
+		imprint[0] = KSI_HASHALG_SHA2_256;
+		imprint[1] = (unsigned char)p->producer;
+		imprint[2] = (unsigned char)(i >> 8);
+		imprint[3] = (unsigned char)i;
+
+		p->reqCtx[i].producer = p->producer;
+		p->reqCtx[i].seq = i;
+		p->reqCtx[i].freeCount = 0;
+
+		res = KSI_AsyncSubmitQueue_addSigningRequest(p->queue, imprint, sizeof(imprint), 0,
+				(void *)&p->reqCtx[i], (void (*)(void*))TestSubmitReqCtx_free);
+		if (res != KSI_OK && p->res == KSI_OK) p->res = res;
+	}
+	TEST_THREAD_RETURN;
+}
+
+static void Test_AsyncSign_submitQueue_multipleProducers(CuTest* tc) {
+#define TEST_SUBMIT_TOTAL_COUNT (TEST_SUBMIT_PRODUCER_COUNT * TEST_SUBMIT_PRODUCER_REQ_COUNT)
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+	};
+	static TestSubmitReqCtx reqCtx[TEST_SUBMIT_PRODUCER_COUNT][TEST_SUBMIT_PRODUCER_REQ_COUNT];
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncSubmitQueue *queue = NULL;
+	KSI_AsyncClient *client = NULL;
+	TestSubmitProducer producer[TEST_SUBMIT_PRODUCER_COUNT];
+	TestThread thread[TEST_SUBMIT_PRODUCER_COUNT];
+	size_t nextSeq[TEST_SUBMIT_PRODUCER_COUNT];
+	size_t added = 0;
+	size_t total = 0;
+	size_t i;
+	size_t j;
+	time_t start;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_REQ_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)TEST_SUBMIT_TOTAL_COUNT);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncSubmitQueue_new(as, &queue);
+	CuAssert(tc, "Unable to create submission queue.", res == KSI_OK && queue != NULL);
+
+	for (i = 0; i < TEST_SUBMIT_PRODUCER_COUNT; i++) {
+		producer[i].queue = queue;
+		producer[i].producer = i;
+		producer[i].reqCtx = reqCtx[i];
+		producer[i].res = KSI_UNKNOWN_ERROR;
+
+		res = TestThread_create(&thread[i], submitQueueProducer, &producer[i]);
+		CuAssert(tc, "Unable to start producer thread.", res == 0);
+	}
+
+	/* Drain concurrently with the producers. */
+	start = time(NULL);
+	do {
+		res = KSI_AsyncSubmitQueue_drain(queue, &added);
+		CuAssert(tc, "Unable to drain submission queue.", res == KSI_OK);
+		total += added;
+	} while (total < TEST_SUBMIT_TOTAL_COUNT && time(NULL) - start < 10);
+
+	for (i = 0; i < TEST_SUBMIT_PRODUCER_COUNT; i++) {
+		TestThread_join(thread[i]);
+		CuAssert(tc, "Unable to submit request.", producer[i].res == KSI_OK);
+	}
+
+	res = KSI_AsyncSubmitQueue_drain(queue, &added);
+	CuAssert(tc, "Unable to drain submission queue.", res == KSI_OK);
+	total += added;
+	CuAssert(tc, "Drained request count mismatch.", total == TEST_SUBMIT_TOTAL_COUNT);
+
+	/* The requests are cached in the order they were drained. */
+	client = (KSI_AsyncClient *)as->impl;
+	memset(nextSeq, 0, sizeof(nextSeq));
+	for (i = 0; i < TEST_SUBMIT_TOTAL_COUNT; i++) {
+		KSI_AsyncHandle *handle = client->reqCache[KSI_ASYNC_CACHE_START_POS + i];
+		const TestSubmitReqCtx *p = NULL;
+
+		CuAssert(tc, "Request missing from the cache.", handle != NULL);
+
+		res = KSI_AsyncHandle_getRequestCtx(handle, (const void **)&p);
+		CuAssert(tc, "Request context missing.", res == KSI_OK && p != NULL);
+		CuAssert(tc, "Request order mismatch.", p->producer < TEST_SUBMIT_PRODUCER_COUNT && p->seq == nextSeq[p->producer]);
+		nextSeq[p->producer]++;
+	}
+
+	KSI_AsyncSubmitQueue_free(queue);
+	KSI_AsyncService_free(as);
+
+	for (i = 0; i < TEST_SUBMIT_PRODUCER_COUNT; i++) {
+		for (j = 0; j < TEST_SUBMIT_PRODUCER_REQ_COUNT; j++) {
+			CuAssert(tc, "Request context must be released exactly once.", reqCtx[i][j].freeCount == 1);
+		}
+	}
+#undef TEST_SUBMIT_TOTAL_COUNT
+}
+#endif
+
+static void Test_AsyncSign_multipleRequests_collect_responseOrderAfterCacheResize(CuTest* tc) {
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_02h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_03h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_04h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_05h.tlv",
+	};
+	static const size_t TEST_REQ_COUNT = TEST_RESP_COUNT(TEST_REQ_AGGR_RESPONSE_FILES);
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	size_t receivedCount = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_REQ_COUNT, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_COUNT));
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	for (i = 0; i < TEST_REQ_COUNT; i++) {
+		KSI_AsyncHandle *reqHandle = NULL;
+
+		res = KSITest_createAggrAsyncHandle(ctx, 0, (unsigned char *)TEST_REQ_DATA[i], strlen(TEST_REQ_DATA[i]), KSI_HASHALG_SHA2_256, NULL, 0, 0, &reqHandle);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+		res = KSI_AsyncService_addRequest(as, reqHandle);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+
+	for (i = 0; i < TEST_REQ_COUNT && receivedCount < TEST_REQ_COUNT; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncService_getReceivedCount(as, &receivedCount);
+		CuAssert(tc, "Unable to get received count.", res == KSI_OK);
+	}
+	CuAssert(tc, "Response count mismatch.", TEST_REQ_COUNT == receivedCount);
+
+	/* Growing the cache may not change the order of the completed requests. */
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_COUNT * 2));
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	for (i = 0; i < receivedCount; i++) {
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_uint64_t id = 0;
+
+		res = KSI_AsyncService_run(as, &handle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK && handle != NULL);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "State should be RESPONSE_RECEIVED.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+		res = KSI_AsyncHandle_getRequestId(handle, &id);
+		CuAssert(tc, "Responses should be returned in the order received.", res == KSI_OK && id == i + 1);
+
+		KSI_AsyncHandle_free(handle);
+	}
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncSign_localAggregation_collect(CuTest* tc) {
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	size_t pendingCount = 0;
+	size_t receivedCount = 0;
+	KSI_AggregationResp *firstResp = NULL;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_REQ_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT, (void*)(TEST_REQ_DATA_COUNT));
+	CuAssert(tc, "Unable to set local aggregation max count.", res == KSI_OK);
+
+	/* All requests fit into a single aggregation request with the default request cache size. */
+	for (i = 0; i < TEST_REQ_DATA_COUNT; i++) {
+		KSI_AsyncHandle *reqHandle = NULL;
+
+		res = KSITest_createAggrAsyncHandle(ctx, 0, (unsigned char *)TEST_REQ_DATA[i], strlen(TEST_REQ_DATA[i]), KSI_HASHALG_SHA2_256, NULL, 0, 0, &reqHandle);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+		res = KSI_AsyncService_addRequest(as, reqHandle);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+
+	res = KSI_AsyncService_getPendingCount(as, &pendingCount);
+	CuAssert(tc, "Pending count mismatch.", res == KSI_OK && pendingCount == TEST_REQ_DATA_COUNT);
+
+	for (i = 0; i < TEST_REQ_DATA_COUNT && receivedCount < TEST_REQ_DATA_COUNT; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncService_getReceivedCount(as, &receivedCount);
+		CuAssert(tc, "Unable to get received count.", res == KSI_OK);
+	}
+	CuAssert(tc, "Response count mismatch.", TEST_REQ_DATA_COUNT == receivedCount);
+
+	for (i = 0; i < TEST_REQ_DATA_COUNT; i++) {
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_AggregationResp *resp = NULL;
+		KSI_uint64_t id = 0;
+
+		res = KSI_AsyncService_run(as, &handle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK && handle != NULL);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "State should be RESPONSE_RECEIVED.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+		res = KSI_AsyncHandle_getRequestId(handle, &id);
+		CuAssert(tc, "All requests should share the aggregation request id.", res == KSI_OK && id == 1);
+
+		res = KSI_AsyncHandle_getAggregationResp(handle, &resp);
+		CuAssert(tc, "Aggregation response is missing.", res == KSI_OK && resp != NULL);
+		if (firstResp == NULL) firstResp = resp;
+		CuAssert(tc, "All requests should share the aggregation response.", resp == firstResp);
+
+		KSI_AsyncHandle_free(handle);
+	}
+
+	res = KSI_AsyncService_getPendingCount(as, &pendingCount);
+	CuAssert(tc, "Pending count mismatch.", res == KSI_OK && pendingCount == 0);
+
+	res = KSI_AsyncService_getReceivedCount(as, &receivedCount);
+	CuAssert(tc, "Received count mismatch.", res == KSI_OK && receivedCount == 0);
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncSign_localAggregation_signatures(CuTest* tc) {
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-local_aggr-req_id_01h.tlv",
+	};
+	/* The leaves of the local aggregation tree. The response is signing the root of these. */
+	static const char *TEST_REQ_IMPRINTS[] = {
+		"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d",
+		"010101010101010101010101010101010101010101010101010101010101010101"
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandles[2] = {NULL, NULL};
+	size_t receivedCount = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_REQ_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_LOCAL_AGGR_MAX_COUNT, (void*)(TEST_RESP_COUNT(TEST_REQ_IMPRINTS)));
+	CuAssert(tc, "Unable to set local aggregation max count.", res == KSI_OK);
+
+	for (i = 0; i < TEST_RESP_COUNT(TEST_REQ_IMPRINTS); i++) {
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)TEST_REQ_IMPRINTS[i], 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &reqHandles[i]);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandles[i] != NULL);
+
+		/* Keep a reference for matching the returned handles. */
+		KSI_AsyncHandle_ref(reqHandles[i]);
+
+		res = KSI_AsyncService_addRequest(as, reqHandles[i]);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+
+	/* The first run sends the local aggregation root, the following ones collect the response. */
+	for (i = 0; i < 10 && receivedCount < TEST_RESP_COUNT(TEST_REQ_IMPRINTS); i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncService_getReceivedCount(as, &receivedCount);
+		CuAssert(tc, "Unable to get received count.", res == KSI_OK);
+	}
+	CuAssert(tc, "Response count mismatch.", TEST_RESP_COUNT(TEST_REQ_IMPRINTS) == receivedCount);
+
+	/* The root signature is built once for the batch. */
+	CuAssert(tc, "Root signature should be shared by the batch.", reqHandles[0]->rootSig != NULL && reqHandles[0]->rootSig == reqHandles[1]->rootSig);
+
+	for (i = 0; i < TEST_RESP_COUNT(TEST_REQ_IMPRINTS); i++) {
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_Signature *signature = NULL;
+		KSI_DataHash *docHash = NULL;
+		KSI_DataHash *sigHash = NULL;
+		KSI_DataHash *otherHash = NULL;
+		KSI_VerificationContext context;
+		KSI_PolicyVerificationResult *result = NULL;
+		size_t idx = TEST_RESP_COUNT(TEST_REQ_IMPRINTS);
+		size_t j;
+
+		res = KSI_AsyncService_run(as, &handle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK && handle != NULL);
+
+		for (j = 0; j < TEST_RESP_COUNT(TEST_REQ_IMPRINTS); j++) {
+			if (reqHandles[j] == handle) idx = j;
+		}
+		CuAssert(tc, "Unexpected handle returned.", idx < TEST_RESP_COUNT(TEST_REQ_IMPRINTS));
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "State should be RESPONSE_RECEIVED.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+		res = KSI_AsyncHandle_getSignature(handle, &signature);
+		CuAssert(tc, "Unable to extract signature.", res == KSI_OK && signature != NULL);
+
+		res = KSITest_DataHash_fromStr(ctx, TEST_REQ_IMPRINTS[idx], &docHash);
+		CuAssert(tc, "Unable to create document hash.", res == KSI_OK && docHash != NULL);
+
+		res = KSI_Signature_getDocumentHash(signature, &sigHash);
+		CuAssert(tc, "Signature document hash mismatch.", res == KSI_OK && KSI_DataHash_equals(sigHash, docHash));
+
+		res = KSI_VerificationContext_init(&context, ctx);
+		CuAssert(tc, "Unable to init verification context.", res == KSI_OK);
+
+		context.signature = signature;
+		context.documentHash = docHash;
+
+		res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_INTERNAL, &context, &result);
+		CuAssert(tc, "Unable to verify signature.", res == KSI_OK && result != NULL);
+		CuAssert(tc, "Signature should verify against its own document hash.", result->finalResult.resultCode == KSI_VER_RES_OK);
+		KSI_PolicyVerificationResult_free(result);
+		result = NULL;
+
+		/* The sibling leaf has been aggregated into the same root, but must not match this signature. */
+		res = KSITest_DataHash_fromStr(ctx, TEST_REQ_IMPRINTS[1 - idx], &otherHash);
+		CuAssert(tc, "Unable to create document hash.", res == KSI_OK && otherHash != NULL);
+
+		context.documentHash = otherHash;
+
+		res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_INTERNAL, &context, &result);
+		CuAssert(tc, "Unable to verify signature.", res == KSI_OK && result != NULL);
+		CuAssert(tc, "Signature should not verify against the sibling document hash.", result->finalResult.resultCode == KSI_VER_RES_FAIL);
+
+		KSI_PolicyVerificationResult_free(result);
+		KSI_DataHash_free(otherHash);
+		KSI_DataHash_free(docHash);
+		KSI_Signature_free(signature);
+		KSI_AsyncHandle_free(reqHandles[idx]);
+		reqHandles[idx] = NULL;
+		KSI_AsyncHandle_free(handle);
+	}
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncSign_multipleRequests_collect_aggrResp301(CuTest* tc) {
+	static const char *TEST_REQ_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv"
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	const char **p_req = NULL;
+	size_t added = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_REQ_AGGR_RESPONSE_FILES, 1, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void*)(TEST_REQ_DATA_COUNT));
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	p_req = TEST_REQ_DATA;
+	while (*p_req != NULL) {
+		size_t pendingCount = 0;
+		KSI_AsyncHandle *reqHandle = NULL;
+
+		res = KSITest_createAggrAsyncHandle(ctx, 0, (unsigned char *)*p_req, strlen(*p_req), KSI_HASHALG_SHA2_256, NULL, 0, 0, &reqHandle);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+		res = KSI_AsyncService_addRequest(as, reqHandle);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+		p_req++;
+
+		res = KSI_AsyncService_getPendingCount(as, &pendingCount);
+		CuAssert(tc, "Unable to get pending count.", res == KSI_OK);
+		CuAssert(tc, "Pending count mitmatch.", pendingCount == ++added);
+	}
+
+	for (i = 0; i < added; i++) {
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+		KSI_AsyncHandle *handle = NULL;
+		KSI_Signature *signature = NULL;
+		int error = 0;
+		long errorExt = 0;
+		KSI_Utf8String *msg = NULL;
+
+		res = KSI_AsyncService_run(as, &handle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+		CuAssert(tc, "State should be ERROR.", state == KSI_ASYNC_STATE_ERROR);
+
+		res = KSI_AsyncHandle_getError(handle, &error);
+		CuAssert(tc, "Signing should fail with error.", res == KSI_OK && error == KSI_SERVICE_UPSTREAM_TIMEOUT);
+
+		res = KSI_AsyncHandle_getExtError(handle, &errorExt);
+		CuAssert(tc, "There should be external error.", res == KSI_OK && errorExt == 0x301);
+
+		res = KSI_AsyncHandle_getErrorMessage(handle, &msg);
+		CuAssert(tc, "There should be error message.", res == KSI_OK && msg != NULL);
+		CuAssert(tc, "Error message mismatch.", strcmp("No response from upstream servers", KSI_Utf8String_cstr(msg)) == 0);
+
+		res = KSI_AsyncHandle_getSignature(handle, &signature);
+		CuAssert(tc, "No signature in error state.", res == KSI_INVALID_STATE && signature == NULL);
+
+		KSI_Signature_free(signature);
+		KSI_AsyncHandle_free(handle);
+	}
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_HASign_confRequest_responseConfDefaultConsolidate(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES1[] = {"resource/tlv/" TEST_RESOURCE_AGGR_VER "/aggr_conf_response-max_req_512.tlv"};
+	static const char *TEST_AGGR_RESPONSE_FILES2[] = {"resource/tlv/" TEST_RESOURCE_AGGR_VER "/aggr_conf_response-max_req_1024.tlv"};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_Integer *intVal = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	KSI_Config *cfg = NULL;
+	KSI_AsyncHandle *cfgHandle = NULL;
+	KSI_AggregationReq *cfgReq = NULL;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES1, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES1), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES2, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES2), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AggregationReq_new(ctx, &cfgReq);
+	CuAssert(tc, "Unable to create aggregation request.", res == KSI_OK && cfgReq != NULL);
+
+	res = KSI_Config_new(ctx, &cfg);
+	CuAssert(tc, "Unable to create config object.", res == KSI_OK && cfg != NULL);
+
+	res = KSI_AggregationReq_setConfig(cfgReq, cfg);
+	CuAssert(tc, "Unable to set request data hash.", res == KSI_OK);
+
+	res = KSI_AsyncAggregationHandle_new(ctx, cfgReq, &cfgHandle);
+	CuAssert(tc, "Unable to create async request.", res == KSI_OK && cfgHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, cfgHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	callbackCalls = 0;
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+	CuAssert(tc, "Conf callback has been invoked.", callbackCalls == 0);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Request state mismatch.", state == KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED);
+
+	cfg = NULL;
+	res = KSI_AsyncHandle_getConfig(respHandle, &cfg);
+	CuAssert(tc, "Unable to get server config.", res == KSI_OK && cfg != NULL);
+
+	res = KSI_Config_getMaxRequests(cfg, &intVal);
+	CuAssert(tc, "Conf max requests value mismatch.", res == KSI_OK && KSI_Integer_getUInt64(intVal) == 1024);
+
+	intVal = NULL;
+	res = KSI_Config_getAggrPeriod(cfg, &intVal);
+	CuAssert(tc, "Conf aggregation period value mismatch.", res == KSI_OK && KSI_Integer_getUInt64(intVal) == 400);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
+static void Test_HASign_lowestLatencyRouting(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_AsyncServiceList *subservices = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t optVal = 0;
+	size_t routed = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	verifyOption(tc, as, KSI_ASYNC_OPT_HA_ROUTING_MODE, KSI_ASYNC_HA_ROUTING_BROADCAST, KSI_ASYNC_HA_ROUTING_LOWEST_LATENCY);
+	verifyOption(tc, as, KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE, 95, 99);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_HA_ROUTING_MODE, (void *)__KSI_ASYNC_HA_ROUTING_COUNT);
+	CuAssert(tc, "Unknown routing mode accepted.", res == KSI_INVALID_ARGUMENT);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_HA_HEDGE_PERCENTILE, (void *)0);
+	CuAssert(tc, "Invalid percentile accepted.", res == KSI_INVALID_ARGUMENT);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	/* The request must have been sent to a single subservice. */
+	res = KSI_AsyncService_getOption(as, KSI_ASYNC_OPT_HA_SUBSERVICE_LIST, (void *)&optVal);
+	CuAssert(tc, "Unable to get subservice list.", res == KSI_OK && optVal != 0);
+	subservices = (KSI_AsyncServiceList *)optVal;
+
+	for (i = 0; i < KSI_AsyncServiceList_length(subservices); i++) {
+		KSI_AsyncService *sub = NULL;
+		size_t pending = 0;
+
+		res = KSI_AsyncServiceList_elementAt(subservices, i, &sub);
+		CuAssert(tc, "Unable to get subservice.", res == KSI_OK && sub != NULL);
+
+		res = KSI_AsyncService_getPendingCount(sub, &pending);
+		CuAssert(tc, "Unable to get pending count.", res == KSI_OK);
+		routed += pending;
+	}
+	CuAssert(tc, "Request routed to more than one subservice.", routed == 1);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
+static KSI_AsyncService *getSubservice(CuTest* tc, KSI_AsyncService *as, size_t index) {
+	int res;
+	size_t optVal = 0;
+	KSI_AsyncService *sub = NULL;
+
+	res = KSI_AsyncService_getOption(as, KSI_ASYNC_OPT_HA_SUBSERVICE_LIST, (void *)&optVal);
+	CuAssert(tc, "Unable to get subservice list.", res == KSI_OK && optVal != 0);
+
+	res = KSI_AsyncServiceList_elementAt((KSI_AsyncServiceList *)optVal, index, &sub);
+	CuAssert(tc, "Unable to get subservice.", res == KSI_OK && sub != NULL);
+
+	return sub;
+}
+
+static size_t getSubservicePendingCount(CuTest* tc, KSI_AsyncService *as, size_t index) {
+	int res;
+	size_t pending = 0;
+
+	res = KSI_AsyncService_getPendingCount(getSubservice(tc, as, index), &pending);
+	CuAssert(tc, "Unable to get pending count.", res == KSI_OK);
+
+	return pending;
+}
+
+static void addHARequest(CuTest* tc, KSI_AsyncService *as, KSI_AsyncHandle **handle) {
+	int res;
+	KSI_AsyncHandle *reqHandle = NULL;
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	if (handle != NULL) *handle = reqHandle;
+}
+
+static void Test_HASign_lowestLatencyRouting_fastestSelected(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	/* The mock endpoint reads a response file on every run, thus the response is set once the request is routed. */
+	res = KSITest_MockAsyncService_addEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)10);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_HA_ROUTING_MODE, (void *)KSI_ASYNC_HA_ROUTING_LOWEST_LATENCY);
+	CuAssert(tc, "Unable to set routing mode.", res == KSI_OK);
+
+	/* The first subservice responds slowly. */
+	addHARequest(tc, as, NULL);
+	CuAssert(tc, "Request must be routed to the first subservice.", getSubservicePendingCount(tc, as, 0) == 1);
+	sleep_ms(100);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	KSI_AsyncHandle_free(respHandle);
+	respHandle = NULL;
+
+	/* The unmeasured subservice is preferred, and it responds fast. */
+	addHARequest(tc, as, NULL);
+	CuAssert(tc, "Request must be routed to the unmeasured subservice.", getSubservicePendingCount(tc, as, 1) == 1);
+
+	res = KSITest_MockAsyncService_setEndpoint(getSubservice(tc, as, 1), TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	KSI_AsyncHandle_free(respHandle);
+	respHandle = NULL;
+
+	/* Both subservices are measured, the fastest one must be selected. */
+	addHARequest(tc, as, NULL);
+	CuAssert(tc, "Request must not be routed to the slow subservice.", getSubservicePendingCount(tc, as, 0) == 0);
+	CuAssert(tc, "Request must be routed to the fastest subservice.", getSubservicePendingCount(tc, as, 1) == 1);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_HASign_lowestLatencyRouting_failover(CuTest* tc) {
+	static const char *TEST_AGGR_ERROR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok_aggr_error_response_301.tlv",
+	};
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t notices = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, TEST_AGGR_ERROR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_ERROR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)10);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_HA_ROUTING_MODE, (void *)KSI_ASYNC_HA_ROUTING_LOWEST_LATENCY);
+	CuAssert(tc, "Unable to set routing mode.", res == KSI_OK);
+
+	addHARequest(tc, as, &reqHandle);
+	CuAssert(tc, "Request must be routed to the first subservice.", getSubservicePendingCount(tc, as, 0) == 1);
+
+	/* The first subservice fails, the request must be resent to the second one. */
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle == NULL);
+	CuAssert(tc, "Request must be resent to the second subservice.", getSubservicePendingCount(tc, as, 1) == 1);
+
+	res = KSITest_MockAsyncService_setEndpoint(getSubservice(tc, as, 1), TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	/* The error of the first subservice is reported as a notice before the response. */
+	for (i = 0; i < 5 && respHandle != reqHandle; i++) {
+		KSI_AsyncHandle_free(respHandle);
+		respHandle = NULL;
+
+		res = KSI_AsyncService_run(as, &respHandle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		if (respHandle != NULL && respHandle != reqHandle) {
+			res = KSI_AsyncHandle_getState(respHandle, &state);
+			CuAssert(tc, "Error notice expected.", res == KSI_OK && state == KSI_ASYNC_STATE_ERROR_NOTICE);
+			notices++;
+		}
+	}
+	CuAssert(tc, "Error notice of the failed subservice missing.", notices == 1);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Request must succeed on the second subservice.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	KSI_AsyncHandle_free(respHandle);
+
+	/* The failed subservice is penalized. */
+	addHARequest(tc, as, NULL);
+	CuAssert(tc, "Request must not be routed to the failed subservice.", getSubservicePendingCount(tc, as, 0) == 0);
+	CuAssert(tc, "Request must be routed to the working subservice.", getSubservicePendingCount(tc, as, 1) == 1);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_HASign_hedgedRouting(CuTest* tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	res = KSI_SigningHighAvailabilityService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	/* The first subservice never responds. */
+	res = KSITest_MockAsyncService_addEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSITest_MockAsyncService_addEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_HA_ROUTING_MODE, (void *)KSI_ASYNC_HA_ROUTING_HEDGED);
+	CuAssert(tc, "Unable to set routing mode.", res == KSI_OK);
+
+	addHARequest(tc, as, &reqHandle);
+	CuAssert(tc, "Request must be routed to the first subservice.", getSubservicePendingCount(tc, as, 0) == 1);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle == NULL);
+	CuAssert(tc, "Request must not be hedged before the delay.", getSubservicePendingCount(tc, as, 1) == 0);
+
+	/* After the hedge delay the request is resent to the second subservice. */
+	for (i = 0; i < 100 && getSubservicePendingCount(tc, as, 1) == 0; i++) {
+		sleep_ms(50);
+
+		res = KSI_AsyncService_run(as, &respHandle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle == NULL);
+	}
+	CuAssert(tc, "Request was not hedged.", getSubservicePendingCount(tc, as, 1) == 1);
+	CuAssert(tc, "The first copy must still be pending.", getSubservicePendingCount(tc, as, 0) == 1);
+
+	res = KSITest_MockAsyncService_setEndpoint(getSubservice(tc, as, 1), TEST_AGGR_RESPONSE_FILES, TEST_RESP_COUNT(TEST_AGGR_RESPONSE_FILES), "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+	CuAssert(tc, "No response received from the hedged request.", respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
+static int KSITest_configConsolidateCallback(KSI_CTX *ctx, size_t id, void *userp, KSI_Config *haConfig, KSI_Config *respConfig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *haVal = NULL;
+	KSI_Integer *respVal = NULL;
+
+	KSI_LOG_debug(ctx, "%s: from %p (callback count %llu)", __FUNCTION__, (void*)id, (unsigned long long)++callbackCalls);
+
+	if (ctx == NULL || haConfig == NULL || respConfig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
 
 	if ((void*)ctx != userp) {
 		KSI_LOG_debug(ctx, "%s: user poiter mismatch", __FUNCTION__);
@@ -1801,6 +2884,587 @@ static void preTest(void) {
 	KSI_CTX_setOption(ctx, KSI_OPT_EXT_CONF_RECEIVED_CALLBACK, NULL);
 }
 
+#ifndef _WIN32
+#define TEST_TCP_REQUEST_COUNT 2
+#define TEST_TCP_SEND_LIMIT 16
+
+/* Opens a local endpoint for the TCP client and writes its URI into \c uri. */
+static int openTestServer(CuTest *tc, char *uri, size_t uri_size) {
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int srv = -1;
+
+	srv = socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to create socket.", srv >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	CuAssert(tc, "Unable to bind socket.", bind(srv, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	CuAssert(tc, "Unable to listen.", listen(srv, 1) == 0);
+	CuAssert(tc, "Unable to get socket address.", getsockname(srv, (struct sockaddr *)&addr, &addrLen) == 0);
+	KSI_snprintf(uri, uri_size, "ksi+tcp://127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+
+	return srv;
+}
+
+static int acceptConnection(int srv, KSI_AsyncService *as) {
+	int fd = -1;
+	size_t i;
+
+	/* Keep the client running until it has (re)connected. */
+	for (i = 0; i < 200 && fd < 0; i++) {
+		struct pollfd pfd;
+
+		KSI_AsyncService_run(as, NULL, NULL);
+
+		pfd.fd = srv;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10) == 1) fd = accept(srv, NULL, NULL);
+	}
+	return fd;
+}
+
+static void Test_AsyncSign_tcp_connectionClosedMidSend_requestResentWhole(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handles[TEST_TCP_REQUEST_COUNT];
+	KSI_AsyncHandle *partial = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	int srv = -1;
+	int peer = -1;
+	char uri[64];
+	unsigned char hdr[4];
+	size_t hdrLen = 0;
+	size_t partialLen = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	/* Local endpoint that never reads the requests. */
+	srv = openTestServer(tc, uri, sizeof(uri));
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSI_AsyncService_setEndpoint(as, uri, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)TEST_TCP_REQUEST_COUNT);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)TEST_TCP_REQUEST_COUNT);
+	CuAssert(tc, "Unable to set maximum request count.", res == KSI_OK);
+
+	/* Write at most a few bytes per call, so the first request is always sent partially. */
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_PRIVOPT_SEND_LIMIT, (void *)TEST_TCP_SEND_LIMIT);
+	CuAssert(tc, "Unable to set send limit.", res == KSI_OK);
+
+	for (i = 0; i < TEST_TCP_REQUEST_COUNT; i++) {
+		handles[i] = NULL;
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID_VALUE, NULL, 0, 0, &handles[i]);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handles[i] != NULL);
+
+		res = KSI_AsyncService_addRequest(as, handles[i]);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+	partial = KSI_AsyncHandle_ref(handles[0]);
+
+	/* Run until the first chunk of the first request has been written. */
+	for (i = 0; i < 200 && partial->sentCount == 0; i++) {
+		res = KSI_AsyncService_run(as, &respHandle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle == NULL);
+		if (partial->sentCount == 0) sleep_ms(5);
+	}
+	CuAssert(tc, "Request was not sent partially.", partial->sentCount == TEST_TCP_SEND_LIMIT && partial->sentCount < partial->len);
+	partialLen = partial->len;
+
+	/* Drop the connection while the request is incomplete. */
+	peer = accept(srv, NULL, NULL);
+	CuAssert(tc, "Client did not connect.", peer >= 0);
+	close(peer);
+	peer = -1;
+
+	for (i = 0; i < 200 && partial->sentCount > 0; i++) {
+		respHandle = NULL;
+		res = KSI_AsyncService_run(as, &respHandle, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		KSI_AsyncHandle_free(respHandle);
+		if (partial->sentCount > 0) sleep_ms(5);
+	}
+	CuAssert(tc, "Partially sent request was not reset.", partial->sentCount == 0);
+	CuAssert(tc, "Partially sent request must be kept for resending.", partial->state == KSI_ASYNC_STATE_WAITING_FOR_DISPATCH);
+
+	/* The new stream must start with the complete request. */
+	peer = acceptConnection(srv, as);
+	CuAssert(tc, "Client did not reconnect.", peer >= 0);
+
+	for (i = 0; i < 200 && hdrLen < sizeof(hdr); i++) {
+		struct pollfd pfd;
+		ssize_t c;
+
+		KSI_AsyncService_run(as, NULL, NULL);
+
+		pfd.fd = peer;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10) != 1) continue;
+		c = recv(peer, hdr + hdrLen, sizeof(hdr) - hdrLen, 0);
+		CuAssert(tc, "Unable to read from socket.", c > 0);
+		hdrLen += (size_t)c;
+	}
+	CuAssert(tc, "No data received after reconnect.", hdrLen == sizeof(hdr));
+	CuAssert(tc, "Stream does not start with an aggregation request PDU.", hdr[0] == 0x82 && hdr[1] == 0x20);
+	CuAssert(tc, "Resent request length mismatch.", ((size_t)hdr[2] << 8 | hdr[3]) + 4 == partialLen);
+
+	KSI_LOG_debug(ctx, "%s: CLEANUP.", __FUNCTION__);
+
+	close(peer);
+	close(srv);
+	KSI_AsyncHandle_free(partial);
+	KSI_AsyncService_free(as);
+}
+#undef TEST_TCP_SEND_LIMIT
+#undef TEST_TCP_REQUEST_COUNT
+
+#define TEST_TCP_RESP_MAX_COUNT 4
+
+struct TcpSession_st {
+	KSI_AsyncService *as;
+	int srv;
+	int peer;
+	KSI_AsyncHandle *handles[TEST_TCP_RESP_MAX_COUNT];
+	size_t count;
+};
+
+static void TcpSession_init(CuTest *tc, struct TcpSession_st *s, size_t connCount) {
+	int res;
+	char uri[64];
+
+	s->as = NULL;
+	s->srv = -1;
+	s->peer = -1;
+	s->count = 0;
+
+	s->srv = openTestServer(tc, uri, sizeof(uri));
+
+	res = KSI_SigningAsyncService_new(ctx, &s->as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && s->as != NULL);
+
+	res = KSI_AsyncService_setEndpoint(s->as, uri, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(s->as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)TEST_TCP_RESP_MAX_COUNT);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(s->as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)TEST_TCP_RESP_MAX_COUNT);
+	CuAssert(tc, "Unable to set maximum request count.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(s->as, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)connCount);
+	CuAssert(tc, "Unable to set connection count.", res == KSI_OK);
+}
+
+/* Adds the next request. The requests get the ids 1, 2, ... in the order added. */
+static void TcpSession_addRequest(CuTest *tc, struct TcpSession_st *s) {
+	int res;
+	KSI_AsyncHandle *handle = NULL;
+
+	res = KSITest_createAggrAsyncHandle(ctx, 0, (unsigned char *)TEST_REQ_DATA[s->count], strlen(TEST_REQ_DATA[s->count]), KSI_HASHALG_SHA2_256, NULL, 0, 0, &handle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_AsyncService_addRequest(s->as, handle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	s->handles[s->count++] = KSI_AsyncHandle_ref(handle);
+}
+
+/* Runs the service until the last added request has been sent out. */
+static void TcpSession_waitSent(CuTest *tc, struct TcpSession_st *s) {
+	size_t i;
+
+	for (i = 0; i < 200; i++) {
+		int state = KSI_ASYNC_STATE_UNDEFINED;
+
+		KSI_AsyncService_run(s->as, NULL, NULL);
+		KSI_AsyncHandle_getState(s->handles[s->count - 1], &state);
+		if (state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) break;
+		sleep_ms(5);
+	}
+	CuAssert(tc, "Requests were not sent.", i < 200);
+}
+
+/* Connects the service to a local peer and sends out \c count requests. */
+static void TcpSession_open(CuTest *tc, struct TcpSession_st *s, size_t count) {
+	size_t i;
+
+	TcpSession_init(tc, s, 1);
+
+	for (i = 0; i < count; i++) {
+		TcpSession_addRequest(tc, s);
+	}
+
+	s->peer = acceptConnection(s->srv, s->as);
+	CuAssert(tc, "Client did not connect.", s->peer >= 0);
+
+	/* Responses are only accepted for the requests that have been sent out. */
+	TcpSession_waitSent(tc, s);
+}
+
+static void TcpSession_close(struct TcpSession_st *s) {
+	size_t i;
+
+	if (s->peer >= 0) close(s->peer);
+	if (s->srv >= 0) close(s->srv);
+	for (i = 0; i < s->count; i++) {
+		KSI_AsyncHandle_free(s->handles[i]);
+	}
+	KSI_AsyncService_free(s->as);
+}
+
+/* Writes \c len bytes to the peer in parts of at most \c chunk bytes, letting the client read in between. */
+static void TcpSession_write(CuTest *tc, struct TcpSession_st *s, int peer, const unsigned char *buf, size_t len, size_t chunk) {
+	size_t off = 0;
+	size_t i;
+
+	for (i = 0; i < 10000 && off < len; i++) {
+		size_t n = (len - off) < chunk ? (len - off) : chunk;
+		ssize_t c = send(peer, buf + off, n, MSG_DONTWAIT);
+
+		if (c > 0) off += (size_t)c;
+		KSI_AsyncService_run(s->as, NULL, NULL);
+	}
+	CuAssert(tc, "Unable to write to the client.", off == len);
+}
+
+/* Runs the service until \c count responses are returned, or the service goes idle. */
+static size_t TcpSession_collect(CuTest *tc, struct TcpSession_st *s, size_t count, KSI_AsyncHandle **resp) {
+	size_t received = 0;
+	size_t i;
+
+	for (i = 0; i < 200 && received < count; i++) {
+		KSI_AsyncHandle *handle = NULL;
+		int res = KSI_AsyncService_run(s->as, &handle, NULL);
+
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		if (handle == NULL) {
+			sleep_ms(5);
+			continue;
+		}
+		if (resp != NULL) {
+			resp[received] = handle;
+		} else {
+			KSI_AsyncHandle_free(handle);
+		}
+		received++;
+	}
+	return received;
+}
+
+static size_t readResponse(CuTest *tc, const char *file, unsigned char *buf, size_t size) {
+	FILE *f = NULL;
+	size_t len = 0;
+
+	f = fopen(getFullResourcePath(file), "rb");
+	CuAssert(tc, "Unable to open response file.", f != NULL);
+	len = fread(buf, 1, size, f);
+	fclose(f);
+	CuAssert(tc, "Unable to read response file.", len > 0 && len < size);
+
+	return len;
+}
+
+static void assertSigned(CuTest *tc, KSI_AsyncHandle *handle) {
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	KSI_Signature *signature = NULL;
+
+	CuAssert(tc, "Unable to get request state.", KSI_AsyncHandle_getState(handle, &state) == KSI_OK);
+	CuAssert(tc, "State should be RESPONSE_RECEIVED.", state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+	CuAssert(tc, "Unable to extract signature.", KSI_AsyncHandle_getSignature(handle, &signature) == KSI_OK && signature != NULL);
+	KSI_Signature_free(signature);
+}
+
+static const char *TEST_TCP_RESP_FILES[TEST_TCP_RESP_MAX_COUNT] = {
+	"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+	"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_02h.tlv",
+	"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_03h.tlv",
+	"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_04h.tlv",
+};
+
+/* Sends the response to the request with the given id. */
+static void sendResponse(CuTest *tc, int peer, size_t id) {
+	unsigned char buf[0x4000];
+	size_t len = readResponse(tc, TEST_TCP_RESP_FILES[id - 1], buf, sizeof(buf));
+
+	CuAssert(tc, "Unable to write to the client.", send(peer, buf, len, 0) == (ssize_t)len);
+}
+
+/* Returns the number of request PDUs the peer has received since the last call. */
+static size_t readRequests(CuTest *tc, int peer) {
+	unsigned char buf[0x4000];
+	size_t len = 0;
+	size_t off = 0;
+	size_t count = 0;
+	ssize_t c;
+
+	while ((c = recv(peer, buf + len, sizeof(buf) - len, MSG_DONTWAIT)) > 0) {
+		len += (size_t)c;
+	}
+
+	while (off < len) {
+		KSI_FTLV ftlv;
+
+		CuAssert(tc, "Unable to parse request.", KSI_FTLV_memRead(buf + off, len - off, &ftlv) == KSI_OK);
+		off += ftlv.hdr_len + ftlv.dat_len;
+		count++;
+	}
+	CuAssert(tc, "Partial request received.", off == len);
+
+	return count;
+}
+
+static void Test_AsyncSign_tcp_multiplePdusInOneRead(CuTest* tc) {
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp[TEST_TCP_RESP_MAX_COUNT];
+	unsigned char buf[0x4000];
+	size_t len = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_open(tc, &s, TEST_TCP_RESP_MAX_COUNT);
+
+	for (i = 0; i < TEST_TCP_RESP_MAX_COUNT; i++) {
+		len += readResponse(tc, TEST_TCP_RESP_FILES[i], buf + len, sizeof(buf) - len);
+	}
+
+	/* All of the responses are written with a single call, thus read at once. */
+	CuAssert(tc, "Unable to write to the client.", send(s.peer, buf, len, 0) == (ssize_t)len);
+
+	CuAssert(tc, "Response count mismatch.", TcpSession_collect(tc, &s, TEST_TCP_RESP_MAX_COUNT, resp) == TEST_TCP_RESP_MAX_COUNT);
+	for (i = 0; i < TEST_TCP_RESP_MAX_COUNT; i++) {
+		/* The responses of a connection are returned in the order received. */
+		CuAssert(tc, "Handle mismatch.", resp[i] == s.handles[i]);
+		assertSigned(tc, resp[i]);
+		KSI_AsyncHandle_free(resp[i]);
+	}
+
+	TcpSession_close(&s);
+}
+
+static void Test_AsyncSign_tcp_pduSplitAcrossReads(CuTest* tc) {
+	/* Split inside the header, after the header and inside the value. */
+	static const size_t splits[] = {1, 3, 4, 100};
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp = NULL;
+	unsigned char buf[0x4000];
+	size_t len = 0;
+	size_t off = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_open(tc, &s, 1);
+
+	len = readResponse(tc, TEST_TCP_RESP_FILES[0], buf, sizeof(buf));
+
+	/* Everything but the last byte of the PDU. */
+	for (i = 0; i <= sizeof(splits) / sizeof(splits[0]); i++) {
+		size_t end = (i < sizeof(splits) / sizeof(splits[0])) ? splits[i] : len - 1;
+
+		CuAssert(tc, "Unable to write to the client.", send(s.peer, buf + off, end - off, 0) == (ssize_t)(end - off));
+		off = end;
+
+		CuAssert(tc, "Incomplete PDU must not be returned.", TcpSession_collect(tc, &s, 1, NULL) == 0);
+	}
+
+	CuAssert(tc, "Unable to write to the client.", send(s.peer, buf + off, len - off, 0) == (ssize_t)(len - off));
+	CuAssert(tc, "Response was not received.", TcpSession_collect(tc, &s, 1, &resp) == 1 && resp == s.handles[0]);
+	assertSigned(tc, resp);
+
+	KSI_AsyncHandle_free(resp);
+	TcpSession_close(&s);
+}
+
+static void Test_AsyncSign_tcp_bufferCompaction(CuTest* tc) {
+	/* More data than the input buffer of the connection (4 maximum size PDUs) can hold at once. */
+	static const size_t streamSize = 0x50000;
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp = NULL;
+	unsigned char filler[0x1000];
+	unsigned char *buf = NULL;
+	size_t fillerLen = 0;
+	size_t len = 0;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_open(tc, &s, 1);
+
+	/* Responses with an unknown request id are consumed and dropped by the client. */
+	fillerLen = readResponse(tc, "resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response-wrong-id.tlv", filler, sizeof(filler));
+
+	buf = KSI_malloc(streamSize + sizeof(filler));
+	CuAssert(tc, "Out of memory.", buf != NULL);
+
+	while (len < streamSize) {
+		memcpy(buf + len, filler, fillerLen);
+		len += fillerLen;
+	}
+	len += readResponse(tc, TEST_TCP_RESP_FILES[0], buf + len, sizeof(filler));
+
+	/* The parts do not line up with the PDUs, thus a partial PDU is always left at the end of the
+	 * buffer. Without moving it to the beginning of the buffer the stream could not be read. */
+	TcpSession_write(tc, &s, s.peer, buf, len, 997);
+	KSI_free(buf);
+
+	CuAssert(tc, "Response was not received.", TcpSession_collect(tc, &s, 1, &resp) == 1 && resp == s.handles[0]);
+	assertSigned(tc, resp);
+
+	KSI_AsyncHandle_free(resp);
+	TcpSession_close(&s);
+}
+
+static void Test_AsyncSign_tcp_oversizedLength(CuTest* tc) {
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp = NULL;
+	unsigned char *buf = NULL;
+	const size_t len = 0xffff + 4;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	int error = KSI_OK;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_open(tc, &s, 1);
+
+	/* An aggregation response header with the maximum length, followed by zeros. */
+	buf = KSI_calloc(len, 1);
+	CuAssert(tc, "Out of memory.", buf != NULL);
+	buf[0] = 0x82;
+	buf[1] = 0x21;
+	buf[2] = 0xff;
+	buf[3] = 0xff;
+
+	/* The PDU is far longer than any response, the client has to wait for all of it. */
+	TcpSession_write(tc, &s, s.peer, buf, len - 1, 0x1000);
+	CuAssert(tc, "Incomplete PDU must not be returned.", TcpSession_collect(tc, &s, 1, NULL) == 0);
+
+	TcpSession_write(tc, &s, s.peer, buf + len - 1, 1, 1);
+	KSI_free(buf);
+
+	/* The complete PDU is invalid and fails the request. */
+	CuAssert(tc, "Request was not completed.", TcpSession_collect(tc, &s, 1, &resp) == 1 && resp == s.handles[0]);
+	CuAssert(tc, "Unable to get request state.", KSI_AsyncHandle_getState(resp, &state) == KSI_OK && state == KSI_ASYNC_STATE_ERROR);
+	CuAssert(tc, "Unable to get error.", KSI_AsyncHandle_getError(resp, &error) == KSI_OK && error != KSI_OK);
+
+	KSI_AsyncHandle_free(resp);
+	TcpSession_close(&s);
+}
+
+/* Opens the pool connections one by one, so that peer A serves requests 1 and 3, and peer B request 2. */
+static void TcpSession_openPool(CuTest *tc, struct TcpSession_st *s, int *peerB) {
+	TcpSession_init(tc, s, 2);
+
+	TcpSession_addRequest(tc, s);
+	s->peer = acceptConnection(s->srv, s->as);
+	CuAssert(tc, "Client did not connect.", s->peer >= 0);
+	TcpSession_waitSent(tc, s);
+
+	/* The idle connection is preferred. */
+	TcpSession_addRequest(tc, s);
+	*peerB = acceptConnection(s->srv, s->as);
+	CuAssert(tc, "Client did not open a second connection.", *peerB >= 0);
+	TcpSession_waitSent(tc, s);
+
+	/* Equally loaded connections are used in turns. */
+	TcpSession_addRequest(tc, s);
+	TcpSession_waitSent(tc, s);
+
+	CuAssert(tc, "Requests are not spread over the connections.", readRequests(tc, s->peer) == 2 && readRequests(tc, *peerB) == 1);
+}
+
+static void Test_AsyncSign_tcp_pool_leastOutstandingConnection(CuTest* tc) {
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp[TEST_TCP_RESP_MAX_COUNT];
+	int peerB = -1;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_openPool(tc, &s, &peerB);
+
+	/* Peer A responds, peer B keeps its request outstanding. */
+	sendResponse(tc, s.peer, 1);
+	sendResponse(tc, s.peer, 3);
+	CuAssert(tc, "Response count mismatch.", TcpSession_collect(tc, &s, 2, resp) == 2);
+	CuAssert(tc, "Handle mismatch.", resp[0] == s.handles[0] && resp[1] == s.handles[2]);
+	KSI_AsyncHandle_free(resp[0]);
+	KSI_AsyncHandle_free(resp[1]);
+
+	/* Next in turn would be peer B, but peer A has no requests outstanding. */
+	TcpSession_addRequest(tc, &s);
+	TcpSession_waitSent(tc, &s);
+	CuAssert(tc, "Request was not sent over the least loaded connection.", readRequests(tc, s.peer) == 1 && readRequests(tc, peerB) == 0);
+
+	sendResponse(tc, s.peer, 4);
+	sendResponse(tc, peerB, 2);
+	CuAssert(tc, "Response count mismatch.", TcpSession_collect(tc, &s, 2, resp) == 2);
+	for (i = 0; i < 2; i++) {
+		CuAssert(tc, "Handle mismatch.", resp[i] == s.handles[1] || resp[i] == s.handles[3]);
+		assertSigned(tc, resp[i]);
+		KSI_AsyncHandle_free(resp[i]);
+	}
+
+	close(peerB);
+	TcpSession_close(&s);
+}
+
+static void Test_AsyncSign_tcp_pool_closedConnectionFailsOwnRequests(CuTest* tc) {
+	struct TcpSession_st s;
+	KSI_AsyncHandle *resp[TEST_TCP_RESP_MAX_COUNT];
+	int peerB = -1;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	int error = KSI_OK;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "START %s", __FUNCTION__);
+
+	TcpSession_openPool(tc, &s, &peerB);
+
+	/* Peer A drops the connection with requests 1 and 3 outstanding. */
+	close(s.peer);
+	s.peer = -1;
+
+	CuAssert(tc, "Response count mismatch.", TcpSession_collect(tc, &s, 2, resp) == 2);
+	for (i = 0; i < 2; i++) {
+		CuAssert(tc, "Request of the other connection was failed.", resp[i] == s.handles[0] || resp[i] == s.handles[2]);
+		CuAssert(tc, "Unable to get request state.", KSI_AsyncHandle_getState(resp[i], &state) == KSI_OK && state == KSI_ASYNC_STATE_ERROR);
+		CuAssert(tc, "Unexpected error.", KSI_AsyncHandle_getError(resp[i], &error) == KSI_OK && error == KSI_ASYNC_CONNECTION_CLOSED);
+		KSI_AsyncHandle_free(resp[i]);
+	}
+
+	/* The request over the other connection is still waiting. */
+	CuAssert(tc, "Unable to get request state.", KSI_AsyncHandle_getState(s.handles[1], &state) == KSI_OK && state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
+
+	/* The closed connection is reopened for the next request. */
+	TcpSession_addRequest(tc, &s);
+	s.peer = acceptConnection(s.srv, s.as);
+	CuAssert(tc, "Client did not reconnect.", s.peer >= 0);
+	TcpSession_waitSent(tc, &s);
+	CuAssert(tc, "Request was not sent over the reopened connection.", readRequests(tc, s.peer) == 1 && readRequests(tc, peerB) == 0);
+
+	sendResponse(tc, peerB, 2);
+	sendResponse(tc, s.peer, 4);
+	CuAssert(tc, "Response count mismatch.", TcpSession_collect(tc, &s, 2, resp) == 2);
+	for (i = 0; i < 2; i++) {
+		CuAssert(tc, "Handle mismatch.", resp[i] == s.handles[1] || resp[i] == s.handles[3]);
+		assertSigned(tc, resp[i]);
+		KSI_AsyncHandle_free(resp[i]);
+	}
+
+	close(peerB);
+	TcpSession_close(&s);
+}
+#undef TEST_TCP_RESP_MAX_COUNT
+#endif
+
 CuSuite* KSITest_NetAsync_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
@@ -1818,6 +3482,8 @@ CuSuite* KSITest_NetAsync_getSuite(void) {
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifyReqCtx);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifySignature);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_multipleResponses_verifySignature);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifyStatistics);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_eventLoop);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifyNoError);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_responseWithPushConf_viaServiceCallback);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_responseWithPushConf_viaKsiCtxAggrCallback);
@@ -1836,10 +3502,32 @@ CuSuite* KSITest_NetAsync_getSuite(void) {
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_loop);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_loop_cacheSize5);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_collect);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_completionCallback);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_submitQueue_collect);
+#ifdef TEST_THREADS_SUPPORTED
+	SUITE_ADD_TEST(suite, Test_AsyncSign_submitQueue_multipleProducers);
+#endif
+	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_collect_responseOrderAfterCacheResize);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_collect_aggrResp301);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_localAggregation_collect);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_localAggregation_signatures);
 
 	SUITE_ADD_TEST(suite, Test_HASign_confRequest_responseConfDefaultConsolidate);
 	SUITE_ADD_TEST(suite, Test_HASign_confRequest_responseConfConsolidateCallback);
+	SUITE_ADD_TEST(suite, Test_HASign_lowestLatencyRouting);
+	SUITE_ADD_TEST(suite, Test_HASign_lowestLatencyRouting_fastestSelected);
+	SUITE_ADD_TEST(suite, Test_HASign_lowestLatencyRouting_failover);
+	SUITE_ADD_TEST(suite, Test_HASign_hedgedRouting);
+
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_connectionClosedMidSend_requestResentWhole);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_multiplePdusInOneRead);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_pduSplitAcrossReads);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_bufferCompaction);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_oversizedLength);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_pool_leastOutstandingConnection);
+	SUITE_ADD_TEST(suite, Test_AsyncSign_tcp_pool_closedConnectionFailsOwnRequests);
+#endif
 
 	return suite;
 }
@@ -400,6 +400,116 @@ static void testSerializeSignature(CuTest *tc) {
 #undef TEST_SIGNATURE_FILE
 }
 
+static void testSignatureWriteBytes(CuTest *tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+
+	int res;
+
+	unsigned char in[0x1ffff];
+	size_t in_len = 0;
+
+	unsigned char out[0x1ffff];
+	size_t out_len = 0;
+
+	FILE *f = NULL;
+
+	KSI_Signature *sig = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	f = fopen(getFullResourcePath(TEST_SIGNATURE_FILE), "rb");
+	CuAssert(tc, "Unable to open signature file.", f != NULL);
+
+	in_len = (unsigned)fread(in, 1, sizeof(in), f);
+	CuAssert(tc, "Nothing read from signature file.", in_len > 0);
+
+	fclose(f);
+
+	res = KSI_Signature_parse(ctx, in, in_len, &sig);
+	CuAssert(tc, "Failed to parse signature.", res == KSI_OK && sig != NULL);
+
+	/* Calculate the length only. */
+	res = KSI_Signature_writeBytes(sig, NULL, 0, &out_len, 0);
+	CuAssert(tc, "Failed to calculate serialized signature length.", res == KSI_OK && out_len == in_len);
+
+	res = KSI_Signature_writeBytes(sig, out, in_len - 1, &out_len, 0);
+	CuAssert(tc, "Serializing into a too small buffer should fail.", res == KSI_BUFFER_OVERFLOW);
+
+	memset(out, 0, sizeof(out));
+	res = KSI_Signature_writeBytes(sig, out, in_len, &out_len, 0);
+	CuAssert(tc, "Failed to serialize signature into an exact size buffer.", res == KSI_OK);
+	CuAssert(tc, "Serialized signature length mismatch.", in_len == out_len);
+	CuAssert(tc, "Serialized signature content mismatch.", !memcmp(in, out, in_len));
+
+	KSI_Signature_free(sig);
+
+#undef TEST_SIGNATURE_FILE
+}
+
+static void testLazySignature(CuTest *tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+
+	int res;
+
+	unsigned char in[0x1ffff];
+	size_t in_len = 0;
+
+	FILE *f = NULL;
+
+	KSI_LazySignature *lazy = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *full = NULL;
+	KSI_Integer *lazyTime = NULL;
+	KSI_Integer *sigTime = NULL;
+	KSI_DataHash *lazyHash = NULL;
+	KSI_DataHash *sigHash = NULL;
+	KSI_CalendarHashChain *calChain = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	f = fopen(getFullResourcePath(TEST_SIGNATURE_FILE), "rb");
+	CuAssert(tc, "Unable to open signature file.", f != NULL);
+
+	in_len = (unsigned)fread(in, 1, sizeof(in), f);
+	CuAssert(tc, "Nothing read from signature file.", in_len > 0);
+
+	fclose(f);
+
+	res = KSI_LazySignature_parse(ctx, in, in_len - 1, &lazy);
+	CuAssert(tc, "Truncated signature should not be accepted.", res != KSI_OK && lazy == NULL);
+
+	res = KSI_LazySignature_parse(ctx, in, in_len, &lazy);
+	CuAssert(tc, "Failed to index signature.", res == KSI_OK && lazy != NULL);
+
+	res = KSI_Signature_parse(ctx, in, in_len, &full);
+	CuAssert(tc, "Failed to parse signature.", res == KSI_OK && full != NULL);
+
+	res = KSI_LazySignature_getSigningTime(lazy, &lazyTime);
+	CuAssert(tc, "Unable to get lazy signing time.", res == KSI_OK && lazyTime != NULL);
+
+	res = KSI_Signature_getSigningTime(full, &sigTime);
+	CuAssert(tc, "Unable to get signing time.", res == KSI_OK && sigTime != NULL);
+	CuAssert(tc, "Signing time mismatch.", KSI_Integer_equals(lazyTime, sigTime));
+
+	res = KSI_LazySignature_getDocumentHash(lazy, &lazyHash);
+	CuAssert(tc, "Unable to get lazy document hash.", res == KSI_OK && lazyHash != NULL);
+
+	res = KSI_Signature_getDocumentHash(full, &sigHash);
+	CuAssert(tc, "Unable to get document hash.", res == KSI_OK && sigHash != NULL);
+	CuAssert(tc, "Document hash mismatch.", KSI_DataHash_equals(lazyHash, sigHash));
+
+	res = KSI_LazySignature_getCalendarChain(lazy, &calChain);
+	CuAssert(tc, "Unable to get lazy calendar chain.", res == KSI_OK && calChain != NULL);
+
+	res = KSI_LazySignature_getSignature(lazy, &sig);
+	CuAssert(tc, "Unable to materialize signature.", res == KSI_OK && sig != NULL);
+
+	KSI_Signature_free(full);
+	KSI_LazySignature_free(lazy);
+
+#undef TEST_SIGNATURE_FILE
+}
+
 static void testVerifyDocument(CuTest *tc) {
 #define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
 
@@ -1031,6 +1141,8 @@ CuSuite* KSITest_Signature_getSuite(void) {
 	SUITE_ADD_TEST(suite, testSignatureSigningTime);
 	SUITE_ADD_TEST(suite, testSignatureSigningTimeNoCalendarChain);
 	SUITE_ADD_TEST(suite, testSerializeSignature);
+	SUITE_ADD_TEST(suite, testSignatureWriteBytes);
+	SUITE_ADD_TEST(suite, testLazySignature);
 	SUITE_ADD_TEST(suite, testVerifyDocument);
 	SUITE_ADD_TEST(suite, testVerifyDocumentHash);
 	SUITE_ADD_TEST(suite, testVerifySignatureNew);
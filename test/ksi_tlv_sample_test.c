@@ -333,6 +333,102 @@ static void extendPduVer2Test(CuTest *tc) {
 	ctx->options[KSI_OPT_EXT_PDU_VER] = KSI_EXTENDING_PDU_VERSION;
 }
 
+static void testObjectWriteBytes(CuTest *tc, const char *sample,
+									int (*parse)(KSI_CTX *, unsigned char *, size_t, void **),
+									int (*serialize)(void *, unsigned char **, size_t *),
+									int (*writeBytes)(void *, unsigned char *, size_t, size_t *, int),
+									void (*objFree)(void *)) {
+	int res;
+	void *pdu = NULL;
+	unsigned char in[0xffff + 4];
+	size_t in_len;
+	unsigned char *exp = NULL;
+	size_t exp_len;
+	unsigned char out[0xffff + 4];
+	size_t out_len = 0;
+	FILE *f = NULL;
+	char errm[1024];
+
+	f = fopen(sample, "rb");
+	KSI_snprintf(errm, sizeof(errm), "Unable to open pdu file: '%s'.", sample);
+	CuAssert(tc, errm, f != NULL);
+
+	in_len = (unsigned)fread(in, 1, sizeof(in), f);
+	fclose(f);
+	KSI_snprintf(errm, sizeof(errm), "Unable to read pdu file: '%s'.", sample);
+	CuAssert(tc, errm, in_len > 0);
+
+	res = parse(ctx, in, in_len, &pdu);
+	KSI_snprintf(errm, sizeof(errm), "Unable to parse pdu: '%s'.", sample);
+	CuAssert(tc, errm, res == KSI_OK && pdu != NULL);
+
+	res = serialize(pdu, &exp, &exp_len);
+	KSI_snprintf(errm, sizeof(errm), "Unable to serialize pdu: '%s'.", sample);
+	CuAssert(tc, errm, res == KSI_OK && exp != NULL && exp_len > 0);
+
+	/* Calculate the length only. */
+	res = writeBytes(pdu, NULL, 0, &out_len, 0);
+	KSI_snprintf(errm, sizeof(errm), "Unable to calculate serialized pdu length: '%s'.", sample);
+	CuAssert(tc, errm, res == KSI_OK && out_len == exp_len);
+
+	res = writeBytes(pdu, out, exp_len - 1, &out_len, 0);
+	KSI_snprintf(errm, sizeof(errm), "Writing pdu into a too small buffer should fail: '%s'.", sample);
+	CuAssert(tc, errm, res == KSI_BUFFER_OVERFLOW);
+
+	memset(out, 0, sizeof(out));
+	res = writeBytes(pdu, out, exp_len, &out_len, 0);
+	KSI_snprintf(errm, sizeof(errm), "Unable to write pdu into an exact size buffer: '%s'.", sample);
+	CuAssert(tc, errm, res == KSI_OK && out_len == exp_len);
+
+	KSI_snprintf(errm, sizeof(errm), "Written pdu content mismatch: '%s'.", sample);
+	CuAssert(tc, errm, !KSITest_memcmp(exp, out, exp_len));
+
+	KSI_free(exp);
+	objFree(pdu);
+}
+
+static void aggregationPduVer2WriteBytesTest(CuTest *tc) {
+	static const char *samples[] = {
+		"resource/tlv/v2/aggr_request.tlv",
+		"resource/tlv/v2/aggr_response.tlv",
+		"resource/tlv/v2/aggr_conf_response-max_req_1024.tlv",
+		"resource/tlv/v2/ok-sig-2014-07-01.1-aggr_response-with-conf-and-ack.tlv",
+		NULL
+	};
+	size_t i;
+
+	ctx->options[KSI_OPT_AGGR_PDU_VER] = KSI_PDU_VERSION_2;
+	for (i = 0; samples[i] != NULL; i++) {
+		testObjectWriteBytes(tc, getFullResourcePath(samples[i]),
+				(int (*)(KSI_CTX *, unsigned char *, size_t, void **))KSI_AggregationPdu_parse,
+				(int (*)(void *, unsigned char **, size_t *))KSI_AggregationPdu_serialize,
+				(int (*)(void *, unsigned char *, size_t, size_t *, int))KSI_AggregationPdu_writeBytes,
+				(void (*)(void *))KSI_AggregationPdu_free);
+	}
+	ctx->options[KSI_OPT_AGGR_PDU_VER] = KSI_AGGREGATION_PDU_VERSION;
+}
+
+static void extendPduVer2WriteBytesTest(CuTest *tc) {
+	static const char *samples[] = {
+		"resource/tlv/v2/extend_request.tlv",
+		"resource/tlv/v2/extend_response.tlv",
+		"resource/tlv/v2/ext_error_pdu.tlv",
+		"resource/tlv/v2/ok-sig-2014-04-30.1-extend_response-with-conf.tlv",
+		NULL
+	};
+	size_t i;
+
+	ctx->options[KSI_OPT_EXT_PDU_VER] = KSI_PDU_VERSION_2;
+	for (i = 0; samples[i] != NULL; i++) {
+		testObjectWriteBytes(tc, getFullResourcePath(samples[i]),
+				(int (*)(KSI_CTX *, unsigned char *, size_t, void **))KSI_ExtendPdu_parse,
+				(int (*)(void *, unsigned char **, size_t *))KSI_ExtendPdu_serialize,
+				(int (*)(void *, unsigned char *, size_t, size_t *, int))KSI_ExtendPdu_writeBytes,
+				(void (*)(void *))KSI_ExtendPdu_free);
+	}
+	ctx->options[KSI_OPT_EXT_PDU_VER] = KSI_EXTENDING_PDU_VERSION;
+}
+
 static void testErrorMessage(CuTest* tc, const char *expected, const char *tlv_file,
 		int (*obj_new)(KSI_CTX *ctx, void **),
 		void (*obj_free)(void*),
@@ -396,6 +492,8 @@ CuSuite* KSITest_TLV_Sample_getSuite(void)
 	SUITE_ADD_TEST(suite, TestClone);
 	SUITE_ADD_TEST(suite, aggregationPduVer2Test);
 	SUITE_ADD_TEST(suite, extendPduVer2Test);
+	SUITE_ADD_TEST(suite, aggregationPduVer2WriteBytesTest);
+	SUITE_ADD_TEST(suite, extendPduVer2WriteBytesTest);
 	SUITE_ADD_TEST(suite, testUnknownCriticalTagErrorPduVer2);
 	SUITE_ADD_TEST(suite, testMissingMandatoryTagErrorPduVer2);
 
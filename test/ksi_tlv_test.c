@@ -28,7 +28,9 @@
 
 #include "all_tests.h"
 
+#include "../src/ksi/impl/ctx_impl.h"
 #include "../src/ksi/impl/signature_impl.h"
+#include "../src/ksi/impl/tlv_template_impl.h"
 
 extern KSI_CTX *ctx;
 
@@ -449,6 +451,342 @@ static void testTlvSerializeMandatoryListObjectEmpty(CuTest *tc) {
 #undef TEST_SIGNATURE_FILE
 }
 
+KSI_IMPORT_TLV_TEMPLATE(KSI_PublicationData);
+
+static void testTemplateParseDirect(CuTest *tc) {
+	int res;
+	size_t i;
+	KSI_TLV *tlv = NULL;
+	KSI_PublicationData *direct = NULL;
+	KSI_PublicationData *extracted = NULL;
+	KSI_Integer *timeDirect = NULL;
+	KSI_Integer *timeExtracted = NULL;
+	KSI_DataHash *hshDirect = NULL;
+	KSI_DataHash *hshExtracted = NULL;
+	unsigned char ok[] = {
+			0x10, 0x2c,
+			0x02, 0x04, 0x53, 0x60, 0xdf, 0x80,
+			0x45, 0x01, 0xff,
+			0x04, 0x21, 0x01,
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+			0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+	struct {
+		const char *msg;
+		unsigned char raw[16];
+		size_t raw_len;
+	} bad[] = {
+		{ "Unknown critical element accepted.", { 0x10, 0x09, 0x02, 0x04, 0x53, 0x60, 0xdf, 0x80, 0x05, 0x01, 0xff }, 11 },
+		{ "Missing mandatory element accepted.", { 0x10, 0x06, 0x02, 0x04, 0x53, 0x60, 0xdf, 0x80 }, 8 },
+		{ "Badly encoded integer accepted.", { 0x10, 0x04, 0x02, 0x02, 0x00, 0x01 }, 6 },
+		{ "Truncated element accepted.", { 0x10, 0x04, 0x02, 0x04, 0x53, 0x60 }, 6 },
+		{ "Duplicate element accepted.", { 0x10, 0x0c, 0x02, 0x04, 0x53, 0x60, 0xdf, 0x80, 0x02, 0x04, 0x53, 0x60, 0xdf, 0x81 }, 14 },
+		{ NULL, { 0 }, 0 }
+	};
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_PublicationData_new(ctx, &direct);
+	CuAssert(tc, "Unable to create publication data.", res == KSI_OK && direct != NULL);
+
+	res = KSI_TlvTemplate_parse(ctx, ok, sizeof(ok), KSI_TLV_TEMPLATE(KSI_PublicationData), direct);
+	CuAssert(tc, "Unable to decode publication data.", res == KSI_OK);
+
+	res = KSI_TLV_parseBlob(ctx, ok, sizeof(ok), &tlv);
+	CuAssert(tc, "Unable to parse TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_PublicationData_new(ctx, &extracted);
+	CuAssert(tc, "Unable to create publication data.", res == KSI_OK && extracted != NULL);
+
+	res = KSI_TlvTemplate_extract(ctx, extracted, tlv, KSI_TLV_TEMPLATE(KSI_PublicationData));
+	CuAssert(tc, "Unable to extract publication data.", res == KSI_OK);
+
+	KSI_PublicationData_getTime(direct, &timeDirect);
+	KSI_PublicationData_getTime(extracted, &timeExtracted);
+	CuAssert(tc, "Publication time mismatch.", KSI_Integer_equals(timeDirect, timeExtracted));
+
+	KSI_PublicationData_getImprint(direct, &hshDirect);
+	KSI_PublicationData_getImprint(extracted, &hshExtracted);
+	CuAssert(tc, "Publication imprint mismatch.", KSI_DataHash_equals(hshDirect, hshExtracted));
+
+	KSI_PublicationData_free(direct);
+	direct = NULL;
+
+	for (i = 0; bad[i].msg != NULL; i++) {
+		res = KSI_PublicationData_new(ctx, &direct);
+		CuAssert(tc, "Unable to create publication data.", res == KSI_OK && direct != NULL);
+
+		res = KSI_TlvTemplate_parse(ctx, bad[i].raw, bad[i].raw_len, KSI_TLV_TEMPLATE(KSI_PublicationData), direct);
+		CuAssert(tc, bad[i].msg, res != KSI_OK);
+
+		KSI_PublicationData_free(direct);
+		direct = NULL;
+	}
+
+	KSI_PublicationData_free(extracted);
+	KSI_TLV_free(tlv);
+}
+
+typedef struct TestIdx_st {
+	KSI_Integer *first;
+	KSI_Integer *second;
+	KSI_Integer *collision;
+	KSI_Integer *last;
+	size_t fillers;
+} TestIdx;
+
+static void TestIdx_free(TestIdx *o) {
+	if (o != NULL) {
+		KSI_Integer_free(o->first);
+		KSI_Integer_free(o->second);
+		KSI_Integer_free(o->collision);
+		KSI_Integer_free(o->last);
+		KSI_free(o);
+	}
+}
+
+#define TEST_IDX_FIELD(name) \
+static int TestIdx_get_##name(TestIdx *o, KSI_Integer **v) { *v = o->name; return KSI_OK; } \
+static int TestIdx_set_##name(TestIdx *o, KSI_Integer *v) { o->name = v; return KSI_OK; }
+
+TEST_IDX_FIELD(first)
+TEST_IDX_FIELD(second)
+TEST_IDX_FIELD(collision)
+TEST_IDX_FIELD(last)
+
+static int TestIdx_addFiller(TestIdx *o, KSI_Integer *v) {
+	KSI_Integer_free(v);
+	o->fillers++;
+	return KSI_OK;
+}
+
+/* Tag 0x01 is matched by two entries, tag 0x80 shares the index bucket with tag 0x01. */
+KSI_DEFINE_TLV_TEMPLATE(TestIdxMoreDefs)
+	KSI_TLV_INTEGER(0x01, KSI_TLV_TMPL_FLG_MORE_DEFS, TestIdx_get_first, TestIdx_set_first, "first")
+	KSI_TLV_INTEGER(0x02, KSI_TLV_TMPL_FLG_NONE, TestIdx_get_second, TestIdx_set_second, "second")
+	KSI_TLV_INTEGER(0x80, KSI_TLV_TMPL_FLG_NONE, TestIdx_get_collision, TestIdx_set_collision, "collision")
+	KSI_TLV_INTEGER(0x01, KSI_TLV_TMPL_FLG_MANDATORY, TestIdx_get_last, TestIdx_set_last, "last")
+KSI_END_TLV_TEMPLATE
+
+#define TEST_IDX_FILLER(tg) KSI_TLV_INTEGER(tg, KSI_TLV_TMPL_FLG_NONE, NULL, TestIdx_addFiller, "filler")
+#define TEST_IDX_FILLER_8(tg) \
+	TEST_IDX_FILLER((tg) + 0) TEST_IDX_FILLER((tg) + 1) TEST_IDX_FILLER((tg) + 2) TEST_IDX_FILLER((tg) + 3) \
+	TEST_IDX_FILLER((tg) + 4) TEST_IDX_FILLER((tg) + 5) TEST_IDX_FILLER((tg) + 6) TEST_IDX_FILLER((tg) + 7)
+
+/* Template with more entries than a compiled index can cover. */
+KSI_DEFINE_TLV_TEMPLATE(TestIdxLarge)
+	TEST_IDX_FILLER_8(0x20)
+	TEST_IDX_FILLER_8(0x28)
+	TEST_IDX_FILLER_8(0x30)
+	TEST_IDX_FILLER_8(0x38)
+	TEST_IDX_FILLER_8(0x40)
+	TEST_IDX_FILLER_8(0x48)
+	TEST_IDX_FILLER_8(0x50)
+	TEST_IDX_FILLER_8(0x58)
+	KSI_TLV_INTEGER(0x01, KSI_TLV_TMPL_FLG_MANDATORY, TestIdx_get_last, TestIdx_set_last, "last")
+KSI_END_TLV_TEMPLATE
+
+/* Occupies the template index cache slots, the template itself is never parsed. */
+KSI_DEFINE_TLV_TEMPLATE(TestIdxDummy)
+	KSI_TLV_INTEGER(0x01, KSI_TLV_TMPL_FLG_NONE, NULL, NULL, "dummy")
+KSI_END_TLV_TEMPLATE
+
+static int fillTemplateIndexCache(KSI_CTX *c, size_t count) {
+	size_t i;
+
+	for (i = 0; i < KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE && count > 0; i++) {
+		if (c->templateIndex[i] != NULL) continue;
+
+		c->templateIndex[i] = KSI_calloc(1, sizeof(KSI_TlvTemplateIndex));
+		if (c->templateIndex[i] == NULL) return KSI_OUT_OF_MEMORY;
+		c->templateIndex[i]->tmpl = KSI_TLV_TEMPLATE(TestIdxDummy);
+		count--;
+	}
+	return KSI_OK;
+}
+
+static bool isTemplateIndexed(KSI_CTX *c, const KSI_TlvTemplate *tmpl) {
+	size_t i;
+
+	for (i = 0; i < KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE; i++) {
+		if (c->templateIndex[i] != NULL && c->templateIndex[i]->tmpl == tmpl) return true;
+	}
+	return false;
+}
+
+/* Parses the raw TLV with the direct decoder or the TLV tree extractor. */
+static int parseTestIdx(KSI_CTX *c, const unsigned char *raw, size_t raw_len, const KSI_TlvTemplate *tmpl, bool direct, TestIdx **out) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+	TestIdx *tmp = NULL;
+
+	tmp = KSI_calloc(1, sizeof(TestIdx));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	if (direct) {
+		res = KSI_TlvTemplate_parse(c, raw, raw_len, tmpl, tmp);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = KSI_TLV_parseBlob(c, raw, raw_len, &tlv);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_TlvTemplate_extract(c, tmp, tlv, tmpl);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	*out = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_TLV_free(tlv);
+	TestIdx_free(tmp);
+	return res;
+}
+
+static bool integerEquals(const KSI_Integer *a, const KSI_Integer *b) {
+	return (a == NULL && b == NULL) || (a != NULL && b != NULL && KSI_Integer_equals(a, b));
+}
+
+static bool TestIdx_equals(const TestIdx *a, const TestIdx *b) {
+	return integerEquals(a->first, b->first) && integerEquals(a->second, b->second) &&
+			integerEquals(a->collision, b->collision) && integerEquals(a->last, b->last) && a->fillers == b->fillers;
+}
+
+/* Parses the raw TLV with and without the template index and verifies the results match. */
+static void assertIndexedParse(CuTest *tc, const unsigned char *raw, size_t raw_len, const KSI_TlvTemplate *tmpl, bool indexable, int expRes, TestIdx **out) {
+	int res;
+	KSI_CTX *indexed = NULL;
+	KSI_CTX *scanned = NULL;
+	TestIdx *idx = NULL;
+	TestIdx *scan = NULL;
+	int direct;
+
+	res = KSI_CTX_new(&indexed);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && indexed != NULL);
+
+	res = KSI_CTX_new(&scanned);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && scanned != NULL);
+
+	res = fillTemplateIndexCache(scanned, KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE);
+	CuAssert(tc, "Unable to fill template index cache.", res == KSI_OK);
+
+	for (direct = 0; direct < 2; direct++) {
+		res = parseTestIdx(indexed, raw, raw_len, tmpl, direct, &idx);
+		CuAssert(tc, "Unexpected result with template index.", res == expRes);
+
+		res = parseTestIdx(scanned, raw, raw_len, tmpl, direct, &scan);
+		CuAssert(tc, "Unexpected result without template index.", res == expRes);
+
+		CuAssert(tc, "Template index usage mismatch.", isTemplateIndexed(indexed, tmpl) == indexable);
+		CuAssert(tc, "Template must not be indexed in a full cache.", !isTemplateIndexed(scanned, tmpl));
+
+		if (expRes == KSI_OK) {
+			CuAssert(tc, "Parse result mismatch with and without template index.", TestIdx_equals(idx, scan));
+		}
+
+		if (out != NULL && *out == NULL) {
+			*out = idx;
+			idx = NULL;
+		}
+		TestIdx_free(idx);
+		idx = NULL;
+		TestIdx_free(scan);
+		scan = NULL;
+	}
+
+	KSI_CTX_free(indexed);
+	KSI_CTX_free(scanned);
+}
+
+static void testTemplateIndexMoreDefs(CuTest *tc) {
+	TestIdx *p = NULL;
+	unsigned char ok[] = {
+			0x10, 0x0b,
+			0x02, 0x01, 0x07,
+			0x80, 0x80, 0x00, 0x01, 0x09,
+			0x01, 0x01, 0x05 };
+	unsigned char missing[] = {
+			0x10, 0x03,
+			0x02, 0x01, 0x07 };
+
+	assertIndexedParse(tc, ok, sizeof(ok), KSI_TLV_TEMPLATE(TestIdxMoreDefs), true, KSI_OK, &p);
+	CuAssert(tc, "Element must be set by every matching template entry.",
+			KSI_Integer_equalsUInt(p->first, 5) && KSI_Integer_equalsUInt(p->last, 5));
+	CuAssert(tc, "Element value mismatch.", KSI_Integer_equalsUInt(p->second, 7));
+	CuAssert(tc, "Colliding tag value mismatch.", KSI_Integer_equalsUInt(p->collision, 9));
+	TestIdx_free(p);
+
+	assertIndexedParse(tc, missing, sizeof(missing), KSI_TLV_TEMPLATE(TestIdxMoreDefs), true, KSI_INVALID_FORMAT, NULL);
+}
+
+static void testTemplateIndexLargeTemplate(CuTest *tc) {
+	TestIdx *p = NULL;
+	unsigned char ok[] = {
+			0x10, 0x0d,
+			0x80, 0x20, 0x00, 0x01, 0x01,
+			0x80, 0x5f, 0x00, 0x01, 0x02,
+			0x01, 0x01, 0x03 };
+	unsigned char missing[] = {
+			0x10, 0x0a,
+			0x80, 0x20, 0x00, 0x01, 0x01,
+			0x80, 0x5f, 0x00, 0x01, 0x02 };
+
+	CuAssert(tc, "Template should not fit into the index.",
+			sizeof(TestIdxLarge_template) / sizeof(TestIdxLarge_template[0]) - 1 > KSI_TLV_TEMPLATE_INDEX_MAX_LEN);
+
+	assertIndexedParse(tc, ok, sizeof(ok), KSI_TLV_TEMPLATE(TestIdxLarge), false, KSI_OK, &p);
+	CuAssert(tc, "Filler count mismatch.", p->fillers == 2);
+	CuAssert(tc, "Last element value mismatch.", KSI_Integer_equalsUInt(p->last, 3));
+	TestIdx_free(p);
+
+	assertIndexedParse(tc, missing, sizeof(missing), KSI_TLV_TEMPLATE(TestIdxLarge), false, KSI_INVALID_FORMAT, NULL);
+}
+
+static void testTemplateIndexCacheFull(CuTest *tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+	int res;
+	KSI_CTX *c[2] = { NULL, NULL };
+	KSI_Signature *sig[2] = { NULL, NULL };
+	unsigned char *raw[2] = { NULL, NULL };
+	size_t raw_len[2] = { 0, 0 };
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_CTX_new(&c[i]);
+		CuAssert(tc, "Unable to create context.", res == KSI_OK && c[i] != NULL);
+	}
+
+	/* Leave a single free slot, which is taken by the first template parsed. */
+	res = fillTemplateIndexCache(c[1], KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE - 1);
+	CuAssert(tc, "Unable to fill template index cache.", res == KSI_OK);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_Signature_fromFile(c[i], getFullResourcePath(TEST_SIGNATURE_FILE), &sig[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig[i] != NULL);
+
+		res = KSI_Signature_serialize(sig[i], &raw[i], &raw_len[i]);
+		CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw[i] != NULL);
+	}
+
+	CuAssert(tc, "Signature mismatch with and without template index.", raw_len[0] == raw_len[1] && !memcmp(raw[0], raw[1], raw_len[0]));
+	CuAssert(tc, "Signature template should be indexed.", isTemplateIndexed(c[0], KSI_TLV_TEMPLATE(KSI_Signature)));
+	for (i = 0; i < KSI_TLV_TEMPLATE_INDEX_CACHE_SIZE; i++) {
+		CuAssert(tc, "Full template index cache should not be modified.", c[1]->templateIndex[i] != NULL);
+	}
+
+	for (i = 0; i < 2; i++) {
+		KSI_free(raw[i]);
+		KSI_Signature_free(sig[i]);
+		KSI_CTX_free(c[i]);
+	}
+#undef TEST_SIGNATURE_FILE
+}
+
 static void testTlvParseBlobFailWithExtraData(CuTest* tc) {
 	int res;
 	KSI_TLV *tlv = NULL;
@@ -798,6 +1136,10 @@ CuSuite* KSITest_TLV_getSuite(void)
 	SUITE_ADD_TEST(suite, testTlvSerializeMandatoryListObjectEmpty);
 	SUITE_ADD_TEST(suite, testTlvLenientFlag);
 	SUITE_ADD_TEST(suite, testTlvForwardFlag);
+	SUITE_ADD_TEST(suite, testTemplateParseDirect);
+	SUITE_ADD_TEST(suite, testTemplateIndexMoreDefs);
+	SUITE_ADD_TEST(suite, testTemplateIndexLargeTemplate);
+	SUITE_ADD_TEST(suite, testTemplateIndexCacheFull);
 	SUITE_ADD_TEST(suite, testTlvParseBlobFailWithExtraData);
 	SUITE_ADD_TEST(suite, testBadUtf8);
 	SUITE_ADD_TEST(suite, testBadUtf8WithZeros);
@@ -127,6 +127,379 @@ static void testGetAggregationChain(CuTest* tc) {
 	KSI_TreeBuilder_free(builder);
 }
 
+static void testGetAggregationChainLargeTree(CuTest* tc) {
+	int res;
+	KSI_TreeBuilder *builder = NULL;
+	/* Enough leaves for the nodes to span several node blocks of the builder. */
+	KSI_TreeLeafHandle *handles[300];
+	size_t count = sizeof(handles) / sizeof(*handles);
+	size_t i;
+	KSI_DataHash *hsh = NULL;
+	KSI_AggregationHashChain *chn = NULL;
+	KSI_DataHash *tmp = NULL;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	for (i = 0; i < count; i++) {
+		res = KSI_DataHash_create(ctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_TreeBuilder_addDataHash(builder, hsh, 0, &handles[i]);
+		CuAssert(tc, "Unable to add data hash to the tree builder.", res == KSI_OK);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+	CuAssert(tc, "Root node missing.", builder->rootNode != NULL && builder->rootNode->hash != NULL);
+
+	for (i = 0; i < count; i++) {
+		res = KSI_TreeLeafHandle_getAggregationChain(handles[i], &chn);
+		CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && chn != NULL);
+
+		res = KSI_AggregationHashChain_aggregate(chn, 0, NULL, &tmp);
+		CuAssert(tc, "Unable to aggregate the aggregation hash chain.", res == KSI_OK && tmp != NULL);
+		CuAssert(tc, "Root hashes mismatch.", KSI_DataHash_equals(builder->rootNode->hash, tmp));
+
+		KSI_DataHash_free(tmp);
+		tmp = NULL;
+		KSI_AggregationHashChain_free(chn);
+		chn = NULL;
+
+		KSI_TreeLeafHandle_free(handles[i]);
+	}
+
+	KSI_TreeBuilder_free(builder);
+}
+
+static int siblingProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+	return KSI_TreeNode_new(in->ctx, (KSI_DataHash *)c, NULL, (int)in->level, out);
+}
+
+static void addSubtreeLeaves(CuTest *tc, KSI_TreeBuilder *builder, size_t from, size_t to, KSI_TreeLeafHandle **handles) {
+	int res;
+	size_t i;
+	KSI_DataHash *hsh = NULL;
+
+	for (i = from; i < to; i++) {
+		res = KSI_DataHash_create(builder->ctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_TreeBuilder_addDataHash(builder, hsh, (int)(i % 3), &handles[i]);
+		CuAssert(tc, "Unable to add data hash to the tree builder.", res == KSI_OK);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+}
+
+static void writeLeafChain(CuTest *tc, KSI_TreeLeafHandle *handle, unsigned char *buf, size_t buf_size, size_t *buf_len) {
+	int res;
+	KSI_AggregationHashChain *chn = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *shape = NULL;
+	KSI_LIST(KSI_Integer) *chainIndex = NULL;
+	KSI_uint64_t shapeVal = 0;
+
+	res = KSI_TreeLeafHandle_getAggregationChain(handle, &chn);
+	CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && chn != NULL);
+
+	/* Fill the mandatory fields for serialization. */
+	res = KSI_Integer_new(ctx, 1, &aggrTime);
+	CuAssert(tc, "Unable to create aggregation time.", res == KSI_OK);
+	res = KSI_AggregationHashChain_setAggregationTime(chn, aggrTime);
+	CuAssert(tc, "Unable to set aggregation time.", res == KSI_OK);
+
+	res = KSI_AggregationHashChain_calculateShape(chn, &shapeVal);
+	CuAssert(tc, "Unable to calculate chain shape.", res == KSI_OK);
+	res = KSI_Integer_new(ctx, shapeVal, &shape);
+	CuAssert(tc, "Unable to create chain shape.", res == KSI_OK);
+	res = KSI_IntegerList_new(&chainIndex);
+	CuAssert(tc, "Unable to create chain index.", res == KSI_OK);
+	res = KSI_IntegerList_append(chainIndex, shape);
+	CuAssert(tc, "Unable to create chain index.", res == KSI_OK);
+	res = KSI_AggregationHashChain_setChainIndex(chn, chainIndex);
+	CuAssert(tc, "Unable to set chain index.", res == KSI_OK);
+
+	res = KSI_AggregationHashChain_writeBytes(chn, buf, buf_size, buf_len, 0);
+	CuAssert(tc, "Unable to serialize aggregation chain.", res == KSI_OK);
+
+	KSI_AggregationHashChain_free(chn);
+}
+
+static void testAddSubtree(CuTest* tc) {
+	static const size_t sizes[] = { 64, 64, 64, 32, 8, 1, 0 };
+	int res;
+	KSI_CTX *workerCtx = NULL;
+	KSI_TreeBuilder *seqBuilder = NULL;
+	KSI_TreeBuilder *builder = NULL;
+	KSI_TreeBuilder *subtree = NULL;
+	KSI_TreeLeafHandle *seqHandles[233];
+	KSI_TreeLeafHandle *handles[233];
+	KSI_TreeBuilderLeafProcessor seqProc;
+	KSI_TreeBuilderLeafProcessor proc;
+	KSI_DataHash *sibling = NULL;
+	KSI_DataHash *workerSibling = NULL;
+	unsigned char seqBuf[0x1000];
+	unsigned char buf[0x1000];
+	size_t seqLen;
+	size_t len;
+	size_t pos = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	/* The subtrees would normally be built on worker threads, each with its own context. */
+	res = KSI_CTX_new(&workerCtx);
+	CuAssert(tc, "Unable to create worker context.", res == KSI_OK && workerCtx != NULL);
+
+	res = KSI_DataHash_create(ctx, "sibling", 7, KSI_HASHALG_SHA2_256, &sibling);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && sibling != NULL);
+
+	/* The worker keeps a reference to its sibling hash, so the merge has to copy it. */
+	res = KSI_DataHash_create(workerCtx, "sibling", 7, KSI_HASHALG_SHA2_256, &workerSibling);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && workerSibling != NULL);
+
+	seqProc.fn = siblingProcessor;
+	seqProc.c = sibling;
+	seqProc.levelOverhead = 1;
+	proc = seqProc;
+	proc.c = workerSibling;
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &seqBuilder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && seqBuilder != NULL);
+
+	res = KSI_TreeBuilderLeafProcessorList_append(seqBuilder->cbList, &seqProc);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	addSubtreeLeaves(tc, seqBuilder, 0, 233, seqHandles);
+
+	res = KSI_TreeBuilder_close(seqBuilder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	for (i = 0; sizes[i] != 0; i++) {
+		res = KSI_TreeBuilder_new(workerCtx, KSI_HASHALG_SHA2_256, &subtree);
+		CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && subtree != NULL);
+
+		res = KSI_TreeBuilderLeafProcessorList_append(subtree->cbList, &proc);
+		CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+		addSubtreeLeaves(tc, subtree, pos, pos + sizes[i], handles);
+		pos += sizes[i];
+
+		res = KSI_TreeBuilder_addSubtree(builder, subtree);
+		CuAssert(tc, "Unable to add subtree.", res == KSI_OK);
+
+		res = KSI_TreeBuilder_addDataHash(subtree, sibling, 0, NULL);
+		CuAssert(tc, "Leaves may not be added to a merged subtree.", res == KSI_INVALID_STATE);
+
+		KSI_TreeBuilder_free(subtree);
+		subtree = NULL;
+	}
+
+	/* The merged tree may not depend on the worker context. */
+	KSI_DataHash_free(workerSibling);
+	KSI_CTX_free(workerCtx);
+
+	/* The remaining leaves are added one by one. */
+	proc.c = sibling;
+	res = KSI_TreeBuilderLeafProcessorList_append(builder->cbList, &proc);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	addSubtreeLeaves(tc, builder, pos, 233, handles);
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	CuAssert(tc, "Root hashes mismatch.", KSI_DataHash_equals(seqBuilder->rootNode->hash, builder->rootNode->hash));
+	CuAssert(tc, "Root levels mismatch.", seqBuilder->rootNode->level == builder->rootNode->level);
+
+	for (i = 0; i < 233; i++) {
+		writeLeafChain(tc, seqHandles[i], seqBuf, sizeof(seqBuf), &seqLen);
+		writeLeafChain(tc, handles[i], buf, sizeof(buf), &len);
+		CuAssert(tc, "Aggregation chains mismatch.", seqLen == len && !memcmp(seqBuf, buf, len));
+
+		KSI_TreeLeafHandle_free(seqHandles[i]);
+		KSI_TreeLeafHandle_free(handles[i]);
+	}
+
+	KSI_TreeBuilder_free(seqBuilder);
+	KSI_TreeBuilder_free(builder);
+	KSI_DataHash_free(sibling);
+}
+
+#ifdef TEST_THREADS_SUPPORTED
+#define TEST_SUBTREE_WORKER_COUNT 4
+#define TEST_SUBTREE_SIZE 64
+#define TEST_SUBTREE_LEAF_COUNT (TEST_SUBTREE_WORKER_COUNT * TEST_SUBTREE_SIZE + 5)
+
+struct SubtreeWorker_st {
+	KSI_CTX *ctx;
+	KSI_TreeBuilder *subtree;
+	size_t from;
+	KSI_TreeLeafHandle **handles;
+	int res;
+};
+
+/* Fills a subtree the same way as #addSubtreeLeaves. The result is checked by the main thread. */
+TEST_THREAD_FUNC(subtreeWorker, arg) {
+	struct SubtreeWorker_st *w = arg;
+	KSI_DataHash *hsh = NULL;
+	size_t i;
+
+	w->res = KSI_TreeBuilder_new(w->ctx, KSI_HASHALG_SHA2_256, &w->subtree);
+
+	for (i = w->from; w->res == KSI_OK && i < w->from + TEST_SUBTREE_SIZE; i++) {
+		w->res = KSI_DataHash_create(w->ctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+		if (w->res != KSI_OK) break;
+
+		w->res = KSI_TreeBuilder_addDataHash(w->subtree, hsh, (int)(i % 3), &w->handles[i]);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	TEST_THREAD_RETURN;
+}
+
+static void testAddSubtreeThreaded(CuTest* tc) {
+	int res;
+	KSI_TreeBuilder *seqBuilder = NULL;
+	KSI_TreeBuilder *builder = NULL;
+	KSI_TreeLeafHandle *seqHandles[TEST_SUBTREE_LEAF_COUNT];
+	KSI_TreeLeafHandle *handles[TEST_SUBTREE_LEAF_COUNT];
+	struct SubtreeWorker_st worker[TEST_SUBTREE_WORKER_COUNT];
+	TestThread thread[TEST_SUBTREE_WORKER_COUNT];
+	unsigned char seqBuf[0x1000];
+	unsigned char buf[0x1000];
+	size_t seqLen;
+	size_t len;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	memset(handles, 0, sizeof(handles));
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &seqBuilder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && seqBuilder != NULL);
+
+	addSubtreeLeaves(tc, seqBuilder, 0, TEST_SUBTREE_LEAF_COUNT, seqHandles);
+
+	res = KSI_TreeBuilder_close(seqBuilder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	/* Every worker fills its subtree on its own context. */
+	for (i = 0; i < TEST_SUBTREE_WORKER_COUNT; i++) {
+		worker[i].ctx = NULL;
+		worker[i].subtree = NULL;
+		worker[i].from = i * TEST_SUBTREE_SIZE;
+		worker[i].handles = handles;
+		worker[i].res = KSI_UNKNOWN_ERROR;
+
+		res = KSI_CTX_new(&worker[i].ctx);
+		CuAssert(tc, "Unable to create worker context.", res == KSI_OK && worker[i].ctx != NULL);
+	}
+
+	for (i = 0; i < TEST_SUBTREE_WORKER_COUNT; i++) {
+		res = TestThread_create(&thread[i], subtreeWorker, &worker[i]);
+		CuAssert(tc, "Unable to start worker thread.", res == 0);
+	}
+	for (i = 0; i < TEST_SUBTREE_WORKER_COUNT; i++) {
+		TestThread_join(thread[i]);
+	}
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	/* The subtrees are merged in the order of their ranges. */
+	for (i = 0; i < TEST_SUBTREE_WORKER_COUNT; i++) {
+		CuAssert(tc, "Worker failed to fill its subtree.", worker[i].res == KSI_OK);
+
+		res = KSI_TreeBuilder_addSubtree(builder, worker[i].subtree);
+		CuAssert(tc, "Unable to add subtree.", res == KSI_OK);
+
+		KSI_TreeBuilder_free(worker[i].subtree);
+		KSI_CTX_free(worker[i].ctx);
+	}
+
+	addSubtreeLeaves(tc, builder, TEST_SUBTREE_WORKER_COUNT * TEST_SUBTREE_SIZE, TEST_SUBTREE_LEAF_COUNT, handles);
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	CuAssert(tc, "Root hashes mismatch.", KSI_DataHash_equals(seqBuilder->rootNode->hash, builder->rootNode->hash));
+	CuAssert(tc, "Root levels mismatch.", seqBuilder->rootNode->level == builder->rootNode->level);
+
+	for (i = 0; i < TEST_SUBTREE_LEAF_COUNT; i++) {
+		writeLeafChain(tc, seqHandles[i], seqBuf, sizeof(seqBuf), &seqLen);
+		writeLeafChain(tc, handles[i], buf, sizeof(buf), &len);
+		CuAssert(tc, "Aggregation chains mismatch.", seqLen == len && !memcmp(seqBuf, buf, len));
+
+		KSI_TreeLeafHandle_free(seqHandles[i]);
+		KSI_TreeLeafHandle_free(handles[i]);
+	}
+
+	KSI_TreeBuilder_free(seqBuilder);
+	KSI_TreeBuilder_free(builder);
+}
+#undef TEST_SUBTREE_LEAF_COUNT
+#undef TEST_SUBTREE_SIZE
+#undef TEST_SUBTREE_WORKER_COUNT
+#endif
+
+static void testAddSubtreeInvalidSize(CuTest* tc) {
+	int res;
+	KSI_TreeBuilder *builder = NULL;
+	KSI_TreeBuilder *subtree = NULL;
+	KSI_TreeLeafHandle *handles[8];
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &subtree);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && subtree != NULL);
+
+	/* Three leaves is not a power of two. */
+	addSubtreeLeaves(tc, subtree, 0, 3, handles);
+	res = KSI_TreeBuilder_addSubtree(builder, subtree);
+	CuAssert(tc, "Subtree size must be a power of two.", res == KSI_INVALID_STATE);
+
+	/* Four leaves may not follow two leaves. */
+	addSubtreeLeaves(tc, subtree, 3, 4, handles);
+	addSubtreeLeaves(tc, builder, 4, 6, handles);
+	res = KSI_TreeBuilder_addSubtree(builder, subtree);
+	CuAssert(tc, "Subtree may not be added at an unaligned position.", res == KSI_INVALID_STATE);
+
+	addSubtreeLeaves(tc, builder, 6, 7, handles);
+	res = KSI_TreeBuilder_addSubtree(builder, subtree);
+	CuAssert(tc, "Subtree may not be added at an unaligned position.", res == KSI_INVALID_STATE);
+
+	addSubtreeLeaves(tc, builder, 7, 8, handles);
+	res = KSI_TreeBuilder_addSubtree(builder, subtree);
+	CuAssert(tc, "Unable to add subtree.", res == KSI_OK);
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK && builder->rootNode != NULL);
+
+	for (i = 0; i < 8; i++) {
+		KSI_TreeLeafHandle_free(handles[i]);
+	}
+
+	KSI_TreeBuilder_free(subtree);
+	KSI_TreeBuilder_free(builder);
+}
+
 static void testMaxTreeLevelt1(CuTest *tc) {
 	int res;
 	KSI_TreeBuilder *builder = NULL;
@@ -325,6 +698,12 @@ CuSuite* KSITest_TreeBuilder_getSuite(void)
 	SUITE_ADD_TEST(suite, testCreateTreeBuilder);
 	SUITE_ADD_TEST(suite, testTreeBuilderAddLeafs);
 	SUITE_ADD_TEST(suite, testGetAggregationChain);
+	SUITE_ADD_TEST(suite, testGetAggregationChainLargeTree);
+	SUITE_ADD_TEST(suite, testAddSubtree);
+#ifdef TEST_THREADS_SUPPORTED
+	SUITE_ADD_TEST(suite, testAddSubtreeThreaded);
+#endif
+	SUITE_ADD_TEST(suite, testAddSubtreeInvalidSize);
 	SUITE_ADD_TEST(suite, testMaxTreeLevelt1);
 	SUITE_ADD_TEST(suite, testMaxTreeLevelWithAbove0Level);
 	SUITE_ADD_TEST(suite, testMaxTreeLevelWithFullTree);
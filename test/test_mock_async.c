@@ -48,6 +48,10 @@ typedef struct {
 
 	/* Poiter to the async options. */
 	size_t *options;
+	/* Poiter to the async client statistics. */
+	KSI_AsyncStatistics *stats;
+	/* Pointer to the time of the next request cache check of the async client. */
+	time_t *nextSweep;
 
 	/* Endpoint data. */
 	const char **paths;
@@ -57,10 +61,14 @@ typedef struct {
 	const char *ksi_pass;
 } KSITest_FileAsyncClientCtx;
 
-static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err, long ext) {
+static void reqQueue_clearWithError(KSITest_FileAsyncClientCtx *clientCtx, int err, long ext) {
+	KSI_LIST(KSI_AsyncHandle) *reqQueue = clientCtx->reqQueue;
 	size_t size = 0;
 
-	if (reqQueue == NULL) return;
+	if (reqQueue == NULL || KSI_AsyncHandleList_length(reqQueue) == 0) return;
+
+	/* Let the async client collect the failed requests on the next cache check. */
+	*clientCtx->nextSweep = 0;
 
 	while ((size = KSI_AsyncHandleList_length(reqQueue)) > 0) {
 		int res;
@@ -119,6 +127,12 @@ static int dispatch(KSITest_FileAsyncClientCtx *clientCtx) {
 		if (req->state == KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
 			clientCtx->roundCount++;
 
+			/* Update statistics. */
+			req->sndTimeMs = KSI_getMonotonicTimeMs();
+			clientCtx->stats->sent++;
+			clientCtx->stats->bytesOut += req->len;
+			KSI_AsyncStatistics_addSample(clientCtx->stats->queueTime, req->sndTimeMs - req->reqTimeMs);
+
 			/* Release the serialized payload. */
 			KSI_free(req->raw);
 			req->raw = NULL;
@@ -159,7 +173,7 @@ static int dispatch(KSITest_FileAsyncClientCtx *clientCtx) {
 
 			res = KSI_FTLV_fileRead(clientCtx->file, buf, KSI_TLV_MAX_SIZE,  &count, &ftlv);
 			if (res != KSI_OK && count != 0) {
-				reqQueue_clearWithError(clientCtx->reqQueue, res, 0);
+				reqQueue_clearWithError(clientCtx, res, 0);
 				KSI_LOG_error(clientCtx->ctx, "[%p] Unable to read TLV from file. Error: 0x%x.", clientCtx, res);
 				res = KSI_OK;
 				goto cleanup;
@@ -167,7 +181,7 @@ static int dispatch(KSITest_FileAsyncClientCtx *clientCtx) {
 
 			if (count != 0) {
 				if (count > KSI_TLV_MAX_SIZE){
-					reqQueue_clearWithError(clientCtx->reqQueue, res = KSI_BUFFER_OVERFLOW, 0);
+					reqQueue_clearWithError(clientCtx, res = KSI_BUFFER_OVERFLOW, 0);
 					KSI_LOG_error(clientCtx->ctx, "[%p] Too much data read from file. Error: 0x%x.", clientCtx, res);
 					res = KSI_OK;
 					goto cleanup;
@@ -320,6 +334,10 @@ static int FileAsyncCtx_new(KSI_CTX *ctx, KSITest_FileAsyncClientCtx **clientCtx
 	tmp->roundStartAt = 0;
 	tmp->roundCount = 0;
 
+	tmp->options = NULL;
+	tmp->stats = NULL;
+	tmp->nextSweep = NULL;
+
 	/* Initialize io queues. */
 	res = KSI_AsyncHandleList_new(&tmp->reqQueue);
 	if (res != KSI_OK) goto cleanup;
@@ -358,6 +376,8 @@ static int FileAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	if (res != KSI_OK) goto cleanup;
 
 	clientImpl->options = tmp->options;
+	clientImpl->stats = &tmp->stats;
+	clientImpl->nextSweep = &tmp->nextSweep;
 
 	tmp->clientImpl_free = (void (*)(void*))FileAsyncCtx_free;
 	tmp->clientImpl = clientImpl;